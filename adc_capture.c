@@ -0,0 +1,350 @@
+/*
+ adc_capture.c
+
+ Local ADC acquisition engine.
+
+ • Timer 0A triggers ADC0 sample sequencer 0 at the sample rate; each trigger
+   runs Oversample conversions that the ADC averages in hardware, so the ADC
+   itself can run at its full 1 MSPS while the output rate is reduced
+ • Results are moved from the sequencer FIFO to SRAM by uDMA in ping-pong mode:
+   while one buffer is filled the other one is handed to the main loop, so no
+   CPU work is done per sample
+ • The uDMA completion interrupt re-arms the finished buffer; a buffer that is
+   completed again before the main loop released it is counted as an overrun
+ • Optionally a second step feeds the same input to digital comparator 0; its
+   interrupt latches the index of the sample stream at which the input entered
+   the high band, used as a hardware trigger for triggered captures
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_types.h"
+#include "inc/hw_adc.h"
+#include "driverlib/adc.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/timer.h"
+#include "driverlib/udma.h"
+#include "driverlib/rom.h"
+#include "driverlib/rom_map.h"
+
+#include "dma_table.h"
+#include "adc_capture.h"
+
+//*****************************************************************************
+//
+// ADC Capture State
+//
+//*****************************************************************************
+
+#define ADCC_SEQUENCE       0                       // Sample sequencer used (8-entry FIFO)
+
+static uint16_t ADCC_Buffer[2][ADCC_BLOCK_SAMPLES];     // Ping-pong buffers (primary, alternate)
+static volatile uint32_t ADCC_Active = 0;       // Half the uDMA is currently filling
+static volatile uint32_t ADCC_Ready = 0;        // Filled buffers not yet released (0..2)
+static volatile uint32_t ADCC_ReadIndex = 0;    // Oldest filled buffer
+static uint32_t ADCC_Oversample = 1;            // Hardware averaging factor
+static uint32_t ADCC_Channel = 0;               // ADC input being captured
+static uint32_t ADCC_Steps = 1;                 // Conversions per trigger (2 with the comparator)
+static volatile bool ADCC_Triggered = false;    // Comparator fired since the last AdcCaptureTriggerGet
+static volatile uint32_t ADCC_TriggerIndex = 0; // Sample index at which the comparator fired
+static volatile AdcCaptureStats ADCC_Stats;     // Capture statistics
+
+//*****************************************************************************
+//
+// AdcCaptureArm: Points one half of the ping-pong transfer at its buffer
+//
+// \param Half:     0 for the primary, 1 for the alternate control structure
+//
+//*****************************************************************************
+
+static void AdcCaptureArm(uint32_t Half)
+{
+    MAP_uDMAChannelTransferSet(UDMA_CHANNEL_ADC0 | (Half ? UDMA_ALT_SELECT : UDMA_PRI_SELECT),
+                           UDMA_MODE_PINGPONG, (void *)(ADC0_BASE + ADC_O_SSFIFO0),
+                           ADCC_Buffer[Half], ADCC_BLOCK_SAMPLES);
+}
+
+//*****************************************************************************
+//
+// AdcCaptureDone: Re-arms a finished half and queues it for the main loop
+//
+//*****************************************************************************
+
+static void AdcCaptureDone(uint32_t Half)
+{
+    AdcCaptureArm(Half);
+    ADCC_Stats.Blocks++;
+    ADCC_Active = Half ^ 1;
+
+    if (ADCC_Ready < 2)
+    {
+        ADCC_Ready++;
+    }
+    else
+    {
+        // Both buffers were still unreleased: the oldest one has just been
+        // overwritten, so the other half is now the oldest
+        ADCC_Stats.Overruns++;
+        ADCC_ReadIndex = Half ^ 1;
+    }
+}
+
+//*****************************************************************************
+//
+// AdcCaptureInit: Configures ADC0 sequencer 0, Timer 0A and the uDMA channel
+//
+// \param Channel:      ADC input (ADC_CTL_CH0 .. ADC_CTL_CH11)
+// \param Oversample:   Hardware averaging factor (1, 2, 4 .. 64)
+//
+//*****************************************************************************
+
+void AdcCaptureInit(uint32_t Channel, uint32_t Oversample)
+{
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_ADC0);
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER0);
+    DMATableInit();
+
+    // Run the converter at its full 1 MSPS; oversampling averages consecutive conversions
+    HWREG(ADC0_BASE + ADC_O_PC) = ADC_PC_SR_1M;
+    ADCC_Oversample = (Oversample > 1) ? Oversample : 1;
+    MAP_ADCHardwareOversampleConfigure(ADC0_BASE, (ADCC_Oversample > 1) ? ADCC_Oversample : 0);
+
+    // One conversion of Channel per timer trigger
+    ADCC_Channel = Channel;
+    AdcCaptureComparatorOff();
+    MAP_ADCSequenceDMAEnable(ADC0_BASE, ADCC_SEQUENCE);
+
+    // Timer 0A as a periodic ADC trigger
+    MAP_TimerConfigure(TIMER0_BASE, TIMER_CFG_PERIODIC);
+    MAP_TimerControlTrigger(TIMER0_BASE, TIMER_A, true);
+
+    // Peripheral-to-memory, 16-bit results, one request per conversion
+    MAP_uDMAChannelAssign(UDMA_CH14_ADC0_0);
+    MAP_uDMAChannelAttributeDisable(UDMA_CHANNEL_ADC0, UDMA_ATTR_ALTSELECT | UDMA_ATTR_HIGH_PRIORITY |
+                                                   UDMA_ATTR_REQMASK | UDMA_ATTR_USEBURST);
+    MAP_uDMAChannelControlSet(UDMA_CHANNEL_ADC0 | UDMA_PRI_SELECT,
+                          UDMA_SIZE_16 | UDMA_SRC_INC_NONE | UDMA_DST_INC_16 | UDMA_ARB_1);
+    MAP_uDMAChannelControlSet(UDMA_CHANNEL_ADC0 | UDMA_ALT_SELECT,
+                          UDMA_SIZE_16 | UDMA_SRC_INC_NONE | UDMA_DST_INC_16 | UDMA_ARB_1);
+}
+
+//*****************************************************************************
+//
+// AdcCaptureComparatorSet: Adds a step that passes each trigger's conversion
+// to digital comparator 0, which interrupts once when the input rises above
+// High and re-arms after it falls below Low; call while capture is stopped
+//
+// \param Low:      Lower band limit (12-bit)
+// \param High:     Upper band limit (12-bit)
+//
+//*****************************************************************************
+
+void AdcCaptureComparatorSet(uint32_t Low, uint32_t High)
+{
+    MAP_ADCSequenceDisable(ADC0_BASE, ADCC_SEQUENCE);
+    MAP_ADCSequenceConfigure(ADC0_BASE, ADCC_SEQUENCE, ADC_TRIGGER_TIMER, 0);
+
+    // Converted values sent to a comparator do not reach the FIFO, so the input
+    // is converted twice per trigger
+    MAP_ADCSequenceStepConfigure(ADC0_BASE, ADCC_SEQUENCE, 0, ADCC_Channel | ADC_CTL_IE);
+    MAP_ADCSequenceStepConfigure(ADC0_BASE, ADCC_SEQUENCE, 1, ADCC_Channel | ADC_CTL_CMP0 | ADC_CTL_END);
+    ADCC_Steps = 2;
+
+    MAP_ADCComparatorConfigure(ADC0_BASE, 0, ADC_COMP_TRIG_NONE | ADC_COMP_INT_HIGH_HONCE);
+    MAP_ADCComparatorRegionSet(ADC0_BASE, 0, Low, High);
+    MAP_ADCComparatorReset(ADC0_BASE, 0, true, true);
+    MAP_ADCComparatorIntClear(ADC0_BASE, 0x0F);
+    MAP_ADCComparatorIntEnable(ADC0_BASE, ADCC_SEQUENCE);
+
+    ADCC_Triggered = false;
+}
+
+//*****************************************************************************
+//
+// AdcCaptureComparatorOff: Returns to one FIFO conversion per trigger; call
+// while capture is stopped
+//
+//*****************************************************************************
+
+void AdcCaptureComparatorOff(void)
+{
+    MAP_ADCSequenceDisable(ADC0_BASE, ADCC_SEQUENCE);
+    MAP_ADCComparatorIntDisable(ADC0_BASE, ADCC_SEQUENCE);
+    MAP_ADCSequenceConfigure(ADC0_BASE, ADCC_SEQUENCE, ADC_TRIGGER_TIMER, 0);
+    MAP_ADCSequenceStepConfigure(ADC0_BASE, ADCC_SEQUENCE, 0, ADCC_Channel | ADC_CTL_IE | ADC_CTL_END);
+    ADCC_Steps = 1;
+    ADCC_Triggered = false;
+}
+
+//*****************************************************************************
+//
+// AdcCaptureTriggerGet: Takes the comparator trigger, if it fired
+//
+// \param Index:    Receives the index of the sample (counted from
+//                  AdcCaptureStart) at which the comparator fired
+//
+// \return true if the comparator fired since the last call
+//
+//*****************************************************************************
+
+bool AdcCaptureTriggerGet(uint32_t *Index)
+{
+    if (!ADCC_Triggered)
+    {
+        return false;
+    }
+
+    *Index = ADCC_TriggerIndex;
+    ADCC_Triggered = false;
+    return true;
+}
+
+//*****************************************************************************
+//
+// AdcCaptureStart: Starts continuous acquisition
+//
+// \param SysClock:     System clock in Hz (Timer 0 clock)
+// \param SampleRate:   Output samples per second
+//
+// \return false if the conversions needed per second exceed 1 MSPS
+//
+//*****************************************************************************
+
+bool AdcCaptureStart(uint32_t SysClock, uint32_t SampleRate)
+{
+    if ((SampleRate == 0) || (SampleRate > (ADCC_MAX_CONVERSIONS / (ADCC_Oversample * ADCC_Steps))))
+    {
+        return false;
+    }
+
+    ADCC_Ready = 0;
+    ADCC_ReadIndex = 0;
+    ADCC_Active = 0;
+    ADCC_Triggered = false;
+    ADCC_Stats.Blocks = 0;
+    ADCC_Stats.Overruns = 0;
+    ADCC_Stats.FifoOverflows = 0;
+
+    AdcCaptureArm(0);
+    AdcCaptureArm(1);
+    MAP_uDMAChannelEnable(UDMA_CHANNEL_ADC0);
+
+    // The uDMA completion is signalled on the sequencer interrupt; the per-sample
+    // sequencer interrupt itself stays masked
+    MAP_ADCSequenceOverflowClear(ADC0_BASE, ADCC_SEQUENCE);
+    MAP_ADCSequenceEnable(ADC0_BASE, ADCC_SEQUENCE);
+    MAP_IntEnable(INT_ADC0SS0);
+
+    MAP_TimerLoadSet(TIMER0_BASE, TIMER_A, (SysClock / SampleRate) - 1);
+    MAP_TimerEnable(TIMER0_BASE, TIMER_A);
+    return true;
+}
+
+//*****************************************************************************
+//
+// AdcCaptureStop: Stops the trigger timer and the uDMA channel
+//
+//*****************************************************************************
+
+void AdcCaptureStop(void)
+{
+    MAP_TimerDisable(TIMER0_BASE, TIMER_A);
+    MAP_IntDisable(INT_ADC0SS0);
+    MAP_ADCSequenceDisable(ADC0_BASE, ADCC_SEQUENCE);
+    MAP_uDMAChannelDisable(UDMA_CHANNEL_ADC0);
+}
+
+//*****************************************************************************
+//
+// AdcCaptureBlockGet: Returns the oldest filled buffer of ADCC_BLOCK_SAMPLES
+// 12-bit results, or 0 if none is ready; it stays valid until released and
+// must be released before the other buffer fills
+//
+//*****************************************************************************
+
+const uint16_t *AdcCaptureBlockGet(void)
+{
+    if (ADCC_Ready == 0)
+    {
+        return 0;
+    }
+
+    return ADCC_Buffer[ADCC_ReadIndex];
+}
+
+//*****************************************************************************
+//
+// AdcCaptureBlockRelease: Hands the buffer returned by AdcCaptureBlockGet back
+//
+//*****************************************************************************
+
+void AdcCaptureBlockRelease(void)
+{
+    MAP_IntDisable(INT_ADC0SS0);
+
+    if (ADCC_Ready)
+    {
+        ADCC_Ready--;
+        ADCC_ReadIndex ^= 1;
+    }
+
+    MAP_IntEnable(INT_ADC0SS0);
+}
+
+//*****************************************************************************
+//
+// AdcCaptureStatsGet: Copies the current capture statistics
+//
+// \param Stats:    Pointer to the structure to fill in
+//
+//*****************************************************************************
+
+void AdcCaptureStatsGet(AdcCaptureStats *Stats)
+{
+    *Stats = ADCC_Stats;
+}
+
+//*****************************************************************************
+//
+// AdcCaptureIntHandler: ADC0 sequencer 0 interrupt; runs once per filled
+// buffer when the uDMA transfer completes, and when the comparator fires
+//
+//*****************************************************************************
+
+void AdcCaptureIntHandler(void)
+{
+    MAP_ADCIntClear(ADC0_BASE, ADCC_SEQUENCE);
+
+    // Comparator hit: note where in the sample stream it happened (the uDMA
+    // transfer count of the active half gives the position within the buffer)
+    if (MAP_ADCComparatorIntStatus(ADC0_BASE) & (1 << 0))
+    {
+        MAP_ADCComparatorIntClear(ADC0_BASE, 1 << 0);
+        if (!ADCC_Triggered)
+        {
+            ADCC_TriggerIndex = (ADCC_Stats.Blocks * ADCC_BLOCK_SAMPLES) + ADCC_BLOCK_SAMPLES -
+                                MAP_uDMAChannelSizeGet(UDMA_CHANNEL_ADC0 | (ADCC_Active ? UDMA_ALT_SELECT : UDMA_PRI_SELECT));
+            ADCC_Triggered = true;
+        }
+    }
+
+    if (MAP_ADCSequenceOverflow(ADC0_BASE, ADCC_SEQUENCE))
+    {
+        ADCC_Stats.FifoOverflows++;
+        MAP_ADCSequenceOverflowClear(ADC0_BASE, ADCC_SEQUENCE);
+    }
+
+    // A stopped control structure is the half that has just been filled
+    if (MAP_uDMAChannelModeGet(UDMA_CHANNEL_ADC0 | UDMA_PRI_SELECT) == UDMA_MODE_STOP)
+    {
+        AdcCaptureDone(0);
+    }
+    if (MAP_uDMAChannelModeGet(UDMA_CHANNEL_ADC0 | UDMA_ALT_SELECT) == UDMA_MODE_STOP)
+    {
+        AdcCaptureDone(1);
+    }
+}
@@ -0,0 +1,41 @@
+/*
+ adc_capture.h
+
+ Timer-triggered local ADC acquisition with hardware oversampling and uDMA
+ ping-pong transfers into SRAM.
+ */
+
+#ifndef ADC_CAPTURE_H_
+#define ADC_CAPTURE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// ADC Capture Settings
+//
+//*****************************************************************************
+
+#define ADCC_BLOCK_SAMPLES      512         // Samples per ping-pong buffer (max 1024 per uDMA transfer)
+#define ADCC_MAX_CONVERSIONS    1000000     // ADC conversion rate limit (1 MSPS)
+
+// Capture statistics
+typedef struct {
+    uint32_t Blocks;                // Buffers filled since AdcCaptureStart
+    uint32_t Overruns;              // Buffers overwritten before they were released
+    uint32_t FifoOverflows;         // Sequencer FIFO overflows (uDMA did not keep up)
+} AdcCaptureStats;
+
+extern void AdcCaptureInit(uint32_t Channel, uint32_t Oversample);
+extern void AdcCaptureComparatorSet(uint32_t Low, uint32_t High);
+extern void AdcCaptureComparatorOff(void);
+extern bool AdcCaptureTriggerGet(uint32_t *Index);
+extern bool AdcCaptureStart(uint32_t SysClock, uint32_t SampleRate);
+extern void AdcCaptureStop(void);
+extern const uint16_t *AdcCaptureBlockGet(void);
+extern void AdcCaptureBlockRelease(void);
+extern void AdcCaptureStatsGet(AdcCaptureStats *Stats);
+extern void AdcCaptureIntHandler(void);
+
+#endif /* ADC_CAPTURE_H_ */
@@ -0,0 +1,225 @@
+/*
+ calibration.c
+
+ Per-module sensor calibration.
+
+ • Each sensor module (identified by the ID in its 0x7DF broadcast) can have
+   its own polynomial, so a module swapped on the bus is converted with the
+   right coefficients
+ • The calibrations live in the journaled flash parameter block, so they
+   survive resets and updating one costs a single 128-byte block append
+ • CalibrationSelect copies the polynomial of the module being processed into
+   RAM once; CalibrationApply is then one FPU Horner evaluation per sample,
+   cheap enough for the export loops and the live stream
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "flash_params.h"
+#include "fixed_math.h"
+#include "calibration.h"
+
+//*****************************************************************************
+//
+// Calibration State
+//
+//*****************************************************************************
+
+static FixPoly CAL_Poly;                    // Polynomial of the selected module
+static bool CAL_Active = false;             // A calibration is selected
+static uint32_t CAL_ModuleID = 0;           // Module passed to the last CalibrationSelect
+
+//*****************************************************************************
+//
+// CalibrationFind: Returns the slot of a module in a parameter block, or 0
+//
+//*****************************************************************************
+
+static FlashParamsCal *CalibrationFind(FlashParams *Params, uint32_t ModuleID)
+{
+    uint32_t lop;
+
+    if (ModuleID == 0)
+    {
+        return 0;
+    }
+
+    for (lop = 0; lop < FLASH_PARAMS_CAL_SLOTS; lop++)
+    {
+        if (Params->Cal[lop].ModuleID == ModuleID)
+        {
+            return &Params->Cal[lop];
+        }
+    }
+
+    return 0;
+}
+
+//*****************************************************************************
+//
+// CalibrationSelect: Selects the calibration used by CalibrationApply
+//
+// \param ModuleID:     Module whose samples are processed next (0 = none)
+//
+// \return true if the module has a calibration; otherwise samples pass
+//         through unchanged
+//
+//*****************************************************************************
+
+bool CalibrationSelect(uint32_t ModuleID)
+{
+    FlashParamsCal *Cal = CalibrationFind(FlashParamsGet(), ModuleID);
+
+    CAL_ModuleID = ModuleID;
+    CAL_Active = (Cal != 0);
+    if (CAL_Active)
+    {
+        CAL_Poly = Cal->Poly;
+    }
+
+    return CAL_Active;
+}
+
+//*****************************************************************************
+//
+// CalibrationActive: Returns true if CalibrationApply converts samples
+//
+//*****************************************************************************
+
+bool CalibrationActive(void)
+{
+    return CAL_Active;
+}
+
+//*****************************************************************************
+//
+// CalibrationApply: Converts a raw sample with the selected calibration
+//
+// \return The value in CAL_UNIT, or the raw sample if none is selected
+//
+//*****************************************************************************
+
+int32_t CalibrationApply(uint32_t Raw)
+{
+    if (!CAL_Active)
+    {
+        return (int32_t)Raw;
+    }
+
+    return FixPolyApply(&CAL_Poly, (int32_t)Raw);
+}
+
+//*****************************************************************************
+//
+// CalibrationGet: Returns the stored calibration of a module
+//
+// \return false if the module has none
+//
+//*****************************************************************************
+
+bool CalibrationGet(uint32_t ModuleID, FixPoly *Poly)
+{
+    FlashParamsCal *Cal = CalibrationFind(FlashParamsGet(), ModuleID);
+
+    if (Cal == 0)
+    {
+        return false;
+    }
+
+    *Poly = Cal->Poly;
+    return true;
+}
+
+//*****************************************************************************
+//
+// CalibrationSet: Stores the calibration of a module in the parameter block;
+// a new module takes a free slot, or the first slot if all are in use
+//
+// \param ModuleID:     Module ID (not 0)
+// \param Poly:         Polynomial from raw counts to CAL_UNIT
+//
+// \return true if the parameter block was saved
+//
+//*****************************************************************************
+
+bool CalibrationSet(uint32_t ModuleID, const FixPoly *Poly)
+{
+    FlashParams Params;
+    FlashParamsCal *Cal;
+    uint32_t lop;
+
+    if ((ModuleID == 0) || (Poly->Order > FIX_POLY_MAX_ORDER))
+    {
+        return false;
+    }
+
+    // Edit a copy; the working parameters only change once it is in flash
+    Params = *FlashParamsGet();
+    Cal = CalibrationFind(&Params, ModuleID);
+    for (lop = 0; (Cal == 0) && (lop < FLASH_PARAMS_CAL_SLOTS); lop++)
+    {
+        if (Params.Cal[lop].ModuleID == 0)
+        {
+            Cal = &Params.Cal[lop];
+        }
+    }
+    if (Cal == 0)
+    {
+        Cal = &Params.Cal[0];
+    }
+
+    Cal->ModuleID = ModuleID;
+    Cal->Poly = *Poly;
+
+    if (!FlashParamsSaveCopy(&Params))
+    {
+        return false;
+    }
+
+    // Drop a stale copy if this module is the selected one
+    if (CAL_ModuleID == ModuleID)
+    {
+        CAL_Active = false;
+    }
+    return true;
+}
+
+//*****************************************************************************
+//
+// CalibrationClear: Removes the calibration of a module
+//
+// \return true if the parameter block was saved
+//
+//*****************************************************************************
+
+bool CalibrationClear(uint32_t ModuleID)
+{
+    FlashParams Params = *FlashParamsGet();
+    FlashParamsCal *Cal = CalibrationFind(&Params, ModuleID);
+    uint32_t lop;
+
+    if (Cal == 0)
+    {
+        return true;
+    }
+
+    Cal->ModuleID = 0;
+    Cal->Poly.Order = 0;
+    for (lop = 0; lop <= FIX_POLY_MAX_ORDER; lop++)
+    {
+        Cal->Poly.Coeffs[lop] = 0.0f;
+    }
+
+    if (!FlashParamsSaveCopy(&Params))
+    {
+        return false;
+    }
+
+    // Samples of this module are no longer converted
+    if (CAL_ModuleID == ModuleID)
+    {
+        CAL_Active = false;
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+/*
+ calibration.h
+
+ Per-module sensor calibration: converts raw sensor counts to engineering
+ units with a polynomial stored in the flash parameter block for each sensor
+ module ID.
+ */
+
+#ifndef CALIBRATION_H_
+#define CALIBRATION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fixed_math.h"
+
+//*****************************************************************************
+//
+// Calibration Settings
+//
+//*****************************************************************************
+
+#define CAL_UNIT                "Pa"        // Unit of calibrated values
+
+extern bool CalibrationSelect(uint32_t ModuleID);
+extern bool CalibrationActive(void);
+extern int32_t CalibrationApply(uint32_t Raw);
+extern bool CalibrationGet(uint32_t ModuleID, FixPoly *Poly);
+extern bool CalibrationSet(uint32_t ModuleID, const FixPoly *Poly);
+extern bool CalibrationClear(uint32_t ModuleID);
+
+#endif /* CALIBRATION_H_ */
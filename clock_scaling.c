@@ -0,0 +1,227 @@
+/*
+ clock_scaling.c
+
+ Dynamic system clock scaling.
+
+ • Two profiles: idle runs the core straight from the 16 MHz crystal with the
+   PLL powered down, full runs it at 80 MHz from the PLL. The application
+   picks the profile (full while anything runs, idle once it has been quiet
+   for a while); the ADC is clocked from the PLL and only runs at full
+ • Every peripheral whose bit or tick timing is derived from the system clock
+   (UART baud, CAN bit timing, I2C SCL, SysTick) registers a callback. Before
+   a switch each one is called to let a transfer in progress finish, since a
+   frame on the wire would be corrupted by a divider change; after the switch
+   each one reprograms its dividers for the new clock
+ • The switch time covers SysCtlClockSet (which runs on the 16 MHz crystal
+   while the PLL is bypassed and, going up, while it locks) and the
+   reprogramming callbacks; it is taken from the DWT cycle counter, scaling
+   each part by the clock it ran at. The wait for transfers is kept apart as
+   it depends on the traffic, not on the switch
+ • The time spent in each profile is kept so the saving can be estimated
+   from the run-mode currents in clock_scaling.h
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "inc/hw_types.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/rom.h"
+#include "driverlib/rom_map.h"
+
+#include "cycle_counter.h"
+#include "clock_scaling.h"
+
+//*****************************************************************************
+//
+// Clock Scaling State
+//
+//*****************************************************************************
+
+#define CLK_BYPASS_MHZ          16          // Crystal the core runs on during SysCtlClockSet
+
+// SysCtlClockSet configuration of each profile
+static const uint32_t CLK_Config[CLK_PROFILES] = {
+    SYSCTL_SYSDIV_1 | SYSCTL_USE_OSC | SYSCTL_OSC_MAIN | SYSCTL_XTAL_16MHZ,       // USE_OSC powers the PLL down
+    SYSCTL_SYSDIV_2_5 | SYSCTL_USE_PLL | SYSCTL_OSC_MAIN | SYSCTL_XTAL_16MHZ
+};
+
+static ClockCallback CLK_Callbacks[CLK_MAX_CALLBACKS];  // Registered peripherals
+static uint32_t CLK_Count = 0;                  // Callbacks registered
+static uint32_t CLK_Profile = CLK_PROFILE_FULL; // Current profile
+static uint32_t CLK_SysClock = 0;               // Current system clock in Hz
+static uint32_t CLK_Since = 0;                  // Time the current profile was entered or counted
+static ClockStats CLK_Stats;                    // Switch statistics
+
+//*****************************************************************************
+//
+// CLK_Residency: Adds the time since the last count to the current profile
+//
+//*****************************************************************************
+
+static void CLK_Residency(uint32_t NowMS)
+{
+    CLK_Stats.ProfileMS[CLK_Profile] += NowMS - CLK_Since;
+    CLK_Since = NowMS;
+}
+
+//*****************************************************************************
+//
+// ClockInit: Sets the starting profile; call first thing in main, before the
+// peripherals are set up (no callbacks are made)
+//
+// \param Profile:  CLK_PROFILE_*
+// \param NowMS:    Current time in ms
+//
+// \return The system clock in Hz
+//
+//*****************************************************************************
+
+uint32_t ClockInit(uint32_t Profile, uint32_t NowMS)
+{
+    CLK_Profile = Profile;
+    MAP_SysCtlClockSet(CLK_Config[Profile]);
+
+    // SysCtlClockGet is always the flash version, the TM4C123 ROM one does not
+    // decode the /2.5 divider
+    CLK_SysClock = SysCtlClockGet();
+    ClockStatsClear(NowMS);
+    return CLK_SysClock;
+}
+
+//*****************************************************************************
+//
+// ClockCallbackRegister: Adds a peripheral to be told about clock switches;
+// callbacks are made in the order registered
+//
+// \param Callback: The peripheral's callback
+//
+// \return false if CLK_MAX_CALLBACKS are already registered
+//
+//*****************************************************************************
+
+bool ClockCallbackRegister(ClockCallback Callback)
+{
+    if (CLK_Count == CLK_MAX_CALLBACKS)
+    {
+        return false;
+    }
+    CLK_Callbacks[CLK_Count++] = Callback;
+    return true;
+}
+
+//*****************************************************************************
+//
+// ClockProfileSet: Switches to a profile; call from the main loop, not from an
+// interrupt, as the callbacks may wait for interrupt-driven transfers
+//
+// \param Profile:  CLK_PROFILE_*
+// \param NowMS:    Current time in ms
+//
+// \return The system clock in Hz
+//
+//*****************************************************************************
+
+uint32_t ClockProfileSet(uint32_t Profile, uint32_t NowMS)
+{
+    uint32_t Start, Switch, Switched, Done, OldMHz, lop;
+
+    if ((Profile == CLK_Profile) || (Profile >= CLK_PROFILES))
+    {
+        return CLK_SysClock;
+    }
+
+    OldMHz = CLK_SysClock / 1000000;
+    Start = CycleCounterGet();
+    for (lop = 0; lop < CLK_Count; lop++)
+    {
+        CLK_Callbacks[lop](CLK_EVT_BEFORE, CLK_SysClock);
+    }
+
+    Switch = CycleCounterGet();
+    MAP_SysCtlClockSet(CLK_Config[Profile]);
+    Switched = CycleCounterGet();
+
+    CLK_Residency(NowMS);
+    CLK_Profile = Profile;
+    CLK_SysClock = SysCtlClockGet();
+    for (lop = 0; lop < CLK_Count; lop++)
+    {
+        CLK_Callbacks[lop](CLK_EVT_AFTER, CLK_SysClock);
+    }
+    Done = CycleCounterGet();
+
+    CLK_Stats.Switches++;
+    CLK_Stats.WaitUS = (Switch - Start) / OldMHz;
+    CLK_Stats.LastUS = ((Switched - Switch) / CLK_BYPASS_MHZ) + ((Done - Switched) / (CLK_SysClock / 1000000));
+    if (CLK_Stats.LastUS > CLK_Stats.MaxUS)
+    {
+        CLK_Stats.MaxUS = CLK_Stats.LastUS;
+    }
+    return CLK_SysClock;
+}
+
+//*****************************************************************************
+//
+// ClockProfileGet: Gets the current profile
+//
+// \return CLK_PROFILE_*
+//
+//*****************************************************************************
+
+uint32_t ClockProfileGet(void)
+{
+    return CLK_Profile;
+}
+
+//*****************************************************************************
+//
+// ClockGet: Gets the system clock of the current profile
+//
+// \return The system clock in Hz
+//
+//*****************************************************************************
+
+uint32_t ClockGet(void)
+{
+    return CLK_SysClock;
+}
+
+//*****************************************************************************
+//
+// ClockStatsClear: Clears the switch statistics
+//
+// \param NowMS:    Current time in ms
+//
+//*****************************************************************************
+
+void ClockStatsClear(uint32_t NowMS)
+{
+    uint32_t lop;
+
+    CLK_Stats.Switches = 0;
+    CLK_Stats.LastUS = 0;
+    CLK_Stats.MaxUS = 0;
+    CLK_Stats.WaitUS = 0;
+    for (lop = 0; lop < CLK_PROFILES; lop++)
+    {
+        CLK_Stats.ProfileMS[lop] = 0;
+    }
+    CLK_Since = NowMS;
+}
+
+//*****************************************************************************
+//
+// ClockStatsGet: Copies the switch statistics, counting the time in the
+// current profile up to now
+//
+// \param Stats:    Pointer to the structure to fill in
+// \param NowMS:    Current time in ms
+//
+//*****************************************************************************
+
+void ClockStatsGet(ClockStats *Stats, uint32_t NowMS)
+{
+    CLK_Residency(NowMS);
+    *Stats = CLK_Stats;
+}
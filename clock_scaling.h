@@ -0,0 +1,63 @@
+/*
+ clock_scaling.h
+
+ System clock profiles: a low-frequency idle profile and the full 80 MHz PLL
+ clock for captures and exports. Peripherals whose timing derives from the
+ system clock register a callback to finish their transfers before a switch
+ and reprogram their dividers after it.
+ */
+
+#ifndef CLOCK_SCALING_H_
+#define CLOCK_SCALING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Clock Scaling Settings
+//
+//*****************************************************************************
+
+#define CLK_MAX_CALLBACKS       8           // Registered peripheral callbacks
+
+// Clock profiles
+enum {
+    CLK_PROFILE_IDLE = 0,           // 16 MHz crystal, PLL powered down
+    CLK_PROFILE_FULL,               // 80 MHz from the PLL
+    CLK_PROFILES
+};
+
+// Rough run-mode supply current per profile (mA, peripherals clocked), for
+// the estimated saving; measure the board to refine
+#define CLK_IDLE_MA             12
+#define CLK_FULL_MA             45
+
+// Callback events
+enum {
+    CLK_EVT_BEFORE = 0,             // Clock about to change: let transfers in progress finish
+    CLK_EVT_AFTER                   // Clock changed: reprogram dividers from SysClock
+};
+
+// Peripheral callback; SysClock is the old clock for CLK_EVT_BEFORE and the
+// new one for CLK_EVT_AFTER
+typedef void (*ClockCallback)(uint32_t Event, uint32_t SysClock);
+
+// Switch statistics, cleared by ClockStatsClear
+typedef struct {
+    uint32_t Switches;              // Profile changes
+    uint32_t LastUS;                // Last switch: oscillator change and reprogramming (us)
+    uint32_t MaxUS;                 // Slowest switch (us)
+    uint32_t WaitUS;                // Last wait for transfers to finish before a switch (us)
+    uint32_t ProfileMS[CLK_PROFILES]; // Time spent in each profile
+} ClockStats;
+
+extern uint32_t ClockInit(uint32_t Profile, uint32_t NowMS);
+extern bool ClockCallbackRegister(ClockCallback Callback);
+extern uint32_t ClockProfileSet(uint32_t Profile, uint32_t NowMS);
+extern uint32_t ClockProfileGet(void);
+extern uint32_t ClockGet(void);
+extern void ClockStatsClear(uint32_t NowMS);
+extern void ClockStatsGet(ClockStats *Stats, uint32_t NowMS);
+
+#endif /* CLOCK_SCALING_H_ */
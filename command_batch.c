@@ -0,0 +1,203 @@
+/*
+ command_batch.c
+
+ Command batches for scripted test sequences.
+
+ • A batch is one line of named commands separated by ';', e.g.
+   "erase; wait done; size 0x8000; get; wait done 120000; dump bin", so a
+   test rig can run a whole capture sequence in one round-trip
+ • Commands run one per BatchPoll from the main loop through CmdLineProcess and
+   the application's g_psCmdTable, so CAN responses, flash writes and the other
+   polls keep being serviced between them
+ • A command may call BatchWait to hold the batch until a condition is met (or
+   for a fixed time); a wait that times out abandons the rest of the batch
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "utils/cmdline.h"
+#include "command_batch.h"
+
+//*****************************************************************************
+//
+// Command Batch State
+//
+//*****************************************************************************
+
+static char BA_Line[BATCH_MAX_LENGTH];          // Batch being run, cut up as commands execute
+static char *BA_Next = 0;                       // Rest of the batch, 0 = no batch
+static const char *BA_Command = "";             // Name of the last command run
+static bool BA_Waiting = false;                 // Held by BatchWait
+static BatchCondition BA_WaitDone = 0;          // Condition ending the wait, 0 = fixed delay
+static uint32_t BA_WaitStart = 0;               // Time the wait started
+static uint32_t BA_WaitMS = 0;                  // Wait timeout (or delay)
+static uint32_t BA_Now = 0;                     // Time of the current BatchPoll
+
+//*****************************************************************************
+//
+// BatchStart: Starts a batch, replacing any batch still running
+//
+// \param Line:     Commands separated by BATCH_SEPARATOR (null-terminated)
+//
+// \return false if the line is longer than BATCH_MAX_LENGTH - 1
+//
+//*****************************************************************************
+
+bool BatchStart(const char *Line)
+{
+    uint32_t Length;
+
+    for (Length = 0; Line[Length] != 0; Length++)
+    {
+        if (Length == (BATCH_MAX_LENGTH - 1))
+        {
+            return false;
+        }
+        BA_Line[Length] = Line[Length];
+    }
+    BA_Line[Length] = 0;
+
+    BA_Next = BA_Line;
+    BA_Command = "";
+    BA_Waiting = false;
+    return true;
+}
+
+//*****************************************************************************
+//
+// BatchAbort: Abandons the rest of the batch
+//
+//*****************************************************************************
+
+void BatchAbort(void)
+{
+    BA_Next = 0;
+    BA_Waiting = false;
+}
+
+//*****************************************************************************
+//
+// BatchActive: Checks if a batch is running
+//
+// \return true until the batch is done or abandoned
+//
+//*****************************************************************************
+
+bool BatchActive(void)
+{
+    return (BA_Next != 0);
+}
+
+//*****************************************************************************
+//
+// BatchWaiting: Checks if the batch is held by BatchWait
+//
+// \return true while a wait is running
+//
+//*****************************************************************************
+
+bool BatchWaiting(void)
+{
+    return (BA_Next != 0) && BA_Waiting;
+}
+
+//*****************************************************************************
+//
+// BatchWait: Holds the batch after the current command; called by commands
+//
+// \param Done:         Condition to wait for, or 0 to simply wait TimeoutMS
+// \param TimeoutMS:    Wait limit in ms
+//
+//*****************************************************************************
+
+void BatchWait(BatchCondition Done, uint32_t TimeoutMS)
+{
+    BA_WaitDone = Done;
+    BA_WaitStart = BA_Now;
+    BA_WaitMS = TimeoutMS;
+    BA_Waiting = (BA_Next != 0);
+}
+
+//*****************************************************************************
+//
+// BatchPoll: Runs the next command of the batch unless it is waiting; call
+// from the main loop
+//
+// \param NowMS:    Current time in ms
+// \param Status:   Receives the CmdLineProcess result on BATCH_EVT_COMMAND
+//
+// \return BATCH_EVT_*
+//
+//*****************************************************************************
+
+int BatchPoll(uint32_t NowMS, int *Status)
+{
+    char *Command;
+
+    BA_Now = NowMS;
+    if (BA_Next == 0)
+    {
+        return BATCH_EVT_NONE;
+    }
+
+    if (BA_Waiting)
+    {
+        if ((BA_WaitDone != 0) && BA_WaitDone())
+        {
+            BA_Waiting = false;
+        }
+        else if ((NowMS - BA_WaitStart) >= BA_WaitMS)
+        {
+            if (BA_WaitDone != 0)
+            {
+                BatchAbort();
+                return BATCH_EVT_TIMEOUT;
+            }
+            BA_Waiting = false;
+        }
+        else
+        {
+            return BATCH_EVT_NONE;
+        }
+    }
+
+    // Skip blanks and empty commands
+    while ((*BA_Next == ' ') || (*BA_Next == BATCH_SEPARATOR))
+    {
+        BA_Next++;
+    }
+    if (*BA_Next == 0)
+    {
+        BA_Next = 0;
+        return BATCH_EVT_DONE;
+    }
+
+    // Cut the command off the batch, then run it
+    Command = BA_Next;
+    while ((*BA_Next != 0) && (*BA_Next != BATCH_SEPARATOR))
+    {
+        BA_Next++;
+    }
+    if (*BA_Next != 0)
+    {
+        *BA_Next++ = 0;
+    }
+
+    BA_Command = Command;
+    *Status = CmdLineProcess(Command);
+    return BATCH_EVT_COMMAND;
+}
+
+//*****************************************************************************
+//
+// BatchCommand: Gets the name of the last command run, e.g. to report an error
+//
+// \return The command name (argv[0])
+//
+//*****************************************************************************
+
+const char *BatchCommand(void)
+{
+    return BA_Command;
+}
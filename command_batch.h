@@ -0,0 +1,43 @@
+/*
+ command_batch.h
+
+ Command batches: runs a line of ';'-separated named commands through the
+ utils/cmdline table one at a time from the main loop, with waits for
+ background operations between them.
+ */
+
+#ifndef COMMAND_BATCH_H_
+#define COMMAND_BATCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Command Batch Settings
+//
+//*****************************************************************************
+
+#define BATCH_MAX_LENGTH        256         // Longest batch line (characters)
+#define BATCH_SEPARATOR         ';'         // Separates the commands of a batch
+
+// BatchPoll events
+enum {
+    BATCH_EVT_NONE = 0,             // Idle, or waiting for a condition
+    BATCH_EVT_COMMAND,              // A command ran; see the Status of BatchPoll
+    BATCH_EVT_TIMEOUT,              // A wait timed out; the batch was abandoned
+    BATCH_EVT_DONE                  // The last command of the batch ran
+};
+
+// Condition a batch waits for; returns true once satisfied
+typedef bool (*BatchCondition)(void);
+
+extern bool BatchStart(const char *Line);
+extern void BatchAbort(void);
+extern bool BatchActive(void);
+extern bool BatchWaiting(void);
+extern void BatchWait(BatchCondition Done, uint32_t TimeoutMS);
+extern int BatchPoll(uint32_t NowMS, int *Status);
+extern const char *BatchCommand(void);
+
+#endif /* COMMAND_BATCH_H_ */
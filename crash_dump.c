@@ -0,0 +1,250 @@
+/*
+ crash_dump.c
+
+ Crash dump capture in EEPROM.
+
+ • All fault vectors (hard, memory management, bus, usage) go to
+   CrashFaultHandler instead of spinning; the memory management, bus and usage
+   faults are enabled so they are reported as such rather than escalating to
+   a hard fault
+ • The handler takes the registers the core stacked on entry (R0-R3, R12, LR,
+   the faulting PC and xPSR), the fault status and address registers, the
+   supervised task that was running and the tail of the event trace, lets the
+   application add the state it needs to resume, writes it all to the on-chip
+   EEPROM and resets the part. The watchdog supervisor saves the same record
+   when a task hangs
+ • EEPROM rather than flash: it is written a word at a time without erasing a
+   page, does not stall instruction fetches from flash, and survives any reset
+   (the SRAM is not retained over a system reset)
+ • The trace is a small RAM ring of timestamped events (commands run, CAN
+   traffic, clock switches) filled by the main loop; it costs two stores per
+   event and gives the steps that led to the crash
+ • If the stack pointer itself is bad (stack overflow) the stacked frame is
+   not read; if the handler faults again the core locks up and the watchdog
+   resets the part without a dump
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "inc/hw_types.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_nvic.h"
+#include "driverlib/eeprom.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/rom.h"
+#include "driverlib/rom_map.h"
+
+#include "supervisor.h"
+#include "crash_dump.h"
+
+//*****************************************************************************
+//
+// Crash Dump State
+//
+//*****************************************************************************
+
+#define CRS_SRAM_START          0x20000000  // TM4C123GE6PM SRAM (32 KB)
+#define CRS_SRAM_END            0x20008000
+
+static bool CRS_Ready = false;                  // EEPROM initialized
+static volatile uint32_t *CRS_TickMS = 0;       // Application ms counter, for timestamps
+static CrashHook CRS_Hook = 0;                  // Adds the application state
+static CrashTraceEntry CRS_Trace[CRASH_TRACE_DEPTH];   // Event ring
+static uint32_t CRS_TraceNext = 0;              // Events traced (next slot)
+static CrashRecord CRS_Record;                  // Record being saved (not on the stack, which may be bad)
+
+// Called by CrashFaultHandler with the stacked registers; not static, the
+// handler branches to it from assembly
+void CrashFaultFrame(uint32_t *Frame);
+
+//*****************************************************************************
+//
+// CrashInit: Powers up the EEPROM and enables the configurable faults; call
+// early in main
+//
+// \param TickMS:   Millisecond counter used for timestamps
+// \param Hook:     Fills in the application state of a dump, or 0
+//
+// \return false if the EEPROM could not be initialized (no dumps are saved)
+//
+//*****************************************************************************
+
+bool CrashInit(volatile uint32_t *TickMS, CrashHook Hook)
+{
+    CRS_TickMS = TickMS;
+    CRS_Hook = Hook;
+
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_EEPROM0);
+    while (!MAP_SysCtlPeripheralReady(SYSCTL_PERIPH_EEPROM0))
+    {
+    }
+    CRS_Ready = (MAP_EEPROMInit() == EEPROM_INIT_OK);
+
+    MAP_IntEnable(FAULT_MPU);
+    MAP_IntEnable(FAULT_BUS);
+    MAP_IntEnable(FAULT_USAGE);
+
+    return CRS_Ready;
+}
+
+//*****************************************************************************
+//
+// CrashTrace: Adds an event to the trace; call from the main loop only
+//
+// \param Event:    CRASH_EVENT(Type, Code, Value)
+//
+//*****************************************************************************
+
+void CrashTrace(uint32_t Event)
+{
+    CrashTraceEntry *Entry = &CRS_Trace[CRS_TraceNext & (CRASH_TRACE_DEPTH - 1)];
+
+    Entry->TimeMS = *CRS_TickMS;
+    Entry->Event = Event;
+    CRS_TraceNext++;
+}
+
+//*****************************************************************************
+//
+// CrashSave: Writes a crash record to EEPROM; called by the fault handler and
+// the watchdog supervisor, the caller resets the part afterwards
+//
+// \param Cause:    CRASH_CAUSE_*
+// \param Task:     Supervised task running
+// \param Frame:    Registers stacked on exception entry
+//
+//*****************************************************************************
+
+void CrashSave(uint32_t Cause, uint32_t Task, const uint32_t *Frame)
+{
+    uint32_t Old[4], lop;
+
+    if (!CRS_Ready)
+    {
+        return;
+    }
+
+    // Count the crashes since the record was last cleared
+    MAP_EEPROMRead(Old, CRASH_EEPROM_ADDR, sizeof(Old));
+    CRS_Record.Count = (Old[0] == CRASH_MAGIC) ? (Old[3] + 1) : 1;
+
+    CRS_Record.Magic = CRASH_MAGIC;
+    CRS_Record.Cause = Cause;
+    CRS_Record.Task = Task;
+    CRS_Record.Handled = 0;
+    CRS_Record.UptimeMS = *CRS_TickMS;
+
+    for (lop = 0; lop < 8; lop++)
+    {
+        CRS_Record.Frame[lop] = (((uint32_t)Frame >= CRS_SRAM_START) &&
+                                 ((uint32_t)Frame <= (CRS_SRAM_END - sizeof(CRS_Record.Frame)))) ? Frame[lop] : 0;
+    }
+    CRS_Record.Cfsr = HWREG(NVIC_FAULT_STAT);
+    CRS_Record.Hfsr = HWREG(NVIC_HFAULT_STAT);
+    CRS_Record.Mmfar = HWREG(NVIC_MM_ADDR);
+    CRS_Record.Bfar = HWREG(NVIC_FAULT_ADDR);
+
+    for (lop = 0; lop < CRASH_TRACE_DEPTH; lop++)
+    {
+        CRS_Record.Trace[lop] = CRS_Trace[(CRS_TraceNext + lop) & (CRASH_TRACE_DEPTH - 1)];
+    }
+
+    for (lop = 0; lop < CRASH_APP_WORDS; lop++)
+    {
+        CRS_Record.App[lop] = 0;
+    }
+    if (CRS_Hook)
+    {
+        CRS_Hook(CRS_Record.App);
+    }
+
+    MAP_EEPROMProgram((uint32_t *)&CRS_Record, CRASH_EEPROM_ADDR, sizeof(CRS_Record));
+}
+
+//*****************************************************************************
+//
+// CrashRecordGet: Reads the crash record back from EEPROM
+//
+// \param Record:   Structure to fill in
+//
+// \return true if a crash has been recorded
+//
+//*****************************************************************************
+
+bool CrashRecordGet(CrashRecord *Record)
+{
+    if (!CRS_Ready)
+    {
+        return false;
+    }
+    MAP_EEPROMRead((uint32_t *)Record, CRASH_EEPROM_ADDR, sizeof(CrashRecord));
+    return (Record->Magic == CRASH_MAGIC);
+}
+
+//*****************************************************************************
+//
+// CrashRecordHandled: Marks the record as acted on, so later boots do not
+// report or resume it again
+//
+//*****************************************************************************
+
+void CrashRecordHandled(void)
+{
+    uint32_t Handled = 1;
+
+    if (CRS_Ready)
+    {
+        MAP_EEPROMProgram(&Handled, CRASH_EEPROM_ADDR + offsetof(CrashRecord, Handled), 4);
+    }
+}
+
+//*****************************************************************************
+//
+// CrashRecordClear: Invalidates the record and restarts the crash count
+//
+//*****************************************************************************
+
+void CrashRecordClear(void)
+{
+    uint32_t Magic = 0;
+
+    if (CRS_Ready)
+    {
+        MAP_EEPROMProgram(&Magic, CRASH_EEPROM_ADDR, 4);
+    }
+}
+
+//*****************************************************************************
+//
+// CrashFaultFrame: Saves the dump of a fault and resets the part
+//
+// \param Frame:    Registers stacked when the fault was taken
+//
+//*****************************************************************************
+
+void CrashFaultFrame(uint32_t *Frame)
+{
+    // Give the dump a full budget of the faulting task
+    SupervisorKick();
+    CrashSave(CRASH_CAUSE_FAULT, SupervisorTaskGet(), Frame);
+    MAP_SysCtlReset();
+}
+
+//*****************************************************************************
+//
+// CrashFaultHandler: Fault vector; passes the stacked registers of the
+// faulting code to CrashFaultFrame
+//
+//*****************************************************************************
+
+void CrashFaultHandler(void)
+{
+    __asm("    tst     lr, #4\n"
+          "    ite     eq\n"
+          "    mrseq   r0, msp\n"
+          "    mrsne   r0, psp\n"
+          "    b.w     CrashFaultFrame");
+}
@@ -0,0 +1,90 @@
+/*
+ crash_dump.h
+
+ Crash dumps: the fault handlers and the watchdog supervisor save the
+ registers, the fault status, a tail of recent events and application state
+ to EEPROM before resetting, so the next boot can report the crash and pick
+ up where the application stopped.
+ */
+
+#ifndef CRASH_DUMP_H_
+#define CRASH_DUMP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Crash Dump Settings
+//
+//*****************************************************************************
+
+#define CRASH_EEPROM_ADDR       0x000       // EEPROM offset of the crash record (word aligned)
+#define CRASH_MAGIC             0xC4A50001  // Valid record; bump the low bits when the layout changes
+#define CRASH_TRACE_DEPTH       16          // Trace entries kept (power of two)
+#define CRASH_APP_WORDS         12          // Words of application state saved with a dump
+
+// Causes
+enum {
+    CRASH_CAUSE_NONE = 0,
+    CRASH_CAUSE_FAULT,              // Hard, memory management, bus or usage fault
+    CRASH_CAUSE_WATCHDOG            // A supervised task overran its budget
+};
+
+// Trace event types (bits 31..28 of an event)
+enum {
+    CRASH_EVT_COMMAND = 1,          // Menu, batch or I2C command run (code = command)
+    CRASH_EVT_CAN_TX,               // Command sent to the sensor (code = command, value = parameter, bit 19 = failed)
+    CRASH_EVT_CAN_RX,               // Response from the sensor (code = response ID, value = low bits)
+    CRASH_EVT_CLOCK                 // Clock profile switch (value = profile)
+};
+
+// Packs a trace event: type, 8-bit code, 20-bit value
+#define CRASH_EVENT(Type, Code, Value)  (((uint32_t)(Type) << 28) | (((uint32_t)(Code) & 0xFF) << 20) | \
+                                         ((uint32_t)(Value) & 0xFFFFF))
+#define CRASH_EVENT_TYPE(Event)         ((Event) >> 28)
+#define CRASH_EVENT_CODE(Event)         (((Event) >> 20) & 0xFF)
+#define CRASH_EVENT_VALUE(Event)        ((Event) & 0xFFFFF)
+#define CRASH_CAN_TX_FAILED             0x80000     // CRASH_EVT_CAN_TX value flag: the send timed out
+
+// Trace entry
+typedef struct {
+    uint32_t TimeMS;                // Time of the event
+    uint32_t Event;                 // CRASH_EVENT(), 0 = unused
+} CrashTraceEntry;
+
+// Crash record as stored in EEPROM
+typedef struct {
+    uint32_t Magic;                 // CRASH_MAGIC if valid
+    uint32_t Cause;                 // CRASH_CAUSE_*
+    uint32_t Task;                  // Supervised task running
+    uint32_t Count;                 // Crashes since the record was last cleared
+    uint32_t Handled;               // Set once the boot after the crash has acted on it
+    uint32_t UptimeMS;              // Time of the crash since boot
+    uint32_t Frame[8];              // Stacked R0-R3, R12, LR, PC, xPSR
+    uint32_t Cfsr;                  // Configurable fault status
+    uint32_t Hfsr;                  // Hard fault status
+    uint32_t Mmfar;                 // Memory management fault address
+    uint32_t Bfar;                  // Bus fault address
+    CrashTraceEntry Trace[CRASH_TRACE_DEPTH];   // Latest events, oldest first
+    uint32_t App[CRASH_APP_WORDS];  // Application state from the crash hook
+} CrashRecord;
+
+// Frame[] indices of the registers most often looked at
+#define CRASH_FRAME_LR          5
+#define CRASH_FRAME_PC          6
+#define CRASH_FRAME_PSR         7
+
+// Fills App with the state to resume from; called in the fault or watchdog
+// handler, so it must only read RAM
+typedef void (*CrashHook)(uint32_t *App);
+
+extern bool CrashInit(volatile uint32_t *TickMS, CrashHook Hook);
+extern void CrashTrace(uint32_t Event);
+extern void CrashSave(uint32_t Cause, uint32_t Task, const uint32_t *Frame);
+extern bool CrashRecordGet(CrashRecord *Record);
+extern void CrashRecordHandled(void);
+extern void CrashRecordClear(void);
+extern void CrashFaultHandler(void);
+
+#endif /* CRASH_DUMP_H_ */
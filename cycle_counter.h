@@ -0,0 +1,35 @@
+/*
+ cycle_counter.h
+
+ Access to the Cortex-M4 DWT cycle counter, used to measure the latency of
+ time-critical operations in CPU clock cycles.
+ */
+
+#ifndef CYCLE_COUNTER_H_
+#define CYCLE_COUNTER_H_
+
+#include <stdint.h>
+
+#include "inc/hw_types.h"
+#include "inc/hw_nvic.h"
+
+//*****************************************************************************
+//
+// DWT Cycle Counter Registers
+//
+//*****************************************************************************
+
+#define DWT_CTRL                0xE0001000  // DWT Control
+#define DWT_CYCCNT              0xE0001004  // DWT Cycle Count
+#define DWT_CTRL_CYCCNTENA      0x00000001  // Enable the cycle counter
+#define NVIC_DBG_INT_TRCENA     0x01000000  // Enable DWT/ITM (DEMCR.TRCENA)
+
+// Enables the free-running cycle counter; call once at startup
+#define CycleCounterInit()      do { HWREG(NVIC_DBG_INT) |= NVIC_DBG_INT_TRCENA; \
+                                     HWREG(DWT_CYCCNT) = 0;                       \
+                                     HWREG(DWT_CTRL) |= DWT_CTRL_CYCCNTENA; } while (0)
+
+// Returns the current cycle count (wraps every 2^32 cycles, ~53 s at 80 MHz)
+#define CycleCounterGet()       (HWREG(DWT_CYCCNT))
+
+#endif /* CYCLE_COUNTER_H_ */
@@ -0,0 +1,52 @@
+/*
+ dma_table.c
+
+ The uDMA controller has a single channel control table, which must be aligned
+ on a 1024-byte boundary; every module using uDMA channels shares this one.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "driverlib/sysctl.h"
+#include "driverlib/udma.h"
+#include "driverlib/rom.h"
+#include "driverlib/rom_map.h"
+
+#include "dma_table.h"
+
+//*****************************************************************************
+//
+// uDMA Channel Control Table: primary and alternate structures for all 32
+// channels (32 * 2 * 16 bytes)
+//
+//*****************************************************************************
+
+#if defined(ccs)
+#pragma DATA_ALIGN(DMAControlTable, 1024)
+static uint8_t DMAControlTable[1024];
+#else
+static uint8_t DMAControlTable[1024] __attribute__ ((aligned(1024)));
+#endif
+
+static bool DMAReady = false;       // Controller enabled and table installed
+
+//*****************************************************************************
+//
+// DMATableInit: Enables the uDMA controller and installs the control table;
+// safe to call from every module that uses uDMA
+//
+//*****************************************************************************
+
+void DMATableInit(void)
+{
+    if (DMAReady)
+    {
+        return;
+    }
+
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+    MAP_uDMAEnable();
+    MAP_uDMAControlBaseSet(DMAControlTable);
+    DMAReady = true;
+}
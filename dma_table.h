@@ -0,0 +1,14 @@
+/*
+ dma_table.h
+
+ Shared uDMA channel control table and controller start-up.
+ */
+
+#ifndef DMA_TABLE_H_
+#define DMA_TABLE_H_
+
+#include <stdint.h>
+
+extern void DMATableInit(void);
+
+#endif /* DMA_TABLE_H_ */
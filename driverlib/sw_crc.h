@@ -51,6 +51,25 @@ extern "C"
 {
 #endif
 
+//*****************************************************************************
+//
+// The state of an incremental CRC-32 computation.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    // The running (un-inverted) CRC-32 value.
+    //
+    uint32_t ui32Crc;
+
+    //
+    // The number of bytes added to the CRC so far.
+    //
+    uint32_t ui32Count;
+}
+tCrc32Context;
+
 //*****************************************************************************
 //
 // Prototypes for the functions.
@@ -65,6 +84,19 @@ extern void Crc16Array3(uint32_t ui32WordLen, const uint32_t *pui32Data,
                         uint16_t *pui16Crc3);
 extern uint32_t Crc32(uint32_t ui32Crc, const uint8_t *pui8Data,
                       uint32_t ui32Count);
+extern uint32_t Crc32Slice8(uint32_t ui32Crc, const uint8_t *pui8Data,
+                            uint32_t ui32Count);
+extern uint8_t Crc8CCITTSlice4(uint8_t ui8Crc, const uint8_t *pui8Data,
+                               uint32_t ui32Count);
+extern uint16_t Crc16Slice4(uint16_t ui16Crc, const uint8_t *pui8Data,
+                            uint32_t ui32Count);
+extern uint32_t Crc32Slice4(uint32_t ui32Crc, const uint8_t *pui8Data,
+                            uint32_t ui32Count);
+extern uint32_t Crc32Array(uint32_t ui32WordLen, const uint32_t *pui32Data);
+extern void Crc32ContextInit(tCrc32Context *psCtx);
+extern void Crc32ContextUpdate(tCrc32Context *psCtx, const uint8_t *pui8Data,
+                               uint32_t ui32Count);
+extern uint32_t Crc32ContextFinal(const tCrc32Context *psCtx);
 
 //*****************************************************************************
 //
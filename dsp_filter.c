@@ -0,0 +1,569 @@
+/*
+ dsp_filter.c
+
+ Fixed-point streaming filters.
+
+ • Samples are Q15 (int16) or Q31 (int32) fractions; all filters work on blocks
+   and keep their history between calls, so a stream can be fed in the block
+   sizes it arrives in (e.g. one ADC ping-pong buffer at a time)
+ • The Q15 biquad and FIR inner loops use the Cortex-M4 dual 16-bit MAC
+   instructions (SMLAD/SMLALD) on sample and coefficient pairs packed into one
+   word, and SSAT for the saturating conversion back to Q15
+ • With the TI compiler the instructions are reached through its intrinsics,
+   with GCC/Clang through the ACLE intrinsics; on any other target (e.g. a host
+   benchmark) portable C macros with the same results are used
+ • The *Ref functions are straightforward one-multiply-per-tap versions of the
+   same filters, kept to check the packed versions and compare their speed
+ • The FIR decimator only computes the outputs it keeps, so decimating by N
+   also divides its cost by N
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dsp_filter.h"
+
+//*****************************************************************************
+//
+// SIMD Primitives
+//
+// DSP_SMLAD:   Acc + lo(X) * lo(Y) + hi(X) * hi(Y), 32-bit accumulator
+// DSP_SMLALD:  Same with a 64-bit accumulator
+// DSP_SAT_Q15: Saturates a 32-bit value to the Q15 range
+//
+//*****************************************************************************
+
+#if defined(__TI_ARM__)
+
+#define DSP_SMLAD(X, Y, Acc)    _smlad((X), (Y), (Acc))
+#define DSP_SMLALD(X, Y, Acc)   _smlald((Acc), (X), (Y))
+#define DSP_SAT_Q15(Val)        _ssata((Val), 0, 16)
+
+#elif defined(__ARM_FEATURE_DSP)
+
+#include <arm_acle.h>
+
+#define DSP_SMLAD(X, Y, Acc)    __smlad((X), (Y), (Acc))
+#define DSP_SMLALD(X, Y, Acc)   __smlald((X), (Y), (Acc))
+#define DSP_SAT_Q15(Val)        __ssat((Val), 16)
+
+#else
+
+#define DSP_LO(X)               ((int32_t)(int16_t)((X) & 0xFFFF))
+#define DSP_HI(X)               ((int32_t)(int16_t)((X) >> 16))
+#define DSP_SMLAD(X, Y, Acc)    ((int32_t)((Acc) + (DSP_LO(X) * DSP_LO(Y)) + (DSP_HI(X) * DSP_HI(Y))))
+#define DSP_SMLALD(X, Y, Acc)   ((int64_t)((Acc) + (DSP_LO(X) * DSP_LO(Y)) + (DSP_HI(X) * DSP_HI(Y))))
+#define DSP_SAT_Q15(Val)        (((Val) > 32767) ? 32767 : (((Val) < -32768) ? -32768 : (Val)))
+
+#endif
+
+// Packs a new sample in front of a delay line pair: x[n] | x[n-1] << 16
+#define DSP_PUSH(Pair, Val)     (((uint32_t)(uint16_t)(Val)) | ((Pair) << 16))
+
+// Packs two Q15 values into one word, first in the low half
+#define DSP_PACK(Lo, Hi)        (((uint32_t)(uint16_t)(Lo)) | ((uint32_t)(uint16_t)(Hi) << 16))
+
+// Reference saturation, independent of the primitives above
+#define DSP_CLIP_Q15(Val)       (((Val) > 32767) ? 32767 : (((Val) < -32768) ? -32768 : (Val)))
+
+//*****************************************************************************
+//
+// DspBiquadQ15Init: Sets up a Q15 biquad cascade and clears its history
+//
+// \param F:            Filter state
+// \param Stages:       Second-order sections (1..DSP_BIQUAD_MAX_STAGES)
+// \param Coeffs:       { b0, b1, b2, a1, a2 } per section, Q15 scaled by 2^-PostShift
+// \param PostShift:    Coefficient scaling
+//
+// \return false if the configuration is not supported
+//
+//*****************************************************************************
+
+bool DspBiquadQ15Init(DspBiquadQ15 *F, uint32_t Stages, const int16_t *Coeffs, uint32_t PostShift)
+{
+    uint32_t lop;
+
+    if ((Stages == 0) || (Stages > DSP_BIQUAD_MAX_STAGES) || (PostShift > 15))
+    {
+        return false;
+    }
+
+    F->Stages = Stages;
+    F->PostShift = PostShift;
+    for (lop = 0; lop < Stages; lop++, Coeffs += 5)
+    {
+        F->B0[lop] = Coeffs[0];
+        F->B12[lop] = DSP_PACK(Coeffs[1], Coeffs[2]);
+        F->A12[lop] = DSP_PACK(Coeffs[3], Coeffs[4]);
+        F->X12[lop] = 0;
+        F->Y12[lop] = 0;
+    }
+
+    return true;
+}
+
+//*****************************************************************************
+//
+// DspBiquadQ15Process: Filters a block through the cascade; each section needs
+// one multiply and two dual MACs per sample
+//
+// \param F:        Filter state
+// \param In:       Input samples
+// \param Out:      Output samples (may be the same buffer as In)
+// \param Count:    Samples in the block
+//
+//*****************************************************************************
+
+void DspBiquadQ15Process(DspBiquadQ15 *F, const int16_t *In, int16_t *Out, uint32_t Count)
+{
+    uint32_t Stage, lop, B12, A12, X12, Y12;
+    uint32_t Shift = 15 - F->PostShift;
+    int32_t B0, Y;
+    int64_t Acc;
+
+    for (Stage = 0; Stage < F->Stages; Stage++)
+    {
+        // Keep the section in registers for the whole block
+        B0 = F->B0[Stage];
+        B12 = F->B12[Stage];
+        A12 = F->A12[Stage];
+        X12 = F->X12[Stage];
+        Y12 = F->Y12[Stage];
+
+        for (lop = 0; lop < Count; lop++)
+        {
+            Acc = (int64_t)(B0 * In[lop]);
+            Acc = DSP_SMLALD(B12, X12, Acc);
+            Acc = DSP_SMLALD(A12, Y12, Acc);
+            Y = (int32_t)(Acc >> Shift);
+            Y = DSP_SAT_Q15(Y);
+
+            X12 = DSP_PUSH(X12, In[lop]);
+            Y12 = DSP_PUSH(Y12, Y);
+            Out[lop] = (int16_t)Y;
+        }
+
+        F->X12[Stage] = X12;
+        F->Y12[Stage] = Y12;
+
+        // Later sections filter the output of the previous one in place
+        In = Out;
+    }
+}
+
+//*****************************************************************************
+//
+// DspBiquadQ15ProcessRef: Portable reference version of DspBiquadQ15Process
+//
+//*****************************************************************************
+
+void DspBiquadQ15ProcessRef(DspBiquadQ15 *F, const int16_t *In, int16_t *Out, uint32_t Count)
+{
+    uint32_t Stage, lop;
+    int16_t B[3], A[2], X[2], Yd[2];
+    int64_t Acc;
+    int32_t Y;
+
+    for (Stage = 0; Stage < F->Stages; Stage++)
+    {
+        B[0] = F->B0[Stage];
+        B[1] = (int16_t)(F->B12[Stage] & 0xFFFF);
+        B[2] = (int16_t)(F->B12[Stage] >> 16);
+        A[0] = (int16_t)(F->A12[Stage] & 0xFFFF);
+        A[1] = (int16_t)(F->A12[Stage] >> 16);
+        X[0] = (int16_t)(F->X12[Stage] & 0xFFFF);
+        X[1] = (int16_t)(F->X12[Stage] >> 16);
+        Yd[0] = (int16_t)(F->Y12[Stage] & 0xFFFF);
+        Yd[1] = (int16_t)(F->Y12[Stage] >> 16);
+
+        for (lop = 0; lop < Count; lop++)
+        {
+            Acc = (int64_t)B[0] * In[lop];
+            Acc += (int64_t)B[1] * X[0];
+            Acc += (int64_t)B[2] * X[1];
+            Acc += (int64_t)A[0] * Yd[0];
+            Acc += (int64_t)A[1] * Yd[1];
+            Y = (int32_t)(Acc >> (15 - F->PostShift));
+            Y = DSP_CLIP_Q15(Y);
+
+            X[1] = X[0];
+            X[0] = In[lop];
+            Yd[1] = Yd[0];
+            Yd[0] = (int16_t)Y;
+            Out[lop] = (int16_t)Y;
+        }
+
+        F->X12[Stage] = DSP_PACK(X[0], X[1]);
+        F->Y12[Stage] = DSP_PACK(Yd[0], Yd[1]);
+        In = Out;
+    }
+}
+
+//*****************************************************************************
+//
+// DspBiquadQ31Init: Sets up a Q31 biquad cascade and clears its history
+//
+// \param F:            Filter state
+// \param Stages:       Second-order sections (1..DSP_BIQUAD_MAX_STAGES)
+// \param Coeffs:       { b0, b1, b2, a1, a2 } per section, Q31 scaled by 2^-PostShift
+// \param PostShift:    Coefficient scaling
+//
+// \return false if the configuration is not supported
+//
+//*****************************************************************************
+
+bool DspBiquadQ31Init(DspBiquadQ31 *F, uint32_t Stages, const int32_t *Coeffs, uint32_t PostShift)
+{
+    uint32_t lop, Tap;
+
+    if ((Stages == 0) || (Stages > DSP_BIQUAD_MAX_STAGES) || (PostShift > 31))
+    {
+        return false;
+    }
+
+    F->Stages = Stages;
+    F->PostShift = PostShift;
+    for (lop = 0; lop < Stages; lop++)
+    {
+        for (Tap = 0; Tap < 5; Tap++)
+        {
+            F->Coeffs[lop][Tap] = *Coeffs++;
+        }
+        for (Tap = 0; Tap < 4; Tap++)
+        {
+            F->State[lop][Tap] = 0;
+        }
+    }
+
+    return true;
+}
+
+//*****************************************************************************
+//
+// DspBiquadQ31Process: Filters a block of Q31 samples through the cascade;
+// the 32x32 products are accumulated with SMLAL into 64 bits
+//
+// \param F:        Filter state
+// \param In:       Input samples
+// \param Out:      Output samples (may be the same buffer as In)
+// \param Count:    Samples in the block
+//
+//*****************************************************************************
+
+void DspBiquadQ31Process(DspBiquadQ31 *F, const int32_t *In, int32_t *Out, uint32_t Count)
+{
+    uint32_t Stage, lop;
+    uint32_t Shift = 31 - F->PostShift;
+    int32_t X1, X2, Y1, Y2, X0;
+    const int32_t *C;
+    int64_t Acc;
+
+    for (Stage = 0; Stage < F->Stages; Stage++)
+    {
+        C = F->Coeffs[Stage];
+        X1 = F->State[Stage][0];
+        X2 = F->State[Stage][1];
+        Y1 = F->State[Stage][2];
+        Y2 = F->State[Stage][3];
+
+        for (lop = 0; lop < Count; lop++)
+        {
+            X0 = In[lop];
+            Acc = (int64_t)C[0] * X0;
+            Acc += (int64_t)C[1] * X1;
+            Acc += (int64_t)C[2] * X2;
+            Acc += (int64_t)C[3] * Y1;
+            Acc += (int64_t)C[4] * Y2;
+
+            X2 = X1;
+            X1 = X0;
+            Y2 = Y1;
+            Y1 = (int32_t)(Acc >> Shift);
+            Out[lop] = Y1;
+        }
+
+        F->State[Stage][0] = X1;
+        F->State[Stage][1] = X2;
+        F->State[Stage][2] = Y1;
+        F->State[Stage][3] = Y2;
+        In = Out;
+    }
+}
+
+//*****************************************************************************
+//
+// DspFirDecimQ15Init: Sets up a Q15 FIR decimator and clears its history
+//
+// \param F:        Filter state
+// \param Taps:     Filter length (even, up to DSP_FIR_MAX_TAPS)
+// \param Factor:   Decimation factor (1 = filter only)
+// \param Coeffs:   Impulse response h[0..Taps-1] in Q15; the sum of their
+//                  magnitudes must stay below 2.0 for the 32-bit accumulator
+//
+// \return false if the configuration is not supported
+//
+//*****************************************************************************
+
+bool DspFirDecimQ15Init(DspFirDecimQ15 *F, uint32_t Taps, uint32_t Factor, const int16_t *Coeffs)
+{
+    uint32_t lop;
+
+    if ((Taps == 0) || (Taps & 1) || (Taps > DSP_FIR_MAX_TAPS) || (Factor == 0))
+    {
+        return false;
+    }
+
+    F->Taps = Taps;
+    F->Factor = Factor;
+    F->Pos = 0;
+    F->Phase = 0;
+
+    // The history window runs oldest to newest, so the coefficients are stored
+    // reversed: window[k] is multiplied by h[Taps - 1 - k]
+    for (lop = 0; lop < (Taps / 2); lop++)
+    {
+        F->Coeffs[lop] = DSP_PACK(Coeffs[Taps - 1 - (2 * lop)], Coeffs[Taps - 2 - (2 * lop)]);
+    }
+    for (lop = 0; lop < Taps; lop++)
+    {
+        F->History.Pairs[lop] = 0;
+    }
+
+    return true;
+}
+
+//*****************************************************************************
+//
+// DspFirDecimQ15Process: Filters and decimates a block of samples
+//
+// Each sample is written twice into the history (at Pos and Pos + Taps) so the
+// last Taps samples are always contiguous and can be read in pairs. When the
+// window starts on an odd sample the pairs are packed from halfword loads.
+//
+// \param F:        Filter state
+// \param In:       Input samples
+// \param Out:      Output samples (may be the same buffer as In)
+// \param Count:    Samples in the block
+//
+// \return Output samples produced
+//
+//*****************************************************************************
+
+uint32_t DspFirDecimQ15Process(DspFirDecimQ15 *F, const int16_t *In, int16_t *Out, uint32_t Count)
+{
+    uint32_t lop, Tap, Pairs = F->Taps / 2;
+    uint32_t Produced = 0;
+    const uint32_t *Win;
+    const int16_t *Smp;
+    int32_t Acc;
+
+    for (lop = 0; lop < Count; lop++)
+    {
+        F->History.Samples[F->Pos] = In[lop];
+        F->History.Samples[F->Pos + F->Taps] = In[lop];
+        if (++F->Pos == F->Taps)
+        {
+            F->Pos = 0;
+        }
+
+        if (++F->Phase < F->Factor)
+        {
+            continue;
+        }
+        F->Phase = 0;
+
+        Acc = 0;
+        if ((F->Pos & 1) == 0)
+        {
+            Win = &F->History.Pairs[F->Pos / 2];
+            for (Tap = 0; Tap < Pairs; Tap++)
+            {
+                Acc = DSP_SMLAD(Win[Tap], F->Coeffs[Tap], Acc);
+            }
+        }
+        else
+        {
+            Smp = &F->History.Samples[F->Pos];
+            for (Tap = 0; Tap < Pairs; Tap++, Smp += 2)
+            {
+                Acc = DSP_SMLAD(DSP_PACK(Smp[0], Smp[1]), F->Coeffs[Tap], Acc);
+            }
+        }
+
+        Acc >>= 15;
+        Out[Produced++] = (int16_t)DSP_SAT_Q15(Acc);
+    }
+
+    return Produced;
+}
+
+//*****************************************************************************
+//
+// DspFirDecimQ15ProcessRef: Portable reference version of DspFirDecimQ15Process
+//
+//*****************************************************************************
+
+uint32_t DspFirDecimQ15ProcessRef(DspFirDecimQ15 *F, const int16_t *In, int16_t *Out, uint32_t Count)
+{
+    uint32_t lop, Tap, Coeff;
+    uint32_t Produced = 0;
+    int32_t Acc;
+
+    for (lop = 0; lop < Count; lop++)
+    {
+        F->History.Samples[F->Pos] = In[lop];
+        F->History.Samples[F->Pos + F->Taps] = In[lop];
+        if (++F->Pos == F->Taps)
+        {
+            F->Pos = 0;
+        }
+
+        if (++F->Phase < F->Factor)
+        {
+            continue;
+        }
+        F->Phase = 0;
+
+        Acc = 0;
+        for (Tap = 0; Tap < F->Taps; Tap++)
+        {
+            Coeff = F->Coeffs[Tap / 2];
+            Coeff = (Tap & 1) ? (Coeff >> 16) : (Coeff & 0xFFFF);
+            Acc += (int32_t)F->History.Samples[F->Pos + Tap] * (int16_t)Coeff;
+        }
+
+        Acc >>= 15;
+        Out[Produced++] = (int16_t)DSP_CLIP_Q15(Acc);
+    }
+
+    return Produced;
+}
+
+//*****************************************************************************
+//
+// DspMovingAvgQ15Init: Sets up a moving average and clears its window
+//
+// \param F:        Filter state
+// \param Length:   Window length (power of two, up to DSP_AVG_MAX_LENGTH)
+//
+// \return false if the length is not supported
+//
+//*****************************************************************************
+
+bool DspMovingAvgQ15Init(DspMovingAvgQ15 *F, uint32_t Length)
+{
+    uint32_t lop;
+
+    if ((Length == 0) || (Length & (Length - 1)) || (Length > DSP_AVG_MAX_LENGTH))
+    {
+        return false;
+    }
+
+    for (F->Shift = 0; (1UL << F->Shift) < Length; F->Shift++)
+    {
+    }
+    F->Pos = 0;
+    F->Sum = 0;
+    for (lop = 0; lop < Length; lop++)
+    {
+        F->History[lop] = 0;
+    }
+
+    return true;
+}
+
+//*****************************************************************************
+//
+// DspMovingAvgQ15Process: Averages a block of samples over the window with a
+// running sum, so the cost does not depend on the window length
+//
+// \param F:        Filter state
+// \param In:       Input samples
+// \param Out:      Output samples (may be the same buffer as In)
+// \param Count:    Samples in the block
+//
+//*****************************************************************************
+
+void DspMovingAvgQ15Process(DspMovingAvgQ15 *F, const int16_t *In, int16_t *Out, uint32_t Count)
+{
+    uint32_t lop;
+    uint32_t Mask = (1UL << F->Shift) - 1;
+    int16_t Sample;
+
+    for (lop = 0; lop < Count; lop++)
+    {
+        Sample = In[lop];
+        F->Sum += Sample - F->History[F->Pos];
+        F->History[F->Pos] = Sample;
+        F->Pos = (F->Pos + 1) & Mask;
+        Out[lop] = (int16_t)(F->Sum >> F->Shift);
+    }
+}
+
+//*****************************************************************************
+//
+// DspPipelineQ15Reset: Clears the history of every stage of a pipeline,
+// keeping its coefficients; used before starting a new stream
+//
+//*****************************************************************************
+
+void DspPipelineQ15Reset(DspPipelineQ15 *Pipe)
+{
+    uint32_t lop;
+
+    if (Pipe->Biquad)
+    {
+        for (lop = 0; lop < Pipe->Biquad->Stages; lop++)
+        {
+            Pipe->Biquad->X12[lop] = 0;
+            Pipe->Biquad->Y12[lop] = 0;
+        }
+    }
+
+    if (Pipe->Average)
+    {
+        DspMovingAvgQ15Init(Pipe->Average, 1UL << Pipe->Average->Shift);
+    }
+
+    if (Pipe->Decimator)
+    {
+        Pipe->Decimator->Pos = 0;
+        Pipe->Decimator->Phase = 0;
+        for (lop = 0; lop < Pipe->Decimator->Taps; lop++)
+        {
+            Pipe->Decimator->History.Pairs[lop] = 0;
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// DspPipelineQ15Process: Runs a block through the pipeline in place
+//
+// \param Pipe:     Pipeline stages
+// \param Block:    Samples, replaced by the filtered (and decimated) output
+// \param Count:    Samples in the block
+//
+// \return Samples left in Block
+//
+//*****************************************************************************
+
+uint32_t DspPipelineQ15Process(DspPipelineQ15 *Pipe, int16_t *Block, uint32_t Count)
+{
+    if (Pipe->Biquad)
+    {
+        DspBiquadQ15Process(Pipe->Biquad, Block, Block, Count);
+    }
+
+    if (Pipe->Average)
+    {
+        DspMovingAvgQ15Process(Pipe->Average, Block, Block, Count);
+    }
+
+    if (Pipe->Decimator)
+    {
+        Count = DspFirDecimQ15Process(Pipe->Decimator, Block, Block, Count);
+    }
+
+    return Count;
+}
@@ -0,0 +1,94 @@
+/*
+ dsp_filter.h
+
+ Fixed-point streaming filters (Q15/Q31 cascaded biquads, Q15 FIR decimator,
+ Q15 moving average) used to filter and decimate sample streams on-board
+ before they are stored or transferred.
+ */
+
+#ifndef DSP_FILTER_H_
+#define DSP_FILTER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// DSP Filter Settings
+//
+// Biquad coefficients are given per stage as { b0, b1, b2, a1, a2 } for
+//   y[n] = b0*x[n] + b1*x[n-1] + b2*x[n-2] + a1*y[n-1] + a2*y[n-2]
+// i.e. the feedback coefficients are stored negated. They are scaled down by
+// 2^PostShift so coefficients up to +/-2^PostShift can be represented.
+//
+//*****************************************************************************
+
+#define DSP_BIQUAD_MAX_STAGES   4           // Second-order sections per cascade
+#define DSP_FIR_MAX_TAPS        32          // FIR decimator taps (even)
+#define DSP_AVG_MAX_LENGTH      64          // Moving average window (power of two)
+
+// Q15 biquad cascade (direct form I, 64-bit accumulator)
+typedef struct {
+    uint32_t Stages;                                // Sections in use
+    uint32_t PostShift;                             // Coefficient scaling (0..15)
+    int16_t B0[DSP_BIQUAD_MAX_STAGES];              // b0 per section
+    uint32_t B12[DSP_BIQUAD_MAX_STAGES];            // b1 | b2 << 16 per section
+    uint32_t A12[DSP_BIQUAD_MAX_STAGES];            // a1 | a2 << 16 per section
+    uint32_t X12[DSP_BIQUAD_MAX_STAGES];            // x[n-1] | x[n-2] << 16 per section
+    uint32_t Y12[DSP_BIQUAD_MAX_STAGES];            // y[n-1] | y[n-2] << 16 per section
+} DspBiquadQ15;
+
+// Q31 biquad cascade (direct form I, 64-bit accumulator)
+typedef struct {
+    uint32_t Stages;                                // Sections in use
+    uint32_t PostShift;                             // Coefficient scaling (0..31)
+    int32_t Coeffs[DSP_BIQUAD_MAX_STAGES][5];       // b0, b1, b2, a1, a2 per section
+    int32_t State[DSP_BIQUAD_MAX_STAGES][4];        // x[n-1], x[n-2], y[n-1], y[n-2] per section
+} DspBiquadQ31;
+
+// Q15 FIR decimator
+typedef struct {
+    uint32_t Taps;                                  // Filter length (even)
+    uint32_t Factor;                                // Decimation factor
+    uint32_t Pos;                                   // Oldest sample of the history window
+    uint32_t Phase;                                 // Inputs since the last output
+    uint32_t Coeffs[DSP_FIR_MAX_TAPS / 2];          // Time-reversed coefficients, two per word
+    union {
+        uint32_t Pairs[DSP_FIR_MAX_TAPS];           // History read two samples at a time
+        int16_t Samples[DSP_FIR_MAX_TAPS * 2];      // History stored twice so the window is contiguous
+    } History;
+} DspFirDecimQ15;
+
+// Q15 moving average
+typedef struct {
+    uint32_t Shift;                                 // log2 of the window length
+    uint32_t Pos;                                   // Oldest sample of the window
+    int32_t Sum;                                    // Sum of the samples in the window
+    int16_t History[DSP_AVG_MAX_LENGTH];            // Samples in the window
+} DspMovingAvgQ15;
+
+// Q15 filter pipeline; stages left 0 are skipped
+typedef struct {
+    DspBiquadQ15 *Biquad;                           // Applied first
+    DspMovingAvgQ15 *Average;                       // Applied second
+    DspFirDecimQ15 *Decimator;                      // Applied last
+} DspPipelineQ15;
+
+extern bool DspBiquadQ15Init(DspBiquadQ15 *F, uint32_t Stages, const int16_t *Coeffs, uint32_t PostShift);
+extern void DspBiquadQ15Process(DspBiquadQ15 *F, const int16_t *In, int16_t *Out, uint32_t Count);
+extern void DspBiquadQ15ProcessRef(DspBiquadQ15 *F, const int16_t *In, int16_t *Out, uint32_t Count);
+
+extern bool DspBiquadQ31Init(DspBiquadQ31 *F, uint32_t Stages, const int32_t *Coeffs, uint32_t PostShift);
+extern void DspBiquadQ31Process(DspBiquadQ31 *F, const int32_t *In, int32_t *Out, uint32_t Count);
+
+extern bool DspFirDecimQ15Init(DspFirDecimQ15 *F, uint32_t Taps, uint32_t Factor, const int16_t *Coeffs);
+extern uint32_t DspFirDecimQ15Process(DspFirDecimQ15 *F, const int16_t *In, int16_t *Out, uint32_t Count);
+extern uint32_t DspFirDecimQ15ProcessRef(DspFirDecimQ15 *F, const int16_t *In, int16_t *Out, uint32_t Count);
+
+extern bool DspMovingAvgQ15Init(DspMovingAvgQ15 *F, uint32_t Length);
+extern void DspMovingAvgQ15Process(DspMovingAvgQ15 *F, const int16_t *In, int16_t *Out, uint32_t Count);
+
+extern void DspPipelineQ15Reset(DspPipelineQ15 *Pipe);
+extern uint32_t DspPipelineQ15Process(DspPipelineQ15 *Pipe, int16_t *Block, uint32_t Count);
+
+#endif /* DSP_FILTER_H_ */
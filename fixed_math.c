@@ -0,0 +1,293 @@
+/*
+ fixed_math.c
+
+ Fast integer math.
+
+ • Division by a value that stays the same over a stream (sample counts, scale
+   factors) is replaced by a multiply-high and two shifts with a precomputed
+   magic number, exact for every 32-bit dividend
+ • Square roots of 64-bit values take a single-precision estimate from the FPU
+   (VSQRT), refine it with one integer Newton step and correct the last unit,
+   so the result is the exact floor; utils/isqrt stays the choice for 32-bit
+   values on parts without FPU
+ • log2 uses CLZ for the integer part and repeated squaring for the fraction
+ • atan2 returns angles in the 0.32 fraction-of-a-circle format used by
+   utils/sine, so the two can be combined directly; the ratio is taken on the
+   FPU and the arctangent is a 9th-order odd polynomial in Q30
+ • Calibration polynomials are evaluated with Horner's rule on the FPU, which
+   takes a handful of cycles per sample and keeps the coefficients readable
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "fixed_math.h"
+
+//*****************************************************************************
+//
+// Count Leading Zeros
+//
+//*****************************************************************************
+
+#if defined(__TI_ARM__)
+#define FIX_CLZ(Val)            _norm(Val)
+#elif defined(__GNUC__)
+#define FIX_CLZ(Val)            __builtin_clz(Val)
+#else
+static uint32_t FixClz(uint32_t Val)
+{
+    uint32_t Zeros = 0;
+
+    while (!(Val & 0x80000000))
+    {
+        Val <<= 1;
+        Zeros++;
+    }
+    return Zeros;
+}
+#define FIX_CLZ(Val)            FixClz(Val)
+#endif
+
+//*****************************************************************************
+//
+// Arctangent Coefficients
+//
+// atan(z) = z * (a1 + a3 z^2 + a5 z^4 + a7 z^6 + a9 z^8) for 0 <= z <= 1,
+// error below 1e-5 rad; the coefficients are divided by 2 pi and scaled by
+// 2^32 so the result is a 0.32 fraction of a circle.
+//
+//*****************************************************************************
+
+#define FIX_ATAN_A1             683473678
+#define FIX_ATAN_A3             (-225781269)
+#define FIX_ATAN_A5             123138132
+#define FIX_ATAN_A7             (-58193963)
+#define FIX_ATAN_A9             14242151
+
+#define FIX_QUARTER             0x40000000  // 90 degrees
+#define FIX_HALF                0x80000000  // 180 degrees
+
+//*****************************************************************************
+//
+// FixRecipInit: Precomputes the multiplier for dividing by Divisor
+//
+// \param Recip:    Receives the reciprocal
+// \param Divisor:  The divisor (not 0)
+//
+//*****************************************************************************
+
+void FixRecipInit(FixRecip *Recip, uint32_t Divisor)
+{
+    uint32_t Log2;
+
+    // Log2 = ceil(log2(Divisor))
+    Log2 = (Divisor > 1) ? (32 - FIX_CLZ(Divisor - 1)) : 0;
+
+    Recip->Mul = (uint32_t)((((1ULL << Log2) - Divisor) << 32) / Divisor) + 1;
+    Recip->Shift1 = (Log2 > 0) ? 1 : 0;
+    Recip->Shift2 = (Log2 > 0) ? (Log2 - 1) : 0;
+}
+
+//*****************************************************************************
+//
+// FixRecipDiv: Returns Value / Divisor using a precomputed reciprocal
+//
+//*****************************************************************************
+
+uint32_t FixRecipDiv(const FixRecip *Recip, uint32_t Value)
+{
+    uint32_t High = (uint32_t)(((uint64_t)Recip->Mul * Value) >> 32);
+
+    return (High + ((Value - High) >> Recip->Shift1)) >> Recip->Shift2;
+}
+
+//*****************************************************************************
+//
+// FixSqrt64: Returns floor(sqrt(Value))
+//
+//*****************************************************************************
+
+uint32_t FixSqrt64(uint64_t Value)
+{
+    uint64_t Root;
+
+    // The float estimate only has 24 significant bits: for large values it is
+    // off by up to a few hundred (217 measured, tools/host_tests/math_test.c)
+    Root = (uint64_t)sqrtf((float)Value);
+    if (Root == 0)
+    {
+        return 0;
+    }
+
+    // One Newton step squares the relative error, leaving at most one unit
+    Root = (Root + (Value / Root)) >> 1;
+    if (Root > 0xFFFFFFFF)
+    {
+        Root = 0xFFFFFFFF;
+    }
+
+    while ((Root * Root) > Value)
+    {
+        Root--;
+    }
+    while ((Root < 0xFFFFFFFF) && (((Root + 1) * (Root + 1)) <= Value))
+    {
+        Root++;
+    }
+
+    return (uint32_t)Root;
+}
+
+//*****************************************************************************
+//
+// FixHypot: Returns floor(sqrt(X^2 + Y^2)), e.g. the magnitude of a complex
+// value
+//
+//*****************************************************************************
+
+uint32_t FixHypot(int32_t X, int32_t Y)
+{
+    return FixSqrt64(((int64_t)X * X) + ((int64_t)Y * Y));
+}
+
+//*****************************************************************************
+//
+// FixLog2: Returns log2(Value) in Q16
+//
+// \return FIX_LOG2_ZERO for Value 0
+//
+//*****************************************************************************
+
+int32_t FixLog2(uint32_t Value)
+{
+    uint32_t Int, lop;
+    uint64_t Mant;
+    int32_t Result;
+
+    if (Value == 0)
+    {
+        return FIX_LOG2_ZERO;
+    }
+
+    // Normalize to a Q31 mantissa in [1, 2)
+    Int = 31 - FIX_CLZ(Value);
+    Mant = (uint64_t)Value << (31 - Int);
+    Result = (int32_t)(Int << 16);
+
+    // Each squaring doubles the exponent; a result >= 2 gives the next bit
+    for (lop = 0; lop < 16; lop++)
+    {
+        Mant = (Mant * Mant) >> 31;
+        if (Mant >= (2ULL << 31))
+        {
+            Mant >>= 1;
+            Result |= 1 << (15 - lop);
+        }
+    }
+
+    return Result;
+}
+
+//*****************************************************************************
+//
+// FixAtan2: Returns the angle of the vector (X, Y)
+//
+// \return Angle as a 0.32 fraction of a circle (0x40000000 = 90 degrees),
+//         the format taken by utils/sine
+//
+//*****************************************************************************
+
+uint32_t FixAtan2(int32_t Y, int32_t X)
+{
+    uint32_t Ax, Ay, Angle;
+    int64_t Z, Z2, Poly;
+
+    Ax = (X < 0) ? (0 - (uint32_t)X) : (uint32_t)X;
+    Ay = (Y < 0) ? (0 - (uint32_t)Y) : (uint32_t)Y;
+    if ((Ax | Ay) == 0)
+    {
+        return 0;
+    }
+
+    // Reduce to the first octant: z = min / max in Q30
+    if (Ay <= Ax)
+    {
+        Z = (int64_t)(((float)Ay / (float)Ax) * (float)(1UL << 30));
+    }
+    else
+    {
+        Z = (int64_t)(((float)Ax / (float)Ay) * (float)(1UL << 30));
+    }
+
+    Z2 = (Z * Z) >> 30;
+    Poly = FIX_ATAN_A9;
+    Poly = FIX_ATAN_A7 + ((Poly * Z2) >> 30);
+    Poly = FIX_ATAN_A5 + ((Poly * Z2) >> 30);
+    Poly = FIX_ATAN_A3 + ((Poly * Z2) >> 30);
+    Poly = FIX_ATAN_A1 + ((Poly * Z2) >> 30);
+    Angle = (uint32_t)((Poly * Z) >> 30);
+
+    // Unfold the octant, then the quadrant
+    if (Ay > Ax)
+    {
+        Angle = FIX_QUARTER - Angle;
+    }
+    if (X < 0)
+    {
+        Angle = FIX_HALF - Angle;
+    }
+    if (Y < 0)
+    {
+        Angle = 0 - Angle;
+    }
+
+    return Angle;
+}
+
+//*****************************************************************************
+//
+// FixPolyEval: Evaluates a calibration polynomial
+//
+//*****************************************************************************
+
+float FixPolyEval(const FixPoly *Poly, float X)
+{
+    int32_t lop;
+    float Result = Poly->Coeffs[Poly->Order];
+
+    for (lop = (int32_t)Poly->Order - 1; lop >= 0; lop--)
+    {
+        Result = (Result * X) + Poly->Coeffs[lop];
+    }
+
+    return Result;
+}
+
+//*****************************************************************************
+//
+// FixPolyApply: Converts a raw reading with a calibration polynomial
+//
+// \param Poly:     Calibration; its coefficients set the output unit
+// \param Raw:      The raw reading
+//
+// \return The calibrated value rounded to the nearest integer, saturated to
+//         the int32_t range
+//
+//*****************************************************************************
+
+int32_t FixPolyApply(const FixPoly *Poly, int32_t Raw)
+{
+    float Result = FixPolyEval(Poly, (float)Raw);
+
+    if (Result >= 2147483520.0f)
+    {
+        return 0x7FFFFFFF;
+    }
+    if (Result <= -2147483648.0f)
+    {
+        return (-0x7FFFFFFF - 1);
+    }
+
+    return (int32_t)((Result < 0.0f) ? (Result - 0.5f) : (Result + 0.5f));
+}
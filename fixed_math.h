@@ -0,0 +1,45 @@
+/*
+ fixed_math.h
+
+ Fast integer math for values derived on-board (RMS, magnitudes, calibrated
+ engineering units), built next to utils/isqrt and utils/sine.
+ */
+
+#ifndef FIXED_MATH_H_
+#define FIXED_MATH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Fixed Math Settings
+//
+//*****************************************************************************
+
+#define FIX_POLY_MAX_ORDER      3           // Highest calibration polynomial order
+#define FIX_LOG2_ZERO           (-0x7FFFFFFF - 1)   // FixLog2 result for 0
+
+// Precomputed reciprocal for repeated division by the same divisor
+typedef struct {
+    uint32_t Mul;                   // Magic multiplier
+    uint32_t Shift1;                // First correction shift (0 or 1)
+    uint32_t Shift2;                // Final shift
+} FixRecip;
+
+// Calibration polynomial: Out = C[0] + C[1]*x + ... + C[Order]*x^Order
+typedef struct {
+    uint32_t Order;                         // Polynomial order (0..FIX_POLY_MAX_ORDER)
+    float Coeffs[FIX_POLY_MAX_ORDER + 1];   // Coefficients, constant term first
+} FixPoly;
+
+extern void FixRecipInit(FixRecip *Recip, uint32_t Divisor);
+extern uint32_t FixRecipDiv(const FixRecip *Recip, uint32_t Value);
+extern uint32_t FixSqrt64(uint64_t Value);
+extern uint32_t FixHypot(int32_t X, int32_t Y);
+extern int32_t FixLog2(uint32_t Value);
+extern uint32_t FixAtan2(int32_t Y, int32_t X);
+extern float FixPolyEval(const FixPoly *Poly, float X);
+extern int32_t FixPolyApply(const FixPoly *Poly, int32_t Raw);
+
+#endif /* FIXED_MATH_H_ */
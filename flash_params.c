@@ -0,0 +1,199 @@
+/*
+ flash_params.c
+
+ Flash-resident parameter blocks for high-churn counters.
+
+ • Counters such as the boot count or recording sequence number change too often
+   to be rewritten in place; instead every save appends a new 128-byte block to a
+   journal of flash pages managed by utils/flash_pb.c
+ • Each block carries a sequence number and checksum, so a save interrupted by a
+   power loss leaves an invalid block behind and the newest valid block is used
+   on the next boot
+ • flash_pb's checksum is a byte sum, which passes about one torn block in 256;
+   blocks also carry a CRC-32 in their last word and the journal is rescanned
+   for the newest block whose CRC matches (tools/host_tests/params_test.c)
+ • Flash is only erased once every (journal size / 128) saves, spreading wear
+ • Save latency is measured with the DWT cycle counter
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "driverlib/sw_crc.h"
+#include "utils/flash_pb.h"
+
+#include "cycle_counter.h"
+#include "flash_writer.h"
+#include "flash_params.h"
+
+//*****************************************************************************
+//
+// Parameter State
+//
+//*****************************************************************************
+
+static FlashParams FP_Params;           // Working copy of the parameters
+static uint32_t FP_SaveCycles = 0;      // Cycles taken by the last save
+static uint32_t FP_SaveCyclesMax = 0;   // Slowest save since boot
+
+//*****************************************************************************
+//
+// FlashParamsDefaults: Resets the working copy to its defaults
+//
+//*****************************************************************************
+
+static void FlashParamsDefaults(void)
+{
+    uint32_t lop;
+    uint8_t *Bytes = (uint8_t *)&FP_Params;
+
+    for (lop = 0; lop < sizeof(FP_Params); lop++)
+    {
+        Bytes[lop] = 0;
+    }
+
+    FP_Params.Version = FLASH_PARAMS_VERSION;
+}
+
+//*****************************************************************************
+//
+// FlashParamsCrc: Returns the CRC-32 of a block, leaving out the bytes
+// maintained by flash_pb (Sequence, Checksum) and the CRC itself
+//
+//*****************************************************************************
+
+static uint32_t FlashParamsCrc(const FlashParams *Block)
+{
+    return Crc32(0xFFFFFFFF, (const uint8_t *)&Block->Version,
+                 offsetof(FlashParams, Crc) - offsetof(FlashParams, Version)) ^ 0xFFFFFFFF;
+}
+
+//*****************************************************************************
+//
+// FlashParamsInit: Scans the journal for the newest valid parameter block and
+// loads it, falling back to defaults if there is none
+//
+// \param Start:    Page-aligned start of the journal in flash
+// \param End:      Page-aligned end of the journal (at least two pages so the
+//                  newest block is never in the page being erased)
+//
+//*****************************************************************************
+
+void FlashParamsInit(uint32_t Start, uint32_t End)
+{
+    const FlashParams *Block, *Newest = 0;
+
+    FlashPBInit(Start, End, sizeof(FlashParams));
+
+    // flash_pb may have picked a torn block that passed its checksum; the next
+    // save still follows it, with a newer sequence number
+    for (Block = (const FlashParams *)Start; Block < (const FlashParams *)End; Block++)
+    {
+        if ((Block->Version != FLASH_PARAMS_VERSION) || (Block->Crc != FlashParamsCrc(Block)))
+        {
+            continue;
+        }
+
+        // Same ordering as FlashPBInit: the sequence number wraps after 256 blocks
+        if (Newest && ((uint8_t)(Block->Sequence - Newest->Sequence) > 128))
+        {
+            continue;
+        }
+        Newest = Block;
+    }
+
+    if (Newest == 0)
+    {
+        FlashParamsDefaults();
+        return;
+    }
+
+    FP_Params = *Newest;
+}
+
+//*****************************************************************************
+//
+// FlashParamsGet: Returns the working copy of the parameters; changes are
+// kept in RAM until FlashParamsSave is called
+//
+//*****************************************************************************
+
+FlashParams *FlashParamsGet(void)
+{
+    return &FP_Params;
+}
+
+//*****************************************************************************
+//
+// FlashParamsSave: Appends the working copy to the journal
+//
+// \return true if the new block was written and verified
+//
+//*****************************************************************************
+
+bool FlashParamsSave(void)
+{
+    return FlashParamsSaveCopy(&FP_Params);
+}
+
+//*****************************************************************************
+//
+// FlashParamsSaveCopy: Appends an edited copy of the parameters to the journal
+// and makes it the working copy once it is in flash, so a failed save leaves
+// RAM matching flash
+//
+// \param Params:   The parameters to save, usually a copy of FlashParamsGet()
+//
+// \return true if the new block was written and verified
+//
+//*****************************************************************************
+
+bool FlashParamsSaveCopy(const FlashParams *Params)
+{
+    FlashParams Block;
+    uint8_t *Previous;
+    uint32_t Start;
+
+    // flash_pb erases and programs synchronously, so let any recording finish first
+    while (FlashWriterBusy())
+    {
+    }
+
+    Block = *Params;
+    Block.Checksum = 0;
+    Block.Crc = FlashParamsCrc(&Block);
+    Previous = FlashPBGet();
+
+    Start = CycleCounterGet();
+    FlashPBSave((uint8_t *)&Block);
+    FP_SaveCycles = CycleCounterGet() - Start;
+
+    if (FP_SaveCycles > FP_SaveCyclesMax)
+    {
+        FP_SaveCyclesMax = FP_SaveCycles;
+    }
+
+    // flash_pb only moves to the new block once it has been verified
+    if (FlashPBGet() == Previous)
+    {
+        return false;
+    }
+
+    FP_Params = Block;
+    return true;
+}
+
+//*****************************************************************************
+//
+// FlashParamsSaveCycles: Returns the save latency in CPU cycles
+//
+// \param Max:      true for the slowest save since boot (includes page erases),
+//                  false for the last save
+//
+//*****************************************************************************
+
+uint32_t FlashParamsSaveCycles(bool Max)
+{
+    return Max ? FP_SaveCyclesMax : FP_SaveCycles;
+}
@@ -0,0 +1,53 @@
+/*
+ flash_params.h
+
+ Journaled, flash-resident storage for frequently changing counters (boot
+ statistics, recording sequence numbers, last sample size) and the per-module
+ sensor calibrations, built on utils/flash_pb.c.
+ */
+
+#ifndef FLASH_PARAMS_H_
+#define FLASH_PARAMS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fixed_math.h"
+
+//*****************************************************************************
+//
+// Parameter Block Settings
+//
+//*****************************************************************************
+
+#define FLASH_PARAMS_VERSION    3           // Bump when the FlashParams layout changes
+#define FLASH_PARAMS_CAL_SLOTS  4           // Sensor modules with a stored calibration
+
+// Calibration of one sensor module
+typedef struct {
+    uint32_t ModuleID;              // Module ID from the 0x7DF broadcast, 0 = free slot
+    FixPoly Poly;                   // Raw counts to engineering units
+} FlashParamsCal;
+
+// Parameter block; the size must be a power of two dividing the 1 KB flash page
+typedef struct {
+    uint8_t Sequence;               // Sequence number, maintained by flash_pb
+    uint8_t Checksum;               // Checksum byte, maintained by flash_pb
+    uint16_t Version;               // Layout version (FLASH_PARAMS_VERSION)
+    uint32_t BootCount;             // Number of boots
+    uint32_t LastResetCause;        // SYSCTL_CAUSE_* flags of the last reset
+    uint32_t RecordingSeq;          // Completed sample downloads
+    uint32_t LastSampleSize;        // Size in bytes of the last downloaded sample
+    uint32_t LastSampleCrc;         // CRC32 of the last downloaded sample
+    FlashParamsCal Cal[FLASH_PARAMS_CAL_SLOTS]; // Sensor calibrations
+    uint32_t Reserved;              // Spare, keeps the block at 128 bytes
+    uint32_t Crc;                   // CRC-32 of Version..Reserved; written last, so a torn block fails it
+} FlashParams;
+
+extern void FlashParamsInit(uint32_t Start, uint32_t End);
+extern FlashParams *FlashParamsGet(void);
+extern bool FlashParamsSave(void);
+extern bool FlashParamsSaveCopy(const FlashParams *Params);
+extern uint32_t FlashParamsSaveCycles(bool Max);
+
+#endif /* FLASH_PARAMS_H_ */
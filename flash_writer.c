@@ -0,0 +1,432 @@
+/*
+ flash_writer.c
+
+ Asynchronous flash writer for the local sample recording.
+
+ • Samples are collected into one of two page-sized RAM buffers while the other
+   one is being committed, so the CAN response path never waits on FlashErase
+   or FlashProgram
+ • Erase and program operations are started directly on the flash controller and
+   advanced from the flash controller interrupt (FLASH_INT_PROGRAM), one page
+   erase or one 32-word write-buffer program at a time
+ • The page currently being filled is erased in the background, ahead of the data
+ • Queue depth and stall counts are kept so the operator can see whether flash
+   keeps up with the incoming sample rate
+ • An erase or program error stops the session: queued pages are dropped and
+   further words ignored until the next FlashWriterStart, and FlashWriterFailed
+   tells the caller the recording is bad
+
+ Note: on the TM4C123 instruction fetches from flash are held off while an erase
+ or program is in progress; incoming CAN frames are held by the CAN controller's
+ message objects during that window and picked up when the operation completes.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_types.h"
+#include "inc/hw_flash.h"
+#include "driverlib/flash.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/rom.h"
+#include "driverlib/rom_map.h"
+
+#include "flash_writer.h"
+
+//*****************************************************************************
+//
+// Flash Writer State
+//
+//*****************************************************************************
+
+// Flash controller operation in progress
+enum {
+    FW_IDLE = 0,                    // Controller idle
+    FW_ERASE,                       // Page erase in progress
+    FW_PROGRAM                      // Write-buffer program in progress
+};
+
+// Flash controller interrupts serviced by the writer
+#define FW_INT_FLAGS    (FLASH_INT_PROGRAM | FLASH_INT_ACCESS | FLASH_INT_VOLTAGE_ERR | \
+                         FLASH_INT_DATA_ERR | FLASH_INT_ERASE_ERR | FLASH_INT_PROGRAM_ERR)
+
+// Flash controller interrupts counted as errors
+#define FW_INT_ERRORS   (FLASH_INT_ACCESS | FLASH_INT_VOLTAGE_ERR | FLASH_INT_DATA_ERR | \
+                         FLASH_INT_ERASE_ERR | FLASH_INT_PROGRAM_ERR)
+
+static uint32_t FW_Buffer[FLASH_WRITER_BUFFERS][FLASH_WRITER_PAGE_WORDS];  // Page buffers
+static volatile uint32_t FW_BufAddr[FLASH_WRITER_BUFFERS];  // Flash address of each queued buffer
+static volatile uint32_t FW_BufWords[FLASH_WRITER_BUFFERS]; // Number of valid words in each queued buffer
+
+static volatile uint32_t FW_QueueHead = 0;      // Oldest queued buffer (being programmed)
+static volatile uint32_t FW_QueueCount = 0;     // Number of queued buffers
+static volatile uint32_t FW_ProgOffset = 0;     // Words of the head buffer already handed to the controller
+static volatile uint32_t FW_EraseNext = 0;      // First page not yet erased
+static volatile uint32_t FW_State = FW_IDLE;    // Current controller operation
+static volatile bool FW_Failed = false;         // Session stopped by an erase/program error
+
+static uint32_t FW_FillIndex = 0;               // Buffer currently being filled by FlashWriterPut
+static uint32_t FW_FillAddr = 0;                // Flash address of the page being filled
+static uint32_t FW_FillWords = 0;               // Words written into the fill buffer
+static uint32_t FW_EndAddress = 0;              // End of the region (exclusive)
+
+static volatile FlashWriterStats FW_Stats;      // Writer statistics
+
+//*****************************************************************************
+//
+// FlashWriterKick: Starts the next flash controller operation if the controller
+// is idle; must be called from the flash ISR or with the flash interrupt masked
+//
+//*****************************************************************************
+
+static void FlashWriterKick(void)
+{
+    uint32_t Head, Addr, Words, lop;
+
+    if ((FW_State != FW_IDLE) || FW_Failed)
+    {
+        return;
+    }
+
+    if (FW_QueueCount)
+    {
+        Head = FW_QueueHead;
+
+        // The page must be erased before it can be programmed
+        if (FW_BufAddr[Head] >= FW_EraseNext)
+        {
+            HWREG(FLASH_FCMISC) = FLASH_FCMISC_AMISC | FLASH_FCMISC_VOLTMISC | FLASH_FCMISC_ERMISC;
+            HWREG(FLASH_FMA) = FW_EraseNext;
+            HWREG(FLASH_FMC) = FLASH_FMC_WRKEY | FLASH_FMC_ERASE;
+            FW_State = FW_ERASE;
+            return;
+        }
+
+        // Load the next (up to) 32 words of the head buffer into the write buffer
+        Addr = FW_BufAddr[Head] + (FW_ProgOffset * 4);
+        Words = FW_BufWords[Head] - FW_ProgOffset;
+        if (Words > FLASH_WRITER_CHUNK_WORDS)
+        {
+            Words = FLASH_WRITER_CHUNK_WORDS;
+        }
+
+        HWREG(FLASH_FCMISC) = FLASH_FCMISC_AMISC | FLASH_FCMISC_VOLTMISC |
+                              FLASH_FCMISC_INVDMISC | FLASH_FCMISC_PROGMISC;
+        HWREG(FLASH_FMA) = Addr & ~(0x7f);
+        for (lop = 0; lop < Words; lop++)
+        {
+            HWREG(FLASH_FWBN + ((Addr + (lop * 4)) & 0x7c)) = FW_Buffer[Head][FW_ProgOffset + lop];
+        }
+        FW_ProgOffset += Words;
+
+        HWREG(FLASH_FMC2) = FLASH_FMC2_WRKEY | FLASH_FMC2_WRBUF;
+        FW_State = FW_PROGRAM;
+        return;
+    }
+
+    // Nothing queued: erase the page currently being filled in the background
+    if ((FW_EraseNext <= FW_FillAddr) && (FW_EraseNext < FW_EndAddress))
+    {
+        HWREG(FLASH_FCMISC) = FLASH_FCMISC_AMISC | FLASH_FCMISC_VOLTMISC | FLASH_FCMISC_ERMISC;
+        HWREG(FLASH_FMA) = FW_EraseNext;
+        HWREG(FLASH_FMC) = FLASH_FMC_WRKEY | FLASH_FMC_ERASE;
+        FW_State = FW_ERASE;
+    }
+}
+
+//*****************************************************************************
+//
+// FlashWriterQueue: Hands the fill buffer to the interrupt-driven commit queue
+// and switches filling over to the other buffer
+//
+//*****************************************************************************
+
+static void FlashWriterQueue(void)
+{
+    MAP_IntDisable(INT_FLASH);
+
+    // A failed session programs nothing more; drop the page
+    if (FW_Failed)
+    {
+        FW_FillWords = 0;
+        MAP_IntEnable(INT_FLASH);
+        return;
+    }
+
+    FW_BufAddr[FW_FillIndex] = FW_FillAddr;
+    FW_BufWords[FW_FillIndex] = FW_FillWords;
+    FW_QueueCount++;
+
+    FW_Stats.QueueDepth = FW_QueueCount;
+    if (FW_QueueCount > FW_Stats.MaxQueueDepth)
+    {
+        FW_Stats.MaxQueueDepth = FW_QueueCount;
+    }
+
+    FW_FillIndex = (FW_FillIndex + 1) % FLASH_WRITER_BUFFERS;
+    FW_FillAddr += FLASH_WRITER_PAGE_SIZE;
+    FW_FillWords = 0;
+
+    FlashWriterKick();
+
+    MAP_IntEnable(INT_FLASH);
+}
+
+//*****************************************************************************
+//
+// FlashWriterInit: Enables the flash controller interrupts used by the writer
+//
+//*****************************************************************************
+
+void FlashWriterInit(void)
+{
+    MAP_FlashIntClear(FW_INT_FLAGS);
+    MAP_FlashIntEnable(FW_INT_FLAGS);
+    MAP_IntEnable(INT_FLASH);
+}
+
+//*****************************************************************************
+//
+// FlashWriterStart: Begins a new write session; the first page is erased in the
+// background straight away
+//
+// \param Address:  Page-aligned flash address to start writing at
+// \param Size:     Size of the region in bytes
+//
+// \return true if the session was started, false if the writer is still busy
+// or the address is not page aligned
+//
+//*****************************************************************************
+
+bool FlashWriterStart(uint32_t Address, uint32_t Size)
+{
+    if ((Address & (FLASH_WRITER_PAGE_SIZE - 1)) || FlashWriterBusy())
+    {
+        return false;
+    }
+
+    MAP_IntDisable(INT_FLASH);
+
+    FW_QueueHead = 0;
+    FW_QueueCount = 0;
+    FW_ProgOffset = 0;
+    FW_EraseNext = Address;
+    FW_FillIndex = 0;
+    FW_FillAddr = Address;
+    FW_FillWords = 0;
+    FW_EndAddress = Address + Size;
+    FW_Failed = false;
+
+    FW_Stats.QueueDepth = 0;
+    FW_Stats.MaxQueueDepth = 0;
+    FW_Stats.Stalls = 0;
+    FW_Stats.PagesErased = 0;
+    FW_Stats.PagesWritten = 0;
+    FW_Stats.Errors = 0;
+
+    FlashWriterKick();
+
+    MAP_IntEnable(INT_FLASH);
+
+    return true;
+}
+
+//*****************************************************************************
+//
+// FlashWriterPut: Appends one 32-bit word to the recording; only waits if both
+// page buffers are full (counted as a stall)
+//
+// \param Word:     The word to write
+//
+//*****************************************************************************
+
+void FlashWriterPut(uint32_t Word)
+{
+    // Ignore data past the end of the region or after an error
+    if (((FW_FillAddr + (FW_FillWords * 4)) >= FW_EndAddress) || FW_Failed)
+    {
+        return;
+    }
+
+    // Wait for the ISR to free a buffer if both are queued
+    if (FW_QueueCount == FLASH_WRITER_BUFFERS)
+    {
+        FW_Stats.Stalls++;
+        while (FW_QueueCount == FLASH_WRITER_BUFFERS)
+        {
+        }
+    }
+
+    FW_Buffer[FW_FillIndex][FW_FillWords++] = Word;
+
+    // Queue the buffer once the page is full or the region ends
+    if ((FW_FillWords == FLASH_WRITER_PAGE_WORDS) ||
+        ((FW_FillAddr + (FW_FillWords * 4)) >= FW_EndAddress))
+    {
+        FlashWriterQueue();
+    }
+}
+
+//*****************************************************************************
+//
+// FlashWriterFlush: Queues a partially filled page buffer for programming
+//
+//*****************************************************************************
+
+void FlashWriterFlush(void)
+{
+    if (FW_FillWords == 0)
+    {
+        return;
+    }
+
+    if (FW_QueueCount == FLASH_WRITER_BUFFERS)
+    {
+        FW_Stats.Stalls++;
+        while (FW_QueueCount == FLASH_WRITER_BUFFERS)
+        {
+        }
+    }
+
+    FlashWriterQueue();
+}
+
+//*****************************************************************************
+//
+// FlashWriterBusy: Checks whether any page is still queued or a flash
+// operation is in progress
+//
+// \return true if the writer is busy
+//
+//*****************************************************************************
+
+bool FlashWriterBusy(void)
+{
+    return (FW_QueueCount != 0) || (FW_State != FW_IDLE);
+}
+
+//*****************************************************************************
+//
+// FlashWriterFailed: Checks whether the flash controller reported an erase or
+// program error since FlashWriterStart; the recording is then incomplete
+//
+// \return true if the session was stopped by an error
+//
+//*****************************************************************************
+
+bool FlashWriterFailed(void)
+{
+    return FW_Failed;
+}
+
+//*****************************************************************************
+//
+// FlashWriterSync: Flushes the fill buffer, closes the session and waits until
+// everything has been committed to flash. Once it returns the writer leaves the
+// flash controller alone, so blocking driverlib flash calls can be used again.
+//
+//*****************************************************************************
+
+void FlashWriterSync(void)
+{
+    FlashWriterFlush();
+
+    // Stop background erasing of pages past the data written so far
+    FW_EndAddress = FW_FillAddr;
+
+    while (FlashWriterBusy())
+    {
+    }
+}
+
+//*****************************************************************************
+//
+// FlashWriterAddressGet: Returns the flash address the next word will be
+// written to
+//
+//*****************************************************************************
+
+uint32_t FlashWriterAddressGet(void)
+{
+    return FW_FillAddr + (FW_FillWords * 4);
+}
+
+//*****************************************************************************
+//
+// FlashWriterStatsGet: Copies the current writer statistics
+//
+// \param Stats:    Pointer to the structure to fill in
+//
+//*****************************************************************************
+
+void FlashWriterStatsGet(FlashWriterStats *Stats)
+{
+    MAP_IntDisable(INT_FLASH);
+
+    Stats->QueueDepth = FW_Stats.QueueDepth;
+    Stats->MaxQueueDepth = FW_Stats.MaxQueueDepth;
+    Stats->Stalls = FW_Stats.Stalls;
+    Stats->PagesErased = FW_Stats.PagesErased;
+    Stats->PagesWritten = FW_Stats.PagesWritten;
+    Stats->Errors = FW_Stats.Errors;
+
+    MAP_IntEnable(INT_FLASH);
+}
+
+//*****************************************************************************
+//
+// Flash Controller Interrupt Handler: Called when a page erase or write-buffer
+// program completes; retires the finished operation and starts the next one
+//
+//*****************************************************************************
+
+void FlashWriterIntHandler(void)
+{
+    uint32_t ulStatus;
+
+    // Get the cause of the interrupt and clear it
+    ulStatus = MAP_FlashIntStatus(true);
+    MAP_FlashIntClear(ulStatus);
+
+    if (ulStatus & FW_INT_ERRORS)
+    {
+        FW_Stats.Errors++;
+
+        // An operation of the session failed: the page was not erased or not
+        // programmed, so stop rather than program on top of it
+        if (FW_State != FW_IDLE)
+        {
+            FW_Failed = true;
+            FW_QueueCount = 0;
+            FW_ProgOffset = 0;
+            FW_Stats.QueueDepth = 0;
+            FW_State = FW_IDLE;
+            return;
+        }
+    }
+
+    // Retire the finished operation
+    if ((FW_State == FW_ERASE) && !(HWREG(FLASH_FMC) & FLASH_FMC_ERASE))
+    {
+        FW_EraseNext += FLASH_WRITER_PAGE_SIZE;
+        FW_Stats.PagesErased++;
+        FW_State = FW_IDLE;
+    }
+    else if ((FW_State == FW_PROGRAM) && !(HWREG(FLASH_FMC2) & FLASH_FMC2_WRBUF))
+    {
+        if (FW_ProgOffset >= FW_BufWords[FW_QueueHead])
+        {
+            FW_QueueHead = (FW_QueueHead + 1) % FLASH_WRITER_BUFFERS;
+            FW_QueueCount--;
+            FW_ProgOffset = 0;
+            FW_Stats.QueueDepth = FW_QueueCount;
+            FW_Stats.PagesWritten++;
+        }
+        FW_State = FW_IDLE;
+    }
+
+    // Start the next erase or program operation
+    FlashWriterKick();
+}
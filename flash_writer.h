@@ -0,0 +1,46 @@
+/*
+ flash_writer.h
+
+ Asynchronous, interrupt-driven flash writer used to commit received sensor
+ samples to the local flash user space without blocking the CAN response path.
+ */
+
+#ifndef FLASH_WRITER_H_
+#define FLASH_WRITER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Flash Writer Settings
+//
+//*****************************************************************************
+
+#define FLASH_WRITER_PAGE_SIZE      1024                            // Flash erase page size in bytes
+#define FLASH_WRITER_PAGE_WORDS     (FLASH_WRITER_PAGE_SIZE / 4)    // 32-bit words per page
+#define FLASH_WRITER_CHUNK_WORDS    32                              // Words per write-buffer program operation
+#define FLASH_WRITER_BUFFERS        2                               // Page buffers (double buffered)
+
+// Writer statistics, exposed so the operator can see whether flash keeps up
+typedef struct {
+    uint32_t QueueDepth;            // Page buffers currently waiting to be programmed
+    uint32_t MaxQueueDepth;         // Highest queue depth seen since FlashWriterStart
+    uint32_t Stalls;                // Times FlashWriterPut had to wait for a free buffer
+    uint32_t PagesErased;           // Pages erased since FlashWriterStart
+    uint32_t PagesWritten;          // Page buffers fully programmed since FlashWriterStart
+    uint32_t Errors;                // Erase/program errors reported by the flash controller
+} FlashWriterStats;
+
+extern void FlashWriterInit(void);
+extern bool FlashWriterStart(uint32_t Address, uint32_t Size);
+extern void FlashWriterPut(uint32_t Word);
+extern void FlashWriterFlush(void);
+extern bool FlashWriterBusy(void);
+extern bool FlashWriterFailed(void);
+extern void FlashWriterSync(void);
+extern uint32_t FlashWriterAddressGet(void);
+extern void FlashWriterStatsGet(FlashWriterStats *Stats);
+extern void FlashWriterIntHandler(void);
+
+#endif /* FLASH_WRITER_H_ */
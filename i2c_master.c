@@ -0,0 +1,349 @@
+/*
+ i2c_master.c
+
+ Interrupt-driven I2C master transaction engine.
+
+ • Callers queue transaction descriptors and return straight away; each byte
+   completion raises the master interrupt, which advances the transaction
+   instead of the caller spinning on I2CMasterBusy
+ • A write followed by a read is issued without a STOP in between, so the read
+   starts with a repeated start (register reads)
+ • NACKs, lost arbitration and clock low timeouts end the transaction with the
+   error reported in its status, and the queue moves on to the next one
+ • The bus clock is set directly from the requested speed so Fast-mode Plus can
+   be used, which I2CMasterInitExpClk does not offer
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_types.h"
+#include "inc/hw_i2c.h"
+#include "driverlib/i2c.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/rom.h"
+#include "driverlib/rom_map.h"
+
+#include "i2c_master.h"
+
+//*****************************************************************************
+//
+// I2C Master Queue State
+//
+//*****************************************************************************
+
+// Phase of the transaction at the head of the queue
+enum {
+    I2CM_IDLE = 0,                  // Nothing in progress
+    I2CM_WRITE,                     // Writing TxData
+    I2CM_READ,                      // Reading RxData
+    I2CM_STOP                       // Error STOP issued, waiting for it to finish
+};
+
+#define I2CM_CLOCK_TIMEOUT      0x7D        // Clock low timeout, in units of 16 SCL periods
+
+static I2CMasterXfer *volatile I2CM_Queue[I2CM_QUEUE_SIZE];  // Queued transactions, head in progress
+static volatile uint32_t I2CM_Head = 0;     // Transaction in progress
+static volatile uint32_t I2CM_Count = 0;    // Number of queued transactions
+static volatile uint32_t I2CM_Phase = I2CM_IDLE;
+static uint32_t I2CM_Index = 0;             // Next byte of the current phase
+static uint32_t I2CM_Error = 0;             // Error that ended the current transaction
+static uint32_t I2CM_Speed = 0;             // Bus speed in bit/s
+
+static volatile I2CMasterStats I2CM_Stats;  // Queue statistics
+
+//*****************************************************************************
+//
+// I2CMasterStartRead: Addresses the slave for reading; after a write this
+// produces a repeated start
+//
+//*****************************************************************************
+
+static void I2CMasterStartRead(I2CMasterXfer *Xfer)
+{
+    I2CM_Phase = I2CM_READ;
+    I2CM_Index = 0;
+
+    MAP_I2CMasterSlaveAddrSet(I2CM_BASE, Xfer->Address, true);
+    MAP_I2CMasterControl(I2CM_BASE, (Xfer->RxCount == 1) ? I2C_MASTER_CMD_SINGLE_RECEIVE :
+                                                       I2C_MASTER_CMD_BURST_RECEIVE_START);
+}
+
+//*****************************************************************************
+//
+// I2CMasterStart: Starts the transaction at the head of the queue; must be
+// called from the I2C ISR or with the I2C interrupt masked
+//
+//*****************************************************************************
+
+static void I2CMasterStart(void)
+{
+    I2CMasterXfer *Xfer;
+
+    if (I2CM_Count == 0)
+    {
+        I2CM_Phase = I2CM_IDLE;
+        return;
+    }
+
+    Xfer = I2CM_Queue[I2CM_Head];
+    I2CM_Error = I2C_MASTER_ERR_NONE;
+
+    if (Xfer->TxCount == 0)
+    {
+        I2CMasterStartRead(Xfer);
+        return;
+    }
+
+    // A single byte with nothing to read can go out as one complete transfer;
+    // otherwise the STOP is held back for the rest of the data or the read
+    I2CM_Phase = I2CM_WRITE;
+    I2CM_Index = 1;
+
+    MAP_I2CMasterSlaveAddrSet(I2CM_BASE, Xfer->Address, false);
+    MAP_I2CMasterDataPut(I2CM_BASE, Xfer->TxData[0]);
+    MAP_I2CMasterControl(I2CM_BASE, ((Xfer->TxCount == 1) && (Xfer->RxCount == 0)) ?
+                                I2C_MASTER_CMD_SINGLE_SEND : I2C_MASTER_CMD_BURST_SEND_START);
+}
+
+//*****************************************************************************
+//
+// I2CMasterComplete: Retires the head transaction, reports it to its owner and
+// starts the next one
+//
+//*****************************************************************************
+
+static void I2CMasterComplete(void)
+{
+    I2CMasterXfer *Xfer = I2CM_Queue[I2CM_Head];
+
+    if (I2CM_Error == I2C_MASTER_ERR_NONE)
+    {
+        I2CM_Stats.Completed++;
+    }
+    else if (I2CM_Error & I2C_MASTER_ERR_ARB_LOST)
+    {
+        I2CM_Stats.ArbLost++;
+    }
+    else if (I2CM_Error & I2C_MASTER_ERR_CLK_TOUT)
+    {
+        I2CM_Stats.Timeouts++;
+    }
+    else
+    {
+        I2CM_Stats.Nacks++;
+    }
+
+    I2CM_Head = (I2CM_Head + 1) % I2CM_QUEUE_SIZE;
+    I2CM_Count--;
+
+    Xfer->Status = I2CM_Error;
+    if (Xfer->Done)
+    {
+        Xfer->Done(Xfer);
+    }
+
+    I2CMasterStart();
+}
+
+//*****************************************************************************
+//
+// I2CMasterQueueInit: Configures the I2C master for interrupt-driven operation
+// at the requested speed; the module, clocks and pins must already be set up
+//
+// \param SysClock: System clock in Hz
+// \param Speed:    Bus speed in bit/s (I2CM_SPEED_*)
+//
+//*****************************************************************************
+
+void I2CMasterQueueInit(uint32_t SysClock, uint32_t Speed)
+{
+    MAP_I2CMasterEnable(I2CM_BASE);
+
+    I2CM_Speed = Speed;
+    I2CMasterQueueClockSet(SysClock);
+
+    // A slave holding SCL low ends the transaction instead of hanging the queue
+    MAP_I2CMasterTimeoutSet(I2CM_BASE, I2CM_CLOCK_TIMEOUT);
+
+    I2CM_Head = 0;
+    I2CM_Count = 0;
+    I2CM_Phase = I2CM_IDLE;
+
+    MAP_I2CMasterIntClearEx(I2CM_BASE, I2C_MASTER_INT_DATA | I2C_MASTER_INT_TIMEOUT);
+    MAP_I2CMasterIntEnableEx(I2CM_BASE, I2C_MASTER_INT_DATA | I2C_MASTER_INT_TIMEOUT);
+    MAP_IntEnable(INT_I2C0);
+}
+
+//*****************************************************************************
+//
+// I2CMasterQueueClockSet: Keeps the bus speed after a system clock change;
+// call while the queue is idle
+//
+// \param SysClock: New system clock in Hz
+//
+//*****************************************************************************
+
+void I2CMasterQueueClockSet(uint32_t SysClock)
+{
+    // SCL period = 2 * (1 + TPR) * 10 system clocks; round the divider up so the
+    // bus never runs faster than requested (TPR = 3 for 1 Mbit/s at 80 MHz)
+    HWREG(I2CM_BASE + I2C_O_MTPR) = ((SysClock + (2 * 10 * I2CM_Speed) - 1) / (2 * 10 * I2CM_Speed)) - 1;
+}
+
+//*****************************************************************************
+//
+// I2CMasterSubmit: Queues a transaction; it is started straight away if the bus
+// is idle
+//
+// \param Xfer:     The transaction; Status is set to I2CM_PENDING and updated
+//                  when it completes
+//
+// \return false if the queue is full or the transaction moves no data
+//
+//*****************************************************************************
+
+bool I2CMasterSubmit(I2CMasterXfer *Xfer)
+{
+    bool Accepted = false;
+
+    // With nothing to write the read path would start a receive into RxData
+    if ((Xfer->TxCount == 0) && (Xfer->RxCount == 0))
+    {
+        return false;
+    }
+
+    MAP_IntDisable(INT_I2C0);
+
+    if (I2CM_Count < I2CM_QUEUE_SIZE)
+    {
+        Xfer->Status = I2CM_PENDING;
+        I2CM_Queue[(I2CM_Head + I2CM_Count) % I2CM_QUEUE_SIZE] = Xfer;
+        I2CM_Count++;
+
+        if (I2CM_Count > I2CM_Stats.MaxDepth)
+        {
+            I2CM_Stats.MaxDepth = I2CM_Count;
+        }
+
+        if (I2CM_Phase == I2CM_IDLE)
+        {
+            I2CMasterStart();
+        }
+        Accepted = true;
+    }
+
+    MAP_IntEnable(INT_I2C0);
+
+    return Accepted;
+}
+
+//*****************************************************************************
+//
+// I2CMasterIdle: Checks whether all queued transactions have completed
+//
+//*****************************************************************************
+
+bool I2CMasterIdle(void)
+{
+    return I2CM_Count == 0;
+}
+
+//*****************************************************************************
+//
+// I2CMasterStatsGet: Copies the current queue statistics
+//
+// \param Stats:    Pointer to the structure to fill in
+//
+//*****************************************************************************
+
+void I2CMasterStatsGet(I2CMasterStats *Stats)
+{
+    *Stats = I2CM_Stats;
+}
+
+//*****************************************************************************
+//
+// I2CMasterQueueIntHandler: Advances the current transaction after each byte;
+// called from the I2C0 interrupt handler, which is shared with the slave
+//
+//*****************************************************************************
+
+void I2CMasterQueueIntHandler(void)
+{
+    I2CMasterXfer *Xfer;
+    uint32_t ulStatus;
+
+    // Get the cause of the interrupt and clear it
+    ulStatus = MAP_I2CMasterIntStatusEx(I2CM_BASE, true);
+    MAP_I2CMasterIntClearEx(I2CM_BASE, ulStatus);
+
+    if ((I2CM_Phase == I2CM_IDLE) || (ulStatus == 0))
+    {
+        return;
+    }
+
+    Xfer = I2CM_Queue[I2CM_Head];
+
+    // The error STOP has gone out, the bus is free again
+    if (I2CM_Phase == I2CM_STOP)
+    {
+        I2CMasterComplete();
+        return;
+    }
+
+    I2CM_Error = MAP_I2CMasterErr(I2CM_BASE);
+    if (ulStatus & I2C_MASTER_INT_TIMEOUT)
+    {
+        I2CM_Error |= I2C_MASTER_ERR_CLK_TOUT;
+    }
+
+    if (I2CM_Error != I2C_MASTER_ERR_NONE)
+    {
+        // Single transfers and lost arbitration leave the bus already released;
+        // an unfinished burst still owns the bus and has to be stopped
+        if (!(I2CM_Error & I2C_MASTER_ERR_ARB_LOST) && MAP_I2CMasterBusBusy(I2CM_BASE))
+        {
+            MAP_I2CMasterControl(I2CM_BASE, (I2CM_Phase == I2CM_READ) ? I2C_MASTER_CMD_BURST_RECEIVE_ERROR_STOP :
+                                                                   I2C_MASTER_CMD_BURST_SEND_ERROR_STOP);
+            I2CM_Phase = I2CM_STOP;
+            return;
+        }
+        I2CMasterComplete();
+        return;
+    }
+
+    if (I2CM_Phase == I2CM_WRITE)
+    {
+        if (I2CM_Index < Xfer->TxCount)
+        {
+            // Send the next byte, stopping after the last one unless a read follows
+            MAP_I2CMasterDataPut(I2CM_BASE, Xfer->TxData[I2CM_Index++]);
+            MAP_I2CMasterControl(I2CM_BASE, ((I2CM_Index == Xfer->TxCount) && (Xfer->RxCount == 0)) ?
+                                        I2C_MASTER_CMD_BURST_SEND_FINISH : I2C_MASTER_CMD_BURST_SEND_CONT);
+        }
+        else if (Xfer->RxCount)
+        {
+            I2CMasterStartRead(Xfer);
+        }
+        else
+        {
+            I2CMasterComplete();
+        }
+        return;
+    }
+
+    // Reading: store the byte and acknowledge all but the last one
+    Xfer->RxData[I2CM_Index++] = MAP_I2CMasterDataGet(I2CM_BASE);
+    if (I2CM_Index == Xfer->RxCount)
+    {
+        I2CMasterComplete();
+    }
+    else
+    {
+        MAP_I2CMasterControl(I2CM_BASE, (I2CM_Index == (Xfer->RxCount - 1)) ? I2C_MASTER_CMD_BURST_RECEIVE_FINISH :
+                                                                          I2C_MASTER_CMD_BURST_RECEIVE_CONT);
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ i2c_master.h
+
+ Queued, interrupt-driven I2C master transactions (write, read and
+ write-then-read with a repeated start) on I2C0, completed through callbacks.
+ */
+
+#ifndef I2C_MASTER_H_
+#define I2C_MASTER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// I2C Master Settings
+//
+//*****************************************************************************
+
+#define I2CM_BASE               I2C0_BASE   // I2C module driven by the queue
+#define I2CM_QUEUE_SIZE         8           // Transactions that can be queued at once
+
+// Bus speeds accepted by I2CMasterQueueInit
+#define I2CM_SPEED_STANDARD     100000      // Standard mode, 100 kbit/s
+#define I2CM_SPEED_FAST         400000      // Fast mode, 400 kbit/s
+#define I2CM_SPEED_FAST_PLUS    1000000     // Fast-mode Plus, 1 Mbit/s (needs strong pull-ups)
+
+// Transaction status; otherwise I2C_MASTER_ERR_* bits from driverlib/i2c.h
+#define I2CM_PENDING            0xFFFFFFFF  // Queued or in progress
+
+typedef struct I2CMasterXfer I2CMasterXfer;
+
+// One transaction; owned by the caller and must stay valid until it completes.
+// TxCount bytes are written, then RxCount bytes are read after a repeated
+// start; either count may be zero, but not both (an address-only probe is not
+// supported).
+struct I2CMasterXfer {
+    uint8_t Address;                        // 7-bit slave address
+    const uint8_t *TxData;                  // Bytes to write
+    uint32_t TxCount;                       // Number of bytes to write
+    uint8_t *RxData;                        // Buffer for bytes read
+    uint32_t RxCount;                       // Number of bytes to read
+    void (*Done)(I2CMasterXfer *Xfer);      // Completion callback (interrupt context), may be 0
+    volatile uint32_t Status;               // I2CM_PENDING, I2C_MASTER_ERR_NONE or error bits
+};
+
+// Queue statistics
+typedef struct {
+    uint32_t Completed;                     // Transactions finished without error
+    uint32_t Nacks;                         // Transactions ended by an address or data NACK
+    uint32_t ArbLost;                       // Transactions that lost arbitration
+    uint32_t Timeouts;                      // Transactions ended by a clock low timeout
+    uint32_t MaxDepth;                      // Highest number of queued transactions seen
+} I2CMasterStats;
+
+extern void I2CMasterQueueInit(uint32_t SysClock, uint32_t Speed);
+extern void I2CMasterQueueClockSet(uint32_t SysClock);
+extern bool I2CMasterSubmit(I2CMasterXfer *Xfer);
+extern bool I2CMasterIdle(void);
+extern void I2CMasterStatsGet(I2CMasterStats *Stats);
+extern void I2CMasterQueueIntHandler(void);
+
+#endif /* I2C_MASTER_H_ */
@@ -0,0 +1,241 @@
+/*
+ i2c_slave.c
+
+ I2C slave command channel.
+
+ • Bytes written by the master are assembled into command frames in the slave
+   interrupt; a frame is complete at the STOP (or repeated START) that ends the
+   write, and is queued for the main loop, which runs it through the same
+   dispatcher as the UART menu
+ • Responses are queued as 5-byte frames and handed out one byte per master
+   read request, so a supervisor can write a command and read the result
+   without going through the text menu
+ • Both queues are utils/ringbuf buffers with the interrupt as the only
+   writer of one and the only reader of the other
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "driverlib/i2c.h"
+#include "utils/ringbuf.h"
+
+#include "i2c_slave.h"
+
+//*****************************************************************************
+//
+// I2C Slave Channel State
+//
+//*****************************************************************************
+
+// Ring buffers keep one byte free to tell full from empty
+static uint8_t I2CS_CmdStorage[(I2CS_CMD_FRAMES * I2CS_FRAME_SIZE) + 1];
+static uint8_t I2CS_RespStorage[(I2CS_RESP_FRAMES * I2CS_FRAME_SIZE) + 1];
+static tRingBufObject I2CS_CmdRing;         // Complete command frames (ISR -> main loop)
+static tRingBufObject I2CS_RespRing;        // Response frames (main loop -> ISR)
+
+static uint8_t I2CS_Frame[I2CS_FRAME_SIZE]; // Command frame being received
+static uint32_t I2CS_FrameLen = 0;          // Bytes received for the current frame
+
+static volatile I2CSlaveStats I2CS_Stats;   // Channel statistics
+
+//*****************************************************************************
+//
+// I2CSlaveFrameEnd: Queues the command frame written by the master, if any
+//
+//*****************************************************************************
+
+static void I2CSlaveFrameEnd(void)
+{
+    uint32_t lop;
+
+    if (I2CS_FrameLen == 0)
+    {
+        return;
+    }
+
+    if ((I2CS_FrameLen != 1) && (I2CS_FrameLen != I2CS_FRAME_SIZE))
+    {
+        I2CS_Stats.BadFrames++;
+    }
+    else if (RingBufFree(&I2CS_CmdRing) < I2CS_FRAME_SIZE)
+    {
+        I2CS_Stats.CommandsDropped++;
+    }
+    else
+    {
+        // A bare command byte carries a zero parameter
+        for (lop = I2CS_FrameLen; lop < I2CS_FRAME_SIZE; lop++)
+        {
+            I2CS_Frame[lop] = 0;
+        }
+        RingBufWrite(&I2CS_CmdRing, I2CS_Frame, I2CS_FRAME_SIZE);
+        I2CS_Stats.Commands++;
+    }
+
+    I2CS_FrameLen = 0;
+}
+
+//*****************************************************************************
+//
+// I2CSlaveChannelInit: Enables the I2C slave at the given address with the
+// data, start and stop interrupts; the module clock, pins and NVIC interrupt
+// must already be set up
+//
+// \param Address:  7-bit slave address
+//
+//*****************************************************************************
+
+void I2CSlaveChannelInit(uint8_t Address)
+{
+    RingBufInit(&I2CS_CmdRing, I2CS_CmdStorage, sizeof(I2CS_CmdStorage));
+    RingBufInit(&I2CS_RespRing, I2CS_RespStorage, sizeof(I2CS_RespStorage));
+    I2CS_FrameLen = 0;
+
+    I2CSlaveInit(I2CS_BASE, Address);
+
+    I2CSlaveIntClearEx(I2CS_BASE, I2C_SLAVE_INT_DATA | I2C_SLAVE_INT_START | I2C_SLAVE_INT_STOP);
+    I2CSlaveIntEnableEx(I2CS_BASE, I2C_SLAVE_INT_DATA | I2C_SLAVE_INT_START | I2C_SLAVE_INT_STOP);
+}
+
+//*****************************************************************************
+//
+// I2CSlaveCommandGet: Takes the oldest command frame received from the master
+//
+// \param Cmd:      Receives the command byte
+// \param Param:    Receives the 32-bit parameter
+//
+// \return true if a command was returned
+//
+//*****************************************************************************
+
+bool I2CSlaveCommandGet(uint32_t *Cmd, uint32_t *Param)
+{
+    uint8_t Frame[I2CS_FRAME_SIZE];
+
+    if (RingBufUsed(&I2CS_CmdRing) < I2CS_FRAME_SIZE)
+    {
+        return false;
+    }
+
+    RingBufRead(&I2CS_CmdRing, Frame, I2CS_FRAME_SIZE);
+
+    *Cmd = Frame[0];
+    *Param = ((uint32_t)Frame[1] << 24) | ((uint32_t)Frame[2] << 16) |
+             ((uint32_t)Frame[3] << 8) | Frame[4];
+    return true;
+}
+
+//*****************************************************************************
+//
+// I2CSlaveCommandWaiting: Checks for a command frame without taking it, e.g.
+// before the main loop goes to sleep
+//
+// \return true if I2CSlaveCommandGet would return a command
+//
+//*****************************************************************************
+
+bool I2CSlaveCommandWaiting(void)
+{
+    return RingBufUsed(&I2CS_CmdRing) >= I2CS_FRAME_SIZE;
+}
+
+//*****************************************************************************
+//
+// I2CSlaveResponsePut: Queues a response frame for the master to read
+//
+// \param RespID:   Response (command) ID
+// \param Value:    32-bit response value, sent MSB first
+//
+// \return false if the response queue is full
+//
+//*****************************************************************************
+
+bool I2CSlaveResponsePut(uint8_t RespID, uint32_t Value)
+{
+    uint8_t Frame[I2CS_FRAME_SIZE];
+
+    if (RingBufFree(&I2CS_RespRing) < I2CS_FRAME_SIZE)
+    {
+        I2CS_Stats.ResponsesDropped++;
+        return false;
+    }
+
+    Frame[0] = RespID;
+    Frame[1] = Value >> 24;
+    Frame[2] = Value >> 16;
+    Frame[3] = Value >> 8;
+    Frame[4] = Value;
+    RingBufWrite(&I2CS_RespRing, Frame, I2CS_FRAME_SIZE);
+    return true;
+}
+
+//*****************************************************************************
+//
+// I2CSlaveStatsGet: Copies the current channel statistics
+//
+// \param Stats:    Pointer to the structure to fill in
+//
+//*****************************************************************************
+
+void I2CSlaveStatsGet(I2CSlaveStats *Stats)
+{
+    *Stats = I2CS_Stats;
+}
+
+//*****************************************************************************
+//
+// I2CSlaveChannelIntHandler: Receives command bytes and hands out response
+// bytes; called from the I2C0 interrupt handler, which is shared with the master
+//
+//*****************************************************************************
+
+void I2CSlaveChannelIntHandler(void)
+{
+    uint32_t ulStatus, Action;
+    uint8_t Byte;
+
+    // Get the cause of the interrupt and clear it
+    ulStatus = I2CSlaveIntStatusEx(I2CS_BASE, true);
+    I2CSlaveIntClearEx(I2CS_BASE, ulStatus);
+
+    // A (repeated) start ends any write in progress
+    if (ulStatus & I2C_SLAVE_INT_START)
+    {
+        I2CSlaveFrameEnd();
+    }
+
+    if (ulStatus & I2C_SLAVE_INT_DATA)
+    {
+        Action = I2CSlaveStatus(I2CS_BASE);
+
+        if (Action & I2C_SLAVE_ACT_RREQ)
+        {
+            Byte = I2CSlaveDataGet(I2CS_BASE);
+            if (I2CS_FrameLen < I2CS_FRAME_SIZE)
+            {
+                I2CS_Frame[I2CS_FrameLen] = Byte;
+            }
+            I2CS_FrameLen++;                // Overlong writes are rejected at the end of the frame
+        }
+        else if (Action & I2C_SLAVE_ACT_TREQ)
+        {
+            if (RingBufEmpty(&I2CS_RespRing))
+            {
+                I2CS_Stats.Underruns++;
+                I2CSlaveDataPut(I2CS_BASE, I2CS_IDLE_BYTE);
+            }
+            else
+            {
+                I2CSlaveDataPut(I2CS_BASE, RingBufReadOne(&I2CS_RespRing));
+            }
+        }
+    }
+
+    if (ulStatus & I2C_SLAVE_INT_STOP)
+    {
+        I2CSlaveFrameEnd();
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ i2c_slave.h
+
+ Interrupt-driven I2C slave command channel: lets a supervisory controller send
+ command frames to the main dispatcher and read responses back over I2C0.
+ */
+
+#ifndef I2C_SLAVE_H_
+#define I2C_SLAVE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// I2C Slave Channel Settings
+//
+// Command frame (master write):  cmd, param[31:24], param[23:16], param[15:8], param[7:0]
+//                                (a single cmd byte is accepted with param = 0)
+// Response frame (master read):  resp id, value[31:24], value[23:16], value[15:8], value[7:0]
+//                                (0xFF is returned while no response is queued)
+//
+//*****************************************************************************
+
+#define I2CS_BASE               I2C0_BASE   // I2C module used as the slave
+#define I2CS_FRAME_SIZE         5           // Bytes per command or response frame
+#define I2CS_CMD_FRAMES         8           // Command frames queued for the dispatcher
+#define I2CS_RESP_FRAMES        16          // Response frames queued for the master
+#define I2CS_IDLE_BYTE          0xFF        // Sent when the master reads an empty response queue
+
+// Channel statistics
+typedef struct {
+    uint32_t Commands;              // Command frames queued for the dispatcher
+    uint32_t BadFrames;             // Writes that were neither 1 nor 5 bytes long
+    uint32_t CommandsDropped;       // Command frames lost because the queue was full
+    uint32_t ResponsesDropped;      // Responses lost because the queue was full
+    uint32_t Underruns;             // Bytes read by the master with no response queued
+} I2CSlaveStats;
+
+extern void I2CSlaveChannelInit(uint8_t Address);
+extern bool I2CSlaveCommandGet(uint32_t *Cmd, uint32_t *Param);
+extern bool I2CSlaveCommandWaiting(void);
+extern bool I2CSlaveResponsePut(uint8_t RespID, uint32_t Value);
+extern void I2CSlaveStatsGet(I2CSlaveStats *Stats);
+extern void I2CSlaveChannelIntHandler(void);
+
+#endif /* I2C_SLAVE_H_ */
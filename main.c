@@ -23,6 +23,7 @@ Inkley_MasterTester
 #include <stdbool.h>                // For boolean types
 #include <stdint.h>                 // For fixed-width integer types
 #include <stdlib.h>                 // For memory allocation, process control, conversions
+#include <string.h>                 // For string comparison
 #include <stdio.h>                  // For input/output operations
 
 // Tiva C Series-specific hardware headers (Hardware memory mapping, interrupts, peripherals)
@@ -42,9 +43,41 @@ Inkley_MasterTester
 #include "driverlib/i2c.h"          // I2C driver library
 #include "driverlib/systick.h"      // SysTick timer driver library
 #include "driverlib/flash.h"        // Flash memory driver library (for storing sensor data)
+#include "driverlib/rom.h"          // Driverlib entry points in ROM
+#include "driverlib/rom_map.h"      // MAP_ calls: ROM when TARGET_IS_* selects it, flash otherwise
 
 // Utility libraries for Tiva C Series
-#include "utils/uartstdio.h"        // UART standard I/O utility functions
+
+// Application modules
+#include "sensor_protocol.h"        // Sensor command/response IDs
+#include "flash_writer.h"           // Interrupt-driven double-buffered flash writer
+#include "sample_codec.h"           // Delta/varint sample compression and recording reader
+#include "sample_download.h"        // Verified block transfer of sensor samples
+#include "flash_params.h"           // Journaled flash storage for boot/recording counters
+#include "cycle_counter.h"          // DWT cycle counter for latency measurements
+#include "i2c_master.h"             // Queued interrupt-driven I2C master transactions
+#include "i2c_slave.h"              // I2C slave command channel for a supervisory controller
+#include "smbus_telemetry.h"        // SMBus/PMBus telemetry poller on I2C1
+#include "utils/smbus.h"            // SMBus stack (standard device addresses)
+#include "adc_capture.h"            // Timer-triggered ADC acquisition with uDMA ping-pong buffers
+#include "trigger_capture.h"        // Pre-/post-trigger capture window
+#include "dsp_filter.h"             // Fixed-point filters for on-board decimation
+#include "stream_stats.h"           // Incremental statistics over the live sensor stream
+#include "spectrum.h"               // Radix-4 FFT spectrum analysis
+#include "fixed_math.h"             // Fast integer math (reciprocal, sqrt, log2, atan2, polynomials)
+#include "calibration.h"            // Per-module conversion of raw counts to engineering units
+#include "utils/isqrt.h"            // Integer square root
+#include "utils/sine.h"             // Fixed-point sine
+#include "utils/cmdline.h"          // Named command table
+#include "command_batch.h"          // ';'-separated command batches
+#include "response.h"               // Compact single-line response records
+#include "uart_stream.h"            // uDMA-driven UART transmit ring for live streaming
+#include "stack_monitor.h"          // Stack painting and high-water mark
+#include "ram_capture.h"            // Burst capture into the spare SRAM
+#include "power_idle.h"             // Tickless sleep between interrupts
+#include "clock_scaling.h"          // Idle and full system clock profiles
+#include "supervisor.h"             // Watchdog supervision of the main loop tasks
+#include "crash_dump.h"             // Register and trace dump in EEPROM on a fault or hang
 
 //*****************************************************************************
 //
@@ -57,6 +90,7 @@ Inkley_MasterTester
 // I2C Settings
 #define NUM_I2C_DATA 8              // Number of data bytes expected for I2C communication
 #define SLAVE_ADDRESS 0x3C          // I2C slave address for the connected device
+#define I2C_SPEED I2CM_SPEED_FAST   // I2C master bus speed (I2CM_SPEED_FAST_PLUS needs ~1k pull-ups)
 
 // SysTick timer settings
 #define SYSTICK_TIMING   1000       // SysTick timing value (1000 = 1ms, used for time-based operations)
@@ -65,10 +99,138 @@ Inkley_MasterTester
 #define SerialBASE  UART0_BASE      // Base address for UART0, used for serial communication
 #define SerialBAUD  115200          // Baud rate for UART communication (115200 bps)
 char RcvString[1024];               // Global buffer for receiving serial data
+bool RcvTooLong = false;            // The last received line did not fit in RcvString
 
 // Flash Settings
 #define FlashUserSpace  0x30000     // Starting address for flash memory user space
+#define FlashUserEnd    MAP_SysCtlFlashSizeGet()    // End of the user space (end of the part's flash)
+#define FlashParamSpace 0x1F800     // Parameter block journal (last two 1 KB pages, PARAMS in the .cmd)
+#define FlashParamEnd   0x20000     // End of the parameter block journal
 uint32_t FlashSampleSize = 0x10000; // Default sample size for flash memory (64 KB)
+bool SampleCompression = false;     // Compress samples (delta + zig-zag + varint) before flash commit
+#define SensorSampleRate 1000       // Sample rate assumed for recordings downloaded from the sensor (Hz)
+uint32_t RecordingRate = SensorSampleRate; // Sample rate of the recording in flash (Hz)
+uint32_t RecordingModule = 0;       // Sensor module that made the recording in flash (0 = local ADC)
+
+// Local ADC Settings
+#define AdcChannel      ADC_CTL_CH0 // Local analog input (AIN0 on PE3)
+#define AdcOversample   64          // Hardware averaging factor; the ADC converts at the full 1 MSPS
+#define AdcSampleRate   15625       // Recorded samples per second (1 MSPS / AdcOversample)
+bool AdcRecording = false;          // Local ADC recording in progress
+uint32_t AdcRecorded = 0;           // Samples of the local recording committed so far
+SampleEncoder AdcEncoder;           // Compressor for local recordings
+
+// ADC Filter Settings (anti-alias low-pass and decimation of local recordings)
+#define AdcDecimation   4           // Recorded rate with filtering on: AdcSampleRate / AdcDecimation
+#define AdcFirTaps      16          // Taps of the decimating FIR
+bool AdcFiltering = false;          // Filter and decimate local ADC recordings before storage
+const int16_t AdcBiquadCoeffs[10] = { // 4th-order Butterworth low-pass at 1.4 kHz, Q14 (PostShift 1)
+    847, 1693, 847, 18560, -5563,
+    1050, 2100, 1050, 23011, -10827
+};
+const int16_t AdcFirCoeffs[AdcFirTaps] = { // Hamming-windowed low-pass at 1.6 kHz, Q15, unity gain
+    -113, -169, -173, 229, 1386, 3268, 5308, 6648,
+    6648, 5308, 3268, 1386, 229, -173, -169, -113
+};
+DspBiquadQ15 AdcBiquad;             // Low-pass stage
+DspFirDecimQ15 AdcDecimator;        // Decimation stage
+DspPipelineQ15 AdcFilter = { &AdcBiquad, 0, &AdcDecimator };
+int16_t AdcFiltered[ADCC_BLOCK_SAMPLES]; // Working buffer for one ADC block
+
+// Triggered Capture Settings
+#define TRIG_SRC_NONE       0       // Triggered capture not armed
+#define TRIG_SRC_ADC        1       // Local ADC stream, ADC digital comparator trigger
+#define TRIG_SRC_CAN        2       // CAN sensor readings, software threshold trigger
+#define TriggerPre          1024    // Samples kept from before the trigger
+#define TriggerPost         1024    // Samples collected after the trigger
+#define TriggerAdcLow       1800    // ADC comparator re-arm level (12-bit)
+#define TriggerAdcHigh      2300    // ADC comparator trigger level (12-bit)
+#define TriggerAdcRate      (AdcSampleRate / 2) // The comparator needs a second conversion per sample
+#define TriggerCanLevel     100000  // CAN sensor value that triggers on a rising crossing
+#define TriggerCanPeriodMS  10      // CAN sensor poll period while armed
+uint32_t TriggerSource = TRIG_SRC_NONE; // Stream feeding the armed capture
+uint32_t TriggerNextPoll = 0;       // Time of the next CAN sensor poll while armed
+
+// Live Statistics Settings
+#define StatsPeriodMS       10      // CAN sensor poll period while monitoring
+#define StatsHistLow        0       // Lower limit of the first histogram bin
+#define StatsHistWidth      12500   // Histogram bin width (16 bins up to 200000)
+bool StatsMonitoring = false;       // CAN sensor readings are polled into LiveStats
+uint32_t StatsNextPoll = 0;         // Time of the next CAN sensor poll while monitoring
+StreamStats LiveStats;              // Statistics of the CAN sensor readings
+
+// Spectrum Analysis Settings
+#define SpectrumPeaks       5       // Peaks reported per frame
+bool SpectrumLive = false;          // A live ADC frame is being collected for the FFT
+
+// Command Line Settings (named commands and ';'-separated batches)
+#define BatchWaitMS         60000   // Default timeout of 'wait done'
+uint32_t SensorPending = 0;         // Sensor command still waiting for its response (0 = none)
+bool CompactResponses = false;      // Replies and events as single-line JSON records (response.h)
+
+// Live Streaming Settings (CAN sensor readings forwarded to the UART as they arrive)
+#define StreamPeriodMS      2       // CAN sensor poll period while streaming
+#define StreamSync          0xA5    // First byte of a binary stream record
+bool Streaming = false;             // Sensor readings are streamed over the UART
+bool StreamBinary = false;          // Binary records instead of text lines
+uint32_t StreamIndex = 0;           // Readings streamed (or dropped) since the stream started
+uint32_t StreamNextPoll = 0;        // Time of the next CAN sensor poll while streaming
+
+// RAM Burst Capture Settings (sensor readings polled back-to-back into spare SRAM, flushed afterwards)
+#define RAMF_NONE           0       // No burst capture
+#define RAMF_FLASH          1       // Burst goes to the flash recording
+#define RAMF_UART           2       // Burst goes to the UART as stream records
+#define RamRetryMS          5       // Poll the sensor again if a reading is this late
+#define RamFlushChunk       128     // Samples flushed per poll (below one flash page, even compressed)
+uint32_t RamTarget = RAMF_NONE;     // Destination of the running burst capture
+bool RamFlushing = false;           // The burst has ended and is being flushed
+uint32_t RamPollTime = 0;           // Time of the last sensor poll of the burst
+uint32_t RamStartTime = 0;          // Time the burst started
+uint32_t RamElapsed = 0;            // Duration of the burst in ms
+SampleEncoder RamEncoder;           // Compressor for bursts flushed to flash
+
+// Low-Power Idle Settings (the main loop sleeps until the next interrupt or scheduled poll)
+bool LowPowerIdle = true;           // Sleep when a main loop pass has nothing left to do
+uint32_t IdleStatsStart = 0;        // Time the sleep statistics were cleared
+
+// Clock Scaling Settings (16 MHz idle profile, 80 MHz while anything runs)
+#define ClockIdleMS         1000    // Quiet time before dropping to the idle profile
+#define ClockWaitMS         50      // Longest wait for a bus transfer to end before a switch
+bool ClockScaling = true;           // Drop to the idle profile when quiet
+uint32_t ClockBusyTime = 0;         // Last time anything needed the full clock
+
+// Watchdog Supervision Settings (main loop tasks and the longest each may run)
+#define TASK_COMMAND        0       // Menu or I2C command, including exports
+#define TASK_BATCH          1       // Command of a batch
+#define TASK_TELEMETRY      2       // SMBus telemetry
+#define TASK_ADC_RECORD     3       // Local ADC recording
+#define TASK_TRIGGER        4       // Triggered capture
+#define TASK_STATS          5       // Live statistics monitor
+#define TASK_STREAM         6       // Live stream
+#define TASK_BURST          7       // Burst capture and flush
+#define TASK_SPECTRUM       8       // Live spectrum
+#define TASK_CAN            9       // CAN responses, including the download read-back
+#define TASK_CLOCK          10      // Clock profile switch
+#define TASK_IDLE           11      // Low-power idle
+#define TASK_COUNT          12
+static const uint32_t TaskBudgetMS[TASK_COUNT] = {
+    8000, 8000,                     // Commands: a CAN send alone may wait 5 s
+    1000, 2000,                     // Telemetry, ADC recording
+    8000, 8000, 8000, 8000,         // Tasks polling the sensor over CAN
+    2000, 8000,                     // Spectrum, CAN responses
+    1000, 1000                      // Clock switch, idle (sleeps are at most IDLE_MAX_SLEEP_MS)
+};
+static const char *TaskNames[TASK_COUNT] = {
+    "command", "batch", "telemetry", "adc", "trigger", "stats", "stream", "burst", "spectrum", "can", "clock", "idle"
+};
+
+// Crash Recovery Settings (state saved with a crash dump for the warm restart)
+#define CrashMaxResumes     3       // Crashes after which a download is no longer resumed
+typedef struct {
+    SampleDownloadCheckpoint Download;  // Interrupted raw download
+    uint32_t Module;                // Sensor module it comes from
+} RecoveryState;                    // Must fit in CRASH_APP_WORDS words
+CrashRecord LastCrash;              // Crash record read at boot or by the crash command
 
 // CAN Bus Settings
 #define CAN_ID             0x101    // CAN bus ID for the main module
@@ -89,6 +251,24 @@ uint32_t SystemClockSpeed = 80000000;
 // Global Timer: Tracks system's elasped time in ms
 uint32_t GlobalTimer = 0;
 
+// Milliseconds since startup, counted by the SysTick interrupt
+volatile uint32_t SystemTickMS = 0;
+
+// Data log settings: CAN sensor readings and SMBus telemetry share one timestamped stream
+#define LOG_SRC_CAN         0       // Log source: CAN sensor module
+#define LOG_SRC_SMBUS       1       // Log source: SMBus telemetry
+#define TelemetryPeriodMS   100     // SMBus telemetry poll period
+bool DataLogging = false;           // Emit LOG lines over UART
+
+// SMBus telemetry channels polled on I2C1: address, command code, read type, log channel
+static const TelemetryChannel TelemetryChannels[] = {
+    { SMBUS_ADR_SMART_BATTERY, 0x09, TLM_READ_WORD,  1 },   // Smart battery voltage (mV)
+    { SMBUS_ADR_SMART_BATTERY, 0x0A, TLM_READ_WORD,  2 },   // Smart battery current (mA)
+    { SMBUS_ADR_SMART_BATTERY, 0x23, TLM_READ_BLOCK, 3 },   // Smart battery manufacturer data (first 4 bytes)
+    { 0x40,                    0x8B, TLM_READ_WORD,  4 },   // PMBus READ_VOUT
+    { 0x40,                    0x8C, TLM_READ_WORD,  5 }    // PMBus READ_IOUT
+};
+
 // Structure to hold a CAN message
 typedef struct {
     char FLAGS;                     // Flags indicating the status of the CAN message
@@ -110,47 +290,16 @@ static CANBroadcast CAN_MODULES[10];
 // Buffer to hold messages for printing/debugging
 char PrintMsg[255];
 
-// I2C Timeout setting
-#define I2C_TimeOut 10000           // Timeout value for I2C communication (in cycles)
-
-//*****************************************************************************
-//
-// Sensor Commands
-//
-//*****************************************************************************
-
-// Inkley Sensor Commands
-/*
-#define icmdReadVersion         01  // Command to read the version of the sensor
-#define icmdReadData            02  // Command to read sensor data
-#define icmdFlashStart          03  // Command to start recording data into flash memory
-#define icmdFlashReadPos        04  // Command to read data from a specific position in flash memory
-#define icmdFlashEraseFull      05  // Command to erase the entire flash memory
-#define icmdFlashSetSampleSize  06  // Command to set the sample size for flash memory
-#define icmdFlashStatus         07  // Command to get the status of the flash memory read (e.g., percentage complete)
-#define icmdFlashGetData        08  // Get Flash sample from sensor module and store it locally
-#define icmdFlashGenCSV         09  // Generate a CSV file from the flash data stored locally
-*/
-
-enum {
-    icmdReadVersion = 0x01,         // Read sensor firmware version
-    icmdReadData,                   // Retrieve current sensor data
-    icmdFlashStart,                 // Start recording data into flash memory
-    icmdFlashReadPos,               // Read data from a specific flash memory position
-    icmdFlashEraseFull,             // Erase all data in flash memory
-    icmdFlashSetSampleSize,         // Set the size of samples to store in flash
-    icmdFlashStatus,                // Retrieve flash memory operation status
-    icmdFlashGetData,               // Fetch raw data from flash memory
-    icmdFlashGenCSV                 // Generate CSV-formatted output from flash data
-};
-
 int TimeOutClock = 0;               // Global variable to track timeout events
-int I2C_TimeOutClock = 0;           // Global variable to track I2C timeout events
+
+uint8_t I2C_SendBuffer[4];          // Data word being sent by I2C_SendData
+I2CMasterXfer I2C_SendXfer;         // Transaction used by I2C_SendData
 
 uint32_t I2C_RcvCommand = 0;        // Stores the last received I2C command
 uint32_t I2C_RcvCommandParam = 0;   // Stores the parameter associated with the received I2C command
 
 bool I2C_RcvNewCommand = false;     // Flag indicating whether a new I2C command has been received
+bool I2C_ResponseLink = false;      // Forward sensor responses to the I2C supervisor once it has sent a command
 
 //*****************************************************************************
 //
@@ -163,7 +312,7 @@ void DelayMS(unsigned int delay)
 {
     // The SysCtlDelay function introduces a delay based on the system clock speed
     // The formula ensures the delay is calibrated to milliseconds
-    SysCtlDelay(( SysCtlClockGet() / 3 / 1000) * delay );
+    MAP_SysCtlDelay(( SystemClockSpeed / 3 / 1000) * delay );
 }
 
 // Clears a specific bit in a number
@@ -203,22 +352,26 @@ bool bit_check(uint32_t number, uint32_t bit)
 
 void SysTickIntHandler(void)
 {
-    // Currently empty, the interrupt service routine (ISR) can be filled
-    // to handle periodic tasks triggered by the SysTick timer
+    // Count milliseconds for time stamps and periodic tasks
+    SystemTickMS++;
 }
 
 //*****************************************************************************
 //
 // I2C0 Data Slave Interrupt Handler: Handles I2C slave interrupts on I2C0
 // Triggered when the slave device on I2C0 is addressed or when data is
-// transmitted/received
+// transmitted/received. The master shares this vector, so slave events go to
+// the I2C command channel and master events to the I2C transaction queue.
 //
 //*****************************************************************************
 
 void I2C0SlaveIntHandler(void)
 {
-    // Clear the I2C0 interrupt flag to acknowledge and reset the interrupt
-    I2CSlaveIntClear(I2C0_BASE);
+    // Receive command bytes and send response bytes
+    I2CSlaveChannelIntHandler();
+
+    // Advance any queued master transaction
+    I2CMasterQueueIntHandler();
 }
 
 //*****************************************************************************
@@ -232,13 +385,13 @@ void Init_Systick (void)
 {
     // Set the SysTick period based on the system clock speed and the timing setting
     // In this case, it will trigger an interrupt every 1 millisecond
-    SysTickPeriodSet(SysCtlClockGet()/SYSTICK_TIMING);
+    MAP_SysTickPeriodSet(SystemClockSpeed/SYSTICK_TIMING);
 
     // Enable the SysTick Interrupt to allow the system to handle SysTick-based tasks
-    SysTickIntEnable();
+    MAP_SysTickIntEnable();
 
     // Enable the SysTick Timer, starting the countdown for periodic interrupts
-    SysTickEnable();
+    MAP_SysTickEnable();
 }
 
 //*****************************************************************************
@@ -253,20 +406,20 @@ void Init_I2C(void)
 {
     // Enable the I2C0 peripheral; must be done before any I2C0 operations
     // can be performed
-    SysCtlPeripheralEnable(SYSCTL_PERIPH_I2C0);
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_I2C0);
 
     // Enable GPIO port B, which is required for I2C0 on pins B2 (SCL) and B3 (SDA)
     // Consult the data sheet if different GPIO pins are used for I2C on your device
-    SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOB);
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOB);
 
     // Configure the pin muxing for I2C0 on pins B2 (SCL) and B3 (SDA)
     // This is necessary for devices that support pin muxing
-    GPIOPinConfigure(GPIO_PB2_I2C0SCL);
-    GPIOPinConfigure(GPIO_PB3_I2C0SDA);
+    MAP_GPIOPinConfigure(GPIO_PB2_I2C0SCL);
+    MAP_GPIOPinConfigure(GPIO_PB3_I2C0SDA);
 
     // Configure GPIO pins B2 and B3 for I2C operation; these pins are set to
     // open-drain with weak pull-ups for I2C communication
-    GPIOPinTypeI2C(GPIO_PORTB_BASE, GPIO_PIN_2 | GPIO_PIN_3);
+    MAP_GPIOPinTypeI2C(GPIO_PORTB_BASE, GPIO_PIN_2 | GPIO_PIN_3);
 
     // Optional: Enable loopback mode for I2C0; this is useful for debugging
     // as it connects the I2C master and slave internally, allowing testing
@@ -275,24 +428,38 @@ void Init_I2C(void)
 
     // Enable the I2C0 interrupt in the NVIC (Nested Vectored Interrupt Controller)
     // This allows the processor to handle I2C interrupts
-    IntEnable(INT_I2C0);
+    MAP_IntEnable(INT_I2C0);
 
-    // Enable the I2C0 slave interrupt; this allows the slave device to interrupt
-    // the processor only when it receives data
-    I2CSlaveIntEnableEx(I2C0_BASE, I2C_SLAVE_INT_DATA);
+    // Initialize the I2C0 master module for queued, interrupt-driven transactions
+    // I2C_SPEED selects 100kbps, 400kbps or 1Mbps (Fast-mode Plus)
+    I2CMasterQueueInit(SystemClockSpeed, I2C_SPEED);
 
-    // Initialize the I2C0 master module using the system clock
-    // The third parameter sets the data transfer rate: false for 100kbps, true for 400kbps
-    // In this case, 100kbps is chosen for communication
-    I2CMasterInitExpClk(I2C0_BASE, SysCtlClockGet(), false);
-
-    // Enable the I2C0 slave module; this prepares I2C0 to operate in slave mode
-    I2CSlaveEnable(I2C0_BASE);
-
-    // Set the slave address to SLAVE_ADDRESS (defined earlier in the code)
+    // Enable the I2C0 slave at SLAVE_ADDRESS (defined earlier in the code) with
+    // data, start and stop interrupts, so a supervisory controller can send commands
     // In loopback mode, the slave address is arbitrary but typically must be
     // configured correctly for actual I2C communication
-    I2CSlaveInit(I2C0_BASE, SLAVE_ADDRESS);
+    I2CSlaveChannelInit(SLAVE_ADDRESS);
+}
+
+//*****************************************************************************
+//
+// ADC Initialization: Configures the local analog input and the acquisition
+// engine (ADC0 sequencer 0 triggered by Timer 0A, results moved by uDMA)
+//
+//*****************************************************************************
+
+void Init_ADC(void)
+{
+    // AIN0 is on pin E3; consult the data sheet when using another input
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOE);
+    MAP_GPIOPinTypeADC(GPIO_PORTE_BASE, GPIO_PIN_3);
+
+    // Set up the sequencer, trigger timer and uDMA channel; capture starts on demand
+    AdcCaptureInit(AdcChannel, AdcOversample);
+
+    // Low-pass and decimation stages applied to recordings when filtering is on
+    DspBiquadQ15Init(&AdcBiquad, 2, AdcBiquadCoeffs, 1);
+    DspFirDecimQ15Init(&AdcDecimator, AdcFirTaps, AdcDecimation, AdcFirCoeffs);
 }
 
 //*****************************************************************************
@@ -329,13 +496,13 @@ uint32_t CANSendINT(unsigned long CANID, uint32_t pui8MsgData)
     sCANMessage.pui8MsgData = (uint8_t *)&pui8MsgData;  // Cast the data pointer to uint8_t
 
     // Send the CAN message using message object 32
-    CANMessageSet(CAN0_BASE, 32, &sCANMessage, MSG_OBJ_TYPE_TX);
+    MAP_CANMessageSet(CAN0_BASE, 32, &sCANMessage, MSG_OBJ_TYPE_TX);
 
     // Wait for the message to be transmitted, checking for a timeout
-    while (CANStatusGet(CAN0_BASE, CAN_STS_TXREQUEST) != 0)
+    while (MAP_CANStatusGet(CAN0_BASE, CAN_STS_TXREQUEST) != 0)
     {
         TimeOut++;
-        SysCtlDelay(SysCtlClockGet() / 30000);          // Add delay between checks
+        MAP_SysCtlDelay(SystemClockSpeed / 30000);          // Add delay between checks
 
         // If the timeout exceeds a threshold, return an error code
         if (TimeOut > 0x0001000)
@@ -369,13 +536,13 @@ uint32_t CANSendMSG(unsigned long CANID, uint8_t *pui8MsgData)
     sCANMessage.pui8MsgData = pui8MsgData;              // Pointer to the data to send
 
     // Send the CAN message using message object 32
-    CANMessageSet(CAN0_BASE, 32, &sCANMessage, MSG_OBJ_TYPE_TX);
+    MAP_CANMessageSet(CAN0_BASE, 32, &sCANMessage, MSG_OBJ_TYPE_TX);
 
     // Wait for the message to be transmitted, checking for a timeout
-    while (CANStatusGet(CAN0_BASE, CAN_STS_TXREQUEST) != 0)
+    while (MAP_CANStatusGet(CAN0_BASE, CAN_STS_TXREQUEST) != 0)
     {
         TimeOut++;
-        SysCtlDelay(SysCtlClockGet() / 3000);           // Add delay between checks
+        MAP_SysCtlDelay(SystemClockSpeed / 3000);           // Add delay between checks
 
         // If the timeout exceeds a threshold, return an error code
         if (TimeOut > 5000)
@@ -412,18 +579,18 @@ uint32_t CANPollCheck(unsigned char *candata, int MsgID, unsigned char Response)
     sMsgObjectRx.pui8MsgData = candata;    // Point the message data buffer to 'candata'
 
     // Get the status of new data available on the CAN bus
-    ulNewData = CANStatusGet(CAN0_BASE, CAN_STS_NEWDAT);
+    ulNewData = MAP_CANStatusGet(CAN0_BASE, CAN_STS_NEWDAT);
 
     // Loop while there is new data for the specified message ID (MsgID - 1 due to zero-indexing)
     while (ulNewData & (1 << (MsgID - 1)))
     {
         // Read the message from the specified message object (MsgID) and store it in sMsgObjectRx
         // 'true' indicates that the message should be cleared from the message object after reading
-        CANMessageGet(CAN0_BASE, MsgID, &sMsgObjectRx, true);
+        MAP_CANMessageGet(CAN0_BASE, MsgID, &sMsgObjectRx, true);
         rValue++;                           // Increment the counter for each received message
 
         // Check again if there is more new data for the specified message ID
-        ulNewData = CANStatusGet(CAN0_BASE, CAN_STS_NEWDAT);
+        ulNewData = MAP_CANStatusGet(CAN0_BASE, CAN_STS_NEWDAT);
     }
 
     return rValue;                          // Return the number of messages received
@@ -449,24 +616,24 @@ void IntCAN0Handler(void)
     tempCANMsgObject.ui32MsgLen = 8;
 
     // Get the cause of the interrupt and clear it
-    ulStatus = CANIntStatus(CAN0_BASE, CAN_INT_STS_CAUSE);
-    CANIntClear(CAN0_BASE, ulStatus);
+    ulStatus = MAP_CANIntStatus(CAN0_BASE, CAN_INT_STS_CAUSE);
+    MAP_CANIntClear(CAN0_BASE, ulStatus);
 
     // If the interrupt is not a controller status interrupt, handle it
     if (ulStatus != CAN_INT_INTID_STATUS)
     {
         // Get the controller status
-        ulStatus = CANStatusGet(CAN0_BASE, CAN_STS_CONTROL);
+        ulStatus = MAP_CANStatusGet(CAN0_BASE, CAN_STS_CONTROL);
 
         // Check if new data is available on the CAN bus
-        ulNewData = CANStatusGet(CAN0_BASE, CAN_STS_NEWDAT);
+        ulNewData = MAP_CANStatusGet(CAN0_BASE, CAN_STS_NEWDAT);
         if (ulNewData)
         {
             // Check if there is new data for the specified CAN slot
             if (ulNewData & (1 << (CANSlot - 1)))
             {
                 // Get the CAN message and clear the pending flag
-                CANMessageGet(CAN0_BASE, CANSlot, &tempCANMsgObject, true);
+                MAP_CANMessageGet(CAN0_BASE, CANSlot, &tempCANMsgObject, true);
 
                 // If the message ID matches CAN_ID, process it
                 if (tempCANMsgObject.ui32MsgID == CAN_ID)
@@ -520,7 +687,7 @@ void CANListnerEX(int MsgID)
     sMsgObjectRx.pui8MsgData = (unsigned char *)0xffffffff;
 
     // Configure the CAN message object to receive messages with the given MsgID
-    CANMessageSet(CAN0_BASE, MsgID, &sMsgObjectRx, MSG_OBJ_TYPE_RX);
+    MAP_CANMessageSet(CAN0_BASE, MsgID, &sMsgObjectRx, MSG_OBJ_TYPE_RX);
 }
 
 //*****************************************************************************
@@ -535,22 +702,26 @@ void Init_UART(uint32_t Baud)
 {
     // Enable the UART0 peripheral and GPIO port A; required for the UART
     // operation and must be enabled before configuring the UART or GPIO pins
-    SysCtlPeripheralEnable(SYSCTL_PERIPH_UART0);    // Enable UART0 peripheral
-    SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOA);    // Enable GPIO Port A
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_UART0);    // Enable UART0 peripheral
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOA);    // Enable GPIO Port A
 
     // Configure the pin muxing for the UART0 function on GPIO pins A0 (RX) and A1 (TX)
     // This allows these pins to be used for UART communication instead of general GPIO
     // Consult the datasheet for pin allocation based on the specific device being used
-    GPIOPinConfigure(GPIO_PA0_U0RX);                // Configure PA0 for UART0 RX
-    GPIOPinConfigure(GPIO_PA1_U0TX);                // Configure PA1 for UART0 TX
+    MAP_GPIOPinConfigure(GPIO_PA0_U0RX);                // Configure PA0 for UART0 RX
+    MAP_GPIOPinConfigure(GPIO_PA1_U0TX);                // Configure PA1 for UART0 TX
 
     // Set the GPIO pins A0 and A1 for UART operation
     // This configures them as UART peripheral pins rather than general-purpose I/O
-    GPIOPinTypeUART(GPIO_PORTA_BASE, GPIO_PIN_0 | GPIO_PIN_1);
+    MAP_GPIOPinTypeUART(GPIO_PORTA_BASE, GPIO_PIN_0 | GPIO_PIN_1);
 
     // Configure the UART0 module for 8-N-1 operation (8 data bits, no parity, 1 stop bit)
     // with the specified baud rate; the system clock frequency is used for timing
-    UARTConfigSetExpClk(SerialBASE, SysCtlClockGet(), Baud, (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE));
+    MAP_UARTConfigSetExpClk(SerialBASE, SystemClockSpeed, Baud, (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE));
+
+    // Received characters raise the UART0 interrupt so that typing ends a low-power
+    // idle sleep; they stay in the FIFO for UARTStrGet
+    MAP_UARTIntEnable(SerialBASE, UART_INT_RX | UART_INT_RT);
 }
 
 //*****************************************************************************
@@ -564,26 +735,26 @@ void Init_CAN(uint32_t Baud)
 {
     // Enable GPIO Port B and configure pins B4 and B5 for CAN0 operation
     // These pins are used for CAN0 RX (receive) and TX (transmit) respectively
-    SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOB);                // Enable GPIO Port B
-    GPIOPinConfigure(GPIO_PB4_CAN0RX);                          // Configure PB4 for CAN0 RX
-    GPIOPinConfigure(GPIO_PB5_CAN0TX);                          // Configure PB5 for CAN0 TX
-    GPIOPinTypeCAN(GPIO_PORTB_BASE, GPIO_PIN_4 | GPIO_PIN_5);   // Set PB4 and PB5 for CAN functionality
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOB);                // Enable GPIO Port B
+    MAP_GPIOPinConfigure(GPIO_PB4_CAN0RX);                          // Configure PB4 for CAN0 RX
+    MAP_GPIOPinConfigure(GPIO_PB5_CAN0TX);                          // Configure PB5 for CAN0 TX
+    MAP_GPIOPinTypeCAN(GPIO_PORTB_BASE, GPIO_PIN_4 | GPIO_PIN_5);   // Set PB4 and PB5 for CAN functionality
 
     // Enable CAN0 peripheral and initialize it
-    SysCtlPeripheralEnable(SYSCTL_PERIPH_CAN0);                 // Enable CAN0 peripheral
-    CANInit(CAN0_BASE);                                         // Initialize CAN0 module
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_CAN0);                 // Enable CAN0 peripheral
+    MAP_CANInit(CAN0_BASE);                                         // Initialize CAN0 module
 
     // Set the CAN baud rate using the system clock and the specified baud rate
-    CANBitRateSet(CAN0_BASE, SysCtlClockGet(), Baud);
+    MAP_CANBitRateSet(CAN0_BASE, SystemClockSpeed, Baud);
 
     // Enable CAN interrupts for master, error, and status changes
-    CANIntEnable(CAN0_BASE, CAN_INT_MASTER | CAN_INT_ERROR | CAN_INT_STATUS);
+    MAP_CANIntEnable(CAN0_BASE, CAN_INT_MASTER | CAN_INT_ERROR | CAN_INT_STATUS);
 
     // Enable the CAN0 interrupt in the NVIC (Nested Vectored Interrupt Controller)
-    IntEnable(INT_CAN0);
+    MAP_IntEnable(INT_CAN0);
 
     // Enable the CAN0 module for operation
-    CANEnable(CAN0_BASE);
+    MAP_CANEnable(CAN0_BASE);
 
     // Short delay to ensure CAN setup stability
     DelayMS(10);
@@ -597,63 +768,107 @@ void Init_CAN(uint32_t Baud)
 
 //*****************************************************************************
 //
-// I2C_SendData: Sends a 32-bit data word over the I2C bus to a specified slave
-// This function breaks the data into four 8-bit segments and sends them sequentially
-// using I2C burst mode
+// Clock Change Callbacks: Registered with clock_scaling; before a profile switch
+// each lets its transfer in progress finish (a frame on the wire would be
+// corrupted by a divider change), after it each reprograms its dividers
+//
+// \param Event:    CLK_EVT_BEFORE or CLK_EVT_AFTER
+// \param SysClock: Old system clock before, new system clock after the switch
 //
 //*****************************************************************************
 
-void I2C_SendData(uint32_t SData)
+// SysTick and everything timed in system clocks (DelayMS, ADC rates, reports)
+void ClockChangeSystem(uint32_t Event, uint32_t SysClock)
 {
-    // Set the slave address for I2C communication
-    // 'false' indicates that a write operation is to be performed
-    I2CMasterSlaveAddrSet(I2C0_BASE, SLAVE_ADDRESS, false);
-
-    // Send the most significant byte (MSB) of the 32-bit data
-    I2CMasterDataPut(I2C0_BASE, (uint8_t)(SData >> 24));
+    if (Event == CLK_EVT_AFTER)
+    {
+        SystemClockSpeed = SysClock;
 
-    // Start the I2C burst transmission
-    I2CMasterControl(I2C0_BASE, I2C_MASTER_CMD_BURST_SEND_START);
+        // Restart the 1 ms tick at the new rate; at most one partial ms is lost
+        MAP_SysTickPeriodSet(SystemClockSpeed/SYSTICK_TIMING);
+        HWREG(NVIC_ST_CURRENT) = 0;
+        IdleClockSet(SystemClockSpeed);
+    }
+}
 
-    // Wait for the I2C master to finish sending the byte or timeout
-    I2C_TimeOutClock = I2C_TimeOut;
-    while (I2CMasterBusy(I2C0_BASE))
+// UART0 baud rate; the transmit ring is drained first
+void ClockChangeUART(uint32_t Event, uint32_t SysClock)
+{
+    if (Event == CLK_EVT_BEFORE)
+    {
+        UartStreamFlush();
+    }
+    else
     {
-        if (--I2C_TimeOutClock == 0) break;
+        MAP_UARTConfigSetExpClk(SerialBASE, SysClock, SerialBAUD, (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE));
     }
+}
 
-    // Send the second byte of the 32-bit data
-    I2CMasterDataPut(I2C0_BASE, (uint8_t)(SData >> 16));
-    I2CMasterControl(I2C0_BASE, I2C_MASTER_CMD_BURST_SEND_CONT);
+// CAN0 bit timing; queued frames are sent first
+void ClockChangeCAN(uint32_t Event, uint32_t SysClock)
+{
+    uint32_t Start = SystemTickMS;
 
-    // Wait for the I2C master to finish sending the byte or timeout
-    I2C_TimeOutClock = I2C_TimeOut;
-    while (I2CMasterBusy(I2C0_BASE))
+    if (Event == CLK_EVT_BEFORE)
+    {
+        while (MAP_CANStatusGet(CAN0_BASE, CAN_STS_TXREQUEST) && ((SystemTickMS - Start) < ClockWaitMS))
+        {
+        }
+    }
+    else
     {
-        if (--I2C_TimeOutClock == 0) break;
+        MAP_CANBitRateSet(CAN0_BASE, SysClock, CAN_BAUD);
     }
+}
 
-    // Send the third byte of the 32-bit data
-    I2CMasterDataPut(I2C0_BASE, (uint8_t)(SData >> 8));
-    I2CMasterControl(I2C0_BASE, I2C_MASTER_CMD_BURST_SEND_CONT);
+// I2C0 master queue and the SMBus telemetry bus on I2C1
+void ClockChangeI2C(uint32_t Event, uint32_t SysClock)
+{
+    uint32_t Start = SystemTickMS;
 
-    // Wait for the I2C master to finish sending the byte or timeout
-    I2C_TimeOutClock = I2C_TimeOut;
-    while (I2CMasterBusy(I2C0_BASE))
+    if (Event == CLK_EVT_BEFORE)
+    {
+        while ((!I2CMasterIdle() || TelemetryBusy()) && ((SystemTickMS - Start) < ClockWaitMS))
+        {
+        }
+    }
+    else
     {
-        if (--I2C_TimeOutClock == 0) break;
+        I2CMasterQueueClockSet(SysClock);
+        TelemetryClockSet(SysClock);
     }
+}
 
-    // Send the least significant byte (LSB) of the 32-bit data
-    I2CMasterDataPut(I2C0_BASE, (uint8_t)(SData));
-    I2CMasterControl(I2C0_BASE, I2C_MASTER_CMD_BURST_SEND_FINISH);
+//*****************************************************************************
+//
+// I2C_SendData: Queues a 32-bit data word (MSB first) for transmission to the
+// I2C slave; the transfer is completed by the I2C interrupt
+//
+// \return false if the previous word is still being sent or the queue is full
+//
+//*****************************************************************************
 
-    // Wait for the I2C master to finish sending the byte or timeout
-    I2C_TimeOutClock = I2C_TimeOut;
-    while (I2CMasterBusy(I2C0_BASE))
+bool I2C_SendData(uint32_t SData)
+{
+    // The buffer is owned by the transaction until it completes
+    if (I2C_SendXfer.Status == I2CM_PENDING)
     {
-        if (--I2C_TimeOutClock == 0) break;
+        return false;
     }
+
+    I2C_SendBuffer[0] = (uint8_t)(SData >> 24);
+    I2C_SendBuffer[1] = (uint8_t)(SData >> 16);
+    I2C_SendBuffer[2] = (uint8_t)(SData >> 8);
+    I2C_SendBuffer[3] = (uint8_t)(SData);
+
+    I2C_SendXfer.Address = SLAVE_ADDRESS;
+    I2C_SendXfer.TxData = I2C_SendBuffer;
+    I2C_SendXfer.TxCount = 4;
+    I2C_SendXfer.RxData = 0;
+    I2C_SendXfer.RxCount = 0;
+    I2C_SendXfer.Done = 0;
+
+    return I2CMasterSubmit(&I2C_SendXfer);
 }
 
 //*****************************************************************************
@@ -670,16 +885,44 @@ int UARTStrPut(char *Msg)
 {
     int StrPos = 0;  // Position within the string
 
+    // Once uDMA owns the transmitter, text is queued in the ring
+    if (UartStreamActive())
+    {
+        StrPos = strlen(Msg);
+        UartStreamWrite((const uint8_t *)Msg, StrPos);
+        return StrPos;
+    }
+
     // Loop through each character in the string until the null terminator is encountered
     while (Msg[StrPos] != 0)
     {
         // Send the current character over the UART interface
-        UARTCharPut(SerialBASE, Msg[StrPos++]);
+        MAP_UARTCharPut(SerialBASE, Msg[StrPos++]);
     }
 
     return StrPos;  // Return the number of characters sent
 }
 
+//*****************************************************************************
+//
+// UARTBytePut: Sends one byte over the UART interface, through the transmit
+// ring once it runs
+//
+// \param Byte - The byte to be sent
+//
+//*****************************************************************************
+void UARTBytePut(uint8_t Byte)
+{
+    if (UartStreamActive())
+    {
+        UartStreamWrite(&Byte, 1);
+    }
+    else
+    {
+        MAP_UARTCharPut(SerialBASE, Byte);
+    }
+}
+
 //*****************************************************************************
 //
 // UARTHasData: Checks if there is any data available in the UART receive buffer
@@ -690,13 +933,14 @@ int UARTStrPut(char *Msg)
 bool UARTHasData()
 {
     // Check if there are any characters available in the UART0 receive buffer
-    return UARTCharsAvail(UART0_BASE);
+    return MAP_UARTCharsAvail(UART0_BASE);
 }
 
 //*****************************************************************************
 //
 // UART String Reception (Blocking): Reads a string from the UART interface,
-// blocking until a newline ('\n') or carriage return ('\r') character is received
+// blocking until a newline ('\n') or carriage return ('\r') character is received.
+// Characters that do not fit are dropped up to the line end and RcvTooLong is set
 //
 // \return Pointer to the received string
 //
@@ -706,16 +950,31 @@ char *UARTStrGet()
     int StrPos = 0;          // Position within the receive string
     char cThisChar;          // Character currently being read
 
+    RcvTooLong = false;
+
     do
     {
-        // Block until a character is received from the UART interface
-        cThisChar = UARTCharGet(UART0_BASE);
+        // Block until a character is received from the UART interface; waiting
+        // for the operator is not a hang
+        while (!MAP_UARTCharsAvail(UART0_BASE))
+        {
+            SupervisorKick();
+        }
+        cThisChar = MAP_UARTCharGetNonBlocking(UART0_BASE);
 
-        // Store the received character in the global buffer (RcvString)
-        RcvString[StrPos++] = cThisChar;
+        // Store the received character in the global buffer (RcvString); the
+        // last byte is kept for the line end
+        if ((StrPos < (int)(sizeof(RcvString) - 1)) || (cThisChar == '\n') || (cThisChar == '\r'))
+        {
+            RcvString[StrPos++] = cThisChar;
+        }
+        else
+        {
+            RcvTooLong = true;
+        }
 
         // Echo the received character back to the UART (for user feedback)
-        UARTCharPut(UART0_BASE, cThisChar);
+        UARTBytePut(cThisChar);
 
     }
     // Continue until a newline ('\n') or carriage return ('\r') is received
@@ -727,294 +986,2417 @@ char *UARTStrGet()
 
 //*****************************************************************************
 //
-// SendMenu: Displays the main menu over the UART interface; shows the current
-// system status, detected CAN modules, and a list of available commands
+// Respond: Reports a command reply or background event, as text or, in compact
+// mode, as one response record
+//
+// \param Flags:    RSP_REPLY or RSP_EVENT, plus RSP_SIGNED for signed values
+// \param Cmd:      icmd* ID, or RSP_CMD_LINE
+// \param Status:   RSP_OK or RSP_ERR_*
+// \param Values:   Values of the record
+// \param Count:    Number of values
+// \param Text:     Message printed in text mode, or 0 for none
 //
 //*****************************************************************************
-void SendMenu(void)
-{
-    // Send a welcome message indicating the sensor controller is online
-    UARTStrPut("\r\nInkley Sensor Controller Online.\r\n");
-    UARTStrPut("\r\n");
 
-    // Display the host clock speed in MHz
-    sprintf(PrintMsg, "\r\nHost Clock: %d MHZ \r\n", SystemClockSpeed / 1000000);
-    UARTStrPut(PrintMsg);
+void Respond(uint32_t Flags, uint32_t Cmd, uint32_t Status, const uint32_t *Values, uint32_t Count, char *Text)
+{
+    char Record[RSP_MAX_LENGTH];
 
-    // If a CAN module has been detected, display its ID
-    if (CAN_MODULES[0].ID > 0)
+    if (CompactResponses)
     {
-        sprintf(PrintMsg, "Detected Module: %04X\r\n", CAN_MODULES[0].ID);
-        UARTStrPut(PrintMsg);
-        CANLastDetected = CAN_MODULES[0].ID;  // Update the last detected CAN module ID
+        ResponseFormat(Record, Flags, Cmd, Status, Values, Count);
+        UARTStrPut(Record);
     }
+    else if (Text)
+    {
+        UARTStrPut(Text);
+    }
+}
 
-    // Prompt the user to type a command and press enter
-    UARTStrPut("\r\nType command # and press enter.\r\n\r\n");
+// Single-value form of Respond
+void RespondValue(uint32_t Flags, uint32_t Cmd, uint32_t Status, uint32_t Value, char *Text)
+{
+    Respond(Flags, Cmd, Status, &Value, 1, Text);
+}
 
-    // Display the list of available commands
-    UARTStrPut("\r\nCommands:\r\n");
-    UARTStrPut("1 - Read Version\r\n");
-    UARTStrPut("2 - Sensor Read Data\r\n");
-    UARTStrPut("3 - Start recording sensor data to flash memory\r\n");
-    UARTStrPut("4 - Read Flash at position\r\n");
-    UARTStrPut("5 - Erase Flash\r\n");
-    UARTStrPut("6 - Set flash memory sample size\r\n");
-    UARTStrPut("7 - Get flash memory status\r\n");
-    UARTStrPut("8 - Get flash memory sample.\r\n");
-    UARTStrPut("9 - Generate a CSV file from flash memory sample.\r\n");
+//*****************************************************************************
+//
+// SensorCommandSend: Sends a command with a 32-bit parameter to the sensor
+// module; used by modules that drive multi-frame exchanges
+//
+// \param Cmd:      The sensor command ID
+// \param Param:    The 32-bit command parameter (MSB first in MSG[3..6])
+//
+// \return 0 if successful, or 0xFFFFFFFF if there is a timeout error
+//
+//*****************************************************************************
 
-    // Display a prompt (>) for user input
-    UARTStrPut("\r\n\r\n");
-    UARTCharPut(UART0_BASE, '>');
+uint32_t SensorCommandSend(uint8_t Cmd, uint32_t Param)
+{
+    uint8_t Msg[8];
+    uint32_t Result;
+
+    Msg[0] = Cmd;
+    Msg[1] = CAN_ID >> 8;
+    Msg[2] = (uint8_t)CAN_ID;
+    Msg[3] = Param >> 24;
+    Msg[4] = Param >> 16;
+    Msg[5] = Param >> 8;
+    Msg[6] = Param;
+    Msg[7] = 0;
+
+    Result = CANSendMSG(CAN_SENSOR_ID, Msg);
+    CrashTrace(CRASH_EVENT(CRASH_EVT_CAN_TX, Cmd, (Param & ~CRASH_CAN_TX_FAILED) | (Result ? CRASH_CAN_TX_FAILED : 0)));
+    return Result;
 }
 
 //*****************************************************************************
 //
-// UARTClearScreen: Clears the terminal screen and resets the cursor position
-// using ANSI escape codes; this function is useful for clearing previous output
+// SensorCommandIssue: Sends a menu command to the sensor module and reports
+// whether it went out; the response is handled by the main loop
+//
+// \param Cmd:      The sensor command ID
+// \param Param:    The 32-bit command parameter
+// \param Msg:      Message printed before the command is sent
 //
 //*****************************************************************************
-void UARTClearScreen(void)
+
+void SensorCommandIssue(uint8_t Cmd, uint32_t Param, char *Msg)
 {
-    char clrBuf[10];
+    // In compact mode only a failure is reported here; the sensor's reply follows otherwise
+    if (!CompactResponses)
+    {
+        UARTStrPut(Msg);
+    }
+    if (SensorCommandSend(Cmd, Param))
+    {
+        Respond(RSP_REPLY, Cmd, RSP_ERR_CAN, 0, 0, "CAN Network Failed! \r\n");
+    }
+    else
+    {
+        SensorPending = Cmd;
+        if (!CompactResponses)
+        {
+            UARTStrPut("Command Sent. \r\n");
+        }
+    }
+}
 
-    // Clear the screen using the ANSI escape sequence (ESC[2J)
-    sprintf(clrBuf, "%c[2J", 0x1b);     // 0x1b is the ASCII code for ESC
-    UARTStrPut(clrBuf);
+//*****************************************************************************
+//
+// LogSample: Emits one line of the timestamped data log, shared by CAN sensor
+// readings and SMBus telemetry
+//
+// \param Source:   LOG_SRC_* source of the reading
+// \param Channel:  Channel number within the source
+// \param Value:    The reading
+//
+//*****************************************************************************
 
-    // Move the cursor back to the top-left corner (row 0, column 0) using the
-    // ANSI escape sequence (ESC[0;0H)
-    sprintf(clrBuf, "%c[0;0H", 0x1b);   // Reset cursor to the home position
-    UARTStrPut(clrBuf);
+void LogSample(uint8_t Source, uint8_t Channel, uint32_t Value)
+{
+    uint32_t Values[4];
+
+    if (!DataLogging)
+    {
+        return;
+    }
+
+    if (CompactResponses)
+    {
+        Values[0] = SystemTickMS;
+        Values[1] = Source;
+        Values[2] = Channel;
+        Values[3] = Value;
+        Respond(RSP_EVENT, icmdDataLog, RSP_OK, Values, 4, 0);
+        return;
+    }
+    snprintf(PrintMsg, sizeof(PrintMsg), "LOG,%d,%d,%d,%d\r\n", SystemTickMS, Source, Channel, Value);
+    UARTStrPut(PrintMsg);
 }
 
 //*****************************************************************************
 //
-// Main Function: Initializes system peripherals (UART, I2C, CAN, etc.), displays
-// a menu to the user, and processes commands entered via UART; interacts with
-// the CAN bus to send and receive sensor commands and data, and manages the response
-// processing loop
+// TelemetrySink: Receives SMBus telemetry readings from the poller
 //
 //*****************************************************************************
 
-int main(void)
+void TelemetrySink(uint8_t Channel, uint32_t Value)
 {
-    // CAN and Data Processing Variables: used for storing CAN message data, processing
-    // responses, managing sensor samples, and formatting output for logging/communication
-    char CAN_RECV_DATA[255];        // Buffer for formatted CAN data output
-    uint8_t CAN_MSG[8];             // Array for CAN message payload
-    uint32_t SampleValue = 0;       // Current sensor sample value
-    uint8_t CMD_RESPID = 0;         // Response ID of the last processed command
-    uint32_t SampleRecv = 0xFFFFFF; // Last received sensor sample (default value)
-    uint32_t lop = 0;               // Auxiliary loop counter
-    uint32_t Flash_Data = 0;        // Data for flash memory operations
-    char CSV_Line[255];             // Buffer for CSV-formatted output
-
-    // Set the system clock to 80MHz (using a 16MHz crystal and PLL)
-    SysCtlClockSet(SYSCTL_SYSDIV_2_5 | SYSCTL_USE_PLL | SYSCTL_OSC_MAIN | SYSCTL_XTAL_16MHZ);
+    LogSample(LOG_SRC_SMBUS, Channel, Value);
+}
 
-    // Get and store the system clock speed
-    SystemClockSpeed = SysCtlClockGet();
+//*****************************************************************************
+//
+// AdcRecordPoll: Commits filled ADC buffers to the flash recording and ends
+// the recording once FlashSampleSize bytes of samples have been taken; the
+// result is exported with the same CSV/binary commands as a sensor download
+//
+//*****************************************************************************
 
-    // Initialize system peripherals: SysTick, UART, I2C, and CAN
-    Init_Systick();
-    Init_UART(115200);      // UART initialized with 115200 baud rate
-    Init_I2C();
-    Init_CAN(CAN_BAUD);     // CAN initialized with 500Kbps baud rate
+void AdcRecordPoll(void)
+{
+    const uint16_t *Block;
+    AdcCaptureStats AdcStats;
+    FlashWriterStats FlashStats;
+    uint32_t lop, Count, Sample, Values[8];
 
-    // Turn on CAN listener for mailbox 1 and initialize the CAN modules
-    CANListnerEX(1);
-    CAN_MODULES[0].ID = 0;
+    if (!AdcRecording)
+    {
+        return;
+    }
 
-    // Allow some startup time (2 seconds)
-    DelayMS(2000);
+    Block = AdcCaptureBlockGet();
+    if (Block == 0)
+    {
+        return;
+    }
 
-    // Display the main menu over UART
-    SendMenu();
+    Count = ADCC_BLOCK_SAMPLES;
+    if (AdcFiltering)
+    {
+        // Centre the 12-bit codes on zero as Q15, then low-pass and decimate;
+        // the output is stored as a 16-bit code (ADC code x 16)
+        for (lop = 0; lop < ADCC_BLOCK_SAMPLES; lop++)
+        {
+            AdcFiltered[lop] = (int16_t)(((int32_t)Block[lop] - 2048) << 4);
+        }
+        Count = DspPipelineQ15Process(&AdcFilter, AdcFiltered, ADCC_BLOCK_SAMPLES);
+    }
 
-    // Main command processing loop
-    while (1)
+    // Samples are stored as 32-bit words like sensor samples
+    for (lop = 0; (lop < Count) && (AdcRecorded < (FlashSampleSize / 4)); lop++)
     {
-        // Check if there is data available from the UART
-        if (UARTHasData())
+        Sample = AdcFiltering ? (uint32_t)(AdcFiltered[lop] + 32768) : Block[lop];
+        if (SampleCompression)
         {
-            // Prepare the CAN message with default values
-            CAN_MSG[0] = 0;                     // Blank - no command
-            CAN_MSG[1] = CAN_ID >> 8;           // #define icmdReadVersion         01  // Command to read the version of the sensor
-            CAN_MSG[2] = (uint8_t)CAN_ID;       // #define icmdReadData            02  // Command to read sensor data
-            CAN_MSG[3] = 0;                     // #define icmdFlashStart          03  // Command to start recording data into flash memory
-            CAN_MSG[4] = 0;                     // #define icmdFlashReadPos        04  // Command to read data from a specific position in flash memory
-            CAN_MSG[5] = 0;                     // #define icmdFlashEraseFull      05  // Command to erase the entire flash memory
-            CAN_MSG[6] = 0;                     // #define icmdFlashSetSampleSize  06  // Command to set the sample size for flash memory
-            CAN_MSG[7] = 0;                     // #define icmdFlashStatus         07  // Command to get the status of the flash memory read (e.g., percentage complete)
-            //TODO: Don't we need the below CAN messages prepared? I get a warning when I uncomment 'subscript out of range'
-            //CAN_MSG[8] = 0;                     // #define icmdFlashGetData        08  // Get Flash sample from sensor module and store it locally
-            //CAN_MSG[9] = 0;                     // #define icmdFlashGenCSV         09  // Generate a CSV file from the flash data stored locally
-
-            // Wait for the user to enter a command via UART and process it
-            switch (strtoul(UARTStrGet(), NULL, 0))
-            {
-            //*****************************************************************************
-            //
-            // UART Command Processing: Handles user commands entered via UART. Commands
-            // are processed and mapped to corresponding CAN messages sent to the sensor
-            // module. Includes extended functionality for retrieving flash data and
-            // generating CSV files.
-            //
-            // - icmdReadVersion: Requests the firmware version from the sensor module.
-            // - icmdReadData: Requests the latest sensor data sample.
-            // - icmdFlashStart: Initiates recording of sensor data to flash memory.
-            // - icmdFlashReadPos: Retrieves the current read position in flash memory.
-            // - icmdFlashEraseFull: Erases all flash memory data.
-            // - icmdFlashSetSampleSize: Configures the flash memory sample size.
-            // - icmdFlashStatus: Queries the status of flash memory operations.
-            // - icmdFlashGetData: Retrieves stored flash memory samples.
-            // - icmdFlashGenCSV: Generates CSV-formatted output from flash data.
-            //
-            // Each command triggers the corresponding CAN message, and the sensor module
-            // responds with relevant data or an acknowledgment. Additional functionality
-            // like CSV generation adds utility for data export.
-            //
-            //****************************************************************************
-
-            case icmdReadVersion:           // Read Version Command
-                    UARTStrPut("Requesting Version from sensor module. \r\n");
-                    CAN_MSG[0] = icmdReadVersion;
-                    if (CANSendMSG(CAN_SENSOR_ID, CAN_MSG))
-                    {
-                        UARTStrPut("CAN Network Failed! \r\n");
-                    }
-                    else
-                    {
-                        UARTStrPut("Command Sent. \r\n");
-                    }
-                    break;
+            SampleEncodePut(&AdcEncoder, Sample);
+        }
+        else
+        {
+            FlashWriterPut(Sample);
+        }
+        AdcRecorded++;
+    }
+    AdcCaptureBlockRelease();
 
-                case icmdReadData:              // Read Sensor Data Command
-                    UARTStrPut("Reading Sensor Data. \r\n");
-                    CAN_MSG[0] = icmdReadData;
-                    if (CANSendMSG(CAN_SENSOR_ID, CAN_MSG))
-                    {
-                        UARTStrPut("CAN Network Failed! \r\n");
-                    }
-                    else
-                    {
-                        UARTStrPut("Command Sent. \r\n");
-                    }
-                    break;
+    if (AdcRecorded < (FlashSampleSize / 4))
+    {
+        return;
+    }
 
-                case icmdFlashStart:            // Start Recording to Flash Command
-                    UARTStrPut("Getting FLASH memory status. \r\n");
-                    CAN_MSG[0] = icmdFlashStart;
-                    if (CANSendMSG(CAN_SENSOR_ID, CAN_MSG))
-                    {
-                        UARTStrPut("CAN Network Failed! \r\n");
-                    }
-                    else
-                    {
-                        UARTStrPut("Command Sent. \r\n");
-                    }
-                    break;
+    AdcCaptureStop();
+    AdcRecording = false;
+    if (SampleCompression)
+    {
+        SampleEncodeFlush(&AdcEncoder);
+    }
+    FlashWriterSync();
 
-                case icmdFlashReadPos:          // Read Flash Memory at Position Command
-                    UARTStrPut("Reading FLASH memory data. \r\n");
-                    CAN_MSG[0] = icmdFlashReadPos;
-                    if (CANSendMSG(CAN_SENSOR_ID, CAN_MSG))
-                    {
-                        UARTStrPut("CAN Network Failed! \r\n");
-                    }
-                    else
-                    {
-                        UARTStrPut("Command Sent. \r\n");
-                    }
-                    break;
+    // Overruns mean flash could not keep up with the sample rate
+    AdcCaptureStatsGet(&AdcStats);
+    FlashWriterStatsGet(&FlashStats);
+    if (CompactResponses)
+    {
+        Values[0] = AdcRecorded;
+        Values[1] = AdcStats.Blocks;
+        Values[2] = AdcStats.Overruns;
+        Values[3] = AdcStats.FifoOverflows;
+        Values[4] = FlashStats.PagesWritten;
+        Values[5] = FlashStats.MaxQueueDepth;
+        Values[6] = FlashStats.Stalls;
+        Values[7] = FlashStats.Errors;
+        Respond(RSP_EVENT, icmdAdcRecord, FlashStats.Errors ? RSP_ERR_FAILED : RSP_OK, Values, 8, 0);
+        return;
+    }
 
-                case icmdFlashEraseFull:        // Erase Flash Memory Command
-                    UARTStrPut("Erasing FLASH memory. \r\n");
-                    CAN_MSG[0] = icmdFlashEraseFull;
-                    if (CANSendMSG(CAN_SENSOR_ID, CAN_MSG))
-                    {
-                        UARTStrPut("CAN Network Failed! \r\n");
-                    }
-                    else
-                    {
-                        UARTStrPut("Command Sent. \r\n");
-                    }
-                    break;
+    snprintf(PrintMsg, sizeof(PrintMsg), "ADC recording done: %d samples, %d buffers, %d overruns, %d FIFO overflows\r\n",
+             AdcRecorded, AdcStats.Blocks, AdcStats.Overruns, AdcStats.FifoOverflows);
+    UARTStrPut(PrintMsg);
+    snprintf(PrintMsg, sizeof(PrintMsg), "Flash Writer: %d pages, max queue %d, stalls %d, errors %d\r\n",
+             FlashStats.PagesWritten, FlashStats.MaxQueueDepth, FlashStats.Stalls, FlashStats.Errors);
+    UARTStrPut(PrintMsg);
+}
 
-                case icmdFlashSetSampleSize:    // Set Flash Sample Size Command
-                    UARTStrPut("Setting Sample size. Enter Value in HEX. Default is 0x10000. \r\n");
-                    SampleValue = strtoul(UARTStrGet(), NULL, 0);
-                    CAN_MSG[0] = icmdFlashSetSampleSize;
-                    CAN_MSG[3] = SampleValue >> 24;
-                    CAN_MSG[4] = SampleValue >> 16;
-                    CAN_MSG[5] = SampleValue >> 8;
-                    CAN_MSG[6] = SampleValue;
-                    if (CANSendMSG(CAN_SENSOR_ID, CAN_MSG))
-                    {
-                        UARTStrPut("CAN Network Failed! \r\n");
-                    }
-                    else
-                    {
-                        UARTStrPut("Command Sent. \r\n");
-                    }
-                    break;
+//*****************************************************************************
+//
+// TriggerPoll: Feeds the armed triggered capture from its stream and commits
+// the window to flash once it is frozen
+//
+//*****************************************************************************
 
-                case icmdFlashStatus:           // Get Flash Memory Status Command
-                    UARTStrPut("Getting FLASH memory status... \r\n");
-                    CAN_MSG[0] = icmdFlashStatus;
-                    if (CANSendMSG(CAN_SENSOR_ID, CAN_MSG))
-                    {
-                        UARTStrPut("CAN Network Failed! \r\n");
-                    }
-                    else
-                    {
-                        UARTStrPut("Command Sent. \r\n");
-                    }
-                    break;
+void TriggerPoll(void)
+{
+    const uint16_t *Block;
+    TriggerCaptureStatus Status;
+    uint32_t Index, Size, lop, Values[4];
 
-                case icmdFlashGetData:          // Retrieve Flash Memory Samples
-                    UARTStrPut("Requesting flash memory samples from sensor module. \r\n");
-                    CAN_MSG[0] = icmdFlashGetData;
-                    if (CANSendMSG(CAN_SENSOR_ID, CAN_MSG))
-                    {
-                        UARTStrPut("CAN Network Failed! \r\n");
-                    }
-                    else
-                    {
-                        UARTStrPut("Command Sent. \r\n");
-                    }
+    if (TriggerSource == TRIG_SRC_ADC)
+    {
+        // Match the comparator hit to its sample before feeding the samples
+        if (AdcCaptureTriggerGet(&Index))
+        {
+            TriggerCaptureFireAt(Index);
+        }
+
+        Block = AdcCaptureBlockGet();
+        if (Block)
+        {
+            for (lop = 0; lop < ADCC_BLOCK_SAMPLES; lop++)
+            {
+                TriggerCapturePut(Block[lop]);
+            }
+            AdcCaptureBlockRelease();
+        }
+    }
+    else if (TriggerSource == TRIG_SRC_CAN)
+    {
+        // Readings arrive as icmdReadData responses and are fed from the CAN handler
+        if ((int32_t)(SystemTickMS - TriggerNextPoll) >= 0)
+        {
+            TriggerNextPoll = SystemTickMS + TriggerCanPeriodMS;
+            SensorCommandSend(icmdReadData, 0);
+        }
+    }
+    else
+    {
+        return;
+    }
+
+    if (TriggerCaptureState() != TRIG_DONE)
+    {
+        return;
+    }
+
+    if (TriggerSource == TRIG_SRC_ADC)
+    {
+        AdcCaptureStop();
+        AdcCaptureComparatorOff();
+    }
+    TriggerCaptureStatusGet(&Status);
+    Size = TriggerCaptureCommit(FlashUserSpace, SampleCompression);
+    if (Size)
+    {
+        FlashSampleSize = Size;
+        RecordingRate = (TriggerSource == TRIG_SRC_ADC) ? TriggerAdcRate : (1000 / TriggerCanPeriodMS);
+        RecordingModule = (TriggerSource == TRIG_SRC_CAN) ? CAN_MODULES[0].ID : 0;
+    }
+
+    snprintf(PrintMsg, sizeof(PrintMsg), "Triggered at sample %d (value %d): %d pre + %d post samples %s.\r\n",
+             Status.TriggerIndex, Status.TriggerValue, Status.Pre, Status.Post,
+             Size ? "committed to flash" : "NOT stored, flash busy");
+    Values[0] = Status.TriggerIndex;
+    Values[1] = Status.TriggerValue;
+    Values[2] = Status.Pre;
+    Values[3] = Status.Post;
+    Respond(RSP_EVENT, (TriggerSource == TRIG_SRC_ADC) ? icmdTriggerAdc : icmdTriggerCan,
+            Size ? RSP_OK : RSP_ERR_BUSY, Values, 4, PrintMsg);
+    TriggerSource = TRIG_SRC_NONE;
+}
+
+//*****************************************************************************
+//
+// StatsPoll: Requests a CAN sensor reading every StatsPeriodMS while the live
+// statistics monitor runs; the readings are added to LiveStats by the CAN
+// response handler. A triggered capture on CAN already polls the sensor, so
+// its readings are used instead of sending a second request.
+//
+//*****************************************************************************
+
+void StatsPoll(void)
+{
+    if (!StatsMonitoring || (TriggerSource == TRIG_SRC_CAN))
+    {
+        return;
+    }
+
+    if ((int32_t)(SystemTickMS - StatsNextPoll) >= 0)
+    {
+        StatsNextPoll = SystemTickMS + StatsPeriodMS;
+        SensorCommandSend(icmdReadData, 0);
+    }
+}
+
+//*****************************************************************************
+//
+// StreamSample: Forwards one sensor reading to the UART as a text line
+// "S,<index>,<ms>,<value>" or a 6-byte binary record (StreamSync, low byte of
+// the index, value little-endian); a reading the link cannot take is dropped,
+// which shows up as a gap in the index
+//
+// \param TimeMS:   Time the reading was taken
+// \param Value:    The reading
+//
+//*****************************************************************************
+
+void StreamSample(uint32_t TimeMS, uint32_t Value)
+{
+    uint8_t Record[40];
+    uint32_t Length;
+
+    if (StreamBinary)
+    {
+        Record[0] = StreamSync;
+        Record[1] = (uint8_t)StreamIndex;
+        Record[2] = (uint8_t)Value;
+        Record[3] = (uint8_t)(Value >> 8);
+        Record[4] = (uint8_t)(Value >> 16);
+        Record[5] = (uint8_t)(Value >> 24);
+        Length = 6;
+    }
+    else
+    {
+        Length = snprintf((char *)Record, sizeof(Record), "S,%u,%u,%u\r\n", StreamIndex, TimeMS, Value);
+    }
+    StreamIndex++;
+    UartStreamPut(Record, Length);
+}
+
+//*****************************************************************************
+//
+// StreamPoll: Requests a CAN sensor reading every StreamPeriodMS while
+// streaming; the CAN response handler forwards it. The statistics monitor and
+// a triggered capture on CAN already poll the sensor, and their readings are
+// streamed instead.
+//
+//*****************************************************************************
+
+void StreamPoll(void)
+{
+    if (!Streaming || StatsMonitoring || (TriggerSource == TRIG_SRC_CAN))
+    {
+        return;
+    }
+
+    if ((int32_t)(SystemTickMS - StreamNextPoll) >= 0)
+    {
+        StreamNextPoll = SystemTickMS + StreamPeriodMS;
+        SensorCommandSend(icmdReadData, 0);
+    }
+}
+
+//*****************************************************************************
+//
+// StreamReport: Prints the transfer counters of the stream that just ended;
+// drops mean the UART could not keep up with the sensor
+//
+//*****************************************************************************
+
+void StreamReport(void)
+{
+    UartStreamStats Stats;
+    uint32_t Values[5];
+
+    UartStreamStatsGet(&Stats);
+    snprintf(PrintMsg, sizeof(PrintMsg), "\r\nStream stopped: %d records, %d dropped, %d bytes, max buffer %d of %d, %d stalls\r\n",
+             Stats.Records, Stats.Drops, Stats.Bytes, Stats.MaxFill, UST_BUFFER_SIZE, Stats.Stalls);
+    Values[0] = Stats.Records;
+    Values[1] = Stats.Drops;
+    Values[2] = Stats.Bytes;
+    Values[3] = Stats.MaxFill;
+    Values[4] = Stats.Stalls;
+    Respond(RSP_REPLY, icmdStream, Stats.Drops ? RSP_ERR_BUSY : RSP_OK, Values, 5, PrintMsg);
+}
+
+//*****************************************************************************
+//
+// RamCaptureReport: Prints the result of a burst once it has been flushed
+//
+// \param Errors:   Flash errors of the flush (0 for the UART)
+//
+//*****************************************************************************
+
+void RamCaptureReport(uint32_t Errors)
+{
+    RamCaptureStatus Status;
+    uint32_t Values[6];
+
+    RamCaptureStatusGet(&Status);
+    snprintf(PrintMsg, sizeof(PrintMsg), "\r\nBurst: %d of %d samples in %d ms (%d Hz), %d late, sent to %s%s\r\n",
+             Status.Samples, Status.Capacity, RamElapsed, RecordingRate, Status.Overflows,
+             (RamTarget == RAMF_FLASH) ? "flash" : "UART", Errors ? " WITH ERRORS" : "");
+    Values[0] = Status.Samples;
+    Values[1] = Status.Capacity;
+    Values[2] = RamElapsed;
+    Values[3] = RecordingRate;
+    Values[4] = Status.Overflows;
+    Values[5] = Errors;
+    Respond(RSP_EVENT, (RamTarget == RAMF_FLASH) ? icmdRamCaptureFlash : icmdRamCaptureUart,
+            Errors ? RSP_ERR_FAILED : RSP_OK, Values, 6, PrintMsg);
+}
+
+//*****************************************************************************
+//
+// IdleReport: Prints how much of the time since low-power idle was enabled
+// the core slept, and how long it took to wake up at a deadline
+//
+//*****************************************************************************
+
+void IdleReport(void)
+{
+    IdleStats Stats;
+    uint32_t Values[7], Elapsed, Average;
+
+    IdleStatsGet(&Stats);
+    Elapsed = SystemTickMS - IdleStatsStart;
+    Average = Stats.DeadlineWakes ? (Stats.LatencyTotal / Stats.DeadlineWakes) : 0;
+    snprintf(PrintMsg, sizeof(PrintMsg), "Low-power idle disabled: asleep %d of %d ms (%d%%), %d sleeps, %d tickless "
+             "(%d at the deadline, %d woken early), wake-up latency %d cycles average, %d max (%d ns)\r\n",
+             Stats.SleepMS, Elapsed, Elapsed ? (uint32_t)(((uint64_t)Stats.SleepMS * 100) / Elapsed) : 0,
+             Stats.Sleeps, Stats.Tickless, Stats.DeadlineWakes, Stats.EventWakes, Average, Stats.LatencyMax,
+             (Stats.LatencyMax * 1000) / (SystemClockSpeed / 1000000));
+    Values[0] = Stats.SleepMS;
+    Values[1] = Elapsed;
+    Values[2] = Stats.Sleeps;
+    Values[3] = Stats.Tickless;
+    Values[4] = Stats.EventWakes;
+    Values[5] = Average;
+    Values[6] = Stats.LatencyMax;
+    Respond(RSP_REPLY, icmdLowPowerIdle, RSP_OK, Values, 7, PrintMsg);
+}
+
+//*****************************************************************************
+//
+// ClockReport: Prints the profile switches since clock scaling was enabled,
+// the time spent in each profile and the estimated average supply current
+//
+//*****************************************************************************
+
+void ClockReport(void)
+{
+    ClockStats Stats;
+    uint32_t Values[7], Total, Average;
+
+    ClockStatsGet(&Stats, SystemTickMS);
+    Total = Stats.ProfileMS[CLK_PROFILE_IDLE] + Stats.ProfileMS[CLK_PROFILE_FULL];
+    Average = Total ? (uint32_t)((((uint64_t)Stats.ProfileMS[CLK_PROFILE_IDLE] * CLK_IDLE_MA) +
+                                  ((uint64_t)Stats.ProfileMS[CLK_PROFILE_FULL] * CLK_FULL_MA)) / Total) : CLK_FULL_MA;
+    snprintf(PrintMsg, sizeof(PrintMsg), "Clock scaling disabled: %d switches, last %d us, slowest %d us "
+             "(+%d us waiting for transfers), %d ms idle, %d ms at full clock, about %d mA average (%d mA at full clock)\r\n",
+             Stats.Switches, Stats.LastUS, Stats.MaxUS, Stats.WaitUS, Stats.ProfileMS[CLK_PROFILE_IDLE],
+             Stats.ProfileMS[CLK_PROFILE_FULL], Average, CLK_FULL_MA);
+    Values[0] = Stats.Switches;
+    Values[1] = Stats.LastUS;
+    Values[2] = Stats.MaxUS;
+    Values[3] = Stats.WaitUS;
+    Values[4] = Stats.ProfileMS[CLK_PROFILE_IDLE];
+    Values[5] = Stats.ProfileMS[CLK_PROFILE_FULL];
+    Values[6] = Average;
+    Respond(RSP_REPLY, icmdClockScaling, RSP_OK, Values, 7, PrintMsg);
+}
+
+//*****************************************************************************
+//
+// ClockFull: Switches to the full clock profile, e.g. before a command runs
+//
+//*****************************************************************************
+
+void ClockFull(void)
+{
+    ClockBusyTime = SystemTickMS;
+    if (ClockProfileGet() != CLK_PROFILE_FULL)
+    {
+        CrashTrace(CRASH_EVENT(CRASH_EVT_CLOCK, 0, CLK_PROFILE_FULL));
+        ClockProfileSet(CLK_PROFILE_FULL, SystemTickMS);
+    }
+}
+
+//*****************************************************************************
+//
+// RamCapturePoll: Keeps a burst going if a sensor response was lost, then
+// flushes the captured samples a chunk at a time, as fast as the flash writer
+// or the UART ring take them, and reports the burst
+//
+//*****************************************************************************
+
+void RamCapturePoll(void)
+{
+    const uint32_t *Data;
+    FlashWriterStats FlashStats;
+    RamCaptureStatus Status;
+    uint32_t Count, lop;
+
+    if (RamTarget == RAMF_NONE)
+    {
+        return;
+    }
+
+    if (RamCaptureState() == RCAP_RECORDING)
+    {
+        // Readings are requested back-to-back from the CAN handler
+        if ((SystemTickMS - RamPollTime) >= RamRetryMS)
+        {
+            RamPollTime = SystemTickMS;
+            SensorCommandSend(icmdReadData, 0);
+        }
+        return;
+    }
+
+    // The burst has ended; start the flush
+    if (!RamFlushing)
+    {
+        RamCaptureStatusGet(&Status);
+        RamElapsed = SystemTickMS - RamStartTime;
+        if (RamTarget == RAMF_FLASH)
+        {
+            if (!FlashWriterStart(FlashUserSpace, SampleCompression ? CODEC_WORST_CASE(Status.Samples * 4)
+                                                                    : (Status.Samples * 4)))
+            {
+                return;                 // Flash still busy; try again on the next poll
+            }
+            SampleEncodeInit(&RamEncoder, FlashWriterPut);
+        }
+        StreamIndex = 0;
+        RecordingRate = (Status.Samples * 1000) / (RamElapsed ? RamElapsed : 1);
+        RamFlushing = true;
+    }
+
+    RamCaptureStatusGet(&Status);
+    Data = RamCapturePending(&Count);
+    if (Count > RamFlushChunk)
+    {
+        Count = RamFlushChunk;
+    }
+
+    if (RamTarget == RAMF_FLASH)
+    {
+        // Only feed the writer when it has no page waiting, so a put never stalls
+        FlashWriterStatsGet(&FlashStats);
+        if (FlashStats.QueueDepth)
+        {
+            return;
+        }
+        for (lop = 0; lop < Count; lop++)
+        {
+            if (SampleCompression)
+            {
+                SampleEncodePut(&RamEncoder, Data[lop]);
+            }
+            else
+            {
+                FlashWriterPut(Data[lop]);
+            }
+        }
+    }
+    else
+    {
+        // Only as many records as the ring takes; readings are spread over the burst time
+        if (Count > (UartStreamFree() / 40))
+        {
+            Count = UartStreamFree() / 40;
+        }
+        for (lop = 0; lop < Count; lop++)
+        {
+            StreamSample(RamStartTime + ((StreamIndex * RamElapsed) / Status.Samples), Data[lop]);
+        }
+    }
+    RamCaptureRelease(Count);
+
+    if (RamCaptureState() != RCAP_IDLE)
+    {
+        return;
+    }
+
+    FlashStats.Errors = 0;
+    if (RamTarget == RAMF_FLASH)
+    {
+        if (SampleCompression)
+        {
+            SampleEncodeFlush(&RamEncoder);
+        }
+        FlashWriterSync();
+        FlashWriterStatsGet(&FlashStats);
+        FlashSampleSize = Status.Samples * 4;
+        RecordingModule = CAN_MODULES[0].ID;
+    }
+    RamCaptureReport(FlashStats.Errors);
+    RamTarget = RAMF_NONE;
+    RamFlushing = false;
+}
+
+//*****************************************************************************
+//
+// StatsReport: Prints a snapshot of the live statistics and their histogram
+//
+//*****************************************************************************
+
+void StatsReport(void)
+{
+    StreamStatsSnapshot Snap;
+    uint32_t lop, Values[STATS_BINS + 2];
+
+    if (!StreamStatsSnapshotGet(&LiveStats, &Snap))
+    {
+        Respond(RSP_REPLY, icmdStatsShow, RSP_ERR_FAILED, 0, 0, "No live samples yet (start the monitor first). \r\n");
+        return;
+    }
+
+    // Compact mode: one record of the statistics, one of the histogram counts
+    if (CompactResponses)
+    {
+        Values[0] = Snap.Count;
+        Values[1] = Snap.Min;
+        Values[2] = Snap.Max;
+        Values[3] = Snap.Mean;
+        Values[4] = Snap.StdDev;
+        Values[5] = Snap.Rms;
+        Values[6] = (uint32_t)Snap.Rate;
+        Values[7] = Snap.MaxRate;
+        Respond(RSP_REPLY | RSP_SIGNED, icmdStatsShow, RSP_OK, Values, 8, 0);
+
+        Values[0] = Snap.Under;
+        for (lop = 0; lop < STATS_BINS; lop++)
+        {
+            Values[lop + 1] = Snap.Hist[lop];
+        }
+        Values[STATS_BINS + 1] = Snap.Over;
+        Respond(RSP_REPLY, icmdStatsShow, RSP_OK, Values, STATS_BINS + 2, 0);
+        return;
+    }
+
+    snprintf(PrintMsg, sizeof(PrintMsg), "Samples: %d, min %d, max %d, mean %d, std dev %d, RMS %d\r\n",
+             Snap.Count, Snap.Min, Snap.Max, Snap.Mean, Snap.StdDev, Snap.Rms);
+    UARTStrPut(PrintMsg);
+    snprintf(PrintMsg, sizeof(PrintMsg), "Rate of change: %d/s (max %d/s)\r\n", Snap.Rate, Snap.MaxRate);
+    UARTStrPut(PrintMsg);
+
+    snprintf(PrintMsg, sizeof(PrintMsg), "  < %d: %d\r\n", Snap.HistLow, Snap.Under);
+    UARTStrPut(PrintMsg);
+    for (lop = 0; lop < STATS_BINS; lop++)
+    {
+        snprintf(PrintMsg, sizeof(PrintMsg), "  %d..%d: %d\r\n", Snap.HistLow + (lop * Snap.HistWidth),
+                 Snap.HistLow + ((lop + 1) * Snap.HistWidth) - 1, Snap.Hist[lop]);
+        UARTStrPut(PrintMsg);
+    }
+    snprintf(PrintMsg, sizeof(PrintMsg), "  >= %d: %d\r\n", Snap.HistLow + (STATS_BINS * Snap.HistWidth), Snap.Over);
+    UARTStrPut(PrintMsg);
+}
+
+//*****************************************************************************
+//
+// SpectrumReport: Transforms the collected frame and prints its largest peaks;
+// in compact mode one record holds the frame start and (Hz, amplitude) pairs
+//
+// \param Flags:        RSP_REPLY or RSP_EVENT
+// \param Cmd:          Command the frame belongs to
+// \param SampleRate:   Sample rate of the frame in Hz
+// \param Start:        Index of the first sample of the frame
+//
+//*****************************************************************************
+
+void SpectrumReport(uint32_t Flags, uint32_t Cmd, uint32_t SampleRate, uint32_t Start)
+{
+    SpectrumPeak Peaks[SpectrumPeaks];
+    uint32_t Found, lop, Values[1 + (SpectrumPeaks * 2)];
+
+    Found = SpectrumAnalyze(SampleRate, Peaks, SpectrumPeaks);
+    if (CompactResponses)
+    {
+        Values[0] = Start;
+        for (lop = 0; lop < Found; lop++)
+        {
+            Values[1 + (lop * 2)] = Peaks[lop].FreqHz;
+            Values[2 + (lop * 2)] = Peaks[lop].Amplitude;
+        }
+        Respond(Flags, Cmd, RSP_OK, Values, 1 + (Found * 2), 0);
+        return;
+    }
+
+    if (Found == 0)
+    {
+        UARTStrPut("  No spectral peaks.\r\n");
+    }
+    for (lop = 0; lop < Found; lop++)
+    {
+        snprintf(PrintMsg, sizeof(PrintMsg), "  Peak %d: %d Hz, amplitude %d (bin %d)\r\n",
+                 lop + 1, Peaks[lop].FreqHz, Peaks[lop].Amplitude, Peaks[lop].Bin);
+        UARTStrPut(PrintMsg);
+    }
+}
+
+//*****************************************************************************
+//
+// SpectrumRecording: Prints the spectral peaks of each FFT_MAX_SIZE block of
+// the recording in flash
+//
+//*****************************************************************************
+
+void SpectrumRecording(void)
+{
+    SampleReader Reader;
+    uint32_t Value, Start = 0;
+
+    if (!CompactResponses)
+    {
+        snprintf(PrintMsg, sizeof(PrintMsg), "Spectrum of the recording (%d-point FFT, %d Hz):\r\n",
+                 FFT_MAX_SIZE, RecordingRate);
+        UARTStrPut(PrintMsg);
+    }
+
+    SpectrumStart(FFT_MAX_SIZE);
+    SampleReaderInit(&Reader, FlashUserSpace, CODEC_WORST_CASE(FlashSampleSize));
+    while (((Start + FFT_MAX_SIZE) <= (FlashSampleSize / 4)) && SampleReaderNext(&Reader, &Value))
+    {
+        if (SpectrumPut(Value))
+        {
+            if (!CompactResponses)
+            {
+                snprintf(PrintMsg, sizeof(PrintMsg), "Samples %d..%d:\r\n", Start, Start + FFT_MAX_SIZE - 1);
+                UARTStrPut(PrintMsg);
+            }
+            SpectrumReport(RSP_REPLY, icmdSpectrumFlash, RecordingRate, Start);
+            Start += FFT_MAX_SIZE;
+        }
+    }
+
+    if (Start == 0)
+    {
+        Respond(RSP_REPLY, icmdSpectrumFlash, RSP_ERR_FAILED, 0, 0, "The recording is shorter than one FFT frame. \r\n");
+    }
+}
+
+//*****************************************************************************
+//
+// SpectrumPoll: Collects a live frame from the local ADC and prints its
+// spectral peaks once it is complete
+//
+//*****************************************************************************
+
+void SpectrumPoll(void)
+{
+    const uint16_t *Block;
+    uint32_t lop;
+    bool Full = false;
+
+    if (!SpectrumLive)
+    {
+        return;
+    }
+
+    Block = AdcCaptureBlockGet();
+    if (Block == 0)
+    {
+        return;
+    }
+    for (lop = 0; (lop < ADCC_BLOCK_SAMPLES) && !Full; lop++)
+    {
+        Full = SpectrumPut(Block[lop]);
+    }
+    AdcCaptureBlockRelease();
+
+    if (Full)
+    {
+        AdcCaptureStop();
+        SpectrumLive = false;
+        if (!CompactResponses)
+        {
+            snprintf(PrintMsg, sizeof(PrintMsg), "Live ADC spectrum (%d-point FFT, %d Hz):\r\n",
+                     FFT_MAX_SIZE, AdcSampleRate);
+            UARTStrPut(PrintMsg);
+        }
+        SpectrumReport(RSP_EVENT, icmdSpectrumAdc, AdcSampleRate, 0);
+    }
+}
+
+//*****************************************************************************
+//
+// MathBenchmark: Prints the average cost in CPU cycles of the math routines
+// used on the sample path and of formatting a reply line, measured with the
+// DWT cycle counter
+//
+//*****************************************************************************
+
+#define MathBenchRuns       256     // Calls averaged per routine
+
+void MathBenchmark(void)
+{
+    static const FixPoly Poly = { 3, { -12.5f, 0.25f, 1.0e-6f, -2.0e-12f } };
+    volatile uint32_t Input = 123456789;
+    volatile uint32_t Divisor = 1000;
+    volatile uint32_t Sink;
+    FixRecip Recip;
+    char Line[48];
+    uint32_t Start, Cycles[9], lop;
+
+    FixRecipInit(&Recip, Divisor);
+
+    Start = CycleCounterGet();
+    for (lop = 0; lop < MathBenchRuns; lop++)
+    {
+        Sink = Input / Divisor;
+    }
+    Cycles[0] = CycleCounterGet() - Start;
+
+    Start = CycleCounterGet();
+    for (lop = 0; lop < MathBenchRuns; lop++)
+    {
+        Sink = FixRecipDiv(&Recip, Input);
+    }
+    Cycles[1] = CycleCounterGet() - Start;
+
+    Start = CycleCounterGet();
+    for (lop = 0; lop < MathBenchRuns; lop++)
+    {
+        Sink = isqrt(Input);
+    }
+    Cycles[2] = CycleCounterGet() - Start;
+
+    Start = CycleCounterGet();
+    for (lop = 0; lop < MathBenchRuns; lop++)
+    {
+        Sink = FixSqrt64((uint64_t)Input * Input);
+    }
+    Cycles[3] = CycleCounterGet() - Start;
+
+    Start = CycleCounterGet();
+    for (lop = 0; lop < MathBenchRuns; lop++)
+    {
+        Sink = FixLog2(Input);
+    }
+    Cycles[4] = CycleCounterGet() - Start;
+
+    Start = CycleCounterGet();
+    for (lop = 0; lop < MathBenchRuns; lop++)
+    {
+        Sink = FixAtan2((int32_t)Input, -(int32_t)Divisor);
+    }
+    Cycles[5] = CycleCounterGet() - Start;
+
+    Start = CycleCounterGet();
+    for (lop = 0; lop < MathBenchRuns; lop++)
+    {
+        Sink = sine(Input);
+    }
+    Cycles[6] = CycleCounterGet() - Start;
+
+    Start = CycleCounterGet();
+    for (lop = 0; lop < MathBenchRuns; lop++)
+    {
+        Sink = FixPolyApply(&Poly, (int32_t)Input);
+    }
+    Cycles[7] = CycleCounterGet() - Start;
+
+    // A typical reply line, for the cost of formatting a message
+    Start = CycleCounterGet();
+    for (lop = 0; lop < MathBenchRuns; lop++)
+    {
+        Sink = snprintf(Line, sizeof(Line), "Sensor data: %d (raw %d) %08X\r\n", -(int32_t)Divisor, Input, Input);
+    }
+    Cycles[8] = CycleCounterGet() - Start;
+    (void)Sink;
+
+    if (CompactResponses)
+    {
+        for (lop = 0; lop < 9; lop++)
+        {
+            Cycles[lop] /= MathBenchRuns;
+        }
+        Respond(RSP_REPLY, icmdMathBench, RSP_OK, Cycles, 9, 0);
+        return;
+    }
+    snprintf(PrintMsg, sizeof(PrintMsg), "Cycles per call (avg of %d, incl. loop):\r\n", MathBenchRuns);
+    UARTStrPut(PrintMsg);
+    snprintf(PrintMsg, sizeof(PrintMsg), "  divide %d, FixRecipDiv %d, isqrt %d, FixSqrt64 %d\r\n",
+             Cycles[0] / MathBenchRuns, Cycles[1] / MathBenchRuns, Cycles[2] / MathBenchRuns, Cycles[3] / MathBenchRuns);
+    UARTStrPut(PrintMsg);
+    snprintf(PrintMsg, sizeof(PrintMsg), "  FixLog2 %d, FixAtan2 %d, sine %d, FixPolyApply (3rd order) %d\r\n",
+             Cycles[4] / MathBenchRuns, Cycles[5] / MathBenchRuns, Cycles[6] / MathBenchRuns, Cycles[7] / MathBenchRuns);
+    UARTStrPut(PrintMsg);
+    snprintf(PrintMsg, sizeof(PrintMsg), "  snprintf (3 values, %d chars) %d\r\n", (int)strlen(Line),
+             Cycles[8] / MathBenchRuns);
+    UARTStrPut(PrintMsg);
+}
+
+//*****************************************************************************
+//
+// CalibrationStore: Stores or removes the calibration polynomial of a sensor
+// module and reports the result
+//
+// \param ModuleID:     Module from the 0x7DF broadcast
+// \param Poly:         Polynomial (unused coefficients are cleared), or 0 to remove
+//
+//*****************************************************************************
+
+void CalibrationStore(uint32_t ModuleID, FixPoly *Poly)
+{
+    uint32_t lop;
+
+    if (Poly == 0)
+    {
+        if (CalibrationClear(ModuleID))
+        {
+            RespondValue(RSP_REPLY, icmdCalibrationSet, RSP_OK, ModuleID, "Calibration removed. \r\n");
+        }
+        else
+        {
+            RespondValue(RSP_REPLY, icmdCalibrationSet, RSP_ERR_FAILED, ModuleID, "Parameter save failed! \r\n");
+        }
+        return;
+    }
+    for (lop = Poly->Order + 1; lop <= FIX_POLY_MAX_ORDER; lop++)
+    {
+        Poly->Coeffs[lop] = 0.0f;
+    }
+
+    if (CalibrationSet(ModuleID, Poly))
+    {
+        RespondValue(RSP_REPLY, icmdCalibrationSet, RSP_OK, ModuleID, "Calibration stored. \r\n");
+    }
+    else
+    {
+        RespondValue(RSP_REPLY, icmdCalibrationSet, RSP_ERR_FAILED, ModuleID, "Parameter save failed! \r\n");
+    }
+}
+
+//*****************************************************************************
+//
+// CalibrationUpdate: Prompts for the calibration polynomial of a sensor module
+// and stores it; an empty line removes the calibration
+//
+// \param ModuleID:     Module from the 0x7DF broadcast
+//
+//*****************************************************************************
+
+void CalibrationUpdate(uint32_t ModuleID)
+{
+    FixPoly Poly;
+    char *Text, *End;
+    uint32_t lop;
+
+    if (CalibrationGet(ModuleID, &Poly))
+    {
+        snprintf(PrintMsg, sizeof(PrintMsg), "Module %04X has an order %d calibration.\r\n", ModuleID, Poly.Order);
+        UARTStrPut(PrintMsg);
+    }
+    snprintf(PrintMsg, sizeof(PrintMsg), "Enter c0 c1 [c2 [c3]] for %s = c0 + c1*raw + c2*raw^2 + c3*raw^3, empty to clear:\r\n",
+             CAL_UNIT);
+    UARTStrPut(PrintMsg);
+
+    // The receive buffer is not terminated; cut it at the line end
+    Text = UARTStrGet();
+    for (End = Text; (*End != '\r') && (*End != '\n'); End++)
+    {
+    }
+    *End = 0;
+
+    Poly.Order = 0;
+    for (lop = 0; lop <= FIX_POLY_MAX_ORDER; lop++)
+    {
+        Poly.Coeffs[lop] = (float)strtod(Text, &End);
+        if (End == Text)
+        {
+            break;
+        }
+        Poly.Order = lop;
+        Text = End;
+    }
+
+    CalibrationStore(ModuleID, (lop == 0) ? 0 : &Poly);
+}
+
+//*****************************************************************************
+//
+// DownloadReport: Reports progress and the result of a sample transfer
+//
+// \param Event:    The DL_EVT_* event returned by SampleDownloadFrame
+//
+//*****************************************************************************
+
+void DownloadReport(int Event)
+{
+    SampleDownloadStatus Status;
+    FlashWriterStats FlashStats;
+    FlashParams *Params;
+    uint32_t Values[8];
+
+    SampleDownloadStatusGet(&Status);
+
+    switch (Event)
+    {
+        case DL_EVT_STARTED:
+            // Display the size of the sample being received
+            snprintf(PrintMsg, sizeof(PrintMsg), "Receiving Sample Data Size: %08X\r\n", Status.Size);
+            RespondValue(RSP_EVENT, icmdFlashGetData, RSP_OK, Status.Size, PrintMsg);
+            FlashSampleSize = Status.Size;
+            RecordingRate = SensorSampleRate;
+            RecordingModule = CAN_MODULES[0].ID;
+            break;
+
+        case DL_EVT_RETRY:
+            RespondValue(RSP_EVENT, icmdFlashBlockCRC, RSP_ERR_FAILED, Status.Retries,
+                         "Block CRC mismatch, re-requesting block.\r\n");
+            break;
+
+        case DL_EVT_REPAIR:
+            snprintf(PrintMsg, sizeof(PrintMsg), "Flash read-back found %d corrupted blocks, re-requesting.\r\n",
+                     Status.ReadbackErrors);
+            RespondValue(RSP_EVENT, icmdFlashTrailerCRC, RSP_ERR_FAILED, Status.ReadbackErrors, PrintMsg);
+            break;
+
+        case DL_EVT_FAILED:
+            if (Status.Failure == DL_FAIL_SIZE)
+            {
+                snprintf(PrintMsg, sizeof(PrintMsg), "Sample transfer refused: %d bytes do not fit the flash user space.\r\n",
+                         Status.Size);
+            }
+            else if (Status.Failure == DL_FAIL_WRITER)
+            {
+                snprintf(PrintMsg, sizeof(PrintMsg), "Sample transfer failed: flash writer error after %d samples.\r\n",
+                         Status.Received);
+            }
+            else
+            {
+                snprintf(PrintMsg, sizeof(PrintMsg), "Sample transfer failed: block retries exhausted after %d samples.\r\n",
+                         Status.Received);
+            }
+            RespondValue(RSP_EVENT, icmdFlashGetData, RSP_ERR_FAILED, Status.Received, PrintMsg);
+            break;
+
+        case DL_EVT_COMPLETE:
+            FlashWriterStatsGet(&FlashStats);
+            if (CompactResponses)
+            {
+                Values[0] = Status.Received;
+                Values[1] = Status.Size;
+                Values[2] = Status.Crc;
+                Values[3] = Status.Verified;
+                Values[4] = Status.Retries;
+                Values[5] = Status.ReadbackErrors;
+                Values[6] = Status.CompressedBytes;
+                Values[7] = FlashStats.Stalls;
+                Respond(RSP_EVENT, icmdFlashGetData, (Status.Legacy || Status.Verified) ? RSP_OK : RSP_ERR_FAILED,
+                        Values, 8, 0);
+            }
+            else
+            {
+                // Indicate that the sample reception has completed
+                UARTStrPut("Sample Received.\r\n");
+
+                if (Status.Legacy)
+                {
+                    UARTStrPut("Sensor does not send block CRCs, sample NOT verified.\r\n");
+                }
+                else
+                {
+                    snprintf(PrintMsg, sizeof(PrintMsg), "Length %08X CRC32 %08X, trailer %08X/%08X, %d retries, %d read-back errors: %s\r\n",
+                             Status.Size, Status.Crc, Status.TrailerLength, Status.TrailerCrc, Status.Retries,
+                             Status.ReadbackErrors, Status.Verified ? "VERIFIED" : "MISMATCH");
+                    UARTStrPut(PrintMsg);
+                }
+
+                // Report how well flash kept up with the transfer
+                snprintf(PrintMsg, sizeof(PrintMsg), "Flash Writer: %d pages, max queue %d, stalls %d, errors %d\r\n",
+                         FlashStats.PagesWritten, FlashStats.MaxQueueDepth, FlashStats.Stalls, FlashStats.Errors);
+                UARTStrPut(PrintMsg);
+
+                if (Status.CompressedBytes)
+                {
+                    snprintf(PrintMsg, sizeof(PrintMsg), "Compressed %d samples into %d bytes.\r\n",
+                             Status.Received, Status.CompressedBytes);
+                    UARTStrPut(PrintMsg);
+                }
+            }
+
+            // Count the recording in the flash-resident parameters
+            if (Status.Received)
+            {
+                Params = FlashParamsGet();
+                Params->RecordingSeq++;
+                Params->LastSampleSize = Status.Size;
+                Params->LastSampleCrc = Status.Crc;
+                FlashParamsSave();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+//*****************************************************************************
+//
+// CrashCheckpoint: Crash dump hook; saves what a warm restart needs to resume
+// an interrupted download. It runs in the fault or watchdog handler, so it
+// only reads RAM
+//
+// \param App:      Application words of the crash record
+//
+//*****************************************************************************
+
+void CrashCheckpoint(uint32_t *App)
+{
+    RecoveryState *State = (RecoveryState *)App;
+
+    SampleDownloadCheckpointGet(&State->Download);
+    State->Module = CAN_MODULES[0].ID;
+}
+
+//*****************************************************************************
+//
+// CrashReport: Prints a crash record: cause, task, registers, fault status
+// and, in text mode, the trace of the events that led to it
+//
+// \param Flags:    RSP_REPLY or RSP_EVENT
+// \param Record:   The crash record
+//
+//*****************************************************************************
+
+void CrashReport(uint32_t Flags, const CrashRecord *Record)
+{
+    static const char *Events[] = { "?", "command", "CAN tx", "CAN rx", "clock" };
+    const CrashTraceEntry *Entry;
+    uint32_t Values[11], lop;
+
+    snprintf(PrintMsg, sizeof(PrintMsg), "Crash %d: %s in %s task at %d ms, PC %08X LR %08X xPSR %08X, "
+             "CFSR %08X HFSR %08X MMFAR %08X BFAR %08X\r\n",
+             Record->Count, (Record->Cause == CRASH_CAUSE_WATCHDOG) ? "watchdog" : "fault",
+             (Record->Task < TASK_COUNT) ? TaskNames[Record->Task] : "?", Record->UptimeMS,
+             Record->Frame[CRASH_FRAME_PC], Record->Frame[CRASH_FRAME_LR], Record->Frame[CRASH_FRAME_PSR],
+             Record->Cfsr, Record->Hfsr, Record->Mmfar, Record->Bfar);
+    Values[0] = Record->Cause;
+    Values[1] = Record->Task;
+    Values[2] = Record->UptimeMS;
+    Values[3] = Record->Frame[CRASH_FRAME_PC];
+    Values[4] = Record->Frame[CRASH_FRAME_LR];
+    Values[5] = Record->Frame[CRASH_FRAME_PSR];
+    Values[6] = Record->Cfsr;
+    Values[7] = Record->Hfsr;
+    Values[8] = Record->Mmfar;
+    Values[9] = Record->Bfar;
+    Values[10] = Record->Count;
+    Respond(Flags, icmdCrashDump, RSP_OK, Values, 11, PrintMsg);
+
+    if (CompactResponses)
+    {
+        return;
+    }
+
+    // The trace, oldest event first
+    for (lop = 0; lop < CRASH_TRACE_DEPTH; lop++)
+    {
+        Entry = &Record->Trace[lop];
+        if (Entry->Event == 0)
+        {
+            continue;
+        }
+        snprintf(PrintMsg, sizeof(PrintMsg), "  %d ms: %s %d %05X\r\n", Entry->TimeMS,
+                 (CRASH_EVENT_TYPE(Entry->Event) <= CRASH_EVT_CLOCK) ? Events[CRASH_EVENT_TYPE(Entry->Event)] : "?",
+                 CRASH_EVENT_CODE(Entry->Event), CRASH_EVENT_VALUE(Entry->Event));
+        UARTStrPut(PrintMsg);
+    }
+}
+
+//*****************************************************************************
+//
+// CrashRecover: Reports the crash that caused this boot and resumes the raw
+// download it interrupted from the last block that made it to flash; the
+// record is marked handled so later boots do not act on it again
+//
+//*****************************************************************************
+
+void CrashRecover(void)
+{
+    RecoveryState *State = (RecoveryState *)LastCrash.App;
+    uint32_t Block;
+
+    CrashRecordHandled();
+    CrashReport(RSP_EVENT, &LastCrash);
+
+    if (State->Download.Size == 0)
+    {
+        return;
+    }
+
+    // A download that keeps crashing the board is not resumed again
+    if (LastCrash.Count > CrashMaxResumes)
+    {
+        RespondValue(RSP_EVENT, icmdFlashGetData, RSP_ERR_FAILED, LastCrash.Count,
+                     "Download not resumed after repeated crashes; clear the crash dump (36) and start it again.\r\n");
+        return;
+    }
+    SampleDownloadConfig(FlashUserSpace, FlashUserEnd, false);
+    if (SampleDownloadResume(&State->Download, &Block) != DL_EVT_STARTED)
+    {
+        RespondValue(RSP_EVENT, icmdFlashGetData, RSP_ERR_FAILED, 0,
+                     "Download could not be resumed, the recording in flash does not match; start it again.\r\n");
+        return;
+    }
+
+    snprintf(PrintMsg, sizeof(PrintMsg), "Resuming download at block %d.\r\n", Block);
+    RespondValue(RSP_EVENT, icmdFlashGetBlock, RSP_OK, Block, PrintMsg);
+    DownloadReport(DL_EVT_STARTED);
+    RecordingModule = State->Module;
+}
+
+//*****************************************************************************
+//
+// SendMenu: Displays the main menu over the UART interface; shows the current
+// system status, detected CAN modules, and a list of available commands
+//
+//*****************************************************************************
+void SendMenu(void)
+{
+    // Send a welcome message indicating the sensor controller is online
+    UARTStrPut("\r\nInkley Sensor Controller Online.\r\n");
+    UARTStrPut("\r\n");
+
+    // Display the host clock speed in MHz
+    snprintf(PrintMsg, sizeof(PrintMsg), "\r\nHost Clock: %d MHZ \r\n", SystemClockSpeed / 1000000);
+    UARTStrPut(PrintMsg);
+
+    // If a CAN module has been detected, display its ID
+    if (CAN_MODULES[0].ID > 0)
+    {
+        snprintf(PrintMsg, sizeof(PrintMsg), "Detected Module: %04X\r\n", CAN_MODULES[0].ID);
+        UARTStrPut(PrintMsg);
+        CANLastDetected = CAN_MODULES[0].ID;  // Update the last detected CAN module ID
+    }
+
+    // Prompt the user to type a command and press enter
+    UARTStrPut("\r\nType command # and press enter.\r\n");
+    UARTStrPut("Or type named commands separated by ';' (help lists them).\r\n\r\n");
+
+    // Display the list of available commands
+    UARTStrPut("\r\nCommands:\r\n");
+    UARTStrPut("1 - Read Version\r\n");
+    UARTStrPut("2 - Sensor Read Data\r\n");
+    UARTStrPut("3 - Start recording sensor data to flash memory\r\n");
+    UARTStrPut("4 - Read Flash at position\r\n");
+    UARTStrPut("5 - Erase Flash\r\n");
+    UARTStrPut("6 - Set flash memory sample size\r\n");
+    UARTStrPut("7 - Get flash memory status\r\n");
+    UARTStrPut("8 - Get flash memory sample.\r\n");
+    UARTStrPut("9 - Generate a CSV file from flash memory sample.\r\n");
+    UARTStrPut("10 - Dump flash memory sample as binary.\r\n");
+    snprintf(PrintMsg, sizeof(PrintMsg), "11 - Toggle sample compression (currently %s).\r\n",
+             SampleCompression ? "ON" : "OFF");
+    UARTStrPut(PrintMsg);
+    UARTStrPut("16 - Show boot and recording counters.\r\n");
+    snprintf(PrintMsg, sizeof(PrintMsg), "17 - Toggle CAN + SMBus data log (currently %s).\r\n",
+             DataLogging ? "ON" : "OFF");
+    UARTStrPut(PrintMsg);
+    UARTStrPut("18 - Record local ADC input to flash memory.\r\n");
+    UARTStrPut("19 - Arm triggered capture on local ADC comparator.\r\n");
+    UARTStrPut("20 - Arm triggered capture on CAN sensor threshold.\r\n");
+    snprintf(PrintMsg, sizeof(PrintMsg), "21 - Toggle ADC low-pass + %dx decimation (currently %s).\r\n",
+             AdcDecimation, AdcFiltering ? "ON" : "OFF");
+    UARTStrPut(PrintMsg);
+    snprintf(PrintMsg, sizeof(PrintMsg), "22 - Toggle live statistics monitor (currently %s).\r\n",
+             StatsMonitoring ? "ON" : "OFF");
+    UARTStrPut(PrintMsg);
+    UARTStrPut("23 - Show live statistics.\r\n");
+    UARTStrPut("24 - Spectrum peaks of the flash recording.\r\n");
+    UARTStrPut("25 - Spectrum peaks of the live ADC input.\r\n");
+    UARTStrPut("26 - Benchmark math routines and formatter (CPU cycles).\r\n");
+    UARTStrPut("27 - Set calibration of the detected module.\r\n");
+    snprintf(PrintMsg, sizeof(PrintMsg), "28 - Toggle compact JSON responses (currently %s).\r\n",
+             CompactResponses ? "ON" : "OFF");
+    UARTStrPut(PrintMsg);
+    snprintf(PrintMsg, sizeof(PrintMsg), "29 - Toggle live streaming of sensor readings (currently %s).\r\n",
+             Streaming ? "ON" : "OFF");
+    UARTStrPut(PrintMsg);
+    snprintf(PrintMsg, sizeof(PrintMsg), "30 - Toggle binary stream records (currently %s).\r\n",
+             StreamBinary ? "ON" : "OFF");
+    UARTStrPut(PrintMsg);
+    UARTStrPut("31 - Show stack high-water mark.\r\n");
+    UARTStrPut("32 - Burst capture into SRAM, then to flash memory.\r\n");
+    UARTStrPut("33 - Burst capture into SRAM, then to the UART.\r\n");
+    snprintf(PrintMsg, sizeof(PrintMsg), "34 - Toggle low-power idle (currently %s).\r\n",
+             LowPowerIdle ? "ON" : "OFF");
+    UARTStrPut(PrintMsg);
+    snprintf(PrintMsg, sizeof(PrintMsg), "35 - Toggle 16 MHz idle clock profile (currently %s).\r\n",
+             ClockScaling ? "ON" : "OFF");
+    UARTStrPut(PrintMsg);
+    UARTStrPut("36 - Show and clear the last crash dump.\r\n");
+
+    // Display a prompt (>) for user input
+    UARTStrPut("\r\n\r\n");
+    UARTBytePut('>');
+}
+
+//*****************************************************************************
+//
+// UARTClearScreen: Clears the terminal screen and resets the cursor position
+// using ANSI escape codes; this function is useful for clearing previous output
+//
+//*****************************************************************************
+void UARTClearScreen(void)
+{
+    char clrBuf[10];
+
+    // Clear the screen using the ANSI escape sequence (ESC[2J)
+    snprintf(clrBuf, sizeof(clrBuf), "%c[2J", 0x1b);     // 0x1b is the ASCII code for ESC
+    UARTStrPut(clrBuf);
+
+    // Move the cursor back to the top-left corner (row 0, column 0) using the
+    // ANSI escape sequence (ESC[0;0H)
+    snprintf(clrBuf, sizeof(clrBuf), "%c[0;0H", 0x1b);   // Reset cursor to the home position
+    UARTStrPut(clrBuf);
+}
+
+//*****************************************************************************
+//
+// CommandExecute: Runs one menu/I2C command
+//
+// \param Command:  The command ID (icmd*)
+// \param Param:    Command parameter, used if HasParam is set
+// \param HasParam: false to prompt for the parameter over the UART
+//
+//*****************************************************************************
+
+void CommandExecute(uint32_t Command, uint32_t Param, bool HasParam)
+{
+    uint32_t lop;                   // Auxiliary loop counter
+    uint32_t Flash_Data;            // Data for flash memory operations
+    SampleReader FlashReader;       // Reader over the local (raw or compressed) recording
+    char CSV_Line[255];             // Buffer for CSV-formatted output
+    FlashParams *Params;            // Flash-resident boot/recording counters
+    TelemetryStats Telemetry;       // SMBus telemetry statistics
+    uint32_t Values[8];             // Values of a compact response record
+    StackUsage Stack;               // Stack high-water mark
+
+    //*****************************************************************************
+    //
+    // UART Command Processing: Handles user commands entered via UART. Commands
+    // are processed and mapped to corresponding CAN messages sent to the sensor
+    // module. Includes extended functionality for retrieving flash data and
+    // generating CSV files.
+    //
+    // - icmdReadVersion: Requests the firmware version from the sensor module.
+    // - icmdReadData: Requests the latest sensor data sample.
+    // - icmdFlashStart: Initiates recording of sensor data to flash memory.
+    // - icmdFlashReadPos: Retrieves the current read position in flash memory.
+    // - icmdFlashEraseFull: Erases all flash memory data.
+    // - icmdFlashSetSampleSize: Configures the flash memory sample size.
+    // - icmdFlashStatus: Queries the status of flash memory operations.
+    // - icmdFlashGetData: Retrieves stored flash memory samples.
+    // - icmdFlashGenCSV: Generates CSV-formatted output from flash data.
+    //
+    // Each command triggers the corresponding CAN message, and the sensor module
+    // responds with relevant data or an acknowledgment. Additional functionality
+    // like CSV generation adds utility for data export.
+    //
+    //****************************************************************************
+
+    // Commands, captures and exports run at the full clock
+    CrashTrace(CRASH_EVENT(CRASH_EVT_COMMAND, Command, Param));
+    ClockFull();
+
+    switch (Command)
+    {
+        case icmdReadVersion:           // Read Version Command
+            SensorCommandIssue(icmdReadVersion, 0, "Requesting Version from sensor module. \r\n");
+            break;
+
+        case icmdReadData:              // Read Sensor Data Command
+            SensorCommandIssue(icmdReadData, 0, "Reading Sensor Data. \r\n");
+            break;
+
+        case icmdFlashStart:            // Start Recording to Flash Command
+            SensorCommandIssue(icmdFlashStart, 0, "Getting FLASH memory status. \r\n");
+            break;
+
+        case icmdFlashReadPos:          // Read Flash Memory at Position Command
+            SensorCommandIssue(icmdFlashReadPos, 0, "Reading FLASH memory data. \r\n");
+            break;
+
+        case icmdFlashEraseFull:        // Erase Flash Memory Command
+            SensorCommandIssue(icmdFlashEraseFull, 0, "Erasing FLASH memory. \r\n");
+            break;
+
+        case icmdFlashSetSampleSize:    // Set Flash Sample Size Command
+            if (!HasParam)
+            {
+                UARTStrPut("Setting Sample size. Enter Value in HEX. Default is 0x10000. \r\n");
+                Param = strtoul(UARTStrGet(), NULL, 0);
+            }
+            SensorCommandIssue(icmdFlashSetSampleSize, Param, "Setting Sample size. \r\n");
+            break;
+
+        case icmdFlashStatus:           // Get Flash Memory Status Command
+            SensorCommandIssue(icmdFlashStatus, 0, "Getting FLASH memory status... \r\n");
+            break;
+
+        case icmdFlashGetData:          // Retrieve Flash Memory Samples
+            SampleDownloadConfig(FlashUserSpace, FlashUserEnd, SampleCompression);
+            SensorCommandIssue(icmdFlashGetData, 0, "Requesting flash memory samples from sensor module. \r\n");
+            break;
+
+        case icmdFlashGenCSV:           // Generate CSV from Flash Data
+            GlobalTimer = 0;
+            UARTStrPut("CSV BEGIN:\r\n\r\n\r\n");
+
+            // Add column headers to the CSV output; calibrated recordings carry their unit
+            if (CalibrationSelect(RecordingModule))
+            {
+                snprintf(CSV_Line, sizeof(CSV_Line), "TimeStamp,Pressure_%s\r\n", CAL_UNIT);
+            }
+            else
+            {
+                snprintf(CSV_Line, sizeof(CSV_Line), "TimeStamp,Pressure\r\n");
+            }
+            UARTStrPut(CSV_Line);
+
+            // Loop through the recording to generate rows of CSV data; the reader
+            // decompresses the samples if they were stored compressed
+            SampleReaderInit(&FlashReader, FlashUserSpace, CODEC_WORST_CASE(FlashSampleSize));
+            for (lop = 0; lop < FlashSampleSize / 4; lop++)
+            {
+                if (!SampleReaderNext(&FlashReader, &Flash_Data))           // Read next sample from flash memory
+                {
                     break;
+                }
+                SupervisorKick();                                           // Each line is progress
+                snprintf(CSV_Line, sizeof(CSV_Line), "%d,%d\r\n", GlobalTimer, CalibrationApply(Flash_Data)); // Format as CSV
+                UARTStrPut(CSV_Line);                                       // Send CSV line via UART
+                GlobalTimer++;                                              // Increment timestamp
+            }
+
+            UARTStrPut("\r\n\r\n\r\n CSV END:\r\n");                        // Indicate end of CSV
+            break;
+
+        case icmdFlashGenBin:           // Dump Flash Data as binary
+            // Calibrated samples are signed values in CAL_UNIT, announced ahead of the header
+            if (CalibrationSelect(RecordingModule))
+            {
+                snprintf(CSV_Line, sizeof(CSV_Line), "UNITS: %s\r\n", CAL_UNIT);
+                UARTStrPut(CSV_Line);
+            }
+            snprintf(CSV_Line, sizeof(CSV_Line), "BIN BEGIN: %08X\r\n", FlashSampleSize / 4);    // Announce the sample count
+            UARTStrPut(CSV_Line);
+
+            // Send each (decompressed) sample as 4 little-endian bytes
+            SampleReaderInit(&FlashReader, FlashUserSpace, CODEC_WORST_CASE(FlashSampleSize));
+            for (lop = 0; lop < FlashSampleSize / 4; lop++)
+            {
+                if (!SampleReaderNext(&FlashReader, &Flash_Data))
+                {
+                    Flash_Data = 0xFFFFFFFF;                                // Pad missing samples as erased flash
+                }
+                else
+                {
+                    Flash_Data = (uint32_t)CalibrationApply(Flash_Data);
+                }
+                SupervisorKick();                                           // Each sample is progress
+                UARTBytePut((uint8_t)Flash_Data);
+                UARTBytePut((uint8_t)(Flash_Data >> 8));
+                UARTBytePut((uint8_t)(Flash_Data >> 16));
+                UARTBytePut((uint8_t)(Flash_Data >> 24));
+            }
+
+            UARTStrPut("\r\nBIN END:\r\n");
+            break;
+
+        case icmdFlashCompression:      // Toggle Sample Compression
+            SampleCompression = !SampleCompression;
+            snprintf(CSV_Line, sizeof(CSV_Line), "Sample compression %s.\r\n", SampleCompression ? "enabled" : "disabled");
+            RespondValue(RSP_REPLY, Command, RSP_OK, SampleCompression, CSV_Line);
+            break;
+
+        case icmdParamsShow:            // Show Flash-Resident Counters
+            Params = FlashParamsGet();
+            if (CompactResponses)
+            {
+                Values[0] = Params->BootCount;
+                Values[1] = Params->LastResetCause;
+                Values[2] = Params->RecordingSeq;
+                Values[3] = Params->LastSampleSize;
+                Values[4] = Params->LastSampleCrc;
+                Values[5] = FlashParamsSaveCycles(false) / (SystemClockSpeed / 1000000);
+                Values[6] = FlashParamsSaveCycles(true) / (SystemClockSpeed / 1000000);
+                Respond(RSP_REPLY, Command, RSP_OK, Values, 7, 0);
+                break;
+            }
+            snprintf(CSV_Line, sizeof(CSV_Line), "Boots: %d, last reset cause: %08X\r\n",
+                     Params->BootCount, Params->LastResetCause);
+            UARTStrPut(CSV_Line);
+            snprintf(CSV_Line, sizeof(CSV_Line), "Recordings: %d, last size %08X CRC32 %08X\r\n",
+                     Params->RecordingSeq, Params->LastSampleSize, Params->LastSampleCrc);
+            UARTStrPut(CSV_Line);
+            snprintf(CSV_Line, sizeof(CSV_Line), "Parameter save: last %d us, max %d us\r\n",
+                     FlashParamsSaveCycles(false) / (SystemClockSpeed / 1000000),
+                     FlashParamsSaveCycles(true) / (SystemClockSpeed / 1000000));
+            UARTStrPut(CSV_Line);
+            break;
+
+        case icmdDataLog:               // Toggle Data Log
+            DataLogging = !DataLogging;
+            if (DataLogging)
+            {
+                RespondValue(RSP_REPLY, Command, RSP_OK, 1, "LOG,ms,source,channel,value\r\n");
+                TelemetryStart(TelemetryPeriodMS);
+            }
+            else
+            {
+                TelemetryStop();
+                TelemetryStatsGet(&Telemetry);
+                snprintf(CSV_Line, sizeof(CSV_Line), "SMBus telemetry: %d readings, %d errors, %d PEC errors, %d overruns\r\n",
+                         Telemetry.Readings, Telemetry.Errors, Telemetry.PecErrors, Telemetry.Overruns);
+                Values[0] = 0;
+                Values[1] = Telemetry.Readings;
+                Values[2] = Telemetry.Errors;
+                Values[3] = Telemetry.PecErrors;
+                Values[4] = Telemetry.Overruns;
+                Respond(RSP_REPLY, Command, RSP_OK, Values, 5, CSV_Line);
+            }
+            break;
+
+        case icmdAdcRecord:             // Record Local ADC Input
+            if (AdcRecording || SpectrumLive || SampleDownloadActive() || (TriggerSource != TRIG_SRC_NONE) ||
+                !FlashWriterStart(FlashUserSpace, SampleCompression ? CODEC_WORST_CASE(FlashSampleSize) : FlashSampleSize))
+            {
+                Respond(RSP_REPLY, Command, RSP_ERR_BUSY, 0, 0, "A recording is already in progress. \r\n");
+                break;
+            }
+            SampleEncodeInit(&AdcEncoder, FlashWriterPut);
+            DspPipelineQ15Reset(&AdcFilter);
+            AdcRecorded = 0;
+
+            if (AdcCaptureStart(SystemClockSpeed, AdcSampleRate))
+            {
+                AdcRecording = true;
+                RecordingRate = AdcFiltering ? (AdcSampleRate / AdcDecimation) : AdcSampleRate;
+                RecordingModule = 0;
+                snprintf(CSV_Line, sizeof(CSV_Line), "Recording %d ADC samples at %d Hz (%dx oversampled). \r\n",
+                         FlashSampleSize / 4, RecordingRate, AdcOversample);
+                Values[0] = FlashSampleSize / 4;
+                Values[1] = RecordingRate;
+                Respond(RSP_REPLY, Command, RSP_OK, Values, 2, CSV_Line);
+            }
+            else
+            {
+                FlashWriterSync();
+                Respond(RSP_REPLY, Command, RSP_ERR_ARG, 0, 0, "ADC sample rate exceeds 1 MSPS. \r\n");
+            }
+            break;
+
+        case icmdTriggerAdc:            // Arm Triggered Capture on ADC Comparator
+        case icmdTriggerCan:            // Arm Triggered Capture on CAN Threshold
+            if (AdcRecording || SpectrumLive || (TriggerSource != TRIG_SRC_NONE))
+            {
+                Respond(RSP_REPLY, Command, RSP_ERR_BUSY, 0, 0, "A recording is already in progress. \r\n");
+                break;
+            }
+            TriggerCaptureArm(TriggerPre, TriggerPost);
+
+            if (Command == icmdTriggerAdc)
+            {
+                TriggerCaptureLevelSet(0, 0);
+                AdcCaptureComparatorSet(TriggerAdcLow, TriggerAdcHigh);
+                AdcCaptureStart(SystemClockSpeed, TriggerAdcRate);
+                TriggerSource = TRIG_SRC_ADC;
+            }
+            else
+            {
+                TriggerCaptureLevelSet(TriggerCanLevel, TRIG_EDGE_RISING);
+                TriggerNextPoll = SystemTickMS;
+                TriggerSource = TRIG_SRC_CAN;
+            }
+            snprintf(CSV_Line, sizeof(CSV_Line), "Triggered capture armed: %d pre + %d post samples. \r\n",
+                     TriggerPre, TriggerPost);
+            Values[0] = TriggerPre;
+            Values[1] = TriggerPost;
+            Respond(RSP_REPLY, Command, RSP_OK, Values, 2, CSV_Line);
+            break;
+
+        case icmdAdcFilter:             // Toggle ADC Filtering
+            if (AdcRecording)
+            {
+                Respond(RSP_REPLY, Command, RSP_ERR_BUSY, 0, 0, "A recording is already in progress. \r\n");
+                break;
+            }
+            AdcFiltering = !AdcFiltering;
+            snprintf(CSV_Line, sizeof(CSV_Line), "ADC filtering %s.\r\n", AdcFiltering ? "enabled" : "disabled");
+            RespondValue(RSP_REPLY, Command, RSP_OK, AdcFiltering, CSV_Line);
+            break;
+
+        case icmdStatsMonitor:          // Toggle Live Statistics Monitor
+            StatsMonitoring = !StatsMonitoring;
+            if (StatsMonitoring)
+            {
+                StreamStatsReset(&LiveStats);
+                StatsNextPoll = SystemTickMS;
+            }
+            snprintf(CSV_Line, sizeof(CSV_Line), "Live statistics monitor %s.\r\n",
+                     StatsMonitoring ? "started" : "stopped");
+            RespondValue(RSP_REPLY, Command, RSP_OK, StatsMonitoring, CSV_Line);
+            break;
+
+        case icmdStatsShow:             // Show Live Statistics
+            StatsReport();
+            break;
+
+        case icmdSpectrumFlash:         // Spectrum of the Flash Recording
+            SpectrumRecording();
+            break;
+
+        case icmdSpectrumAdc:           // Spectrum of the Live ADC Input
+            if (AdcRecording || SpectrumLive || (TriggerSource == TRIG_SRC_ADC))
+            {
+                Respond(RSP_REPLY, Command, RSP_ERR_BUSY, 0, 0, "The ADC is already in use. \r\n");
+                break;
+            }
+            SpectrumStart(FFT_MAX_SIZE);
+            SpectrumLive = AdcCaptureStart(SystemClockSpeed, AdcSampleRate);
+            Respond(RSP_REPLY, Command, SpectrumLive ? RSP_OK : RSP_ERR_ARG, 0, 0, 0);
+            break;
+
+        case icmdMathBench:             // Benchmark Math Routines
+            MathBenchmark();
+            break;
+
+        case icmdCalibrationSet:        // Set Calibration of the Detected Module
+            if (CAN_MODULES[0].ID == 0)
+            {
+                Respond(RSP_REPLY, Command, RSP_ERR_FAILED, 0, 0, "No sensor module detected. \r\n");
+                break;
+            }
+            CalibrationUpdate(CAN_MODULES[0].ID);
+            break;
+
+        case icmdResponseMode:          // Toggle Compact Responses
+            CompactResponses = !CompactResponses;
+            RespondValue(RSP_REPLY, Command, RSP_OK, CompactResponses, "Compact responses disabled.\r\n");
+            break;
+
+        case icmdStream:                // Toggle Live Streaming
+            if (Streaming)
+            {
+                Streaming = false;
+                StreamReport();
+                break;
+            }
+            if (RamTarget != RAMF_NONE)
+            {
+                Respond(RSP_REPLY, Command, RSP_ERR_BUSY, 0, 0, "A burst capture is in progress. \r\n");
+                break;
+            }
+            RespondValue(RSP_REPLY, Command, RSP_OK, StreamBinary,
+                         StreamBinary ? "Streaming binary records, type a line to stop.\r\n"
+                                      : "Streaming S,<index>,<ms>,<value> lines, type a line to stop.\r\n");
+            UartStreamStatsClear();
+            StreamIndex = 0;
+            StreamNextPoll = SystemTickMS;
+            Streaming = true;
+            break;
+
+        case icmdStreamFormat:          // Toggle Binary Stream Records
+            if (Streaming)
+            {
+                Respond(RSP_REPLY, Command, RSP_ERR_BUSY, 0, 0, "Stop the stream first. \r\n");
+                break;
+            }
+            StreamBinary = !StreamBinary;
+            snprintf(CSV_Line, sizeof(CSV_Line), "Binary stream records %s.\r\n", StreamBinary ? "enabled" : "disabled");
+            RespondValue(RSP_REPLY, Command, RSP_OK, StreamBinary, CSV_Line);
+            break;
+
+        case icmdRamCaptureFlash:       // Burst Capture into SRAM, then Flash
+        case icmdRamCaptureUart:        // Burst Capture into SRAM, then UART
+            // Running the command again ends a burst early
+            if ((RamCaptureState() == RCAP_RECORDING) &&
+                (RamTarget == ((Command == icmdRamCaptureFlash) ? RAMF_FLASH : RAMF_UART)))
+            {
+                RamCaptureStop();
+                break;
+            }
+            if ((RamTarget != RAMF_NONE) || AdcRecording || SampleDownloadActive() || Streaming || StatsMonitoring ||
+                (TriggerSource != TRIG_SRC_NONE) || !RamCaptureStart(FlashSampleSize / 4))
+            {
+                Respond(RSP_REPLY, Command, RSP_ERR_BUSY, 0, 0, "A recording is already in progress. \r\n");
+                break;
+            }
+            RamTarget = (Command == icmdRamCaptureFlash) ? RAMF_FLASH : RAMF_UART;
+            RamStartTime = SystemTickMS;
+            RamPollTime = SystemTickMS;
+            SensorCommandSend(icmdReadData, 0);
+            snprintf(CSV_Line, sizeof(CSV_Line), "Burst capture of up to %d samples (%d fit in SRAM). \r\n",
+                     FlashSampleSize / 4, RamCaptureCapacity());
+            Values[0] = FlashSampleSize / 4;
+            Values[1] = RamCaptureCapacity();
+            Respond(RSP_REPLY, Command, RSP_OK, Values, 2, CSV_Line);
+            break;
+
+        case icmdStackUsage:            // Show Stack High-Water Mark
+            StackUsageGet(&Stack);
+            snprintf(CSV_Line, sizeof(CSV_Line), "Stack: %d of %d bytes used at most, %d now%s\r\n",
+                     Stack.HighWater, Stack.Size, Stack.Current, Stack.Overflowed ? ", OVERFLOWED" : "");
+            Values[0] = Stack.HighWater;
+            Values[1] = Stack.Size;
+            Values[2] = Stack.Current;
+            Respond(RSP_REPLY, Command, Stack.Overflowed ? RSP_ERR_FAILED : RSP_OK, Values, 3, CSV_Line);
+            break;
+
+        case icmdLowPowerIdle:          // Toggle Low-Power Idle
+            if (LowPowerIdle)
+            {
+                IdleReport();
+                LowPowerIdle = false;
+            }
+            else
+            {
+                IdleStatsClear();
+                IdleStatsStart = SystemTickMS;
+                LowPowerIdle = true;
+                RespondValue(RSP_REPLY, Command, RSP_OK, 1, "Low-power idle enabled.\r\n");
+            }
+            IdleEnable(LowPowerIdle);
+            break;
+
+        case icmdClockScaling:          // Toggle Clock Scaling
+            if (ClockScaling)
+            {
+                ClockReport();
+                ClockScaling = false;
+            }
+            else
+            {
+                ClockStatsClear(SystemTickMS);
+                ClockScaling = true;
+                RespondValue(RSP_REPLY, Command, RSP_OK, 1, "Clock scaling enabled.\r\n");
+            }
+            break;
+
+        case icmdCrashDump:             // Show and Clear the Crash Dump
+            if (CrashRecordGet(&LastCrash))
+            {
+                CrashReport(RSP_REPLY, &LastCrash);
+                CrashRecordClear();
+            }
+            else
+            {
+                RespondValue(RSP_REPLY, Command, RSP_OK, 0, "No crash recorded.\r\n");
+            }
+            break;
+
+        default:                        // Unknown Command
+            UARTClearScreen();          // Clear the screen
+            SendMenu();                 // Re-display the menu
+            break;
+    }
+}
+
+//*****************************************************************************
+//
+// CommandLine: Runs a line typed on the UART; a number selects a menu entry,
+// anything else starts a batch of named commands. A new line abandons a batch
+// that is still running
+//
+// \param Line:     The received line (terminated by '\r' or '\n')
+//
+//*****************************************************************************
+
+void CommandLine(char *Line)
+{
+    char *End;
+
+    // The receive buffer is not terminated; cut it at the line end
+    for (End = Line; (*End != '\r') && (*End != '\n'); End++)
+    {
+    }
+    *End = 0;
+
+    // Any line typed while streaming ends the stream first
+    if (Streaming)
+    {
+        CommandExecute(icmdStream, 0, false);
+    }
+
+    if (BatchActive())
+    {
+        BatchAbort();
+        Respond(RSP_REPLY, RSP_CMD_LINE, RSP_ERR_FAILED, 0, 0, "ERROR: batch aborted\r\n");
+    }
+
+    // The end of an overlong line was dropped by UARTStrGet; do not run the rest
+    if (RcvTooLong)
+    {
+        Respond(RSP_REPLY, RSP_CMD_LINE, RSP_ERR_ARG, 0, 0, "ERROR: line too long\r\n");
+        return;
+    }
+
+    while (*Line == ' ')
+    {
+        Line++;
+    }
+    if ((*Line == 0) || ((*Line >= '0') && (*Line <= '9')))
+    {
+        CommandExecute(strtoul(Line, NULL, 0), 0, false);
+    }
+    else if (!BatchStart(Line))
+    {
+        Respond(RSP_REPLY, RSP_CMD_LINE, RSP_ERR_ARG, 0, 0, "ERROR: command line too long\r\n");
+    }
+}
+
+//*****************************************************************************
+//
+// CommandBatchPoll: Runs the next command of a batch and reports how the batch
+// ends; a batch prints DONE, or ERROR and the failing command
+//
+//*****************************************************************************
+
+void CommandBatchPoll(void)
+{
+    static const char *Errors[] = { "failed", "unknown command", "too many arguments",
+                                    "too few arguments", "invalid argument" };
+    int Status = 0;
+
+    switch (BatchPoll(SystemTickMS, &Status))
+    {
+        case BATCH_EVT_COMMAND:
+            if (Status < 0)
+            {
+                BatchAbort();
+                snprintf(PrintMsg, sizeof(PrintMsg), "ERROR: %s: %s\r\n", BatchCommand(),
+                         Errors[(-Status < (int)(sizeof(Errors) / sizeof(Errors[0]))) ? -Status : 0]);
+                Respond(RSP_REPLY, RSP_CMD_LINE, (Status == CMDLINE_BAD_CMD) ? RSP_ERR_UNKNOWN : RSP_ERR_ARG, 0, 0,
+                        PrintMsg);
+            }
+            break;
+
+        case BATCH_EVT_TIMEOUT:
+            snprintf(PrintMsg, sizeof(PrintMsg), "ERROR: %s: timeout\r\n", BatchCommand());
+            Respond(RSP_REPLY, RSP_CMD_LINE, RSP_ERR_TIMEOUT, 0, 0, PrintMsg);
+            break;
+
+        case BATCH_EVT_DONE:
+            Respond(RSP_REPLY, RSP_CMD_LINE, RSP_OK, 0, 0, "DONE\r\n");
+            break;
 
-                case icmdFlashGenCSV:           // Generate CSV from Flash Data
-                    GlobalTimer = 0;
-                    UARTStrPut("CSV BEGIN:\r\n\r\n\r\n");
+        default:
+            break;
+    }
+}
 
-                    // Add column headers to the CSV output
-                    sprintf(CSV_Line, "TimeStamp,Pressure\r\n");
-                    UARTStrPut(CSV_Line);
+//*****************************************************************************
+//
+// IdleDue: Brings a sleep deadline forward to a scheduled poll
+//
+// \param Deadline: Deadline so far in ms from now
+// \param DueMS:    Time the poll is due
+//
+// \return The earlier of the two, 0 if the poll is already due
+//
+//*****************************************************************************
 
-                    // Loop through flash memory to generate rows of CSV data
-                    for (lop = FlashUserSpace; lop <= FlashUserSpace + FlashSampleSize; lop += 4)
-                    {
-                        Flash_Data = *((uint32_t *)lop);                            // Read data from flash memory
-                        sprintf(CSV_Line, "%d,%d\r\n", GlobalTimer, Flash_Data);    // Format as CSV
-                        UARTStrPut(CSV_Line);                                       // Send CSV line via UART
-                        GlobalTimer++;                                              // Increment timestamp
-                    }
+uint32_t IdleDue(uint32_t Deadline, uint32_t DueMS)
+{
+    uint32_t Left = ((int32_t)(DueMS - SystemTickMS) > 0) ? (DueMS - SystemTickMS) : 0;
 
-                    UARTStrPut("\r\n\r\n\r\n CSV END:\r\n");                        // Indicate end of CSV
-                    break;
+    return (Left < Deadline) ? Left : Deadline;
+}
 
-                default:                        // Unknown Command
-                    UARTClearScreen();          // Clear the screen
-                    SendMenu();                 // Re-display the menu
-                    break;
+//*****************************************************************************
+//
+// MainLoopDeadline: IdleSleep callback; how long the main loop may sleep.
+// Typed lines, I2C frames and CAN responses wake it by interrupt, as do ADC
+// blocks, flash programming and UART transfers, so only the polls that are
+// due at a set time (sensor polls, telemetry rounds) and the work checked on
+// every tick limit the sleep
+//
+// \return ms until the next poll, 0 = run the loop again now
+//
+//*****************************************************************************
+
+uint32_t MainLoopDeadline(void)
+{
+    uint32_t Deadline;
+
+    // Work already waiting, or a batch ready for its next command
+    if (UARTHasData() || I2CSlaveCommandWaiting() || bit_check(CAN_RECV.FLAGS, CAN_F_NEW) ||
+        bit_check(CAN_RECV.FLAGS, CAN_F_OVERRUN) || (BatchActive() && !BatchWaiting()))
+    {
+        return 0;
+    }
+
+    Deadline = TelemetryNextDue(SystemTickMS);
+
+    // Batch waits, local ADC captures and burst flushes are checked on every tick
+    if (BatchActive() || AdcRecording || SpectrumLive || (TriggerSource == TRIG_SRC_ADC) ||
+        ((RamTarget != RAMF_NONE) && (RamCaptureState() != RCAP_RECORDING)))
+    {
+        Deadline = (Deadline < 1) ? Deadline : 1;
+    }
+
+    // CAN sensor polls; a triggered capture on CAN serves the monitor and the
+    // stream, and the monitor serves the stream
+    if (TriggerSource == TRIG_SRC_CAN)
+    {
+        Deadline = IdleDue(Deadline, TriggerNextPoll);
+    }
+    else if (StatsMonitoring)
+    {
+        Deadline = IdleDue(Deadline, StatsNextPoll);
+    }
+    else if (Streaming)
+    {
+        Deadline = IdleDue(Deadline, StreamNextPoll);
+    }
+    if ((RamTarget != RAMF_NONE) && (RamCaptureState() == RCAP_RECORDING))
+    {
+        Deadline = IdleDue(Deadline, RamPollTime + RamRetryMS);
+    }
+
+    return Deadline;
+}
+
+//*****************************************************************************
+//
+// CommandsIdle: Batch wait condition; true once the sensor has answered the
+// last command and no local recording, capture or transfer is running
+//
+//*****************************************************************************
+
+bool CommandsIdle(void)
+{
+    return (SensorPending == 0) && !SampleDownloadActive() && !AdcRecording && !SpectrumLive &&
+           (TriggerSource == TRIG_SRC_NONE) && (RamTarget == RAMF_NONE);
+}
+
+//*****************************************************************************
+//
+// ClockPoll: Keeps the full clock profile while a capture, transfer, monitor,
+// stream or batch runs, and drops to the idle profile once nothing has needed
+// it for ClockIdleMS
+//
+//*****************************************************************************
+
+void ClockPoll(void)
+{
+    if (!CommandsIdle() || Streaming || StatsMonitoring || BatchActive() || FlashWriterBusy())
+    {
+        ClockFull();
+    }
+    else if (ClockScaling && ((SystemTickMS - ClockBusyTime) >= ClockIdleMS) &&
+             (ClockProfileGet() != CLK_PROFILE_IDLE))
+    {
+        CrashTrace(CRASH_EVENT(CRASH_EVT_CLOCK, 0, CLK_PROFILE_IDLE));
+        ClockProfileSet(CLK_PROFILE_IDLE, SystemTickMS);
+    }
+}
+
+//*****************************************************************************
+//
+// Named Commands: Handlers for g_psCmdTable; each checks its arguments and
+// runs the matching menu command through CommandExecute
+//
+// \return 0, or a CMDLINE_* error that abandons the batch
+//
+//*****************************************************************************
+
+// Menu commands reachable by name
+typedef struct {
+    const char *Name;               // Command name (argv[0])
+    const char *Arg;                // Argument selecting this command, 0 = none
+    bool *State;                    // Flag of an on/off command, 0 = not a toggle
+    uint32_t Command;               // Menu command ID
+} NamedCommand;
+
+static const NamedCommand NamedCommands[] = {
+    { "version",  0,       0,                  icmdReadVersion },
+    { "read",     0,       0,                  icmdReadData },
+    { "start",    0,       0,                  icmdFlashStart },
+    { "pos",      0,       0,                  icmdFlashReadPos },
+    { "erase",    0,       0,                  icmdFlashEraseFull },
+    { "status",   0,       0,                  icmdFlashStatus },
+    { "get",      0,       0,                  icmdFlashGetData },
+    { "dump",     "csv",   0,                  icmdFlashGenCSV },
+    { "dump",     "bin",   0,                  icmdFlashGenBin },
+    { "compress", 0,       &SampleCompression, icmdFlashCompression },
+    { "params",   0,       0,                  icmdParamsShow },
+    { "log",      0,       &DataLogging,       icmdDataLog },
+    { "adc",      0,       0,                  icmdAdcRecord },
+    { "trigger",  "adc",   0,                  icmdTriggerAdc },
+    { "trigger",  "can",   0,                  icmdTriggerCan },
+    { "filter",   0,       &AdcFiltering,      icmdAdcFilter },
+    { "fft",      "flash", 0,                  icmdSpectrumFlash },
+    { "fft",      "adc",   0,                  icmdSpectrumAdc },
+    { "bench",    0,       0,                  icmdMathBench },
+    { "compact",  0,       &CompactResponses,  icmdResponseMode },
+    { "stream",   0,       &Streaming,         icmdStream },
+    { "binary",   0,       &StreamBinary,      icmdStreamFormat },
+    { "stack",    0,       0,                  icmdStackUsage },
+    { "burst",    "flash", 0,                  icmdRamCaptureFlash },
+    { "burst",    "uart",  0,                  icmdRamCaptureUart },
+    { "sleep",    0,       &LowPowerIdle,      icmdLowPowerIdle },
+    { "clock",    0,       &ClockScaling,      icmdClockScaling },
+    { "crash",    0,       0,                  icmdCrashDump }
+};
+
+// Runs the menu command named by argv[0] (and argv[1]); on/off commands only
+// toggle if the state differs
+int CmdNamed(int argc, char *argv[])
+{
+    const NamedCommand *Named;
+    uint32_t lop;
+    int Result = CMDLINE_BAD_CMD;
+
+    for (lop = 0; lop < (sizeof(NamedCommands) / sizeof(NamedCommands[0])); lop++)
+    {
+        Named = &NamedCommands[lop];
+        if (strcmp(argv[0], Named->Name))
+        {
+            continue;
+        }
+
+        if (Named->Arg)
+        {
+            if (argc < 2)
+            {
+                return CMDLINE_TOO_FEW_ARGS;
+            }
+            Result = CMDLINE_INVALID_ARG;
+            if (strcmp(argv[1], Named->Arg))
+            {
+                continue;
+            }
+        }
+        if (argc > ((Named->Arg || Named->State) ? 2 : 1))
+        {
+            return CMDLINE_TOO_MANY_ARGS;
+        }
+
+        if (Named->State && (argc == 2))
+        {
+            if (strcmp(argv[1], "on") && strcmp(argv[1], "off"))
+            {
+                return CMDLINE_INVALID_ARG;
+            }
+            if (*Named->State == !strcmp(argv[1], "on"))
+            {
+                return 0;
             }
         }
+        CommandExecute(Named->Command, 0, false);
+        return 0;
+    }
+    return Result;
+}
+
+// size <bytes>: Sets the sensor sample size
+int CmdSize(int argc, char *argv[])
+{
+    char *End;
+    uint32_t Size;
+
+    if (argc != 2)
+    {
+        return (argc < 2) ? CMDLINE_TOO_FEW_ARGS : CMDLINE_TOO_MANY_ARGS;
+    }
+    Size = strtoul(argv[1], &End, 0);
+    if ((End == argv[1]) || (*End != 0))
+    {
+        return CMDLINE_INVALID_ARG;
+    }
+    CommandExecute(icmdFlashSetSampleSize, Size, true);
+    return 0;
+}
+
+// stats [on|off]: Starts/stops the live statistics monitor; without an argument shows the statistics
+int CmdStats(int argc, char *argv[])
+{
+    if (argc == 1)
+    {
+        CommandExecute(icmdStatsShow, 0, false);
+        return 0;
+    }
+    if (argc > 2)
+    {
+        return CMDLINE_TOO_MANY_ARGS;
+    }
+    if (strcmp(argv[1], "on") && strcmp(argv[1], "off"))
+    {
+        return CMDLINE_INVALID_ARG;
+    }
+    if (StatsMonitoring != !strcmp(argv[1], "on"))
+    {
+        CommandExecute(icmdStatsMonitor, 0, false);
+    }
+    return 0;
+}
+
+// cal c0 [c1 [c2 [c3]]] | cal clear: Sets the calibration of the detected module
+int CmdCal(int argc, char *argv[])
+{
+    FixPoly Poly;
+    char *End;
+    int lop;
+
+    if (argc < 2)
+    {
+        return CMDLINE_TOO_FEW_ARGS;
+    }
+    if (argc > (FIX_POLY_MAX_ORDER + 2))
+    {
+        return CMDLINE_TOO_MANY_ARGS;
+    }
+    if (CAN_MODULES[0].ID == 0)
+    {
+        Respond(RSP_REPLY, icmdCalibrationSet, RSP_ERR_FAILED, 0, 0, "No sensor module detected. \r\n");
+        return 0;
+    }
+    if ((argc == 2) && !strcmp(argv[1], "clear"))
+    {
+        CalibrationStore(CAN_MODULES[0].ID, 0);
+        return 0;
+    }
+
+    for (lop = 1; lop < argc; lop++)
+    {
+        Poly.Coeffs[lop - 1] = (float)strtod(argv[lop], &End);
+        if ((End == argv[lop]) || (*End != 0))
+        {
+            return CMDLINE_INVALID_ARG;
+        }
+    }
+    Poly.Order = argc - 2;
+    CalibrationStore(CAN_MODULES[0].ID, &Poly);
+    return 0;
+}
+
+// wait done [ms] | wait <ms>: Holds the batch until idle (or timeout), or for a time
+int CmdWait(int argc, char *argv[])
+{
+    char *End;
+    uint32_t Time = BatchWaitMS;
+
+    if (argc < 2)
+    {
+        return CMDLINE_TOO_FEW_ARGS;
+    }
+    if (argc > 3)
+    {
+        return CMDLINE_TOO_MANY_ARGS;
+    }
+    if (argc == 3)
+    {
+        Time = strtoul(argv[2], &End, 0);
+        if ((End == argv[2]) || (*End != 0) || strcmp(argv[1], "done"))
+        {
+            return CMDLINE_INVALID_ARG;
+        }
+    }
+
+    if (!strcmp(argv[1], "done"))
+    {
+        BatchWait(CommandsIdle, Time);
+        return 0;
+    }
+    Time = strtoul(argv[1], &End, 0);
+    if ((End == argv[1]) || (*End != 0))
+    {
+        return CMDLINE_INVALID_ARG;
+    }
+    BatchWait(0, Time);
+    return 0;
+}
+
+// menu: Shows the numbered menu
+int CmdMenu(int argc, char *argv[])
+{
+    (void)argv;
+    if (argc > 1)
+    {
+        return CMDLINE_TOO_MANY_ARGS;
+    }
+    SendMenu();
+    return 0;
+}
+
+// help: Lists the named commands
+int CmdHelp(int argc, char *argv[])
+{
+    tCmdLineEntry *Entry;
+
+    (void)argv;
+    if (argc > 1)
+    {
+        return CMDLINE_TOO_MANY_ARGS;
+    }
+    UARTStrPut("Named commands, several may be separated by ';':\r\n");
+    for (Entry = g_psCmdTable; Entry->pcCmd; Entry++)
+    {
+        snprintf(PrintMsg, sizeof(PrintMsg), "%-9s%s\r\n", Entry->pcCmd, Entry->pcHelp);
+        UARTStrPut(PrintMsg);
+    }
+    return 0;
+}
+
+// Named command table for utils/cmdline
+tCmdLineEntry g_psCmdTable[] = {
+    { "help",     CmdHelp,     "List the named commands" },
+    { "menu",     CmdMenu,     "Show the numbered menu" },
+    { "version",  CmdNamed,    "Read sensor version" },
+    { "read",     CmdNamed,    "Read sensor data" },
+    { "start",    CmdNamed,    "Start sensor recording to flash" },
+    { "pos",      CmdNamed,    "Read sensor flash position" },
+    { "erase",    CmdNamed,    "Erase sensor flash" },
+    { "size",     CmdSize,     "<bytes>: Set sensor sample size" },
+    { "status",   CmdNamed,    "Get sensor flash status" },
+    { "get",      CmdNamed,    "Download the sensor sample into flash" },
+    { "dump",     CmdNamed,    "csv|bin: Export the flash recording" },
+    { "compress", CmdNamed,    "[on|off]: Sample compression" },
+    { "params",   CmdNamed,    "Show boot and recording counters" },
+    { "log",      CmdNamed,    "[on|off]: CAN + SMBus data log" },
+    { "adc",      CmdNamed,    "Record local ADC input to flash" },
+    { "trigger",  CmdNamed,    "adc|can: Arm triggered capture" },
+    { "filter",   CmdNamed,    "[on|off]: ADC low-pass + decimation" },
+    { "stats",    CmdStats,    "[on|off]: Live statistics monitor, show without argument" },
+    { "fft",      CmdNamed,    "flash|adc: Spectrum peaks" },
+    { "bench",    CmdNamed,    "Benchmark math routines and formatter" },
+    { "cal",      CmdCal,      "c0 [c1 [c2 [c3]]] | clear: Calibration of the detected module" },
+    { "compact",  CmdNamed,    "[on|off]: Single-line JSON replies and events" },
+    { "stream",   CmdNamed,    "[on|off]: Live streaming of sensor readings" },
+    { "binary",   CmdNamed,    "[on|off]: Binary stream records" },
+    { "stack",    CmdNamed,    "Show the stack high-water mark" },
+    { "burst",    CmdNamed,    "flash|uart: Burst capture into SRAM (again to end it early)" },
+    { "sleep",    CmdNamed,    "[on|off]: Low-power idle, reports sleep time and wake-up latency when turned off" },
+    { "clock",    CmdNamed,    "[on|off]: 16 MHz clock when idle, reports switch times when turned off" },
+    { "crash",    CmdNamed,    "Show and clear the last crash dump" },
+    { "wait",     CmdWait,     "done [ms] | <ms>: Wait until idle (default 60 s timeout), or for a time" },
+    { 0, 0, 0 }
+};
+
+//*****************************************************************************
+//
+// Main Function: Initializes system peripherals (UART, I2C, CAN, etc.), displays
+// a menu to the user, and processes commands entered via UART; interacts with
+// the CAN bus to send and receive sensor commands and data, and manages the response
+// processing loop
+//
+//*****************************************************************************
+
+int main(void)
+{
+    // CAN and Data Processing Variables: used for storing CAN message data, processing
+    // responses, managing sensor samples, and formatting output for logging/communication
+    char CAN_RECV_DATA[255];        // Buffer for formatted CAN data output
+    uint32_t SampleValue = 0;       // Current sensor sample value
+    uint8_t CMD_RESPID = 0;         // Response ID of the last processed command
+    uint32_t Reading[2];            // Raw and calibrated sensor reading
+    FlashParams *Params;            // Flash-resident boot/recording counters
+    int DownloadEvent;              // Last DL_EVT_* event from the sample download
+    bool Crashed;                   // The last reset was a fault or watchdog timeout
+
+    // Mark the unused stack so its high-water mark can be read back
+    StackPaint();
+
+    // Start on the full profile, 80MHz from the 16MHz crystal and PLL; the main loop
+    // drops to the 16MHz idle profile once nothing has run for ClockIdleMS
+    SystemClockSpeed = ClockInit(CLK_PROFILE_FULL, 0);
+
+    // Faults and watchdog timeouts leave a crash dump in EEPROM from here on
+    CrashInit(&SystemTickMS, CrashCheckpoint);
+
+    // Initialize system peripherals: SysTick, UART, I2C, and CAN
+    Init_Systick();
+    Init_UART(115200);      // UART initialized with 115200 baud rate
+    Init_I2C();
+    Init_CAN(CAN_BAUD);     // CAN initialized with 500Kbps baud rate
+    Init_ADC();             // Local analog input, captured on demand
+    FlashWriterInit();      // Flash controller interrupt drives background erase/program
+    SampleDownloadInit(SensorCommandSend);
+    CycleCounterInit();     // DWT cycle counter for flash save latency
+    TelemetryInit(SystemClockSpeed, TelemetryChannels, sizeof(TelemetryChannels) / sizeof(TelemetryChannels[0]),
+                  TelemetrySink);
+    StreamStatsInit(&LiveStats, StatsHistLow, StatsHistWidth);
+    UartStreamInit();       // UART0 transmit uDMA channel
+    UartStreamStart();      // All UART output is buffered from here on
+    RamCaptureInit();       // Burst capture arena above the last SRAM section
+    IdleInit(SystemClockSpeed, &SystemTickMS);  // Tickless sleep at the end of each main loop pass
+
+    // Peripherals timed from the system clock follow the profile switches
+    ClockCallbackRegister(ClockChangeSystem);
+    ClockCallbackRegister(ClockChangeUART);
+    ClockCallbackRegister(ClockChangeCAN);
+    ClockCallbackRegister(ClockChangeI2C);
+
+    // Count this boot and record why the part was reset
+    FlashParamsInit(FlashParamSpace, FlashParamEnd);
+    Params = FlashParamsGet();
+    Params->BootCount++;
+    Params->LastResetCause = MAP_SysCtlResetCauseGet();
+    MAP_SysCtlResetCauseClear(Params->LastResetCause);
+    FlashParamsSave();
+
+    // Turn on CAN listener for mailbox 1 and initialize the CAN modules
+    CANListnerEX(1);
+    CAN_MODULES[0].ID = 0;
+
+    // Allow some startup time (2 seconds), unless the last reset was a crash:
+    // then restart at once and pick up the interrupted download
+    Crashed = CrashRecordGet(&LastCrash) && !LastCrash.Handled;
+    if (!Crashed)
+    {
+        DelayMS(2000);
+    }
+
+    // Display the main menu over UART
+    SendMenu();
+    if (Crashed)
+    {
+        CrashRecover();
+    }
+
+    // Supervise the main loop tasks with the watchdog from here on
+    SupervisorInit(TaskBudgetMS, TASK_COUNT);
+
+    // Main command processing loop
+    while (1)
+    {
+        // Take a command frame from the I2C slave channel, if the supervisor sent one
+        SupervisorEnter(TASK_COMMAND);
+        I2C_RcvNewCommand = I2CSlaveCommandGet(&I2C_RcvCommand, &I2C_RcvCommandParam);
+        if (I2C_RcvNewCommand)
+        {
+            I2C_ResponseLink = true;
+        }
+
+        // Run a command from the I2C supervisor, or a command line typed on the UART
+        if (I2C_RcvNewCommand)
+        {
+            CommandExecute(I2C_RcvCommand, I2C_RcvCommandParam, true);
+        }
+        else if (UARTHasData())
+        {
+            CommandLine(UARTStrGet());
+        }
+
+        // Run the next command of a batch unless it is waiting
+        SupervisorEnter(TASK_BATCH);
+        CommandBatchPoll();
+
+        // Collect SMBus telemetry and start the next read when due
+        SupervisorEnter(TASK_TELEMETRY);
+        TelemetryPoll(SystemTickMS);
+
+        // Commit filled local ADC buffers to flash
+        SupervisorEnter(TASK_ADC_RECORD);
+        AdcRecordPoll();
+
+        // Feed an armed triggered capture and store it once frozen
+        SupervisorEnter(TASK_TRIGGER);
+        TriggerPoll();
+
+        // Poll the CAN sensor for the live statistics monitor
+        SupervisorEnter(TASK_STATS);
+        StatsPoll();
+
+        // Poll the CAN sensor for the live stream
+        SupervisorEnter(TASK_STREAM);
+        StreamPoll();
+
+        // Keep a burst capture going, then flush it
+        SupervisorEnter(TASK_BURST);
+        RamCapturePoll();
+
+        // Collect a live ADC frame and print its spectrum once complete
+        SupervisorEnter(TASK_SPECTRUM);
+        SpectrumPoll();
 
         // Call the CAN interrupt handler to process incoming CAN messages
+        SupervisorEnter(TASK_CAN);
         IntCAN0Handler();
 
         // Check for any changes in the detected CAN module
@@ -1028,6 +3410,10 @@ int main(void)
         if (bit_check(CAN_RECV.FLAGS, CAN_F_NEW))
         {
             CMD_RESPID = CAN_RECV.MSG[3];       // Extract the command response ID
+            if (CMD_RESPID == SensorPending)
+            {
+                SensorPending = 0;
+            }
 
             // Combine the message data to form a sample value
             SampleValue  =  CAN_RECV.MSG[4] << 24;
@@ -1035,88 +3421,116 @@ int main(void)
             SampleValue +=  CAN_RECV.MSG[6] << 8;
             SampleValue +=  CAN_RECV.MSG[7];
 
+            // Trace the response; the samples of a block would crowd everything else out
+            if (CMD_RESPID != icmdFlashGetBlock)
+            {
+                CrashTrace(CRASH_EVENT(CRASH_EVT_CAN_RX, CMD_RESPID, SampleValue));
+            }
+
+            // Pass the response on to the I2C supervisor; block transfer frames arrive too
+            // fast for the channel and are only summarized when the download ends
+            if (I2C_ResponseLink && (CMD_RESPID < icmdFlashGetData))
+            {
+                I2CSlaveResponsePut(CMD_RESPID, SampleValue);
+            }
+
             // Process the response based on the received command ID
             switch (CMD_RESPID)
             {
                 case icmdReadVersion:           // Read Version
-                    sprintf(CAN_RECV_DATA, "Module firmware: %d\r\n", SampleValue);
-                    UARTStrPut(CAN_RECV_DATA);
+                    snprintf(CAN_RECV_DATA, sizeof(CAN_RECV_DATA), "Module firmware: %d\r\n", SampleValue);
+                    RespondValue(RSP_REPLY, CMD_RESPID, RSP_OK, SampleValue, CAN_RECV_DATA);
                     break;
 
                 case icmdReadData:              // Read Sensor Data
-                    sprintf(CAN_RECV_DATA, "RAW sensor data: %d\r\n", SampleValue);
-                    UARTStrPut(CAN_RECV_DATA);
+                    if (StatsMonitoring)
+                    {
+                        StreamStatsPut(&LiveStats, SampleValue, SystemTickMS);
+                    }
+
+                    if (Streaming)
+                    {
+                        StreamSample(SystemTickMS, SampleValue);
+                    }
+
+                    // A burst asks for the next reading as soon as one arrives
+                    if ((RamTarget != RAMF_NONE) && RamCapturePut(SampleValue) &&
+                        (RamCaptureState() == RCAP_RECORDING))
+                    {
+                        RamPollTime = SystemTickMS;
+                        SensorCommandSend(icmdReadData, 0);
+                    }
+
+                    // Readings polled for a triggered capture, the monitor, the stream or a burst are not echoed
+                    if (TriggerSource == TRIG_SRC_CAN)
+                    {
+                        TriggerCapturePut(SampleValue);
+                    }
+                    else if (!StatsMonitoring && !Streaming && (RamTarget == RAMF_NONE))
+                    {
+                        if (CalibrationSelect(CAN_MODULES[0].ID))
+                        {
+                            Reading[0] = SampleValue;
+                            Reading[1] = (uint32_t)CalibrationApply(SampleValue);
+                            snprintf(CAN_RECV_DATA, sizeof(CAN_RECV_DATA), "Sensor data: %d %s (raw %d)\r\n",
+                                     (int32_t)Reading[1], CAL_UNIT, SampleValue);
+                            Respond(RSP_REPLY | RSP_SIGNED, CMD_RESPID, RSP_OK, Reading, 2, CAN_RECV_DATA);
+                        }
+                        else
+                        {
+                            snprintf(CAN_RECV_DATA, sizeof(CAN_RECV_DATA), "RAW sensor data: %d\r\n", SampleValue);
+                            RespondValue(RSP_REPLY, CMD_RESPID, RSP_OK, SampleValue, CAN_RECV_DATA);
+                        }
+                    }
+                    LogSample(LOG_SRC_CAN, 0, SampleValue);
                     break;
 
                 case icmdFlashStart:            // Start recording data into flash
-                    sprintf(CAN_RECV_DATA, "Flash Recording Started: %08X\r\n", SampleValue);
-                    UARTStrPut(CAN_RECV_DATA);
+                    snprintf(CAN_RECV_DATA, sizeof(CAN_RECV_DATA), "Flash Recording Started: %08X\r\n", SampleValue);
+                    RespondValue(RSP_REPLY, CMD_RESPID, RSP_OK, SampleValue, CAN_RECV_DATA);
                     break;
 
                 case icmdFlashReadPos:          // Read Flash at position
-                    sprintf(CAN_RECV_DATA, "Flash Recording Position: %08X\r\n", SampleValue);
-                    UARTStrPut(CAN_RECV_DATA);
+                    snprintf(CAN_RECV_DATA, sizeof(CAN_RECV_DATA), "Flash Recording Position: %08X\r\n", SampleValue);
+                    RespondValue(RSP_REPLY, CMD_RESPID, RSP_OK, SampleValue, CAN_RECV_DATA);
                     break;
 
                 case icmdFlashEraseFull:        // Erase Flash
-                    sprintf(CAN_RECV_DATA, "Flash Erase Done: %08X\r\n", SampleValue);
-                    UARTStrPut(CAN_RECV_DATA);
+                    snprintf(CAN_RECV_DATA, sizeof(CAN_RECV_DATA), "Flash Erase Done: %08X\r\n", SampleValue);
+                    RespondValue(RSP_REPLY, CMD_RESPID, RSP_OK, SampleValue, CAN_RECV_DATA);
                     break;
 
                 case icmdFlashSetSampleSize:   // Set Flash Sample Size
-                    sprintf(CAN_RECV_DATA, "Flash Sample Size Set: %08X\r\n", SampleValue);
-                    UARTStrPut(CAN_RECV_DATA);
+                    snprintf(CAN_RECV_DATA, sizeof(CAN_RECV_DATA), "Flash Sample Size Set: %08X\r\n", SampleValue);
+                    RespondValue(RSP_REPLY, CMD_RESPID, RSP_OK, SampleValue, CAN_RECV_DATA);
                     break;
 
                 case icmdFlashStatus:           // Get flash memory status
-                    sprintf(CAN_RECV_DATA, "Flash Start Position Status: %08X\r\n", SampleValue);
-                    UARTStrPut(CAN_RECV_DATA);
+                    snprintf(CAN_RECV_DATA, sizeof(CAN_RECV_DATA), "Flash Start Position Status: %08X\r\n", SampleValue);
+                    RespondValue(RSP_REPLY, CMD_RESPID, RSP_OK, SampleValue, CAN_RECV_DATA);
                     break;
 
                 case icmdFlashGetData:          // Get Flash sample from sensor module and store it locally
-                    if (SampleRecv == 0xFFFFFF)                 // Check if this is the first data packet being received
-                    {
-                        // Display the size of the sample being received
-                        sprintf(CAN_RECV_DATA, "Receiving Sample Data Size: %08X\r\n", SampleValue);
-                        UARTStrPut(CAN_RECV_DATA);
-
-                        // Initialize the flash sample size and starting address
-                        FlashSampleSize = SampleValue;
-                        SampleRecv = FlashUserSpace;
-
-                        // Erase the flash memory at the starting address to prepare for writing
-                        FlashErase(SampleRecv);
-                    }
-                    else
+                case icmdFlashGetBlock:         // Block of samples requested by the download
+                case icmdFlashBlockCRC:         // CRC32 closing a block
+                case icmdFlashGetTrailer:       // Transfer trailer: length
+                case icmdFlashTrailerCRC:       // Transfer trailer: CRC32
+                    // Samples are staged, CRC-checked per block and committed by the download module
+                    DownloadEvent = SampleDownloadFrame(CMD_RESPID, SampleValue);
+                    DownloadReport(DownloadEvent);
+
+                    // Tell the I2C supervisor how the transfer ended
+                    if (I2C_ResponseLink && ((DownloadEvent == DL_EVT_COMPLETE) || (DownloadEvent == DL_EVT_FAILED)))
                     {
-                        if (SampleValue == 0)                   // Check if this is the end of the sample transmission
-                        {
-                            // Reset the sample receiving process
-                            SampleRecv = 0xFFFFFF;
-
-                            // Indicate that the sample reception has completed
-                            sprintf(CAN_RECV_DATA, "Sample Received.\r\n");
-                            UARTStrPut(CAN_RECV_DATA);
-                        }
-                        else
-                        {
-                            // Incrementally erase flash blocks as needed
-                            if ((SampleRecv & 0x7FF) == 0x400)  // Erase flash in 0x400 blocks
-                            {
-                                FlashErase(SampleRecv);
-                            }
-
-                            // Program (write) the received sample value to flash memory
-                            FlashProgram(&SampleValue, SampleRecv += 4, 4);
-                        }
+                        I2CSlaveResponsePut(icmdFlashGetData, DownloadEvent);
                     }
                     break;
 
                 //TODO: Missing case for icmdFlashGenCSV?
 
                 default:
-                    sprintf(CAN_RECV_DATA, "Recv Data: %d\r\n", SampleValue);
-                    UARTStrPut(CAN_RECV_DATA);
+                    snprintf(CAN_RECV_DATA, sizeof(CAN_RECV_DATA), "Recv Data: %d\r\n", SampleValue);
+                    RespondValue(RSP_REPLY, CMD_RESPID, RSP_OK, SampleValue, CAN_RECV_DATA);
                     break;
             }
 
@@ -1130,5 +3544,13 @@ int main(void)
             // Clear the overrun flag after detecting the condition
             CAN_RECV.FLAGS = bit_clear(CAN_RECV.FLAGS, CAN_F_OVERRUN);
         }
+
+        // Full clock while anything runs, the idle profile once it has been quiet
+        SupervisorEnter(TASK_CLOCK);
+        ClockPoll();
+
+        // Sleep until the next interrupt or scheduled poll
+        SupervisorEnter(TASK_IDLE);
+        IdleSleep(MainLoopDeadline);
     }
 }
@@ -0,0 +1,264 @@
+/*
+ power_idle.c
+
+ Tickless low-power idle for the main loop.
+
+ • Everything the main loop waits for arrives by interrupt (CAN, I2C, UART
+   receive, uDMA, ADC, flash controller) or is due at a known time (sensor
+   polls, telemetry rounds), so once a pass has nothing left to do the core
+   can sleep in WFI (SysCtlSleep) until the next interrupt
+ • The application says how long it can sleep through an IdleDeadline
+   callback, called with interrupts masked: an interrupt that made work
+   pending after the main loop looked is either seen by the callback or still
+   pending, and a pending interrupt ends WFI at once even while masked
+ • Rather than waking every millisecond for SysTick, the running tick period
+   is stretched to end exactly at the deadline; the tick counter is advanced
+   by the suppressed ticks on wake-up, and a sleep ended early by another
+   interrupt counts only the whole milliseconds that passed and lines the next
+   tick back up with the millisecond grid. The few cycles the tick is stopped
+   for while it is reprogrammed are lost (well under 1 ppm at 10 ms sleeps)
+ • SysTick keeps counting after it reaches the deadline, so the cycles from
+   the deadline to the first instruction after WFI (the wake-up latency) are
+   read straight from it; interrupts stay masked until then, so no handler
+   runs in between
+ • Sleep mode leaves the peripherals on their run-mode clocks (peripheral
+   clock gating is not enabled), so transfers and timers keep going
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "inc/hw_types.h"
+#include "inc/hw_nvic.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/rom.h"
+#include "driverlib/rom_map.h"
+
+#include "power_idle.h"
+
+//*****************************************************************************
+//
+// Power Idle State
+//
+//*****************************************************************************
+
+static uint32_t IDL_Period = 0;                 // SysTick cycles per ms
+static uint32_t IDL_MaxMS = 0;                  // Longest sleep the 24-bit SysTick can time
+static volatile uint32_t *IDL_TickMS = 0;       // Application ms counter, advanced for suppressed ticks
+static bool IDL_Enabled = true;                 // Sleep when idle
+static uint32_t IDL_Cycles = 0;                 // Sleep cycles not yet counted in SleepMS
+static IdleStats IDL_Stats;                     // Sleep statistics
+
+//*****************************************************************************
+//
+// IDL_Slept: Adds sleep cycles to the statistics
+//
+//*****************************************************************************
+
+static void IDL_Slept(uint32_t Cycles)
+{
+    IDL_Cycles += Cycles;
+    IDL_Stats.SleepMS += IDL_Cycles / IDL_Period;
+    IDL_Cycles %= IDL_Period;
+}
+
+//*****************************************************************************
+//
+// IDL_TickRestart: Restarts SysTick with its next interrupt Cycles from now
+// and every ms after that
+//
+//*****************************************************************************
+
+static void IDL_TickRestart(uint32_t Cycles)
+{
+    HWREG(NVIC_ST_RELOAD) = Cycles - 1;
+    HWREG(NVIC_ST_CURRENT) = 0;                 // Loads the reload value on the next clock
+    HWREG(NVIC_ST_CTRL) |= NVIC_ST_CTRL_ENABLE;
+    HWREG(NVIC_ST_RELOAD) = IDL_Period - 1;     // Taken at the following reload
+}
+
+//*****************************************************************************
+//
+// IdleInit: Sets up the idle handling; SysTick must already run at 1 ms
+//
+// \param SysClock: System clock in Hz (SysTick runs from it)
+// \param TickMS:   Millisecond counter incremented by the SysTick handler
+//
+//*****************************************************************************
+
+void IdleInit(uint32_t SysClock, volatile uint32_t *TickMS)
+{
+    IdleClockSet(SysClock);
+    IDL_TickMS = TickMS;
+    IdleStatsClear();
+}
+
+//*****************************************************************************
+//
+// IdleClockSet: Follows a system clock change; SysTick must already have been
+// set to 1 ms at the new clock
+//
+// \param SysClock: New system clock in Hz
+//
+//*****************************************************************************
+
+void IdleClockSet(uint32_t SysClock)
+{
+    IDL_Period = SysClock / 1000;
+    IDL_MaxMS = (NVIC_ST_RELOAD_M + 1) / IDL_Period;
+    if (IDL_MaxMS > IDLE_MAX_SLEEP_MS)
+    {
+        IDL_MaxMS = IDLE_MAX_SLEEP_MS;
+    }
+    IDL_Cycles = 0;
+}
+
+//*****************************************************************************
+//
+// IdleEnable: Turns sleeping on or off, e.g. for benchmarks
+//
+//*****************************************************************************
+
+void IdleEnable(bool Enable)
+{
+    IDL_Enabled = Enable;
+}
+
+//*****************************************************************************
+//
+// IdleSleep: Sleeps until the next interrupt or the deadline, whichever comes
+// first; call at the end of each main loop pass
+//
+// \param Deadline: Returns the ms to the next scheduled work (0 = none now)
+//
+//*****************************************************************************
+
+void IdleSleep(IdleDeadline Deadline)
+{
+    uint32_t SleepMS, Start, Total, Current, Ticks, Latency, Control;
+
+    if (!IDL_Enabled || (IDL_Period == 0))
+    {
+        return;
+    }
+
+    MAP_IntMasterDisable();
+    SleepMS = Deadline();
+    if (SleepMS == 0)
+    {
+        MAP_IntMasterEnable();
+        return;
+    }
+    IDL_Stats.Sleeps++;
+
+    // The next tick comes first anyway: sleep with the tick running
+    if (SleepMS == 1)
+    {
+        Start = HWREG(NVIC_ST_CURRENT);
+        MAP_SysCtlSleep();
+        Current = HWREG(NVIC_ST_CURRENT);
+        IDL_Slept((Current <= Start) ? (Start - Current) : (Start + IDL_Period - Current));
+        MAP_IntMasterEnable();
+        return;
+    }
+    if (SleepMS > IDL_MaxMS)
+    {
+        SleepMS = IDL_MaxMS;
+    }
+
+    // Stop the tick; if it just expired, let its handler run instead of sleeping
+    HWREG(NVIC_ST_CTRL) &= ~NVIC_ST_CTRL_ENABLE;
+    Start = HWREG(NVIC_ST_CURRENT);
+    if ((Start == 0) || (HWREG(NVIC_INT_CTRL) & NVIC_INT_CTRL_PENDSTSET))
+    {
+        IDL_TickRestart(Start ? Start : IDL_Period);
+        MAP_IntMasterEnable();
+        return;
+    }
+    IDL_Stats.Tickless++;
+
+    // Stretch the current tick period to end SleepMS ticks from now
+    Total = Start + ((SleepMS - 1) * IDL_Period);
+    IDL_TickRestart(Total);
+
+    MAP_SysCtlSleep();
+
+    if (HWREG(NVIC_ST_CTRL) & NVIC_ST_CTRL_COUNT)
+    {
+        // Woken by the deadline; the tick is back on 1 ms periods and its
+        // pending interrupt counts the last of the SleepMS ticks
+        Current = HWREG(NVIC_ST_CURRENT);
+        Latency = (IDL_Period - 1) - Current;
+        Ticks = SleepMS - 1;
+        IDL_Stats.DeadlineWakes++;
+        IDL_Stats.LatencyLast = Latency;
+        IDL_Stats.LatencyTotal += Latency;
+        if (Latency > IDL_Stats.LatencyMax)
+        {
+            IDL_Stats.LatencyMax = Latency;
+        }
+        IDL_Slept(Total + Latency);
+    }
+    else
+    {
+        // Woken early; the deadline may still pass while the tick is stopped
+        // (reading the control register clears the count flag)
+        Control = HWREG(NVIC_ST_CTRL);
+        HWREG(NVIC_ST_CTRL) = Control & ~NVIC_ST_CTRL_ENABLE;
+        Current = HWREG(NVIC_ST_CURRENT);
+        if ((Control | HWREG(NVIC_ST_CTRL)) & NVIC_ST_CTRL_COUNT)
+        {
+            Ticks = SleepMS - 1;
+            IDL_Slept(Total);
+            IDL_TickRestart(Current + 1);
+        }
+        else
+        {
+            // Count the ms boundaries passed and resume the tick at the next one
+            if (Current == 0)
+            {
+                Current = Total;
+            }
+            Ticks = (SleepMS - 1) - ((Current - 1) / IDL_Period);
+            IDL_Slept(Total - Current);
+            IDL_TickRestart(((Current - 1) % IDL_Period) + 1);
+        }
+        IDL_Stats.EventWakes++;
+    }
+
+    *IDL_TickMS += Ticks;
+    MAP_IntMasterEnable();
+}
+
+//*****************************************************************************
+//
+// IdleStatsClear: Clears the sleep statistics
+//
+//*****************************************************************************
+
+void IdleStatsClear(void)
+{
+    IDL_Stats.Sleeps = 0;
+    IDL_Stats.Tickless = 0;
+    IDL_Stats.DeadlineWakes = 0;
+    IDL_Stats.EventWakes = 0;
+    IDL_Stats.SleepMS = 0;
+    IDL_Stats.LatencyLast = 0;
+    IDL_Stats.LatencyMax = 0;
+    IDL_Stats.LatencyTotal = 0;
+    IDL_Cycles = 0;
+}
+
+//*****************************************************************************
+//
+// IdleStatsGet: Copies the sleep statistics
+//
+// \param Stats:    Pointer to the structure to fill in
+//
+//*****************************************************************************
+
+void IdleStatsGet(IdleStats *Stats)
+{
+    *Stats = IDL_Stats;
+}
@@ -0,0 +1,47 @@
+/*
+ power_idle.h
+
+ Low-power idle: the main loop sleeps between interrupts, and the 1 ms SysTick
+ is suppressed so the core wakes exactly at the next scheduled poll instead of
+ every millisecond.
+ */
+
+#ifndef POWER_IDLE_H_
+#define POWER_IDLE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Power Idle Settings
+//
+//*****************************************************************************
+
+#define IDLE_MAX_SLEEP_MS       200         // Longest tickless sleep (24-bit SysTick: 209 ms at 80 MHz)
+#define IDLE_NO_DEADLINE        0xFFFFFFFF  // Nothing scheduled; sleep until an interrupt
+
+// Time to the next scheduled work in ms, 0 = work is pending now; called with
+// interrupts masked, so an interrupt that just made work pending is seen
+typedef uint32_t (*IdleDeadline)(void);
+
+// Sleep statistics, cleared by IdleStatsClear
+typedef struct {
+    uint32_t Sleeps;                // Times the core slept
+    uint32_t Tickless;              // Sleeps with the tick suppressed (longer than 1 ms)
+    uint32_t DeadlineWakes;         // Tickless sleeps ended by their deadline
+    uint32_t EventWakes;            // Tickless sleeps ended early by another interrupt
+    uint32_t SleepMS;               // Time spent asleep
+    uint32_t LatencyLast;           // Deadline to the first instruction after WFI (cycles)
+    uint32_t LatencyMax;            // Worst wake-up latency (cycles)
+    uint32_t LatencyTotal;          // Sum of the wake-up latencies, for the average
+} IdleStats;
+
+extern void IdleInit(uint32_t SysClock, volatile uint32_t *TickMS);
+extern void IdleClockSet(uint32_t SysClock);
+extern void IdleEnable(bool Enable);
+extern void IdleSleep(IdleDeadline Deadline);
+extern void IdleStatsClear(void);
+extern void IdleStatsGet(IdleStats *Stats);
+
+#endif /* POWER_IDLE_H_ */
@@ -0,0 +1,227 @@
+/*
+ ram_capture.c
+
+ RAM burst capture.
+
+ • The arena is everything between the end of the highest SRAM section and the
+   end of SRAM, found at start-up from the RUN_END symbols of
+   tm4c123ge6pm.cmd, so it grows and shrinks with the rest of the firmware
+   without a hand-maintained size
+ • RamCapturePut is a bounds check and a store, cheap enough to run for every
+   CAN frame at bus rate; nothing touches flash while recording
+ • After the capture, RamCapturePending/RamCaptureRelease hand the samples out
+   in order, so the caller can drain them at whatever pace its sink (flash
+   writer, UART ring) accepts
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ram_capture.h"
+
+//*****************************************************************************
+//
+// RAM Capture State
+//
+//*****************************************************************************
+
+// Section ends and the end of SRAM (tm4c123ge6pm.cmd)
+extern uint32_t __vtable_end;
+extern uint32_t __data_end;
+extern uint32_t __bss_end;
+extern uint32_t __sysmem_end;
+extern uint32_t __stack_end;
+extern uint32_t __SRAM_END;
+
+static uint32_t *RC_Arena = 0;                  // First word of the arena
+static RamCaptureStatus RC_Status;              // Capture status
+
+//*****************************************************************************
+//
+// RamCaptureInit: Places the arena above the highest SRAM section
+//
+//*****************************************************************************
+
+void RamCaptureInit(void)
+{
+    uint32_t Start, End;
+
+    Start = (uint32_t)&__vtable_end;
+    if ((uint32_t)&__data_end > Start)
+    {
+        Start = (uint32_t)&__data_end;
+    }
+    if ((uint32_t)&__bss_end > Start)
+    {
+        Start = (uint32_t)&__bss_end;
+    }
+    if ((uint32_t)&__sysmem_end > Start)
+    {
+        Start = (uint32_t)&__sysmem_end;
+    }
+    if ((uint32_t)&__stack_end > Start)
+    {
+        Start = (uint32_t)&__stack_end;
+    }
+    Start = (Start + RCAP_RESERVE + 3) & ~3;
+    End = (uint32_t)&__SRAM_END;
+
+    RC_Arena = (uint32_t *)Start;
+    RC_Status.State = RCAP_IDLE;
+    RC_Status.Capacity = (End > Start) ? ((End - Start) / 4) : 0;
+}
+
+//*****************************************************************************
+//
+// RamCaptureCapacity: Gets the size of the arena
+//
+// \return Samples the arena holds
+//
+//*****************************************************************************
+
+uint32_t RamCaptureCapacity(void)
+{
+    return RC_Status.Capacity;
+}
+
+//*****************************************************************************
+//
+// RamCaptureStart: Starts a capture, discarding any samples not yet flushed
+//
+// \param Samples:  Samples to capture, limited to the arena; 0 = fill the arena
+//
+// \return false if there is no arena
+//
+//*****************************************************************************
+
+bool RamCaptureStart(uint32_t Samples)
+{
+    if (RC_Status.Capacity == 0)
+    {
+        return false;
+    }
+
+    if ((Samples == 0) || (Samples > RC_Status.Capacity))
+    {
+        Samples = RC_Status.Capacity;
+    }
+    RC_Status.Limit = Samples;
+    RC_Status.Samples = 0;
+    RC_Status.Flushed = 0;
+    RC_Status.Overflows = 0;
+    RC_Status.State = RCAP_RECORDING;
+    return true;
+}
+
+//*****************************************************************************
+//
+// RamCapturePut: Stores one sample while recording; the capture ends by
+// itself when the requested number of samples has been taken
+//
+// \param Sample:   The sample
+//
+// \return false once the capture is no longer recording
+//
+//*****************************************************************************
+
+bool RamCapturePut(uint32_t Sample)
+{
+    if (RC_Status.State != RCAP_RECORDING)
+    {
+        RC_Status.Overflows++;
+        return false;
+    }
+
+    RC_Arena[RC_Status.Samples++] = Sample;
+    if (RC_Status.Samples == RC_Status.Limit)
+    {
+        RC_Status.State = RCAP_HOLDING;
+    }
+    return true;
+}
+
+//*****************************************************************************
+//
+// RamCaptureStop: Ends a capture early, keeping the samples taken
+//
+//*****************************************************************************
+
+void RamCaptureStop(void)
+{
+    if (RC_Status.State == RCAP_RECORDING)
+    {
+        RC_Status.State = RCAP_HOLDING;
+    }
+}
+
+//*****************************************************************************
+//
+// RamCaptureState: Gets the capture state
+//
+// \return RCAP_*
+//
+//*****************************************************************************
+
+uint32_t RamCaptureState(void)
+{
+    return RC_Status.State;
+}
+
+//*****************************************************************************
+//
+// RamCapturePending: Gets the captured samples not yet released
+//
+// \param Count:    Receives the number of samples
+//
+// \return The first sample, or 0 unless the capture is holding samples
+//
+//*****************************************************************************
+
+const uint32_t *RamCapturePending(uint32_t *Count)
+{
+    if (RC_Status.State != RCAP_HOLDING)
+    {
+        *Count = 0;
+        return 0;
+    }
+
+    *Count = RC_Status.Samples - RC_Status.Flushed;
+    return &RC_Arena[RC_Status.Flushed];
+}
+
+//*****************************************************************************
+//
+// RamCaptureRelease: Marks samples as flushed; the capture returns to idle
+// once all of them are
+//
+// \param Count:    Samples taken from RamCapturePending
+//
+//*****************************************************************************
+
+void RamCaptureRelease(uint32_t Count)
+{
+    if (RC_Status.State != RCAP_HOLDING)
+    {
+        return;
+    }
+
+    RC_Status.Flushed += Count;
+    if (RC_Status.Flushed >= RC_Status.Samples)
+    {
+        RC_Status.Flushed = RC_Status.Samples;
+        RC_Status.State = RCAP_IDLE;
+    }
+}
+
+//*****************************************************************************
+//
+// RamCaptureStatusGet: Copies the capture status
+//
+// \param Status:   Pointer to the structure to fill in
+//
+//*****************************************************************************
+
+void RamCaptureStatusGet(RamCaptureStatus *Status)
+{
+    *Status = RC_Status;
+}
@@ -0,0 +1,49 @@
+/*
+ ram_capture.h
+
+ RAM burst capture: records samples into all SRAM the linker left unused and
+ hands them out afterwards for a background flush to flash or the UART.
+ */
+
+#ifndef RAM_CAPTURE_H_
+#define RAM_CAPTURE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// RAM Capture Settings
+//
+//*****************************************************************************
+
+#define RCAP_RESERVE            256         // Bytes left free above the last linker section
+
+// Capture states
+enum {
+    RCAP_IDLE = 0,                  // Nothing captured
+    RCAP_RECORDING,                 // Taking samples
+    RCAP_HOLDING                    // Capture ended, samples waiting to be flushed
+};
+
+// Capture status
+typedef struct {
+    uint32_t State;                 // RCAP_*
+    uint32_t Capacity;              // Samples the arena holds
+    uint32_t Limit;                 // Samples requested by RamCaptureStart
+    uint32_t Samples;               // Samples captured
+    uint32_t Flushed;               // Samples released by RamCaptureRelease
+    uint32_t Overflows;             // Samples offered after the capture was full
+} RamCaptureStatus;
+
+extern void RamCaptureInit(void);
+extern uint32_t RamCaptureCapacity(void);
+extern bool RamCaptureStart(uint32_t Samples);
+extern bool RamCapturePut(uint32_t Sample);
+extern void RamCaptureStop(void);
+extern uint32_t RamCaptureState(void);
+extern const uint32_t *RamCapturePending(uint32_t *Count);
+extern void RamCaptureRelease(uint32_t Count);
+extern void RamCaptureStatusGet(RamCaptureStatus *Status);
+
+#endif /* RAM_CAPTURE_H_ */
@@ -0,0 +1,136 @@
+/*
+ response.c
+
+ Compact response records.
+
+ • Formats one reply or event as a single JSON line (see response.h), so a
+   host can read records with a line reader and a JSON decoder instead of
+   matching the free-form menu text
+ • Every record carries a sequence number; a gap tells the host that a line
+   was lost on the serial link
+ • Numbers are converted by hand rather than with sprintf, keeping a record
+   to a few microseconds so hundreds of commands per second stay cheap
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "response.h"
+
+//*****************************************************************************
+//
+// Response State
+//
+//*****************************************************************************
+
+static uint32_t RS_Sequence = 0;                // Sequence number of the next record
+
+//*****************************************************************************
+//
+// RS_PutText: Copies a string into the record
+//
+// \return Characters copied
+//
+//*****************************************************************************
+
+static uint32_t RS_PutText(char *Buffer, const char *Text)
+{
+    uint32_t Length = 0;
+
+    while (Text[Length] != 0)
+    {
+        Buffer[Length] = Text[Length];
+        Length++;
+    }
+    return Length;
+}
+
+//*****************************************************************************
+//
+// RS_PutNumber: Writes a number in decimal
+//
+// \param Value:    The number
+// \param Signed:   Treat Value as a signed 32-bit number
+//
+// \return Characters written
+//
+//*****************************************************************************
+
+static uint32_t RS_PutNumber(char *Buffer, uint32_t Value, bool Signed)
+{
+    char Digits[10];
+    uint32_t Count = 0, Length = 0;
+
+    if (Signed && ((int32_t)Value < 0))
+    {
+        Buffer[Length++] = '-';
+        Value = 0 - Value;
+    }
+    do
+    {
+        Digits[Count++] = '0' + (Value % 10);
+        Value /= 10;
+    }
+    while (Value);
+
+    while (Count)
+    {
+        Buffer[Length++] = Digits[--Count];
+    }
+    return Length;
+}
+
+//*****************************************************************************
+//
+// ResponseFormat: Formats one response record and advances the sequence number
+//
+// \param Buffer:   Receives the record (RSP_MAX_LENGTH bytes)
+// \param Flags:    RSP_REPLY or RSP_EVENT, plus RSP_SIGNED for signed values
+// \param Cmd:      icmd* ID, or RSP_CMD_LINE
+// \param Status:   RSP_OK or RSP_ERR_*
+// \param Values:   The values
+// \param Count:    Number of values (0..RSP_MAX_VALUES); more are dropped
+//
+// \return Length of the record, "\r\n" included
+//
+//*****************************************************************************
+
+uint32_t ResponseFormat(char *Buffer, uint32_t Flags, uint32_t Cmd, uint32_t Status,
+                        const uint32_t *Values, uint32_t Count)
+{
+    uint32_t Length, lop;
+    bool Signed = (Flags & RSP_SIGNED) != 0;
+
+    if (Count > RSP_MAX_VALUES)
+    {
+        Count = RSP_MAX_VALUES;
+    }
+
+    Length = RS_PutText(Buffer, "{\"seq\":");
+    Length += RS_PutNumber(Buffer + Length, RS_Sequence++, false);
+    Length += RS_PutText(Buffer + Length, (Flags & RSP_EVENT) ? ",\"t\":\"evt\",\"cmd\":" : ",\"t\":\"rsp\",\"cmd\":");
+    Length += RS_PutNumber(Buffer + Length, Cmd, false);
+    Length += RS_PutText(Buffer + Length, ",\"st\":");
+    Length += RS_PutNumber(Buffer + Length, Status, false);
+
+    if (Count)
+    {
+        Length += RS_PutText(Buffer + Length, (Count > 1) ? ",\"val\":[" : ",\"val\":");
+        for (lop = 0; lop < Count; lop++)
+        {
+            if (lop)
+            {
+                Buffer[Length++] = ',';
+            }
+            Length += RS_PutNumber(Buffer + Length, Values[lop], Signed);
+        }
+        if (Count > 1)
+        {
+            Buffer[Length++] = ']';
+        }
+    }
+
+    Length += RS_PutText(Buffer + Length, "}\r\n");
+    Buffer[Length] = 0;
+    return Length;
+}
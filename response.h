@@ -0,0 +1,52 @@
+/*
+ response.h
+
+ Compact response records: replies to commands and asynchronous events as
+ single-line JSON objects that host scripts can parse without regexes.
+
+ Record format (one line, "\r\n" terminated):
+   {"seq":N,"t":"rsp"|"evt","cmd":ID,"st":S[,"val":V|[V1,V2,...]]}
+   seq  Record sequence number, counts every record since reset
+   t    "rsp" replies to a command, "evt" reports a background event
+   cmd  icmd* ID the record belongs to (RSP_CMD_LINE for command lines)
+   st   RSP_OK or an RSP_ERR_* status
+   val  The value(s); omitted if there are none
+ */
+
+#ifndef RESPONSE_H_
+#define RESPONSE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Response Settings
+//
+//*****************************************************************************
+
+#define RSP_MAX_VALUES          20          // Values per record
+#define RSP_MAX_LENGTH          (80 + (RSP_MAX_VALUES * 12)) // Longest record including "\r\n" and terminator
+
+// Record flags
+#define RSP_REPLY               0x00        // Reply to a command
+#define RSP_EVENT               0x01        // Asynchronous event
+#define RSP_SIGNED              0x02        // Values are signed 32-bit
+
+#define RSP_CMD_LINE            0           // cmd of records about named commands and batches
+
+// Status codes
+enum {
+    RSP_OK = 0,                     // Done, or command sent and its reply follows
+    RSP_ERR_CAN,                    // The command could not be sent over CAN
+    RSP_ERR_BUSY,                   // Another recording/capture is using the resource
+    RSP_ERR_ARG,                    // Bad or missing argument
+    RSP_ERR_TIMEOUT,                // A batch wait timed out
+    RSP_ERR_FAILED,                 // The operation ran but failed (or had nothing to work on)
+    RSP_ERR_UNKNOWN                 // Unknown command
+};
+
+extern uint32_t ResponseFormat(char *Buffer, uint32_t Flags, uint32_t Cmd, uint32_t Status,
+                               const uint32_t *Values, uint32_t Count);
+
+#endif /* RESPONSE_H_ */
@@ -0,0 +1,341 @@
+/*
+ sample_codec.c
+
+ Streaming compression of recorded sensor samples.
+
+ • Consecutive pressure samples differ by small amounts, so each sample is stored
+   as the zig-zag encoded difference to the previous one in a 7-bit varint
+ • Samples are packed into self-contained 128-byte blocks that start with the raw
+   value of their first sample, so any block can be decoded on its own
+ • The reader handles both the compressed and the legacy raw 32-bit layout, so
+   the exporters do not need to know how a recording was stored
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sample_codec.h"
+
+//*****************************************************************************
+//
+// Block Header Helpers
+//
+//*****************************************************************************
+
+#define CODEC_HDR_COUNT(Hdr)    (((Hdr) >> 8) & 0xFF)       // Samples in the block
+#define CODEC_HDR_BYTES(Hdr)    ((Hdr) & 0xFF)              // Payload bytes used
+
+// Checks whether a header word describes a valid compressed block
+static bool SampleCodecHeaderValid(uint32_t Hdr)
+{
+    return ((Hdr & CODEC_MAGIC_MASK) == CODEC_MAGIC) &&
+           (CODEC_HDR_COUNT(Hdr) > 0) &&
+           (CODEC_HDR_BYTES(Hdr) <= CODEC_PAYLOAD_SIZE);
+}
+
+//*****************************************************************************
+//
+// SampleEncodeBlockStart: Starts a new block with Value as its raw first sample
+//
+//*****************************************************************************
+
+static void SampleEncodeBlockStart(SampleEncoder *Enc, uint32_t Value)
+{
+    uint32_t lop;
+
+    // Unused payload bytes are left erased so they program as no-ops
+    for (lop = 0; lop < CODEC_BLOCK_WORDS; lop++)
+    {
+        Enc->Block[lop] = 0xFFFFFFFF;
+    }
+
+    Enc->Block[1] = Enc->Index;
+    Enc->Block[2] = Value;
+    Enc->Bytes = 0;
+    Enc->Count = 1;
+}
+
+//*****************************************************************************
+//
+// SampleEncodeBlockEmit: Finalizes the header of the current block and hands
+// its words to the sink
+//
+//*****************************************************************************
+
+static void SampleEncodeBlockEmit(SampleEncoder *Enc)
+{
+    uint32_t lop;
+
+    Enc->Block[0] = CODEC_MAGIC | (Enc->Count << 8) | Enc->Bytes;
+
+    for (lop = 0; lop < CODEC_BLOCK_WORDS; lop++)
+    {
+        Enc->Emit(Enc->Block[lop]);
+    }
+
+    Enc->BlocksOut++;
+    Enc->Count = 0;
+    Enc->Bytes = 0;
+}
+
+//*****************************************************************************
+//
+// SampleEncodeInit: Resets an encoder for a new recording
+//
+// \param Enc:      Encoder state
+// \param Emit:     Function receiving each 32-bit word of a completed block
+//
+//*****************************************************************************
+
+void SampleEncodeInit(SampleEncoder *Enc, void (*Emit)(uint32_t Word))
+{
+    Enc->Bytes = 0;
+    Enc->Count = 0;
+    Enc->Index = 0;
+    Enc->Prev = 0;
+    Enc->BlocksOut = 0;
+    Enc->Emit = Emit;
+}
+
+//*****************************************************************************
+//
+// SampleEncodePut: Appends one sample to the compressed stream
+//
+// \param Enc:      Encoder state
+// \param Value:    The raw sample value
+//
+//*****************************************************************************
+
+void SampleEncodePut(SampleEncoder *Enc, uint32_t Value)
+{
+    uint8_t Varint[5];
+    uint32_t Len = 0;
+    uint32_t ZigZag, lop;
+    int32_t Delta;
+    uint8_t *Payload;
+
+    if (Enc->Count == 0)
+    {
+        SampleEncodeBlockStart(Enc, Value);
+    }
+    else
+    {
+        // Zig-zag maps small negative and positive deltas to small unsigned values
+        Delta = (int32_t)(Value - Enc->Prev);
+        ZigZag = ((uint32_t)Delta << 1) ^ (uint32_t)(Delta >> 31);
+
+        // Encode 7 bits per byte, high bit set on all but the last byte
+        do
+        {
+            Varint[Len] = ZigZag & 0x7F;
+            ZigZag >>= 7;
+            if (ZigZag)
+            {
+                Varint[Len] |= 0x80;
+            }
+            Len++;
+        }
+        while (ZigZag);
+
+        // Close the block if the delta does not fit and restart with a raw value
+        if ((Enc->Bytes + Len) > CODEC_PAYLOAD_SIZE)
+        {
+            SampleEncodeBlockEmit(Enc);
+            SampleEncodeBlockStart(Enc, Value);
+        }
+        else
+        {
+            Payload = (uint8_t *)Enc->Block + CODEC_HEADER_SIZE + Enc->Bytes;
+            for (lop = 0; lop < Len; lop++)
+            {
+                Payload[lop] = Varint[lop];
+            }
+            Enc->Bytes += Len;
+            Enc->Count++;
+        }
+
+        // Close full blocks straight away
+        if (Enc->Bytes == CODEC_PAYLOAD_SIZE)
+        {
+            SampleEncodeBlockEmit(Enc);
+        }
+    }
+
+    Enc->Prev = Value;
+    Enc->Index++;
+}
+
+//*****************************************************************************
+//
+// SampleEncodeFlush: Emits the partially filled block at the end of a recording
+//
+//*****************************************************************************
+
+void SampleEncodeFlush(SampleEncoder *Enc)
+{
+    if (Enc->Count)
+    {
+        SampleEncodeBlockEmit(Enc);
+    }
+}
+
+//*****************************************************************************
+//
+// SampleReaderInit: Opens a recording for reading; the layout (raw or
+// compressed) is detected from the first block header
+//
+// \param Rdr:      Reader state
+// \param Base:     Start address of the recording
+// \param Size:     Size of the region in bytes
+//
+//*****************************************************************************
+
+void SampleReaderInit(SampleReader *Rdr, uint32_t Base, uint32_t Size)
+{
+    Rdr->Base = Base;
+    Rdr->Compressed = SampleCodecHeaderValid(*((uint32_t *)Base));
+    Rdr->Slots = Rdr->Compressed ? (Size / CODEC_BLOCK_SIZE) : (Size / 4);
+    Rdr->Block = 0;
+    Rdr->Index = 0;
+    Rdr->Value = 0;
+    Rdr->Left = 0;
+    Rdr->Ptr = 0;
+}
+
+//*****************************************************************************
+//
+// SampleReaderSeek: Positions the reader on a given sample; for compressed
+// recordings the block holding it is found by binary search over the block
+// headers and decoded up to the sample
+//
+// \param Rdr:      Reader state
+// \param Index:    Sample index to seek to
+//
+// \return true if the sample exists in the recording
+//
+//*****************************************************************************
+
+bool SampleReaderSeek(SampleReader *Rdr, uint32_t Index)
+{
+    uint32_t Lo, Hi, Mid, Hdr, Value;
+    const uint32_t *Blk;
+
+    if (!Rdr->Compressed)
+    {
+        Rdr->Index = Index;
+        return Index < Rdr->Slots;
+    }
+
+    // Find the last block whose first sample index is <= Index; erased or invalid
+    // blocks sort after every valid block
+    Lo = 0;
+    Hi = Rdr->Slots;
+    while (Lo < Hi)
+    {
+        Mid = (Lo + Hi) / 2;
+        Blk = (const uint32_t *)(Rdr->Base + (Mid * CODEC_BLOCK_SIZE));
+        if (SampleCodecHeaderValid(Blk[0]) && (Blk[1] <= Index))
+        {
+            Lo = Mid + 1;
+        }
+        else
+        {
+            Hi = Mid;
+        }
+    }
+
+    if (Lo == 0)
+    {
+        return false;
+    }
+
+    Rdr->Block = Lo - 1;
+    Blk = (const uint32_t *)(Rdr->Base + (Rdr->Block * CODEC_BLOCK_SIZE));
+    Hdr = Blk[0];
+    if (Index >= (Blk[1] + CODEC_HDR_COUNT(Hdr)))
+    {
+        return false;
+    }
+
+    // Decode forward from the start of the block up to the requested sample
+    Rdr->Index = Blk[1];
+    Rdr->Left = 0;
+    Rdr->Ptr = 0;
+    while (Rdr->Index < Index)
+    {
+        SampleReaderNext(Rdr, &Value);
+    }
+
+    return true;
+}
+
+//*****************************************************************************
+//
+// SampleReaderNext: Returns the next sample of the recording
+//
+// \param Rdr:      Reader state
+// \param Value:    Receives the decoded sample
+//
+// \return true if a sample was returned, false at the end of the recording
+//
+//*****************************************************************************
+
+bool SampleReaderNext(SampleReader *Rdr, uint32_t *Value)
+{
+    const uint32_t *Blk;
+    uint32_t ZigZag, Shift;
+    uint8_t Byte;
+
+    if (!Rdr->Compressed)
+    {
+        if (Rdr->Index >= Rdr->Slots)
+        {
+            return false;
+        }
+        *Value = *((uint32_t *)(Rdr->Base + (Rdr->Index++ * 4)));
+        return true;
+    }
+
+    if (Rdr->Left == 0)
+    {
+        // Move to the block holding the next sample (the current one after a seek)
+        if (Rdr->Ptr != 0)
+        {
+            Rdr->Block++;
+        }
+        if (Rdr->Block >= Rdr->Slots)
+        {
+            return false;
+        }
+
+        Blk = (const uint32_t *)(Rdr->Base + (Rdr->Block * CODEC_BLOCK_SIZE));
+        if (!SampleCodecHeaderValid(Blk[0]))
+        {
+            return false;
+        }
+
+        Rdr->Index = Blk[1];
+        Rdr->Value = Blk[2];
+        Rdr->Left = CODEC_HDR_COUNT(Blk[0]) - 1;
+        Rdr->Ptr = (const uint8_t *)Blk + CODEC_HEADER_SIZE;
+    }
+    else
+    {
+        ZigZag = 0;
+        Shift = 0;
+        do
+        {
+            Byte = *Rdr->Ptr++;
+            ZigZag |= (uint32_t)(Byte & 0x7F) << Shift;
+            Shift += 7;
+        }
+        while (Byte & 0x80);
+
+        Rdr->Value += (ZigZag >> 1) ^ (uint32_t)(-(int32_t)(ZigZag & 1));
+        Rdr->Left--;
+    }
+
+    Rdr->Index++;
+    *Value = Rdr->Value;
+    return true;
+}
@@ -0,0 +1,70 @@
+/*
+ sample_codec.h
+
+ Streaming delta + zig-zag + varint compression of recorded sensor samples and
+ the matching reader used by the exporters.
+ */
+
+#ifndef SAMPLE_CODEC_H_
+#define SAMPLE_CODEC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Compressed Block Format
+//
+// The recording is a sequence of fixed 128-byte blocks (one flash write buffer):
+//   word 0:  CODEC_MAGIC | (sample count << 8) | payload bytes used
+//   word 1:  index of the first sample in the block
+//   word 2:  first sample value (raw)
+//   byte 12..127: zig-zag varint deltas of the following samples
+// An erased block (0xFFFFFFFF) ends the recording. Because every block carries
+// the index of its first sample, the block headers double as the block index
+// used for random access.
+//
+//*****************************************************************************
+
+#define CODEC_BLOCK_SIZE        128                         // Bytes per compressed block
+#define CODEC_BLOCK_WORDS       (CODEC_BLOCK_SIZE / 4)      // 32-bit words per compressed block
+#define CODEC_HEADER_SIZE       12                          // Bytes of block header
+#define CODEC_PAYLOAD_SIZE      (CODEC_BLOCK_SIZE - CODEC_HEADER_SIZE)
+#define CODEC_MAGIC             0xC5000000                  // Marks a compressed block header
+#define CODEC_MAGIC_MASK        0xFF000000
+
+// Worst-case flash needed to hold Size bytes of raw samples once compressed
+#define CODEC_WORST_CASE(Size)  ((Size) + ((Size) / 3) + CODEC_BLOCK_SIZE)
+
+// Streaming encoder state
+typedef struct {
+    uint32_t Block[CODEC_BLOCK_WORDS];  // Block being assembled
+    uint32_t Bytes;                     // Payload bytes used in the current block
+    uint32_t Count;                     // Samples in the current block
+    uint32_t Index;                     // Index of the next sample
+    uint32_t Prev;                      // Previous sample value (delta reference)
+    uint32_t BlocksOut;                 // Blocks emitted so far
+    void (*Emit)(uint32_t Word);        // Sink for completed block words
+} SampleEncoder;
+
+// Sequential/random-access reader over a raw or compressed recording
+typedef struct {
+    uint32_t Base;                      // Start of the recording in memory
+    uint32_t Slots;                     // Block slots (compressed) or samples (raw) in the region
+    uint32_t Block;                     // Current block number
+    uint32_t Index;                     // Index of the next sample to return
+    uint32_t Value;                     // Last decoded sample value
+    uint32_t Left;                      // Samples left in the current block
+    const uint8_t *Ptr;                 // Next payload byte in the current block
+    bool Compressed;                    // Recording uses the compressed block format
+} SampleReader;
+
+extern void SampleEncodeInit(SampleEncoder *Enc, void (*Emit)(uint32_t Word));
+extern void SampleEncodePut(SampleEncoder *Enc, uint32_t Value);
+extern void SampleEncodeFlush(SampleEncoder *Enc);
+
+extern void SampleReaderInit(SampleReader *Rdr, uint32_t Base, uint32_t Size);
+extern bool SampleReaderSeek(SampleReader *Rdr, uint32_t Index);
+extern bool SampleReaderNext(SampleReader *Rdr, uint32_t *Value);
+
+#endif /* SAMPLE_CODEC_H_ */
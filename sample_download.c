@@ -0,0 +1,648 @@
+/*
+ sample_download.c
+
+ Verified transfer of a flash sample from the sensor module (icmdFlashGetData).
+
+ • The sample is pulled one 1 KB block at a time (icmdFlashGetBlock); each block
+   is staged in RAM and only committed to local flash once its CRC32 matches
+ • A corrupted block is requested again on its own, so a single bad frame does
+   not mean re-running the whole download
+ • The end of the transfer is determined by the announced length, not by a zero
+   sample, so recordings containing legitimate zero values are kept intact
+ • A transfer whose announced length (or its compressed worst case) does not
+   fit the local flash region is refused before anything is erased
+ • After the trailer (length + CRC32) the programmed flash is read back in bulk
+   and checked block by block; corrupted raw blocks are re-requested and their
+   page rewritten
+ • The running CRC after each of the last few committed blocks is kept so a
+   raw transfer interrupted by a crash can be resumed: the flash writer is at
+   most its page buffers behind the committed blocks, so the last page that
+   made it to flash is found by checking the recording against those CRCs,
+   and the transfer carries on from the block after it. Compressed transfers
+   cannot be resumed (the encoder state is lost) and start over
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "driverlib/sw_crc.h"
+
+#include "sensor_protocol.h"
+#include "flash_writer.h"
+#include "sample_codec.h"
+#include "sample_download.h"
+
+//*****************************************************************************
+//
+// Download State
+//
+//*****************************************************************************
+
+enum {
+    DL_IDLE = 0,                    // Waiting for a header frame
+    DL_BLOCKS,                      // Pulling blocks with icmdFlashGetBlock
+    DL_LEGACY,                      // Sensor is streaming samples without block CRCs
+    DL_TRAILER,                     // Waiting for the trailer length
+    DL_TRAILER_CRC,                 // Waiting for the trailer CRC
+    DL_REPAIR,                      // Re-requesting blocks that failed read-back
+    DL_REJECTED                     // Transfer refused; its frames are ignored until the next config
+};
+
+static uint32_t (*DL_SendCmd)(uint8_t Cmd, uint32_t Param);    // Sends a command to the sensor
+
+static uint32_t DL_Base = 0;            // Local flash address of the recording
+static uint32_t DL_End = 0;             // End of the local flash region
+static bool DL_Compress = false;        // Compress samples before committing them
+
+static uint32_t DL_State = DL_IDLE;     // Current transfer state
+static uint32_t DL_Block = 0;           // Block currently being received
+static uint32_t DL_BlockRetries = 0;    // Retries of the current block
+static uint32_t DL_Stage[DL_BLOCK_WORDS];   // Samples of the block being received
+static uint32_t DL_StageCount = 0;      // Samples staged
+static uint32_t DL_BlockCrc[DL_MAX_BLOCKS]; // CRC32 of each committed block
+static uint8_t DL_BadBlock[DL_MAX_BLOCKS];  // Blocks that failed read-back
+static uint32_t DL_CrcHistory[DL_CHECKPOINTS];  // Running CRC after the last committed blocks
+
+static SampleEncoder DL_Encoder;        // Encoder used for compressed recordings
+static SampleDownloadStatus DL_Status;  // Status of the current/last transfer
+
+//*****************************************************************************
+//
+// SampleDownloadBlockWords: Returns the number of samples in a block; the
+// last block of a transfer may be shorter than DL_BLOCK_WORDS
+//
+//*****************************************************************************
+
+static uint32_t SampleDownloadBlockWords(uint32_t Block)
+{
+    uint32_t Left = (DL_Status.Size / 4) - (Block * DL_BLOCK_WORDS);
+
+    return (Left > DL_BLOCK_WORDS) ? DL_BLOCK_WORDS : Left;
+}
+
+//*****************************************************************************
+//
+// SampleDownloadFits: Checks that a recording of Size raw bytes fits between
+// Base and the end of the local flash region
+//
+//*****************************************************************************
+
+static bool SampleDownloadFits(uint32_t Base, uint32_t Size)
+{
+    uint32_t Room = (DL_End > Base) ? (DL_End - Base) : 0;
+
+    // Size is checked on its own first so the worst case cannot overflow
+    return (Size <= Room) && (!DL_Compress || (CODEC_WORST_CASE(Size) <= Room));
+}
+
+//*****************************************************************************
+//
+// SampleDownloadCrc: CRC32 of a block of 32-bit samples (little-endian words)
+//
+//*****************************************************************************
+
+static uint32_t SampleDownloadCrc(const uint32_t *Data, uint32_t Words)
+{
+    return Crc32Array(Words, Data);
+}
+
+//*****************************************************************************
+//
+// SampleDownloadCommit: Hands the staged samples to the flash writer, through
+// the encoder when compression is enabled
+//
+//*****************************************************************************
+
+static void SampleDownloadCommit(void)
+{
+    uint32_t lop;
+
+    for (lop = 0; lop < DL_StageCount; lop++)
+    {
+        if (DL_Compress)
+        {
+            SampleEncodePut(&DL_Encoder, DL_Stage[lop]);
+        }
+        else
+        {
+            FlashWriterPut(DL_Stage[lop]);
+        }
+    }
+
+    // Chain the running CRC of the whole transfer (un-inverted between calls)
+    DL_Status.Crc = Crc32Slice8(DL_Status.Crc, (const uint8_t *)DL_Stage, DL_StageCount * 4);
+    DL_Status.Received += DL_StageCount;
+    DL_StageCount = 0;
+}
+
+//*****************************************************************************
+//
+// SampleDownloadReadback: Reads the committed recording back from flash and
+// checks every block against the CRC it was verified with
+//
+// \return Number of blocks that did not match
+//
+//*****************************************************************************
+
+static uint32_t SampleDownloadReadback(void)
+{
+    SampleReader Rdr;
+    uint32_t Block, Words, lop, Errors = 0;
+    uint32_t Blocks = (DL_Status.Blocks > DL_MAX_BLOCKS) ? DL_MAX_BLOCKS : DL_Status.Blocks;
+
+    SampleReaderInit(&Rdr, DL_Base, DL_Compress ? CODEC_WORST_CASE(DL_Status.Size) : DL_Status.Size);
+
+    for (Block = 0; Block < Blocks; Block++)
+    {
+        Words = SampleDownloadBlockWords(Block);
+
+        // Raw recordings are checked in place; compressed ones are decoded first
+        if (Rdr.Compressed)
+        {
+            for (lop = 0; lop < Words; lop++)
+            {
+                if (!SampleReaderNext(&Rdr, &DL_Stage[lop]))
+                {
+                    DL_Stage[lop] = 0xFFFFFFFF;
+                }
+            }
+            DL_BadBlock[Block] = (SampleDownloadCrc(DL_Stage, Words) != DL_BlockCrc[Block]);
+        }
+        else
+        {
+            DL_BadBlock[Block] = (SampleDownloadCrc((const uint32_t *)(DL_Base + (Block * DL_BLOCK_SIZE)), Words) !=
+                                  DL_BlockCrc[Block]);
+        }
+
+        if (DL_BadBlock[Block])
+        {
+            Errors++;
+        }
+    }
+
+    return Errors;
+}
+
+//*****************************************************************************
+//
+// SampleDownloadNextRepair: Requests the next block that failed read-back
+//
+// \return true if a block was requested, false if none are left
+//
+//*****************************************************************************
+
+static bool SampleDownloadNextRepair(void)
+{
+    uint32_t Block;
+
+    for (Block = 0; Block < DL_MAX_BLOCKS && Block < DL_Status.Blocks; Block++)
+    {
+        if (DL_BadBlock[Block])
+        {
+            DL_Block = Block;
+            DL_BlockRetries = 0;
+            DL_StageCount = 0;
+            DL_State = DL_REPAIR;
+            DL_SendCmd(icmdFlashGetBlock, Block);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//*****************************************************************************
+//
+// SampleDownloadFinish: Flushes the recording, verifies it against the trailer
+// and the block CRCs, and starts repairs if read-back found bad raw blocks
+//
+//*****************************************************************************
+
+static int SampleDownloadFinish(void)
+{
+    if (DL_Compress)
+    {
+        SampleEncodeFlush(&DL_Encoder);
+        DL_Status.CompressedBytes = DL_Encoder.BlocksOut * CODEC_BLOCK_SIZE;
+    }
+    FlashWriterSync();
+
+    DL_Status.Crc ^= 0xFFFFFFFF;
+
+    // An erase or program error stopped the writer; the recording is incomplete
+    if (FlashWriterFailed())
+    {
+        DL_Status.Failure = DL_FAIL_WRITER;
+        DL_State = DL_IDLE;
+        return DL_EVT_FAILED;
+    }
+
+    if (DL_Status.Legacy)
+    {
+        DL_State = DL_IDLE;
+        return DL_EVT_COMPLETE;
+    }
+
+    DL_Status.ReadbackErrors = SampleDownloadReadback();
+
+    // Raw blocks map onto a single flash page and can be rewritten in place
+    if (DL_Status.ReadbackErrors && !DL_Compress && SampleDownloadNextRepair())
+    {
+        return DL_EVT_REPAIR;
+    }
+
+    DL_Status.Verified = (DL_Status.ReadbackErrors == 0) &&
+                         (DL_Status.TrailerLength == DL_Status.Size) &&
+                         (DL_Status.TrailerCrc == DL_Status.Crc);
+    DL_State = DL_IDLE;
+    return DL_EVT_COMPLETE;
+}
+
+//*****************************************************************************
+//
+// SampleDownloadBlockCrc: Handles the CRC frame that closes a block
+//
+//*****************************************************************************
+
+static int SampleDownloadBlockCrc(uint32_t Crc)
+{
+    uint32_t Words = SampleDownloadBlockWords(DL_Block);
+
+    // Re-request the block if it is short or corrupted
+    if ((DL_StageCount != Words) || (SampleDownloadCrc(DL_Stage, Words) != Crc))
+    {
+        DL_Status.Retries++;
+        if (++DL_BlockRetries > DL_MAX_RETRIES)
+        {
+            DL_Status.Failure = DL_FAIL_RETRIES;
+            DL_State = DL_IDLE;
+            return DL_EVT_FAILED;
+        }
+        DL_StageCount = 0;
+        DL_SendCmd(icmdFlashGetBlock, DL_Block);
+        return DL_EVT_RETRY;
+    }
+
+    if (DL_Block < DL_MAX_BLOCKS)
+    {
+        DL_BlockCrc[DL_Block] = Crc;
+    }
+
+    // A repaired block replaces its flash page, then the next bad block is fetched
+    if (DL_State == DL_REPAIR)
+    {
+        if (!FlashWriterStart(DL_Base + (DL_Block * DL_BLOCK_SIZE), Words * 4))
+        {
+            DL_Status.Failure = DL_FAIL_WRITER;
+            DL_State = DL_IDLE;
+            return DL_EVT_FAILED;
+        }
+        for (Words = 0; Words < DL_StageCount; Words++)
+        {
+            FlashWriterPut(DL_Stage[Words]);
+        }
+        FlashWriterSync();
+        DL_StageCount = 0;
+        DL_BadBlock[DL_Block] = 0;
+
+        if (SampleDownloadNextRepair())
+        {
+            return DL_EVT_NONE;
+        }
+
+        DL_Status.ReadbackErrors = SampleDownloadReadback();
+        DL_Status.Verified = (DL_Status.ReadbackErrors == 0) &&
+                             (DL_Status.TrailerLength == DL_Status.Size) &&
+                             (DL_Status.TrailerCrc == DL_Status.Crc);
+        DL_State = DL_IDLE;
+        return DL_EVT_COMPLETE;
+    }
+
+    SampleDownloadCommit();
+    if (FlashWriterFailed())
+    {
+        DL_Status.Failure = DL_FAIL_WRITER;
+        DL_State = DL_IDLE;
+        return DL_EVT_FAILED;
+    }
+    DL_BlockRetries = 0;
+    DL_CrcHistory[(DL_Block + 1) & (DL_CHECKPOINTS - 1)] = DL_Status.Crc;
+
+    if (++DL_Block < DL_Status.Blocks)
+    {
+        DL_SendCmd(icmdFlashGetBlock, DL_Block);
+    }
+    else
+    {
+        DL_State = DL_TRAILER;
+        DL_SendCmd(icmdFlashGetTrailer, 0);
+    }
+
+    return DL_EVT_NONE;
+}
+
+//*****************************************************************************
+//
+// SampleDownloadReset: Clears the status for a new transfer of Size bytes
+//
+//*****************************************************************************
+
+static void SampleDownloadReset(uint32_t Size)
+{
+    DL_Status.Size = Size & ~3;
+    DL_Status.Received = 0;
+    DL_Status.Blocks = (DL_Status.Size + DL_BLOCK_SIZE - 1) / DL_BLOCK_SIZE;
+    DL_Status.Retries = 0;
+    DL_Status.ReadbackErrors = 0;
+    DL_Status.CompressedBytes = 0;
+    DL_Status.Crc = 0xFFFFFFFF;
+    DL_Status.TrailerLength = 0;
+    DL_Status.TrailerCrc = 0;
+    DL_Status.Verified = false;
+    DL_Status.Legacy = false;
+    DL_Status.Failure = DL_FAIL_NONE;
+    DL_CrcHistory[0] = DL_Status.Crc;
+}
+
+//*****************************************************************************
+//
+// SampleDownloadInit: Sets the function used to send commands to the sensor
+//
+// \param SendCmd:  Sends a command ID with a 32-bit parameter over CAN
+//
+//*****************************************************************************
+
+void SampleDownloadInit(uint32_t (*SendCmd)(uint8_t Cmd, uint32_t Param))
+{
+    DL_SendCmd = SendCmd;
+    DL_State = DL_IDLE;
+}
+
+//*****************************************************************************
+//
+// SampleDownloadConfig: Sets where and how the next transfer is stored and
+// abandons any unfinished transfer
+//
+// \param Base:     Page-aligned local flash address of the recording
+// \param End:      End of the local flash region the recording must fit in
+// \param Compress: true to compress samples before committing them
+//
+//*****************************************************************************
+
+void SampleDownloadConfig(uint32_t Base, uint32_t End, bool Compress)
+{
+    DL_Base = Base;
+    DL_End = End;
+    DL_Compress = Compress;
+
+    // Abandon any transfer the sensor never finished
+    DL_State = DL_IDLE;
+}
+
+//*****************************************************************************
+//
+// SampleDownloadFrame: Processes one transfer-related response frame
+//
+// \param RespID:   Response ID from the frame (MSG[3])
+// \param Value:    32-bit value from the frame (MSG[4..7])
+//
+// \return One of the DL_EVT_* events
+//
+//*****************************************************************************
+
+int SampleDownloadFrame(uint8_t RespID, uint32_t Value)
+{
+    switch (DL_State)
+    {
+        case DL_IDLE:
+            // A header announces a new transfer; zero-length headers (such as the
+            // end marker sent by older sensors) are ignored
+            if ((RespID != icmdFlashGetData) || (Value < 4))
+            {
+                return DL_EVT_NONE;
+            }
+
+            SampleDownloadReset(Value);
+
+            // Refuse a recording that would run past the flash region; samples a
+            // legacy sensor streams after the header are ignored with it
+            if (!SampleDownloadFits(DL_Base, DL_Status.Size))
+            {
+                DL_Status.Failure = DL_FAIL_SIZE;
+                DL_State = DL_REJECTED;
+                return DL_EVT_FAILED;
+            }
+
+            // Start a background write session; the first page is erased by the flash ISR
+            // Compressed recordings reserve room for the (rare) worst case expansion
+            if (!FlashWriterStart(DL_Base, DL_Compress ? CODEC_WORST_CASE(DL_Status.Size) : DL_Status.Size))
+            {
+                DL_Status.Failure = DL_FAIL_WRITER;
+                DL_State = DL_REJECTED;
+                return DL_EVT_FAILED;
+            }
+            SampleEncodeInit(&DL_Encoder, FlashWriterPut);
+
+            DL_Block = 0;
+            DL_BlockRetries = 0;
+            DL_StageCount = 0;
+            DL_State = DL_BLOCKS;
+            DL_SendCmd(icmdFlashGetBlock, 0);
+            return DL_EVT_STARTED;
+
+        case DL_BLOCKS:
+        case DL_REPAIR:
+            if (RespID == icmdFlashGetBlock)
+            {
+                if (DL_StageCount < DL_BLOCK_WORDS)
+                {
+                    DL_Stage[DL_StageCount++] = Value;
+                }
+                return DL_EVT_NONE;
+            }
+            if (RespID == icmdFlashBlockCRC)
+            {
+                return SampleDownloadBlockCrc(Value);
+            }
+            if ((RespID != icmdFlashGetData) || (DL_State == DL_REPAIR))
+            {
+                return DL_EVT_NONE;
+            }
+
+            // Samples streamed straight after the header: the sensor does not
+            // support block requests, fall back to unverified streaming
+            DL_Status.Legacy = true;
+            DL_State = DL_LEGACY;
+
+            // no break, process the sample in the legacy state
+
+        case DL_LEGACY:
+            if (RespID != icmdFlashGetData)
+            {
+                return DL_EVT_NONE;
+            }
+
+            DL_Stage[DL_StageCount++] = Value;
+            if ((DL_StageCount == DL_BLOCK_WORDS) ||
+                ((DL_Status.Received + DL_StageCount) == (DL_Status.Size / 4)))
+            {
+                SampleDownloadCommit();
+            }
+
+            // The transfer ends after the announced number of samples
+            if (DL_Status.Received == (DL_Status.Size / 4))
+            {
+                return SampleDownloadFinish();
+            }
+            return DL_EVT_NONE;
+
+        case DL_TRAILER:
+            if (RespID == icmdFlashGetTrailer)
+            {
+                DL_Status.TrailerLength = Value;
+                DL_State = DL_TRAILER_CRC;
+            }
+            return DL_EVT_NONE;
+
+        case DL_TRAILER_CRC:
+            if (RespID != icmdFlashTrailerCRC)
+            {
+                return DL_EVT_NONE;
+            }
+            DL_Status.TrailerCrc = Value;
+            return SampleDownloadFinish();
+
+        default:
+            return DL_EVT_NONE;
+    }
+}
+
+//*****************************************************************************
+//
+// SampleDownloadActive: Checks whether a transfer is in progress
+//
+//*****************************************************************************
+
+bool SampleDownloadActive(void)
+{
+    return (DL_State != DL_IDLE) && (DL_State != DL_REJECTED);
+}
+
+//*****************************************************************************
+//
+// SampleDownloadStatusGet: Copies the status of the current/last transfer
+//
+// \param Status:   Pointer to the structure to fill in
+//
+//*****************************************************************************
+
+void SampleDownloadStatusGet(SampleDownloadStatus *Status)
+{
+    *Status = DL_Status;
+}
+
+//*****************************************************************************
+//
+// SampleDownloadCheckpointGet: Gets the point a crashed transfer can resume
+// from; reads RAM only, so it can be called from a fault handler
+//
+// \param Point:    Structure to fill in
+//
+// \return false if no raw transfer is receiving blocks
+//
+//*****************************************************************************
+
+bool SampleDownloadCheckpointGet(SampleDownloadCheckpoint *Point)
+{
+    uint32_t lop;
+
+    if ((DL_State != DL_BLOCKS) || DL_Compress)
+    {
+        Point->Size = 0;
+        return false;
+    }
+
+    Point->Size = DL_Status.Size;
+    Point->Base = DL_Base;
+    Point->Block = DL_Block;
+    Point->Retries = DL_Status.Retries;
+    for (lop = 0; lop < DL_CHECKPOINTS; lop++)
+    {
+        Point->Crc[lop] = DL_CrcHistory[lop];
+    }
+    return true;
+}
+
+//*****************************************************************************
+//
+// SampleDownloadResume: Resumes a raw transfer after a restart; the blocks
+// already in flash are checked against the checkpoint CRCs and the transfer
+// carries on from the first one that is not. The recording must lie in the
+// region set by SampleDownloadConfig
+//
+// \param Point:    Checkpoint saved before the restart
+// \param Block:    Set to the block the transfer resumes at
+//
+// \return DL_EVT_STARTED, or DL_EVT_FAILED if the recording in flash does not
+// match the checkpoint (the transfer has to be started over)
+//
+//*****************************************************************************
+
+int SampleDownloadResume(const SampleDownloadCheckpoint *Point, uint32_t *Block)
+{
+    const uint32_t *Data;
+    uint32_t First, Words, Crc, ResumeCrc = 0, lop;
+    bool Found = false;
+
+    SampleDownloadReset(Point->Size);
+    DL_Compress = false;
+    if ((DL_Status.Size == 0) || (Point->Block >= DL_Status.Blocks) || (Point->Base & (DL_BLOCK_SIZE - 1)) ||
+        (Point->Base < DL_Base) || !SampleDownloadFits(Point->Base, DL_Status.Size))
+    {
+        return DL_EVT_FAILED;
+    }
+    DL_Base = Point->Base;
+
+    // Recompute the running and block CRCs from flash, up to the last block
+    // whose running CRC matches a checkpoint
+    First = (Point->Block >= (DL_CHECKPOINTS - 1)) ? (Point->Block - (DL_CHECKPOINTS - 1)) : 0;
+    Crc = 0xFFFFFFFF;
+    for (lop = 0; lop <= Point->Block; lop++)
+    {
+        if ((lop >= First) && (Crc == Point->Crc[lop & (DL_CHECKPOINTS - 1)]))
+        {
+            *Block = lop;
+            ResumeCrc = Crc;
+            Found = true;
+        }
+        if (lop == Point->Block)
+        {
+            break;
+        }
+
+        Words = SampleDownloadBlockWords(lop);
+        Data = (const uint32_t *)(DL_Base + (lop * DL_BLOCK_SIZE));
+        if (lop < DL_MAX_BLOCKS)
+        {
+            DL_BlockCrc[lop] = SampleDownloadCrc(Data, Words);
+        }
+        Crc = Crc32Slice8(Crc, (const uint8_t *)Data, Words * 4);
+    }
+
+    if (!Found || !FlashWriterStart(DL_Base + (*Block * DL_BLOCK_SIZE), DL_Status.Size - (*Block * DL_BLOCK_SIZE)))
+    {
+        return DL_EVT_FAILED;
+    }
+
+    DL_Status.Received = *Block * DL_BLOCK_WORDS;
+    DL_Status.Retries = Point->Retries;
+    DL_Status.Crc = ResumeCrc;
+    DL_CrcHistory[*Block & (DL_CHECKPOINTS - 1)] = ResumeCrc;
+
+    DL_Block = *Block;
+    DL_BlockRetries = 0;
+    DL_StageCount = 0;
+    DL_State = DL_BLOCKS;
+    DL_SendCmd(icmdFlashGetBlock, DL_Block);
+    return DL_EVT_STARTED;
+}
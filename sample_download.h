@@ -0,0 +1,79 @@
+/*
+ sample_download.h
+
+ Verified transfer of a flash sample from the sensor module into the local
+ flash user space.
+ */
+
+#ifndef SAMPLE_DOWNLOAD_H_
+#define SAMPLE_DOWNLOAD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Download Settings
+//
+//*****************************************************************************
+
+#define DL_BLOCK_SIZE       1024                    // Bytes per transfer block (one local flash page)
+#define DL_BLOCK_WORDS      (DL_BLOCK_SIZE / 4)     // Samples per transfer block
+#define DL_MAX_BLOCKS       128                     // Blocks tracked for read-back verification (128 KB)
+#define DL_MAX_RETRIES      3                       // Re-requests of one block before giving up
+#define DL_CHECKPOINTS      4                       // Running CRCs kept for a resume (power of two)
+
+// Events returned by SampleDownloadFrame, reported to the operator by main
+enum {
+    DL_EVT_NONE = 0,                // Nothing to report
+    DL_EVT_STARTED,                 // Header received, transfer started
+    DL_EVT_RETRY,                   // Block failed its CRC and was re-requested
+    DL_EVT_REPAIR,                  // Read-back found corrupted blocks, re-requesting them
+    DL_EVT_COMPLETE,                // Transfer finished (see status for verification result)
+    DL_EVT_FAILED                   // Transfer aborted (see status for the reason)
+};
+
+// Why a transfer failed, reported in the status after DL_EVT_FAILED
+enum {
+    DL_FAIL_NONE = 0,               // Not failed
+    DL_FAIL_RETRIES,                // A block failed its CRC too many times
+    DL_FAIL_SIZE,                   // The announced size does not fit the flash region
+    DL_FAIL_WRITER                  // The flash writer could not be started or reported an error
+};
+
+// Transfer status, valid after DL_EVT_COMPLETE or DL_EVT_FAILED
+typedef struct {
+    uint32_t Size;                  // Sample size in bytes announced by the sensor
+    uint32_t Received;              // Samples committed to local flash
+    uint32_t Blocks;                // Blocks in the transfer
+    uint32_t Retries;               // Blocks re-requested because of a transport CRC mismatch
+    uint32_t ReadbackErrors;        // Blocks whose flash read-back did not match
+    uint32_t CompressedBytes;       // Flash used by a compressed recording (0 if raw)
+    uint32_t Crc;                   // CRC32 of the received samples
+    uint32_t TrailerLength;         // Length from the transfer trailer
+    uint32_t TrailerCrc;            // CRC32 from the transfer trailer
+    bool Verified;                  // Trailer and flash read-back both matched
+    bool Legacy;                    // Sensor streamed without block CRCs (unverified)
+    uint32_t Failure;               // DL_FAIL_* reason after DL_EVT_FAILED
+} SampleDownloadStatus;
+
+// Where a raw transfer stood, saved with a crash dump so a warm restart can
+// resume it; Crc[n % DL_CHECKPOINTS] is the running CRC after n blocks, for the
+// last DL_CHECKPOINTS values of n up to Block
+typedef struct {
+    uint32_t Size;                  // Sample size in bytes, 0 = nothing to resume
+    uint32_t Base;                  // Local flash address of the recording
+    uint32_t Block;                 // Blocks handed to the flash writer
+    uint32_t Retries;               // Blocks re-requested so far
+    uint32_t Crc[DL_CHECKPOINTS];   // Running CRCs (un-inverted)
+} SampleDownloadCheckpoint;
+
+extern void SampleDownloadInit(uint32_t (*SendCmd)(uint8_t Cmd, uint32_t Param));
+extern void SampleDownloadConfig(uint32_t Base, uint32_t End, bool Compress);
+extern int SampleDownloadFrame(uint8_t RespID, uint32_t Value);
+extern bool SampleDownloadActive(void);
+extern void SampleDownloadStatusGet(SampleDownloadStatus *Status);
+extern bool SampleDownloadCheckpointGet(SampleDownloadCheckpoint *Point);
+extern int SampleDownloadResume(const SampleDownloadCheckpoint *Point, uint32_t *Block);
+
+#endif /* SAMPLE_DOWNLOAD_H_ */
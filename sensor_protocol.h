@@ -0,0 +1,99 @@
+/*
+ sensor_protocol.h
+
+ Command and response IDs shared by the host firmware modules that talk to the
+ Inkley sensor module over CAN.
+
+ Command frames (host -> sensor, CAN_SENSOR_ID):
+   MSG[0]    command ID
+   MSG[1..2] host CAN ID
+   MSG[3..6] 32-bit parameter, MSB first
+
+ Response frames (sensor -> host, CAN_ID):
+   MSG[3]    command/response ID
+   MSG[4..7] 32-bit value, MSB first
+ */
+
+#ifndef SENSOR_PROTOCOL_H_
+#define SENSOR_PROTOCOL_H_
+
+//*****************************************************************************
+//
+// Sensor Commands
+//
+//*****************************************************************************
+
+// Inkley Sensor Commands
+/*
+#define icmdReadVersion         01  // Command to read the version of the sensor
+#define icmdReadData            02  // Command to read sensor data
+#define icmdFlashStart          03  // Command to start recording data into flash memory
+#define icmdFlashReadPos        04  // Command to read data from a specific position in flash memory
+#define icmdFlashEraseFull      05  // Command to erase the entire flash memory
+#define icmdFlashSetSampleSize  06  // Command to set the sample size for flash memory
+#define icmdFlashStatus         07  // Command to get the status of the flash memory read (e.g., percentage complete)
+#define icmdFlashGetData        08  // Get Flash sample from sensor module and store it locally
+#define icmdFlashGenCSV         09  // Generate a CSV file from the flash data stored locally
+*/
+
+enum {
+    icmdReadVersion = 0x01,         // Read sensor firmware version
+    icmdReadData,                   // Retrieve current sensor data
+    icmdFlashStart,                 // Start recording data into flash memory
+    icmdFlashReadPos,               // Read data from a specific flash memory position
+    icmdFlashEraseFull,             // Erase all data in flash memory
+    icmdFlashSetSampleSize,         // Set the size of samples to store in flash
+    icmdFlashStatus,                // Retrieve flash memory operation status
+    icmdFlashGetData,               // Fetch raw data from flash memory
+    icmdFlashGenCSV,                // Generate CSV-formatted output from flash data
+    icmdFlashGenBin,                // Dump flash data as raw little-endian 32-bit samples
+    icmdFlashCompression,           // Toggle compression of received samples
+    icmdFlashGetBlock,              // Request one 1 KB block of the sample (param = block number)
+    icmdFlashBlockCRC,              // Response: CRC32 of the block just sent
+    icmdFlashGetTrailer,            // Request the transfer trailer; response value = sample length in bytes
+    icmdFlashTrailerCRC,            // Response: CRC32 of the whole sample, follows the trailer length
+    icmdParamsShow,                 // Local: show the flash-resident counters (not sent to the sensor)
+    icmdDataLog,                    // Local: toggle the timestamped CAN + SMBus data log
+    icmdAdcRecord,                  // Local: record the local ADC input into flash
+    icmdTriggerAdc,                 // Local: arm a triggered capture on the ADC digital comparator
+    icmdTriggerCan,                 // Local: arm a triggered capture on a CAN sensor value threshold
+    icmdAdcFilter,                  // Local: toggle low-pass filtering and decimation of ADC recordings
+    icmdStatsMonitor,               // Local: toggle the live statistics monitor on CAN sensor readings
+    icmdStatsShow,                  // Local: show a snapshot of the live statistics
+    icmdSpectrumFlash,              // Local: FFT spectrum peaks of the flash recording
+    icmdSpectrumAdc,                // Local: FFT spectrum peaks of the live ADC input
+    icmdMathBench,                  // Local: cycle benchmark of the fixed-point math routines
+    icmdCalibrationSet,             // Local: set the calibration polynomial of the detected module
+    icmdResponseMode,               // Local: toggle compact (single-line JSON) replies and events
+    icmdStream,                     // Local: toggle live streaming of CAN sensor readings to the UART
+    icmdStreamFormat,               // Local: toggle binary (instead of text) stream records
+    icmdStackUsage,                 // Local: show the stack high-water mark
+    icmdRamCaptureFlash,            // Local: burst capture into spare SRAM, then flush to flash
+    icmdRamCaptureUart,             // Local: burst capture into spare SRAM, then flush to the UART
+    icmdLowPowerIdle,               // Local: toggle sleeping between interrupts, report wake-up latency
+    icmdClockScaling,               // Local: toggle the 16 MHz idle clock profile, report switch times
+    icmdCrashDump                   // Local: show and clear the crash dump saved by a fault or the watchdog
+};
+
+//*****************************************************************************
+//
+// Verified Sample Transfer (icmdFlashGetData)
+//
+// 1. Host sends icmdFlashGetData; the sensor replies with one icmdFlashGetData
+//    frame carrying the sample size in bytes
+// 2. Host sends icmdFlashGetBlock(n); the sensor replies with up to 256
+//    icmdFlashGetBlock frames (one sample each) followed by icmdFlashBlockCRC
+// 3. A block whose CRC32 does not match is requested again, otherwise the host
+//    moves on to block n + 1
+// 4. After the last block the host sends icmdFlashGetTrailer; the sensor replies
+//    with the length (icmdFlashGetTrailer) and CRC32 (icmdFlashTrailerCRC) of
+//    the whole sample
+//
+// CRC32s are computed over the sample values as little-endian 32-bit words.
+// Sensors that instead stream icmdFlashGetData samples straight after the
+// header are still accepted; such transfers end after Size / 4 samples and are
+// reported as unverified.
+//
+//*****************************************************************************
+
+#endif /* SENSOR_PROTOCOL_H_ */
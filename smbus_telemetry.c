@@ -0,0 +1,345 @@
+/*
+ smbus_telemetry.c
+
+ SMBus/PMBus telemetry poller.
+
+ • A table of channels (device address, command code, read type) is read once
+   per period, one transfer at a time, on I2C1 so it never contends with the
+   I2C0 command channel and transaction queue
+ • Transfers run from the I2C1 interrupt through SMBusMasterIntProcess with PEC
+   enabled; the main loop only starts the next read and collects the result,
+   so CAN and UART handling are never blocked on the bus
+ • Each good reading is handed to a sink together with its channel number, so
+   the caller can merge it into the same timestamped log as the CAN sensor data
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "driverlib/gpio.h"
+#include "driverlib/i2c.h"
+#include "driverlib/pin_map.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/rom.h"
+#include "driverlib/rom_map.h"
+#include "utils/smbus.h"
+
+#include "smbus_telemetry.h"
+
+//*****************************************************************************
+//
+// Telemetry State
+//
+//*****************************************************************************
+
+static tSMBus TLM_Bus;                              // SMBus instance on TLM_I2C_BASE
+static const TelemetryChannel *TLM_Channels = 0;    // Channel table
+static uint32_t TLM_Count = 0;                      // Channels in the table
+static void (*TLM_Sink)(uint8_t Channel, uint32_t Value) = 0;
+
+static uint32_t TLM_Period = 0;                     // Poll period in ms (0 = stopped)
+static uint32_t TLM_NextRound = 0;                  // Time the next round is due
+static uint32_t TLM_Index = 0;                      // Channel being read
+static bool TLM_RoundActive = false;                // A round is in progress
+static bool TLM_Restart = false;                    // First round after TelemetryStart
+static bool TLM_Pending = false;                    // A transfer has been started
+static uint8_t TLM_Data[TLM_BLOCK_MAX];             // Receive buffer
+static volatile tSMBusStatus TLM_Error = SMBUS_OK;  // First error of the current transfer
+
+static TelemetryStats TLM_Stats;                    // Poller statistics
+
+//*****************************************************************************
+//
+// TelemetryRead: Starts the read of the current channel
+//
+// \return true if the transfer was started
+//
+//*****************************************************************************
+
+static bool TelemetryRead(void)
+{
+    const TelemetryChannel *Chan = &TLM_Channels[TLM_Index];
+    tSMBusStatus Status;
+
+    TLM_Error = SMBUS_OK;
+
+    if (Chan->Read == TLM_READ_BLOCK)
+    {
+        Status = SMBusMasterBlockRead(&TLM_Bus, Chan->Address, Chan->Command, TLM_Data);
+    }
+    else
+    {
+        Status = SMBusMasterByteWordRead(&TLM_Bus, Chan->Address, Chan->Command, TLM_Data,
+                                         (Chan->Read == TLM_READ_WORD) ? 2 : 1);
+    }
+
+    return Status == SMBUS_OK;
+}
+
+//*****************************************************************************
+//
+// TelemetryCollect: Hands the result of the finished transfer to the sink
+//
+//*****************************************************************************
+
+static void TelemetryCollect(void)
+{
+    const TelemetryChannel *Chan = &TLM_Channels[TLM_Index];
+    uint32_t Value = 0;
+    uint32_t Size, lop;
+
+    if (TLM_Error == SMBUS_PEC_ERROR)
+    {
+        TLM_Stats.PecErrors++;
+        return;
+    }
+    if (TLM_Error != SMBUS_OK)
+    {
+        TLM_Stats.Errors++;
+        return;
+    }
+
+    // SMBus sends multi-byte values LSB first
+    Size = (Chan->Read == TLM_READ_BLOCK) ? SMBusRxPacketSizeGet(&TLM_Bus) :
+           (Chan->Read == TLM_READ_WORD) ? 2 : 1;
+    if (Size > 4)
+    {
+        Size = 4;
+    }
+    for (lop = 0; lop < Size; lop++)
+    {
+        Value |= (uint32_t)TLM_Data[lop] << (lop * 8);
+    }
+
+    TLM_Stats.Readings++;
+    if (TLM_Sink)
+    {
+        TLM_Sink(Chan->Channel, Value);
+    }
+}
+
+//*****************************************************************************
+//
+// TelemetryInit: Sets up I2C1 as an SMBus master with PEC and registers the
+// channel table
+//
+// \param SysClock: System clock in Hz
+// \param Channels: Channel table, read in order every period
+// \param Count:    Number of channels in the table
+// \param Sink:     Receives each good reading (called from the main loop)
+//
+//*****************************************************************************
+
+void TelemetryInit(uint32_t SysClock, const TelemetryChannel *Channels, uint32_t Count,
+                   void (*Sink)(uint8_t Channel, uint32_t Value))
+{
+    TLM_Channels = Channels;
+    TLM_Count = Count;
+    TLM_Sink = Sink;
+    TLM_Period = 0;
+
+    // I2C1 on pins A6 (SCL) and A7 (SDA)
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_I2C1);
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOA);
+    MAP_GPIOPinConfigure(GPIO_PA6_I2C1SCL);
+    MAP_GPIOPinConfigure(GPIO_PA7_I2C1SDA);
+    MAP_GPIOPinTypeI2CSCL(GPIO_PORTA_BASE, GPIO_PIN_6);
+    MAP_GPIOPinTypeI2C(GPIO_PORTA_BASE, GPIO_PIN_7);
+
+    // SMBus runs at 100 kHz with a 25 ms clock low timeout
+    SMBusMasterInit(&TLM_Bus, TLM_I2C_BASE, SysClock);
+    SMBusPECEnable(&TLM_Bus);
+    SMBusMasterIntEnable(&TLM_Bus);
+}
+
+//*****************************************************************************
+//
+// TelemetryStart: Starts polling every PeriodMS milliseconds
+//
+//*****************************************************************************
+
+void TelemetryStart(uint32_t PeriodMS)
+{
+    TLM_Period = PeriodMS;
+    TLM_Restart = true;
+}
+
+//*****************************************************************************
+//
+// TelemetryStop: Stops polling after the transfer in progress
+//
+//*****************************************************************************
+
+void TelemetryStop(void)
+{
+    TLM_Period = 0;
+}
+
+//*****************************************************************************
+//
+// TelemetryRunning: Checks whether the poller is started
+//
+//*****************************************************************************
+
+bool TelemetryRunning(void)
+{
+    return TLM_Period != 0;
+}
+
+//*****************************************************************************
+//
+// TelemetryPoll: Collects finished reads and starts the next one; called from
+// the main loop
+//
+// \param NowMS:    Current time in milliseconds
+//
+//*****************************************************************************
+
+void TelemetryPoll(uint32_t NowMS)
+{
+    if (TLM_Pending)
+    {
+        if (SMBusStatusGet(&TLM_Bus) == SMBUS_TRANSFER_IN_PROGRESS)
+        {
+            return;
+        }
+        TLM_Pending = false;
+        TelemetryCollect();
+        TLM_Index++;
+    }
+
+    if ((TLM_Period == 0) || (TLM_Count == 0))
+    {
+        TLM_RoundActive = false;
+        return;
+    }
+
+    if (TLM_RoundActive && (TLM_Index >= TLM_Count))
+    {
+        TLM_RoundActive = false;
+    }
+
+    // Start a new round when it is due
+    if (TLM_Restart)
+    {
+        TLM_NextRound = NowMS;
+        TLM_Restart = false;
+    }
+    if (!TLM_RoundActive)
+    {
+        if ((int32_t)(NowMS - TLM_NextRound) < 0)
+        {
+            return;
+        }
+
+        // Skip rounds the bus could not keep up with rather than bunching them
+        TLM_NextRound += TLM_Period;
+        if ((int32_t)(NowMS - TLM_NextRound) >= 0)
+        {
+            TLM_Stats.Overruns++;
+            TLM_NextRound = NowMS + TLM_Period;
+        }
+
+        TLM_Index = 0;
+        TLM_RoundActive = true;
+    }
+
+    // A busy bus is retried on the next call
+    if (TelemetryRead())
+    {
+        TLM_Pending = true;
+    }
+}
+
+//*****************************************************************************
+//
+// TelemetryBusy: Checks if an SMBus transfer is on the bus
+//
+//*****************************************************************************
+
+bool TelemetryBusy(void)
+{
+    return TLM_Pending && (SMBusStatusGet(&TLM_Bus) == SMBUS_TRANSFER_IN_PROGRESS);
+}
+
+//*****************************************************************************
+//
+// TelemetryClockSet: Keeps SMBus at 100 kHz after a system clock change; call
+// while no transfer is on the bus
+//
+// \param SysClock: New system clock in Hz
+//
+//*****************************************************************************
+
+void TelemetryClockSet(uint32_t SysClock)
+{
+    MAP_I2CMasterInitExpClk(TLM_I2C_BASE, SysClock, false);
+}
+
+//*****************************************************************************
+//
+// TelemetryNextDue: Gets the time until TelemetryPoll has work to do, e.g. to
+// sleep until then
+//
+// \param NowMS:    Current time in milliseconds
+//
+// \return ms to the next round, 0 while a round has reads to start, 1 while a
+// read is on the bus (its interrupt usually comes first), 0xFFFFFFFF when
+// stopped
+//
+//*****************************************************************************
+
+uint32_t TelemetryNextDue(uint32_t NowMS)
+{
+    if (TLM_Pending)
+    {
+        return 1;
+    }
+    if (TLM_RoundActive || TLM_Restart)
+    {
+        return 0;
+    }
+    if ((TLM_Period == 0) || (TLM_Count == 0))
+    {
+        return 0xFFFFFFFF;
+    }
+    if ((int32_t)(TLM_NextRound - NowMS) <= 0)
+    {
+        return 0;
+    }
+    return TLM_NextRound - NowMS;
+}
+
+//*****************************************************************************
+//
+// TelemetryStatsGet: Copies the current poller statistics
+//
+// \param Stats:    Pointer to the structure to fill in
+//
+//*****************************************************************************
+
+void TelemetryStatsGet(TelemetryStats *Stats)
+{
+    *Stats = TLM_Stats;
+}
+
+//*****************************************************************************
+//
+// TelemetryIntHandler: I2C1 interrupt handler; advances the SMBus transfer
+//
+//*****************************************************************************
+
+void TelemetryIntHandler(void)
+{
+    tSMBusStatus Status;
+
+    Status = SMBusMasterIntProcess(&TLM_Bus);
+
+    // Keep the first error of the transfer; the error STOP that follows reports OK
+    if ((Status != SMBUS_OK) && (TLM_Error == SMBUS_OK))
+    {
+        TLM_Error = Status;
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ smbus_telemetry.h
+
+ Periodic, interrupt-driven polling of SMBus/PMBus devices on I2C1 using the
+ utils/smbus.c stack.
+ */
+
+#ifndef SMBUS_TELEMETRY_H_
+#define SMBUS_TELEMETRY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Telemetry Settings
+//
+//*****************************************************************************
+
+#define TLM_I2C_BASE        I2C1_BASE   // I2C module used as the SMBus master (PA6 SCL, PA7 SDA)
+#define TLM_BLOCK_MAX       32          // Largest SMBus block read
+
+// How a channel is read from its device
+enum {
+    TLM_READ_BYTE = 1,                  // Read Byte (8-bit value)
+    TLM_READ_WORD,                      // Read Word (16-bit value, LSB first)
+    TLM_READ_BLOCK                      // Block Read (first 4 bytes, LSB first)
+};
+
+// One polled value; the caller keeps the table for the lifetime of the poller
+typedef struct {
+    uint8_t Address;                    // 7-bit SMBus address
+    uint8_t Command;                    // SMBus/PMBus command code
+    uint8_t Read;                       // TLM_READ_*
+    uint8_t Channel;                    // Channel number reported with the reading
+} TelemetryChannel;
+
+// Poller statistics
+typedef struct {
+    uint32_t Readings;                  // Successful reads
+    uint32_t Errors;                    // Reads ended by a NACK, timeout or lost arbitration
+    uint32_t PecErrors;                 // Reads whose PEC byte did not match
+    uint32_t Overruns;                  // Rounds that were still running when the next one was due
+} TelemetryStats;
+
+extern void TelemetryInit(uint32_t SysClock, const TelemetryChannel *Channels, uint32_t Count,
+                          void (*Sink)(uint8_t Channel, uint32_t Value));
+extern void TelemetryStart(uint32_t PeriodMS);
+extern void TelemetryStop(void);
+extern bool TelemetryRunning(void);
+extern void TelemetryPoll(uint32_t NowMS);
+extern bool TelemetryBusy(void);
+extern void TelemetryClockSet(uint32_t SysClock);
+extern uint32_t TelemetryNextDue(uint32_t NowMS);
+extern void TelemetryStatsGet(TelemetryStats *Stats);
+extern void TelemetryIntHandler(void);
+
+#endif /* SMBUS_TELEMETRY_H_ */
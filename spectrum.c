@@ -0,0 +1,415 @@
+/*
+ spectrum.c
+
+ Spectrum analysis of sample blocks.
+
+ • Samples are collected into a frame, the mean (DC) is removed and the frame
+   is scaled to use the Q15 range before a Hann window is applied
+ • The transform is an in-place radix-4 decimation-in-frequency FFT on Q15
+   complex data; every stage divides by 4, which scales the result by 1/Size
+   and cannot overflow as long as no input has a magnitude above 1.0 (always
+   true for the real frames analysed here), and the output is put back in
+   order by a base-4 digit reversal at the end
+ • Twiddle factors and the window come from one quarter-wave sine table in
+   flash (the same scheme as utils/sine.c, in Q15 and with 256 steps per
+   quarter), so no table is built in SRAM at run time
+ • Peaks are local maxima of the magnitude spectrum. Their frequency offset and
+   amplitude come from the larger neighbouring bin with the exact two-bin Hann
+   interpolation, which also removes the up to 15 % scalloping loss of a tone
+   between bins (a parabola through three bins leaves both biased)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "utils/isqrt.h"
+#include "spectrum.h"
+
+//*****************************************************************************
+//
+// Twiddle Table
+//
+// Sine of the first ninety degrees in 257 steps ([0] = 0, [256] = 90 degrees),
+// Q15. Angles are in units of 1/1024 of a circle.
+//
+//*****************************************************************************
+
+#define FFT_ANGLE_STEPS     1024                    // Angle units per circle
+
+static const int16_t FFT_SineTable[(FFT_ANGLE_STEPS / 4) + 1] =
+{
+    0x0000, 0x00C9, 0x0192, 0x025B, 0x0324, 0x03ED, 0x04B6, 0x057F, 0x0648,
+    0x0711, 0x07D9, 0x08A2, 0x096A, 0x0A33, 0x0AFB, 0x0BC4, 0x0C8C, 0x0D54,
+    0x0E1C, 0x0EE3, 0x0FAB, 0x1072, 0x113A, 0x1201, 0x12C8, 0x138F, 0x1455,
+    0x151C, 0x15E2, 0x16A8, 0x176E, 0x1833, 0x18F9, 0x19BE, 0x1A82, 0x1B47,
+    0x1C0B, 0x1CCF, 0x1D93, 0x1E57, 0x1F1A, 0x1FDD, 0x209F, 0x2161, 0x2223,
+    0x22E5, 0x23A6, 0x2467, 0x2528, 0x25E8, 0x26A8, 0x2767, 0x2826, 0x28E5,
+    0x29A3, 0x2A61, 0x2B1F, 0x2BDC, 0x2C99, 0x2D55, 0x2E11, 0x2ECC, 0x2F87,
+    0x3041, 0x30FB, 0x31B5, 0x326E, 0x3326, 0x33DF, 0x3496, 0x354D, 0x3604,
+    0x36BA, 0x376F, 0x3824, 0x38D9, 0x398C, 0x3A40, 0x3AF2, 0x3BA5, 0x3C56,
+    0x3D07, 0x3DB8, 0x3E68, 0x3F17, 0x3FC5, 0x4073, 0x4121, 0x41CE, 0x427A,
+    0x4325, 0x43D0, 0x447A, 0x4524, 0x45CD, 0x4675, 0x471C, 0x47C3, 0x4869,
+    0x490F, 0x49B4, 0x4A58, 0x4AFB, 0x4B9D, 0x4C3F, 0x4CE0, 0x4D81, 0x4E20,
+    0x4EBF, 0x4F5D, 0x4FFB, 0x5097, 0x5133, 0x51CE, 0x5268, 0x5302, 0x539B,
+    0x5432, 0x54C9, 0x5560, 0x55F5, 0x568A, 0x571D, 0x57B0, 0x5842, 0x58D3,
+    0x5964, 0x59F3, 0x5A82, 0x5B0F, 0x5B9C, 0x5C28, 0x5CB3, 0x5D3E, 0x5DC7,
+    0x5E4F, 0x5ED7, 0x5F5D, 0x5FE3, 0x6068, 0x60EB, 0x616E, 0x61F0, 0x6271,
+    0x62F1, 0x6370, 0x63EE, 0x646C, 0x64E8, 0x6563, 0x65DD, 0x6656, 0x66CF,
+    0x6746, 0x67BC, 0x6832, 0x68A6, 0x6919, 0x698B, 0x69FD, 0x6A6D, 0x6ADC,
+    0x6B4A, 0x6BB7, 0x6C23, 0x6C8E, 0x6CF8, 0x6D61, 0x6DC9, 0x6E30, 0x6E96,
+    0x6EFB, 0x6F5E, 0x6FC1, 0x7022, 0x7083, 0x70E2, 0x7140, 0x719D, 0x71F9,
+    0x7254, 0x72AE, 0x7307, 0x735E, 0x73B5, 0x740A, 0x745F, 0x74B2, 0x7504,
+    0x7555, 0x75A5, 0x75F3, 0x7641, 0x768D, 0x76D8, 0x7722, 0x776B, 0x77B3,
+    0x77FA, 0x783F, 0x7884, 0x78C7, 0x7909, 0x794A, 0x7989, 0x79C8, 0x7A05,
+    0x7A41, 0x7A7C, 0x7AB6, 0x7AEE, 0x7B26, 0x7B5C, 0x7B91, 0x7BC5, 0x7BF8,
+    0x7C29, 0x7C59, 0x7C88, 0x7CB6, 0x7CE3, 0x7D0E, 0x7D39, 0x7D62, 0x7D89,
+    0x7DB0, 0x7DD5, 0x7DFA, 0x7E1D, 0x7E3E, 0x7E5F, 0x7E7E, 0x7E9C, 0x7EB9,
+    0x7ED5, 0x7EEF, 0x7F09, 0x7F21, 0x7F37, 0x7F4D, 0x7F61, 0x7F74, 0x7F86,
+    0x7F97, 0x7FA6, 0x7FB4, 0x7FC1, 0x7FCD, 0x7FD8, 0x7FE1, 0x7FE9, 0x7FF0,
+    0x7FF5, 0x7FF9, 0x7FFD, 0x7FFE, 0x7FFF
+};
+
+//*****************************************************************************
+//
+// Spectrum State
+//
+//*****************************************************************************
+
+// The raw samples are collected as 32-bit words in the same slots that later
+// hold the complex Q15 values (real, imaginary), and converted in place
+static union {
+    uint32_t Raw[FFT_MAX_SIZE];
+    int16_t Complex[FFT_MAX_SIZE * 2];
+} SP_Frame;
+
+static uint32_t SP_Size = 0;                    // Transform size of the current frame
+static uint32_t SP_Count = 0;                   // Samples collected so far
+
+//*****************************************************************************
+//
+// FftSin: Returns the sine of an angle in 1/1024 circle units, Q15
+//
+//*****************************************************************************
+
+static int32_t FftSin(uint32_t Angle)
+{
+    Angle &= (FFT_ANGLE_STEPS - 1);
+
+    if (Angle < (FFT_ANGLE_STEPS / 4))
+    {
+        return FFT_SineTable[Angle];
+    }
+    if (Angle < (FFT_ANGLE_STEPS / 2))
+    {
+        return FFT_SineTable[(FFT_ANGLE_STEPS / 2) - Angle];
+    }
+    if (Angle < ((FFT_ANGLE_STEPS * 3) / 4))
+    {
+        return -FFT_SineTable[Angle - (FFT_ANGLE_STEPS / 2)];
+    }
+    return -FFT_SineTable[FFT_ANGLE_STEPS - Angle];
+}
+
+#define FftCos(Angle)       FftSin((Angle) + (FFT_ANGLE_STEPS / 4))
+
+//*****************************************************************************
+//
+// FftRadix4Q15: In-place forward FFT of Size complex Q15 values
+//
+// \param Data:     Interleaved real and imaginary parts, in and out
+// \param Size:     Transform size, a power of 4 from FFT_MIN_SIZE to FFT_MAX_SIZE
+//
+// The result is in natural order and scaled by 1/Size. Inputs must have a
+// magnitude of at most 1.0 (sqrt(re^2 + im^2) <= 32767), or the rotated
+// butterfly outputs can exceed the Q15 range.
+//
+//*****************************************************************************
+
+void FftRadix4Q15(int16_t *Data, uint32_t Size)
+{
+    uint32_t Span, Quarter, Step, Group, j, i, Rev, Digits, Tmp, lop;
+    int32_t W1r, W1i, W2r, W2i, W3r, W3i;
+    int32_t Ar, Ai, Br, Bi, Cr, Ci, Dr, Di;
+    int32_t T0r, T0i, T1r, T1i, T2r, T2i, T3r, T3i;
+    int32_t Yr, Yi;
+    int16_t *P0, *P1, *P2, *P3;
+
+    // Decimation in frequency: spans Size, Size/4, ... 4
+    for (Span = Size; Span >= 4; Span /= 4)
+    {
+        Quarter = Span / 4;
+        Step = FFT_ANGLE_STEPS / Span;          // Angle units per twiddle index
+
+        for (j = 0; j < Quarter; j++)
+        {
+            // W^k = cos(2 pi k / Span) - i sin(2 pi k / Span)
+            W1r = FftCos(j * Step);
+            W1i = -FftSin(j * Step);
+            W2r = FftCos(2 * j * Step);
+            W2i = -FftSin(2 * j * Step);
+            W3r = FftCos(3 * j * Step);
+            W3i = -FftSin(3 * j * Step);
+
+            for (Group = 0; Group < Size; Group += Span)
+            {
+                P0 = &Data[2 * (Group + j)];
+                P1 = P0 + (2 * Quarter);
+                P2 = P1 + (2 * Quarter);
+                P3 = P2 + (2 * Quarter);
+
+                // Scale by 1/4 on the way in so the sums fit Q15
+                Ar = P0[0] >> 2;
+                Ai = P0[1] >> 2;
+                Br = P1[0] >> 2;
+                Bi = P1[1] >> 2;
+                Cr = P2[0] >> 2;
+                Ci = P2[1] >> 2;
+                Dr = P3[0] >> 2;
+                Di = P3[1] >> 2;
+
+                T0r = Ar + Cr;
+                T0i = Ai + Ci;
+                T1r = Ar - Cr;
+                T1i = Ai - Ci;
+                T2r = Br + Dr;
+                T2i = Bi + Di;
+                T3r = Br - Dr;
+                T3i = Bi - Di;
+
+                P0[0] = (int16_t)(T0r + T2r);
+                P0[1] = (int16_t)(T0i + T2i);
+
+                // (T1 - i T3) * W1
+                Yr = T1r + T3i;
+                Yi = T1i - T3r;
+                P1[0] = (int16_t)(((Yr * W1r) - (Yi * W1i)) >> 15);
+                P1[1] = (int16_t)(((Yr * W1i) + (Yi * W1r)) >> 15);
+
+                // (T0 - T2) * W2
+                Yr = T0r - T2r;
+                Yi = T0i - T2i;
+                P2[0] = (int16_t)(((Yr * W2r) - (Yi * W2i)) >> 15);
+                P2[1] = (int16_t)(((Yr * W2i) + (Yi * W2r)) >> 15);
+
+                // (T1 + i T3) * W3
+                Yr = T1r - T3i;
+                Yi = T1i + T3r;
+                P3[0] = (int16_t)(((Yr * W3r) - (Yi * W3i)) >> 15);
+                P3[1] = (int16_t)(((Yr * W3i) + (Yi * W3r)) >> 15);
+            }
+        }
+    }
+
+    // Base-4 digit reversal puts the bins back in natural order
+    for (Digits = 0, Tmp = Size; Tmp > 1; Tmp /= 4)
+    {
+        Digits++;
+    }
+    for (i = 0; i < Size; i++)
+    {
+        for (Rev = 0, Tmp = i, lop = 0; lop < Digits; lop++)
+        {
+            Rev = (Rev << 2) | (Tmp & 3);
+            Tmp >>= 2;
+        }
+        if (i < Rev)
+        {
+            Tmp = ((uint32_t *)Data)[i];
+            ((uint32_t *)Data)[i] = ((uint32_t *)Data)[Rev];
+            ((uint32_t *)Data)[Rev] = Tmp;
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// SpectrumStart: Starts collecting a new frame
+//
+// \param Size:     Transform size, a power of 4 from FFT_MIN_SIZE to FFT_MAX_SIZE
+//
+// \return false if the size is not supported
+//
+//*****************************************************************************
+
+bool SpectrumStart(uint32_t Size)
+{
+    if ((Size < FFT_MIN_SIZE) || (Size > FFT_MAX_SIZE) || (Size & (Size - 1)) || (Size & 0xAAAAAAAA))
+    {
+        return false;
+    }
+
+    SP_Size = Size;
+    SP_Count = 0;
+    return true;
+}
+
+//*****************************************************************************
+//
+// SpectrumPut: Adds one sample to the frame
+//
+// \return true once the frame is full and ready for SpectrumAnalyze
+//
+//*****************************************************************************
+
+bool SpectrumPut(uint32_t Sample)
+{
+    if (SP_Count < SP_Size)
+    {
+        SP_Frame.Raw[SP_Count++] = Sample;
+    }
+
+    return (SP_Size != 0) && (SP_Count == SP_Size);
+}
+
+//*****************************************************************************
+//
+// SpectrumSize: Returns the transform size of the current frame
+//
+//*****************************************************************************
+
+uint32_t SpectrumSize(void)
+{
+    return SP_Size;
+}
+
+//*****************************************************************************
+//
+// SpectrumMagnitude: Returns the magnitude of bin Bin of the transformed frame
+//
+//*****************************************************************************
+
+static uint32_t SpectrumMagnitude(uint32_t Bin)
+{
+    int32_t Re = SP_Frame.Complex[2 * Bin];
+    int32_t Im = SP_Frame.Complex[(2 * Bin) + 1];
+
+    return isqrt((uint32_t)((Re * Re) + (Im * Im)));
+}
+
+//*****************************************************************************
+//
+// SpectrumAnalyze: Transforms the collected frame and finds its largest peaks
+//
+// \param SampleRate:   Sample rate of the frame in Hz
+// \param Peaks:        Receives the peaks, largest first
+// \param MaxPeaks:     Peaks wanted (up to SPECTRUM_MAX_PEAKS)
+//
+// \return Peaks found; 0 if the frame is not complete
+//
+//*****************************************************************************
+
+uint32_t SpectrumAnalyze(uint32_t SampleRate, SpectrumPeak *Peaks, uint32_t MaxPeaks)
+{
+    uint32_t lop, Slot, Found = 0;
+    uint32_t Size = SP_Size;
+    uint32_t Left, Mid, Right, Side, Offset, Amplitude;
+    int32_t Shift, Delta, Value;
+    int64_t Sum = 0;
+    uint32_t Mean, MaxDev = 0;
+    int64_t Amp;
+
+    if ((Size == 0) || (SP_Count != Size))
+    {
+        return 0;
+    }
+    if (MaxPeaks > SPECTRUM_MAX_PEAKS)
+    {
+        MaxPeaks = SPECTRUM_MAX_PEAKS;
+    }
+
+    // Remove the mean and find the shift that puts the largest deviation just
+    // below full scale
+    for (lop = 0; lop < Size; lop++)
+    {
+        Sum += SP_Frame.Raw[lop];
+    }
+    Mean = (uint32_t)(Sum / Size);
+    for (lop = 0; lop < Size; lop++)
+    {
+        Value = (int32_t)(SP_Frame.Raw[lop] - Mean);
+        if ((uint32_t)((Value < 0) ? -Value : Value) > MaxDev)
+        {
+            MaxDev = (Value < 0) ? -Value : Value;
+        }
+    }
+    for (Shift = 0; (MaxDev != 0) && (MaxDev < 0x4000); Shift++)
+    {
+        MaxDev <<= 1;
+    }
+    for (; MaxDev >= 0x8000; Shift--)
+    {
+        MaxDev >>= 1;
+    }
+
+    // Scale, apply the Hann window (1 - cos) / 2 and convert each slot to complex
+    for (lop = 0; lop < Size; lop++)
+    {
+        Value = (int32_t)(SP_Frame.Raw[lop] - Mean);
+        Value = (Shift >= 0) ? (Value << Shift) : (Value >> -Shift);
+        Value = (Value * ((32767 - FftCos(lop * (FFT_ANGLE_STEPS / Size))) >> 1)) >> 15;
+        SP_Frame.Complex[2 * lop] = (int16_t)Value;
+        SP_Frame.Complex[(2 * lop) + 1] = 0;
+    }
+
+    FftRadix4Q15(SP_Frame.Complex, Size);
+
+    // Local maxima between DC and Nyquist, kept sorted by magnitude
+    for (lop = 2; lop < (Size / 2) - 1; lop++)
+    {
+        Mid = SpectrumMagnitude(lop);
+        Left = SpectrumMagnitude(lop - 1);
+        Right = SpectrumMagnitude(lop + 1);
+        if ((Mid == 0) || (Mid < Left) || (Mid <= Right))
+        {
+            continue;
+        }
+
+        // Hann window: a tone d bins from this one (0 <= d <= 1/2, towards the
+        // larger neighbour) gives Side / Mid = (1 + d) / (2 - d). Offset is d
+        // in 1/256 bin units
+        Side = (Right > Left) ? Right : Left;
+        Offset = (2 * Side > Mid) ? ((((2 * Side) - Mid) * 256) / (Side + Mid)) : 0;
+        Offset = (Offset > 128) ? 128 : Offset;
+        Delta = (Right > Left) ? (int32_t)Offset : -(int32_t)Offset;
+
+        // The bin is down by sin(pi d) / (pi d (1 - d^2)) from the peak; pi d is
+        // 2 * Offset angle units, and pi in Q16 is 205887
+        Amplitude = Mid;
+        if (Offset != 0)
+        {
+            Amplitude = (uint32_t)(((int64_t)Mid * 205887 * Offset * (65536 - (Offset * Offset))) /
+                                   ((int64_t)FftSin(2 * Offset) << 25));
+        }
+
+        for (Slot = Found; (Slot > 0) && (Peaks[Slot - 1].Amplitude < Amplitude); Slot--)
+        {
+            if (Slot < MaxPeaks)
+            {
+                Peaks[Slot] = Peaks[Slot - 1];
+            }
+        }
+        if (Slot >= MaxPeaks)
+        {
+            continue;
+        }
+        if (Found < MaxPeaks)
+        {
+            Found++;
+        }
+
+        Peaks[Slot].Bin = lop;
+        Peaks[Slot].FreqHz = (uint32_t)(((((int64_t)lop * 256) + Delta) * SampleRate) / ((int64_t)Size * 256));
+        Peaks[Slot].Amplitude = Amplitude;      // Spectrum units until the list is final
+    }
+
+    // Undo the FFT scaling (1/Size), the Hann coherent gain (1/2), the one-sided
+    // spectrum (1/2) and the input shift
+    for (lop = 0; lop < Found; lop++)
+    {
+        Amp = (int64_t)Peaks[lop].Amplitude * 4;
+        Peaks[lop].Amplitude = (uint32_t)((Shift >= 0) ? (Amp >> Shift) : (Amp << -Shift));
+    }
+
+    SP_Count = 0;
+    return Found;
+}
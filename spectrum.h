@@ -0,0 +1,37 @@
+/*
+ spectrum.h
+
+ Fixed-point radix-4 FFT and spectral peak detection over blocks of recorded
+ or live samples.
+ */
+
+#ifndef SPECTRUM_H_
+#define SPECTRUM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Spectrum Settings
+//
+//*****************************************************************************
+
+#define FFT_MAX_SIZE            1024        // Largest transform (power of 4, 4 KB of SRAM)
+#define FFT_MIN_SIZE            16          // Smallest transform
+#define SPECTRUM_MAX_PEAKS      8           // Peaks reported by SpectrumAnalyze
+
+// Spectral peak
+typedef struct {
+    uint32_t Bin;                   // FFT bin of the peak
+    uint32_t FreqHz;                // Interpolated peak frequency in Hz
+    uint32_t Amplitude;             // Estimated sine amplitude in sample units
+} SpectrumPeak;
+
+extern void FftRadix4Q15(int16_t *Data, uint32_t Size);
+extern bool SpectrumStart(uint32_t Size);
+extern bool SpectrumPut(uint32_t Sample);
+extern uint32_t SpectrumAnalyze(uint32_t SampleRate, SpectrumPeak *Peaks, uint32_t MaxPeaks);
+extern uint32_t SpectrumSize(void);
+
+#endif /* SPECTRUM_H_ */
@@ -0,0 +1,73 @@
+/*
+ stack_monitor.c
+
+ Main stack high-water mark.
+
+ • The linker places the 2 KB stack (.stack, __stack up to __STACK_TOP in
+   tm4c123ge6pm.cmd) above .bss; nothing catches an overflow, which silently
+   corrupts whatever the linker put below it
+ • StackPaint fills everything between the bottom of the stack and the live
+   frame with STACK_PAINT; interrupts nest on the same stack (MSP), so their
+   frames are included in the mark
+ • StackUsageGet scans up from the bottom for the first overwritten word; the
+   scan takes a few microseconds per KB and is only meant for diagnostics
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stack_monitor.h"
+
+//*****************************************************************************
+//
+// Stack Monitor State
+//
+//*****************************************************************************
+
+extern uint32_t __stack;                        // Bottom of .stack (linker)
+extern uint32_t __STACK_TOP;                    // Initial stack pointer (tm4c123ge6pm.cmd)
+
+//*****************************************************************************
+//
+// StackPaint: Fills the unused stack with STACK_PAINT; call first thing in main
+//
+//*****************************************************************************
+
+void StackPaint(void)
+{
+    volatile uint32_t Marker = 0;               // Lives in the current frame
+    uint32_t *Word = &__stack;
+    uint32_t *End = (uint32_t *)((uint32_t)&Marker - STACK_PAINT_MARGIN);
+
+    while (Word < End)
+    {
+        *Word++ = STACK_PAINT;
+    }
+    (void)Marker;
+}
+
+//*****************************************************************************
+//
+// StackUsageGet: Reads the stack size, high-water mark and current use
+//
+// \param Usage:    Pointer to the structure to fill in
+//
+//*****************************************************************************
+
+void StackUsageGet(StackUsage *Usage)
+{
+    volatile uint32_t Marker = 0;
+    uint32_t *Word = &__stack;
+    uint32_t *Top = &__STACK_TOP;
+
+    while ((Word < Top) && (*Word == STACK_PAINT))
+    {
+        Word++;
+    }
+
+    Usage->Size = (uint32_t)Top - (uint32_t)&__stack;
+    Usage->HighWater = (uint32_t)Top - (uint32_t)Word;
+    Usage->Current = (uint32_t)Top - (uint32_t)&Marker;
+    Usage->Overflowed = (__stack != STACK_PAINT);
+    (void)Marker;
+}
@@ -0,0 +1,34 @@
+/*
+ stack_monitor.h
+
+ Stack painting: fills the unused part of the main stack with a pattern at
+ start-up so the deepest stack use so far (high-water mark) can be read back.
+ */
+
+#ifndef STACK_MONITOR_H_
+#define STACK_MONITOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Stack Monitor Settings
+//
+//*****************************************************************************
+
+#define STACK_PAINT             0xC0FFEE55  // Pattern of untouched stack words
+#define STACK_PAINT_MARGIN      64          // Bytes below the live stack left unpainted
+
+// Stack usage snapshot
+typedef struct {
+    uint32_t Size;                  // Stack size (linker command file)
+    uint32_t HighWater;             // Deepest use since StackPaint, in bytes
+    uint32_t Current;               // Use at the time of the call, in bytes
+    bool Overflowed;                // The bottom word was overwritten
+} StackUsage;
+
+extern void StackPaint(void);
+extern void StackUsageGet(StackUsage *Usage);
+
+#endif /* STACK_MONITOR_H_ */
@@ -0,0 +1,183 @@
+/*
+ stream_stats.c
+
+ Streaming statistics for live sensor monitoring.
+
+ • Every sample updates the statistics in constant time, so the monitor can
+   run on the live stream without keeping the samples
+ • Mean and variance use Welford's update, which avoids the cancellation of a
+   sum of squares on large values with small variations (a pressure signal
+   around its operating point)
+ • Mean and M2 are double: in single precision the mean update Delta / Count
+   falls below half an ulp of a ~1.5e5 mean once Count passes about 1e5 and
+   the mean (and with it M2) stops following the signal. The M4F FPU is single
+   precision only, so these three operations per sample are done in software;
+   the rate of change stays float
+ • The RMS is derived from the same state (RMS^2 = mean^2 + population variance)
+ • Snapshots are taken on demand and convert the state to integers in sample
+   units, so printing them needs no floating-point formatting
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "stream_stats.h"
+
+//*****************************************************************************
+//
+// StreamStatsInit: Sets the histogram range and clears the statistics
+//
+// \param Stats:        Statistics state
+// \param HistLow:      Lower limit of the first histogram bin
+// \param HistWidth:    Width of each of the STATS_BINS bins
+//
+//*****************************************************************************
+
+void StreamStatsInit(StreamStats *Stats, uint32_t HistLow, uint32_t HistWidth)
+{
+    Stats->HistLow = HistLow;
+    Stats->HistWidth = HistWidth ? HistWidth : 1;
+    StreamStatsReset(Stats);
+}
+
+//*****************************************************************************
+//
+// StreamStatsReset: Clears the statistics, keeping the histogram range
+//
+//*****************************************************************************
+
+void StreamStatsReset(StreamStats *Stats)
+{
+    uint32_t lop;
+
+    Stats->Count = 0;
+    Stats->Min = 0xFFFFFFFF;
+    Stats->Max = 0;
+    Stats->Last = 0;
+    Stats->LastTime = 0;
+    Stats->Mean = 0.0;
+    Stats->M2 = 0.0;
+    Stats->Rate = 0.0f;
+    Stats->MaxRate = 0.0f;
+    Stats->Under = 0;
+    Stats->Over = 0;
+    for (lop = 0; lop < STATS_BINS; lop++)
+    {
+        Stats->Hist[lop] = 0;
+    }
+}
+
+//*****************************************************************************
+//
+// StreamStatsPut: Adds one sample to the statistics
+//
+// \param Stats:    Statistics state
+// \param Value:    The sample
+// \param TimeMS:   Time the sample was taken, in ms
+//
+//*****************************************************************************
+
+void StreamStatsPut(StreamStats *Stats, uint32_t Value, uint32_t TimeMS)
+{
+    double Delta;
+    uint32_t Bin, Elapsed;
+
+    Stats->Count++;
+    if (Value < Stats->Min)
+    {
+        Stats->Min = Value;
+    }
+    if (Value > Stats->Max)
+    {
+        Stats->Max = Value;
+    }
+
+    // Welford: the second delta is taken against the updated mean
+    Delta = (double)Value - Stats->Mean;
+    Stats->Mean += Delta / (double)Stats->Count;
+    Stats->M2 += Delta * ((double)Value - Stats->Mean);
+
+    // Samples taken in the same millisecond do not give a usable rate
+    Elapsed = TimeMS - Stats->LastTime;
+    if ((Stats->Count > 1) && (Elapsed > 0))
+    {
+        Stats->Rate = ((float)Value - (float)Stats->Last) * 1000.0f / (float)Elapsed;
+        if (fabsf(Stats->Rate) > Stats->MaxRate)
+        {
+            Stats->MaxRate = fabsf(Stats->Rate);
+        }
+    }
+    Stats->Last = Value;
+    Stats->LastTime = TimeMS;
+
+    if (Value < Stats->HistLow)
+    {
+        Stats->Under++;
+    }
+    else
+    {
+        Bin = (Value - Stats->HistLow) / Stats->HistWidth;
+        if (Bin < STATS_BINS)
+        {
+            Stats->Hist[Bin]++;
+        }
+        else
+        {
+            Stats->Over++;
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// StreamStatsSnapshotGet: Converts the current statistics for reporting
+//
+// \param Stats:    Statistics state
+// \param Snap:     Receives the snapshot
+//
+// \return false if no samples have been seen yet
+//
+//*****************************************************************************
+
+bool StreamStatsSnapshotGet(const StreamStats *Stats, StreamStatsSnapshot *Snap)
+{
+    uint32_t lop;
+    double Variance;
+
+    Snap->Count = Stats->Count;
+    Snap->HistLow = Stats->HistLow;
+    Snap->HistWidth = Stats->HistWidth;
+    Snap->Under = Stats->Under;
+    Snap->Over = Stats->Over;
+    for (lop = 0; lop < STATS_BINS; lop++)
+    {
+        Snap->Hist[lop] = Stats->Hist[lop];
+    }
+
+    if (Stats->Count == 0)
+    {
+        Snap->Min = 0;
+        Snap->Max = 0;
+        Snap->Mean = 0;
+        Snap->StdDev = 0;
+        Snap->Rms = 0;
+        Snap->Rate = 0;
+        Snap->MaxRate = 0;
+        return false;
+    }
+
+    Snap->Min = Stats->Min;
+    Snap->Max = Stats->Max;
+    Snap->Mean = (uint32_t)(Stats->Mean + 0.5);
+
+    // Sample (n - 1) standard deviation; population variance for the RMS
+    Variance = (Stats->Count > 1) ? (Stats->M2 / (double)(Stats->Count - 1)) : 0.0;
+    Snap->StdDev = (uint32_t)(sqrt(Variance) + 0.5);
+    Snap->Rms = (uint32_t)(sqrt((Stats->Mean * Stats->Mean) + (Stats->M2 / (double)Stats->Count)) + 0.5);
+
+    Snap->Rate = (int32_t)Stats->Rate;
+    Snap->MaxRate = (uint32_t)Stats->MaxRate;
+
+    return true;
+}
@@ -0,0 +1,62 @@
+/*
+ stream_stats.h
+
+ Incremental statistics over a live sample stream: min/max, mean and variance
+ (Welford), RMS, rate of change and a fixed-bin histogram.
+ */
+
+#ifndef STREAM_STATS_H_
+#define STREAM_STATS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Stream Statistics Settings
+//
+//*****************************************************************************
+
+#define STATS_BINS              16          // Histogram bins between the low and high limits
+
+// Running state, updated in O(1) per sample
+typedef struct {
+    uint32_t Count;                 // Samples seen since the last reset
+    uint32_t Min;                   // Smallest sample
+    uint32_t Max;                   // Largest sample
+    uint32_t Last;                  // Previous sample (rate of change)
+    uint32_t LastTime;              // Time of the previous sample in ms
+    double Mean;                    // Running mean
+    double M2;                      // Sum of squared deviations from the mean
+    float Rate;                     // Rate of change between the last two samples, per second
+    float MaxRate;                  // Largest rate of change magnitude, per second
+    uint32_t HistLow;               // Lower limit of the first bin
+    uint32_t HistWidth;             // Width of one bin
+    uint32_t Under;                 // Samples below the first bin
+    uint32_t Over;                  // Samples above the last bin
+    uint32_t Hist[STATS_BINS];      // Sample counts per bin
+} StreamStats;
+
+// Snapshot in sample units, rounded to integers for printing
+typedef struct {
+    uint32_t Count;                 // Samples in the snapshot
+    uint32_t Min;                   // Smallest sample
+    uint32_t Max;                   // Largest sample
+    uint32_t Mean;                  // Mean
+    uint32_t StdDev;                // Sample standard deviation
+    uint32_t Rms;                   // Root mean square
+    int32_t Rate;                   // Latest rate of change per second
+    uint32_t MaxRate;               // Largest rate of change magnitude per second
+    uint32_t HistLow;               // Lower limit of the first bin
+    uint32_t HistWidth;             // Width of one bin
+    uint32_t Under;                 // Samples below the first bin
+    uint32_t Over;                  // Samples above the last bin
+    uint32_t Hist[STATS_BINS];      // Sample counts per bin
+} StreamStatsSnapshot;
+
+extern void StreamStatsInit(StreamStats *Stats, uint32_t HistLow, uint32_t HistWidth);
+extern void StreamStatsReset(StreamStats *Stats);
+extern void StreamStatsPut(StreamStats *Stats, uint32_t Value, uint32_t TimeMS);
+extern bool StreamStatsSnapshotGet(const StreamStats *Stats, StreamStatsSnapshot *Snap);
+
+#endif /* STREAM_STATS_H_ */
@@ -0,0 +1,184 @@
+/*
+ supervisor.c
+
+ Watchdog supervision of the main loop tasks.
+
+ • The main loop names the task it is about to run (SupervisorEnter); a task
+   that legitimately runs long, such as an export waiting on the UART or a
+   prompt waiting for the operator, reports progress with SupervisorKick
+ • WATCHDOG1 interrupts every SUP_PERIOD_MS; the check adds the period to the
+   current task's run time and only clears the interrupt (which reloads the
+   counter) while the task is within its budget. The budgets are set by the
+   application, above the longest bounded wait each task can make (a CAN send
+   times out after 5 s)
+ • A task that overruns its budget is saved in a crash dump with the registers
+   it was stopped at and the part is reset at once. The interrupt is left
+   pending, so the second timeout resets the part in hardware should saving
+   the dump hang
+ • The watchdog interrupt is routed to the NMI: it is taken even when the hang
+   is in an interrupt handler or with interrupts masked (IdleSleep)
+ • WATCHDOG1 runs from the 16 MHz PIOSC, so its period does not change with
+   the clock profile; its registers sit in a different clock domain and each
+   write must be followed by a wait for WRC. It stalls while the debugger
+   halts the core
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "inc/hw_watchdog.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/watchdog.h"
+#include "driverlib/rom.h"
+#include "driverlib/rom_map.h"
+
+#include "crash_dump.h"
+#include "supervisor.h"
+
+//*****************************************************************************
+//
+// Supervisor State
+//
+//*****************************************************************************
+
+static uint32_t SUP_Budget[SUP_MAX_TASKS];      // Longest run time of each task in ms
+static uint32_t SUP_Tasks = 0;                  // Tasks supervised, 0 = not started
+static volatile uint32_t SUP_Task = 0;          // Task running
+static volatile uint32_t SUP_Elapsed = 0;       // Run time of the task (or since its last kick)
+
+// Called by SupervisorIntHandler with the stacked registers; not static, the
+// handler branches to it from assembly
+void SupervisorCheck(uint32_t *Frame);
+
+//*****************************************************************************
+//
+// SUP_Sync: Waits for a WATCHDOG1 register write to complete
+//
+//*****************************************************************************
+
+static void SUP_Sync(void)
+{
+    while (!(HWREG(WATCHDOG1_BASE + WDT_O_CTL) & WDT_CTL_WRC))
+    {
+    }
+}
+
+//*****************************************************************************
+//
+// SupervisorInit: Starts the watchdog; call just before the main loop. Once
+// started it runs until the next reset
+//
+// \param BudgetMS: Longest run time of each task in ms (at least 2 periods)
+// \param Tasks:    Number of tasks, up to SUP_MAX_TASKS
+//
+//*****************************************************************************
+
+void SupervisorInit(const uint32_t *BudgetMS, uint32_t Tasks)
+{
+    uint32_t lop;
+
+    if (Tasks > SUP_MAX_TASKS)
+    {
+        Tasks = SUP_MAX_TASKS;
+    }
+    for (lop = 0; lop < Tasks; lop++)
+    {
+        SUP_Budget[lop] = BudgetMS[lop];
+    }
+    SUP_Elapsed = 0;
+    SUP_Tasks = Tasks;
+
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_WDOG1);
+    while (!MAP_SysCtlPeripheralReady(SYSCTL_PERIPH_WDOG1))
+    {
+    }
+
+    MAP_WatchdogReloadSet(WATCHDOG1_BASE, (SUP_WDT_HZ / 1000) * SUP_PERIOD_MS);
+    SUP_Sync();
+    MAP_WatchdogIntTypeSet(WATCHDOG1_BASE, WATCHDOG_INT_TYPE_NMI);
+    SUP_Sync();
+    MAP_WatchdogResetEnable(WATCHDOG1_BASE);
+    SUP_Sync();
+    MAP_WatchdogStallEnable(WATCHDOG1_BASE);
+    SUP_Sync();
+    MAP_WatchdogEnable(WATCHDOG1_BASE);
+    SUP_Sync();
+}
+
+//*****************************************************************************
+//
+// SupervisorEnter: Starts the run-time budget of a task
+//
+// \param Task:     Task about to run (index into the budgets)
+//
+//*****************************************************************************
+
+void SupervisorEnter(uint32_t Task)
+{
+    SUP_Elapsed = 0;
+    SUP_Task = Task;
+}
+
+//*****************************************************************************
+//
+// SupervisorKick: Restarts the budget of the running task; call where a long
+// task makes progress
+//
+//*****************************************************************************
+
+void SupervisorKick(void)
+{
+    SUP_Elapsed = 0;
+}
+
+//*****************************************************************************
+//
+// SupervisorTaskGet: Gets the task running, for the crash dump
+//
+//*****************************************************************************
+
+uint32_t SupervisorTaskGet(void)
+{
+    return SUP_Task;
+}
+
+//*****************************************************************************
+//
+// SupervisorCheck: Charges a watchdog period to the running task; saves a
+// crash dump and resets the part if the task overran its budget
+//
+// \param Frame:    Registers stacked when the NMI was taken
+//
+//*****************************************************************************
+
+void SupervisorCheck(uint32_t *Frame)
+{
+    SUP_Elapsed += SUP_PERIOD_MS;
+    if ((SUP_Task >= SUP_Tasks) || (SUP_Elapsed <= SUP_Budget[SUP_Task]))
+    {
+        MAP_WatchdogIntClear(WATCHDOG1_BASE);
+        SUP_Sync();
+        return;
+    }
+
+    CrashSave(CRASH_CAUSE_WATCHDOG, SUP_Task, Frame);
+    MAP_SysCtlReset();
+}
+
+//*****************************************************************************
+//
+// SupervisorIntHandler: NMI handler (the watchdog interrupt); passes the
+// stacked registers of the interrupted code to SupervisorCheck
+//
+//*****************************************************************************
+
+void SupervisorIntHandler(void)
+{
+    __asm("    tst     lr, #4\n"
+          "    ite     eq\n"
+          "    mrseq   r0, msp\n"
+          "    mrsne   r0, psp\n"
+          "    b.w     SupervisorCheck");
+}
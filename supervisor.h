@@ -0,0 +1,31 @@
+/*
+ supervisor.h
+
+ Watchdog supervision of the main loop tasks: each task has a run-time budget,
+ and a task that overruns it is reported in a crash dump before the part is
+ reset.
+ */
+
+#ifndef SUPERVISOR_H_
+#define SUPERVISOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Supervisor Settings
+//
+//*****************************************************************************
+
+#define SUP_PERIOD_MS           500         // Watchdog check period (a budget overrun is seen within this)
+#define SUP_WDT_HZ              16000000    // WATCHDOG1 clock (PIOSC, independent of the clock profile)
+#define SUP_MAX_TASKS           16          // Supervised tasks
+
+extern void SupervisorInit(const uint32_t *BudgetMS, uint32_t Tasks);
+extern void SupervisorEnter(uint32_t Task);
+extern void SupervisorKick(void);
+extern uint32_t SupervisorTaskGet(void);
+extern void SupervisorIntHandler(void);
+
+#endif /* SUPERVISOR_H_ */
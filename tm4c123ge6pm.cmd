@@ -10,7 +10,9 @@
 
 MEMORY
 {
-    FLASH (RX) : origin = 0x00000000, length = 0x00020000
+    FLASH (RX) : origin = 0x00000000, length = 0x0001F800
+    /* Last two 1 KB pages: parameter block journal (FlashParamSpace, main.c) */
+    PARAMS (R) : origin = 0x0001F800, length = 0x00000800
     SRAM (RWX) : origin = 0x20000000, length = 0x00008000
 }
 
@@ -35,11 +37,14 @@ SECTIONS
     .pinit  :   > FLASH
     .init_array : > FLASH
 
-    .vtable :   > 0x20000000
-    .data   :   > SRAM
-    .bss    :   > SRAM
-    .sysmem :   > SRAM
-    .stack  :   > SRAM
+    .vtable :   > 0x20000000, RUN_END(__vtable_end)
+    .data   :   > SRAM, RUN_END(__data_end)
+    .bss    :   > SRAM, RUN_END(__bss_end)
+    .sysmem :   > SRAM, RUN_END(__sysmem_end)
+    .stack  :   > SRAM, RUN_END(__stack_end)
 }
 
 __STACK_TOP = __stack + 2048;
+
+/* End of SRAM; the space above the last section is the RAM capture arena    */
+__SRAM_END = 0x20008000;
@@ -30,13 +30,17 @@
 //
 //*****************************************************************************
 void ResetISR(void);
-static void NmiSR(void);
-static void FaultISR(void);
 static void IntDefaultHandler(void);
 
 extern void SysTickIntHandler(void);
 extern void I2C0SlaveIntHandler(void);
+extern void TelemetryIntHandler(void);
+extern void AdcCaptureIntHandler(void);
 extern void IntCAN0Handler(void);
+extern void FlashWriterIntHandler(void);
+extern void UartStreamIntHandler(void);
+extern void SupervisorIntHandler(void);
+extern void CrashFaultHandler(void);
 
 
 
@@ -75,11 +79,11 @@ void (* const g_pfnVectors[])(void) =
     (void (*)(void))((uint32_t)&__STACK_TOP),
                                             // The initial stack pointer
     ResetISR,                               // The reset handler
-    NmiSR,                                  // The NMI handler
-    FaultISR,                               // The hard fault handler
-    IntDefaultHandler,                      // The MPU fault handler
-    IntDefaultHandler,                      // The bus fault handler
-    IntDefaultHandler,                      // The usage fault handler
+    SupervisorIntHandler,                   // The NMI handler (watchdog)
+    CrashFaultHandler,                      // The hard fault handler
+    CrashFaultHandler,                      // The MPU fault handler
+    CrashFaultHandler,                      // The bus fault handler
+    CrashFaultHandler,                      // The usage fault handler
     0,                                      // Reserved
     0,                                      // Reserved
     0,                                      // Reserved
@@ -94,7 +98,7 @@ void (* const g_pfnVectors[])(void) =
     IntDefaultHandler,                      // GPIO Port C
     IntDefaultHandler,                      // GPIO Port D
     IntDefaultHandler,                      // GPIO Port E
-    IntDefaultHandler,                      // UART0 Rx and Tx
+    UartStreamIntHandler,                   // UART0 Rx and Tx
     IntDefaultHandler,                      // UART1 Rx and Tx
     IntDefaultHandler,                      // SSI0 Rx and Tx
     I2C0SlaveIntHandler,                    // I2C0 Master and Slave
@@ -103,7 +107,7 @@ void (* const g_pfnVectors[])(void) =
     IntDefaultHandler,                      // PWM Generator 1
     IntDefaultHandler,                      // PWM Generator 2
     IntDefaultHandler,                      // Quadrature Encoder 0
-    IntDefaultHandler,                      // ADC Sequence 0
+    AdcCaptureIntHandler,                   // ADC Sequence 0
     IntDefaultHandler,                      // ADC Sequence 1
     IntDefaultHandler,                      // ADC Sequence 2
     IntDefaultHandler,                      // ADC Sequence 3
@@ -118,7 +122,7 @@ void (* const g_pfnVectors[])(void) =
     IntDefaultHandler,                      // Analog Comparator 1
     IntDefaultHandler,                      // Analog Comparator 2
     IntDefaultHandler,                      // System Control (PLL, OSC, BO)
-    IntDefaultHandler,                      // FLASH Control
+    FlashWriterIntHandler,                  // FLASH Control
     IntDefaultHandler,                      // GPIO Port F
     IntDefaultHandler,                      // GPIO Port G
     IntDefaultHandler,                      // GPIO Port H
@@ -126,7 +130,7 @@ void (* const g_pfnVectors[])(void) =
     IntDefaultHandler,                      // SSI1 Rx and Tx
     IntDefaultHandler,                      // Timer 3 subtimer A
     IntDefaultHandler,                      // Timer 3 subtimer B
-    IntDefaultHandler,                      // I2C1 Master and Slave
+    TelemetryIntHandler,                    // I2C1 Master and Slave
     IntDefaultHandler,                      // Quadrature Encoder 1
     IntCAN0Handler,                      // CAN0
     IntDefaultHandler,                      // CAN1
@@ -251,42 +255,6 @@ ResetISR(void)
           "    b.w     _c_int00");
 }
 
-//*****************************************************************************
-//
-// This is the code that gets called when the processor receives a NMI.  This
-// simply enters an infinite loop, preserving the system state for examination
-// by a debugger.
-//
-//*****************************************************************************
-static void
-NmiSR(void)
-{
-    //
-    // Enter an infinite loop.
-    //
-    while(1)
-    {
-    }
-}
-
-//*****************************************************************************
-//
-// This is the code that gets called when the processor receives a fault
-// interrupt.  This simply enters an infinite loop, preserving the system state
-// for examination by a debugger.
-//
-//*****************************************************************************
-static void
-FaultISR(void)
-{
-    //
-    // Enter an infinite loop.
-    //
-    while(1)
-    {
-    }
-}
-
 //*****************************************************************************
 //
 // This is the code that gets called when the processor receives an unexpected
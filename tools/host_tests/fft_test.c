@@ -0,0 +1,207 @@
+/*
+ fft_test.c
+
+ Host accuracy test and benchmark of the Q15 radix-4 FFT and the peak
+ detection of spectrum.c.
+
+ • FftRadix4Q15 is compared with a double-precision DFT (scaled by 1/Size like
+   the Q15 transform) on random complex data up to full-scale magnitude and on
+   single tones, for every supported size; the error is reported in Q15 LSB
+   and as an SNR (which drops with the size, since the output is scaled by
+   1/Size while the rounding error is not)
+ • SpectrumAnalyze is fed tones of known frequency and amplitude between bins,
+   on a DC offset with noise as the sample stream delivers them, and must
+   report the frequency within 0.05 bin (plus the 1 Hz resolution of FreqHz)
+   and the amplitude within 3 %
+ • Benchmark: microseconds per transform on the host
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "spectrum.h"
+#include "host_tests.h"
+
+#define RANDOM_ROUNDS   20          // Random frames per size
+#define TONE_ROUNDS     200         // Tones per size through SpectrumAnalyze
+#define FFT_STAGE_ERR   3.0         // Error against the double DFT per radix-4 stage, Q15 LSB
+#define FFT_MIN_SNR     45.0        // Worst SNR of a random full-scale frame (1024 points), dB
+#define SAMPLE_RATE     10000       // Sample rate given to SpectrumAnalyze, Hz
+
+static int16_t Data[2 * FFT_MAX_SIZE];
+static double RefRe[FFT_MAX_SIZE], RefIm[FFT_MAX_SIZE];
+
+// Double-precision DFT of Data, scaled by 1/Size
+static void Dft(uint32_t Size)
+{
+    uint32_t k, n;
+
+    for (k = 0; k < Size; k++)
+    {
+        double Re = 0, Im = 0;
+
+        for (n = 0; n < Size; n++)
+        {
+            double Angle = (-2.0 * M_PI * (double)((k * n) % Size)) / Size;
+
+            Re += (Data[2 * n] * cos(Angle)) - (Data[(2 * n) + 1] * sin(Angle));
+            Im += (Data[2 * n] * sin(Angle)) + (Data[(2 * n) + 1] * cos(Angle));
+        }
+        RefRe[k] = Re / Size;
+        RefIm[k] = Im / Size;
+    }
+}
+
+// Transforms Data and compares it with the DFT; returns the SNR in dB
+static double FftCompare(uint32_t Size, double *MaxErr)
+{
+    double Signal = 0, Noise = 0, Err;
+    uint32_t k;
+
+    Dft(Size);
+    FftRadix4Q15(Data, Size);
+    for (k = 0; k < Size; k++)
+    {
+        Err = hypot(Data[2 * k] - RefRe[k], Data[(2 * k) + 1] - RefIm[k]);
+        *MaxErr = (Err > *MaxErr) ? Err : *MaxErr;
+        Signal += (RefRe[k] * RefRe[k]) + (RefIm[k] * RefIm[k]);
+        Noise += Err * Err;
+    }
+    return 10.0 * log10(Signal / (Noise ? Noise : 1e-12));
+}
+
+static void FftCheck(void)
+{
+    uint32_t Size, Round, n, Bin, Stages;
+    double MaxErr, Snr, MinSnr;
+
+    printf("FFT Q15 against double DFT\n");
+    for (Size = FFT_MIN_SIZE; Size <= FFT_MAX_SIZE; Size *= 4)
+    {
+        MaxErr = 0;
+        MinSnr = 1000;
+        for (Stages = 0, n = Size; n > 1; n /= 4)
+        {
+            Stages++;
+        }
+
+        // Random data up to the full-scale magnitude (the FFT's input limit)
+        for (Round = 0; Round < RANDOM_ROUNDS; Round++)
+        {
+            for (n = 0; n < Size; n++)
+            {
+                double Mag = 32767.0 * sqrt((HostRandom() & 0xFFFF) / 65536.0);
+                double Angle = 2.0 * M_PI * ((HostRandom() & 0xFFFF) / 65536.0);
+
+                Data[2 * n] = (int16_t)(Mag * cos(Angle));
+                Data[(2 * n) + 1] = (int16_t)(Mag * sin(Angle));
+            }
+            Snr = FftCompare(Size, &MaxErr);
+            MinSnr = (Snr < MinSnr) ? Snr : MinSnr;
+        }
+
+        // Full-scale tones on exact bins
+        for (Bin = 0; Bin < Size; Bin += 1 + (Size / 16))
+        {
+            for (n = 0; n < Size; n++)
+            {
+                Data[2 * n] = (int16_t)lround(32000.0 * cos((2.0 * M_PI * Bin * n) / Size));
+                Data[(2 * n) + 1] = (int16_t)lround(32000.0 * sin((2.0 * M_PI * Bin * n) / Size));
+            }
+            FftCompare(Size, &MaxErr);
+            HOST_CHECK(fabs(Data[2 * Bin] - 32000.0) <= (FFT_STAGE_ERR * Stages), "size %u tone bin %u: %d", Size, Bin,
+                       Data[2 * Bin]);
+        }
+
+        printf("  %4u points: max error %.2f LSB, worst SNR %.1f dB\n", Size, MaxErr, MinSnr);
+        HOST_CHECK(MaxErr <= (FFT_STAGE_ERR * Stages), "size %u error %.2f LSB", Size, MaxErr);
+        HOST_CHECK(MinSnr >= FFT_MIN_SNR, "size %u SNR %.1f dB", Size, MinSnr);
+    }
+}
+
+//*****************************************************************************
+//
+// Peak detection: tones between bins, on a DC offset with noise
+//
+//*****************************************************************************
+
+static void SpectrumCheck(void)
+{
+    SpectrumPeak Peaks[SPECTRUM_MAX_PEAKS];
+    uint32_t Size, Round, n, Found;
+    double Freq, Amp, FreqErr, AmpErr, MaxFreqErr, MaxAmpErr;
+
+    printf("SpectrumAnalyze tones (%u Hz sampling)\n", SAMPLE_RATE);
+    for (Size = 64; Size <= FFT_MAX_SIZE; Size *= 4)
+    {
+        MaxFreqErr = 0;
+        MaxAmpErr = 0;
+        for (Round = 0; Round < TONE_ROUNDS; Round++)
+        {
+            // Between bins 4 and Size / 2 - 4, amplitude 1000..31000 counts
+            Freq = (4.0 + ((HostRandom() % 10000) / 10000.0) * ((Size / 2) - 8)) * SAMPLE_RATE / Size;
+            Amp = 1000 + (HostRandom() % 30000);
+
+            SpectrumStart(Size);
+            for (n = 0; n < Size; n++)
+            {
+                SpectrumPut((uint32_t)lround(100000.0 + (Amp * sin((2.0 * M_PI * Freq * n) / SAMPLE_RATE)) +
+                                             (int32_t)(HostRandom() % 21) - 10));
+            }
+            Found = SpectrumAnalyze(SAMPLE_RATE, Peaks, 1);
+            HOST_CHECK(Found == 1, "size %u: no peak for %.1f Hz", Size, Freq);
+            if (Found == 0)
+            {
+                continue;
+            }
+
+            FreqErr = (fabs(Peaks[0].FreqHz - Freq) - 1.0) * Size / SAMPLE_RATE;
+            FreqErr = (FreqErr < 0) ? 0 : FreqErr;
+            AmpErr = fabs(Peaks[0].Amplitude - Amp) / Amp;
+            MaxFreqErr = (FreqErr > MaxFreqErr) ? FreqErr : MaxFreqErr;
+            MaxAmpErr = (AmpErr > MaxAmpErr) ? AmpErr : MaxAmpErr;
+        }
+
+        printf("  %4u points: frequency within %.3f bin + 1 Hz, amplitude within %.2f %%\n", Size, MaxFreqErr,
+               MaxAmpErr * 100);
+        HOST_CHECK(MaxFreqErr <= 0.05, "size %u frequency error %.3f bin", Size, MaxFreqErr);
+        HOST_CHECK(MaxAmpErr <= 0.03, "size %u amplitude error %.2f %%", Size, MaxAmpErr * 100);
+    }
+}
+
+//*****************************************************************************
+//
+// Benchmark
+//
+//*****************************************************************************
+
+static void FftBench(void)
+{
+    uint32_t Size, Pass, Passes, n;
+    double Start;
+
+    printf("FFT Q15 time per transform (host)\n");
+    for (Size = FFT_MIN_SIZE; Size <= FFT_MAX_SIZE; Size *= 4)
+    {
+        for (n = 0; n < (2 * Size); n++)
+        {
+            Data[n] = (int16_t)HostRandom();
+        }
+        Passes = (1 << 22) / Size;
+        Start = HostSeconds();
+        for (Pass = 0; Pass < Passes; Pass++)
+        {
+            FftRadix4Q15(Data, Size);
+        }
+        printf("  %4u points: %8.2f us\n", Size, (HostSeconds() - Start) * 1e6 / Passes);
+    }
+}
+
+int main(void)
+{
+    FftCheck();
+    SpectrumCheck();
+    FftBench();
+    return HostDone("fft_test");
+}
@@ -0,0 +1,48 @@
+/*
+ host_tests.h
+
+ Shared helpers of the host test and benchmark programs: wall-clock timing,
+ a repeatable random number generator and a failure counter.
+ */
+
+#ifndef HOST_TESTS_H_
+#define HOST_TESTS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static int HostFailures = 0;                    // Failed checks
+static uint32_t HostSeed = 0x12345678;          // HostRandom state
+
+// Counts and reports a failed check
+#define HOST_CHECK(Cond, ...)   do { if (!(Cond)) { HostFailures++;                              \
+                                         printf("FAIL %s:%d: ", __FILE__, __LINE__);             \
+                                         printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+// Seconds from a monotonic clock
+static inline double HostSeconds(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return Now.tv_sec + (Now.tv_nsec * 1e-9);
+}
+
+// xorshift32; the same sequence on every run
+static inline uint32_t HostRandom(void)
+{
+    HostSeed ^= HostSeed << 13;
+    HostSeed ^= HostSeed >> 17;
+    HostSeed ^= HostSeed << 5;
+    return HostSeed;
+}
+
+// Prints the result line and returns the exit status of the program
+static inline int HostDone(const char *Name)
+{
+    printf("%s: %s (%d failures)\n", Name, HostFailures ? "FAILED" : "passed", HostFailures);
+    return HostFailures ? 1 : 0;
+}
+
+#endif /* HOST_TESTS_H_ */
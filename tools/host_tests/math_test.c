@@ -0,0 +1,240 @@
+/*
+ math_test.c
+
+ Host randomized accuracy test and benchmark of fixed_math.c.
+
+ • Each function is checked on random arguments spread over its whole range
+   (random bit lengths, so small values are covered as well as large ones)
+   and on the edge values, against exact integer or double-precision results:
+   FixRecipDiv and FixSqrt64 must be exact, FixLog2 within 1 Q16 LSB, FixAtan2
+   within the error of its polynomial, FixPolyApply within rounding
+ • The single-precision estimate FixSqrt64 starts from is measured on its own,
+   since it sets how much work the integer correction has to do
+ • Benchmark: nanoseconds per call on the host against the plain C or libm
+   equivalent
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "fixed_math.h"
+#include "utils/isqrt.h"
+#include "host_tests.h"
+
+#define CHECK_ROUNDS    2000000     // Random arguments per function
+#define BENCH_CALLS     10000000    // Calls per benchmark
+#define LOG2_MAX_ERR    1           // FixLog2 against log2, Q16 LSB
+#define ATAN_MAX_ERR    2e-5        // FixAtan2 against atan2, radians
+
+static volatile uint32_t Sink;      // Keeps the benchmarked results alive
+
+// Random value with a random number of significant bits (1..Bits)
+static uint64_t RandomBits(uint32_t Bits)
+{
+    uint64_t Value = ((uint64_t)HostRandom() << 32) | HostRandom();
+    uint32_t Keep = 1 + (HostRandom() % Bits);
+
+    return (Keep >= 64) ? Value : (Value & ((1ULL << Keep) - 1));
+}
+
+// Exact floor(sqrt(Value)) by bisection
+static uint32_t SqrtExact(uint64_t Value)
+{
+    uint64_t Low = 0, High = 0x100000000ULL, Mid;
+
+    while ((High - Low) > 1)
+    {
+        Mid = (Low + High) / 2;
+        if ((Mid * Mid) <= Value)
+        {
+            Low = Mid;
+        }
+        else
+        {
+            High = Mid;
+        }
+    }
+    return (uint32_t)Low;
+}
+
+//*****************************************************************************
+//
+// Accuracy
+//
+//*****************************************************************************
+
+static void RecipCheck(void)
+{
+    static const uint32_t Edges[] = { 1, 2, 3, 7, 10, 641, 0x7FFFFFFF, 0x80000000, 0x80000001, 0xFFFFFFFF };
+    FixRecip Recip;
+    uint32_t Round, Divisor, Value, lop;
+
+    for (Round = 0; Round < CHECK_ROUNDS; Round++)
+    {
+        Divisor = (Round < 10) ? Edges[Round] : (uint32_t)RandomBits(32);
+        Divisor = Divisor ? Divisor : 1;
+        FixRecipInit(&Recip, Divisor);
+        for (lop = 0; lop < 4; lop++)
+        {
+            Value = (lop == 0) ? 0xFFFFFFFF : (uint32_t)RandomBits(32);
+            HOST_CHECK(FixRecipDiv(&Recip, Value) == (Value / Divisor), "FixRecipDiv %u / %u", Value, Divisor);
+        }
+    }
+    printf("FixRecipDiv: exact on %d divisors x 4 dividends\n", CHECK_ROUNDS);
+}
+
+static void SqrtCheck(void)
+{
+    static const uint64_t Edges[] = { 0, 1, 2, 3, 4, 0xFFFFFFFE00000001ULL, 0xFFFFFFFFFFFFFFFFULL,
+                                      0xFFFFFFFE00000000ULL, 1ULL << 62, (1ULL << 62) - 1 };
+    uint32_t Round, Root, Exact, FloatErr, MaxFloatErr = 0;
+    uint64_t Value;
+
+    for (Round = 0; Round < CHECK_ROUNDS; Round++)
+    {
+        Value = (Round < 10) ? Edges[Round] : RandomBits(64);
+
+        // Also just below and at perfect squares, where the floor changes
+        if ((Round & 3) == 1)
+        {
+            Value = (uint64_t)(uint32_t)Value * (uint32_t)Value - (HostRandom() & 1);
+        }
+
+        Root = FixSqrt64(Value);
+        Exact = SqrtExact(Value);
+        HOST_CHECK(Root == Exact, "FixSqrt64(%llu) = %u, expected %u", (unsigned long long)Value, Root, Exact);
+
+        FloatErr = (uint32_t)llabs((int64_t)(uint64_t)sqrtf((float)Value) - (int64_t)Exact);
+        MaxFloatErr = (FloatErr > MaxFloatErr) ? FloatErr : MaxFloatErr;
+    }
+    printf("FixSqrt64: exact on %d values; the float estimate alone was off by up to %u\n", CHECK_ROUNDS,
+           MaxFloatErr);
+
+    for (Round = 0; Round < 100000; Round++)
+    {
+        int32_t X = (int32_t)HostRandom(), Y = (int32_t)HostRandom();
+
+        Exact = SqrtExact(((int64_t)X * X) + ((int64_t)Y * Y));
+        HOST_CHECK(FixHypot(X, Y) == Exact, "FixHypot(%d, %d)", X, Y);
+    }
+}
+
+static void Log2Check(void)
+{
+    uint32_t Round, Value;
+    int32_t Result, Exact, Err, MaxErr = 0;
+
+    HOST_CHECK(FixLog2(0) == FIX_LOG2_ZERO, "FixLog2(0)");
+    for (Round = 0; Round < CHECK_ROUNDS; Round++)
+    {
+        Value = (Round < 32) ? (1U << Round) : (uint32_t)RandomBits(32);
+        Value = Value ? Value : 1;
+        Result = FixLog2(Value);
+        Exact = (int32_t)floor(log2((double)Value) * 65536.0);
+        Err = abs(Result - Exact);
+        MaxErr = (Err > MaxErr) ? Err : MaxErr;
+    }
+    printf("FixLog2: within %d Q16 LSB of log2\n", MaxErr);
+    HOST_CHECK(MaxErr <= LOG2_MAX_ERR, "FixLog2 error %d LSB", MaxErr);
+}
+
+static void Atan2Check(void)
+{
+    uint32_t Round;
+    int32_t X, Y;
+    double Exact, Got, Err, MaxErr = 0;
+
+    for (Round = 0; Round < CHECK_ROUNDS; Round++)
+    {
+        X = (int32_t)RandomBits(32);
+        Y = (int32_t)RandomBits(32);
+        if ((X | Y) == 0)
+        {
+            continue;
+        }
+        Exact = atan2((double)Y, (double)X);
+        Got = (int32_t)FixAtan2(Y, X) * (2.0 * M_PI / 4294967296.0);
+        Err = fabs(remainder(Got - Exact, 2.0 * M_PI));
+        MaxErr = (Err > MaxErr) ? Err : MaxErr;
+    }
+    printf("FixAtan2: within %.2e rad of atan2\n", MaxErr);
+    HOST_CHECK(MaxErr <= ATAN_MAX_ERR, "FixAtan2 error %.2e rad", MaxErr);
+}
+
+static void PolyCheck(void)
+{
+    FixPoly Poly = { 3, { -120.5f, 0.0125f, 2.5e-7f, -1.0e-12f } };
+    uint32_t Round;
+    int32_t Raw, Result;
+    double Exact, Err, MaxErr = 0;
+
+    for (Round = 0; Round < CHECK_ROUNDS; Round++)
+    {
+        Raw = (int32_t)(HostRandom() % 400001) - 200000;
+        Result = FixPolyApply(&Poly, Raw);
+        Exact = Poly.Coeffs[0] + (Raw * (Poly.Coeffs[1] + (Raw * (Poly.Coeffs[2] + (Raw * (double)Poly.Coeffs[3])))));
+        Err = fabs(Result - Exact);
+        MaxErr = (Err > MaxErr) ? Err : MaxErr;
+    }
+    printf("FixPolyApply: within %.3f of the double-precision polynomial\n", MaxErr);
+    HOST_CHECK(MaxErr <= 0.51, "FixPolyApply error %.3f", MaxErr);
+
+    Poly.Order = 1;
+    Poly.Coeffs[0] = 0;
+    Poly.Coeffs[1] = 1e6f;
+    HOST_CHECK(FixPolyApply(&Poly, 100000) == 0x7FFFFFFF, "FixPolyApply saturation high");
+    HOST_CHECK(FixPolyApply(&Poly, -100000) == (-0x7FFFFFFF - 1), "FixPolyApply saturation low");
+}
+
+//*****************************************************************************
+//
+// Benchmarks: arguments are precomputed so the loop measures the function
+//
+//*****************************************************************************
+
+#define BENCH_ARGS      4096
+
+static uint64_t Args64[BENCH_ARGS];
+static uint32_t Args32[BENCH_ARGS];
+
+#define BENCH(Name, Expr)   do { double Start = HostSeconds(); uint32_t Call;                      \
+                                 for (Call = 0; Call < BENCH_CALLS; Call++) { Sink += (uint32_t)(Expr); } \
+                                 printf("  %-26s %6.2f ns\n", Name, (HostSeconds() - Start) * 1e9 / BENCH_CALLS); } while (0)
+
+static void MathBench(void)
+{
+    FixRecip Recip;
+    uint32_t Divisor = 1000003, lop;
+
+    for (lop = 0; lop < BENCH_ARGS; lop++)
+    {
+        Args64[lop] = RandomBits(64);
+        Args32[lop] = (uint32_t)RandomBits(32) | 1;
+    }
+    FixRecipInit(&Recip, Divisor);
+
+    printf("Time per call (host)\n");
+    BENCH("Value / Divisor", Args32[Call & (BENCH_ARGS - 1)] / Divisor);
+    BENCH("FixRecipDiv", FixRecipDiv(&Recip, Args32[Call & (BENCH_ARGS - 1)]));
+    BENCH("FixSqrt64", FixSqrt64(Args64[Call & (BENCH_ARGS - 1)]));
+    BENCH("sqrtl (64-bit exact)", sqrtl((long double)Args64[Call & (BENCH_ARGS - 1)]));
+    BENCH("isqrt (32-bit)", isqrt(Args32[Call & (BENCH_ARGS - 1)]));
+    BENCH("FixLog2", FixLog2(Args32[Call & (BENCH_ARGS - 1)]));
+    BENCH("log2f", log2f((float)Args32[Call & (BENCH_ARGS - 1)]) * 65536.0f);
+    BENCH("FixAtan2", FixAtan2((int32_t)Args32[Call & (BENCH_ARGS - 1)], (int32_t)Args32[(Call + 1) & (BENCH_ARGS - 1)]));
+    BENCH("atan2f", atan2f((float)(int32_t)Args32[Call & (BENCH_ARGS - 1)],
+                           (float)(int32_t)Args32[(Call + 1) & (BENCH_ARGS - 1)]) * 1e6f);
+}
+
+int main(void)
+{
+    RecipCheck();
+    SqrtCheck();
+    Log2Check();
+    Atan2Check();
+    PolyCheck();
+    MathBench();
+    return HostDone("math_test");
+}
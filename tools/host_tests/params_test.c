@@ -0,0 +1,225 @@
+/*
+ params_test.c
+
+ Host power-loss test of the flash parameter journal (flash_params.c on
+ utils/flash_pb.c).
+
+ • The journal addresses of main.c are backed by host memory mapped at the
+   same address, since flash_pb turns the addresses into pointers
+ • FlashErase and FlashProgram are replaced by models of the flash: programming
+   can only clear bits, erasing sets a page to ones. Either can be cut short
+   by a simulated power loss after a random number of words, leaving a torn
+   word (some of its bits programmed) or a partly erased page behind
+ • After every cut the part "reboots" (FlashParamsInit rescans the journal) and
+   the parameters must be those of the last save that completed, or of the
+   interrupted save if its block had been fully written; anything else is a
+   torn block accepted as valid
+ • Save latency comes from FlashParamsSaveCycles; the flash models advance the
+   cycle counter by the programming and erase times below
+ */
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "host_tests.h"
+
+//*****************************************************************************
+//
+// Flash Model
+//
+//*****************************************************************************
+
+#define PARAM_START     0x1F800     // FlashParamSpace of main.c
+#define PARAM_END       0x20000     // FlashParamEnd of main.c
+#define PAGE_SIZE       1024        // TM4C123 flash page (erase unit)
+#define CPU_HZ          80000000    // System clock while busy
+#define PROGRAM_US      50          // Assumed time to program one word
+#define ERASE_US        15000       // Assumed time to erase one page
+#define SAVES           200000      // Saves attempted
+#define CUT_ONE_IN      3           // One save in this many loses power
+
+static uint32_t SimCycles = 0;      // Simulated DWT cycle counter
+static int32_t CutAfter = -1;       // Flash operations left before the power cut, -1 = none
+static jmp_buf PowerLost;           // Where a power cut returns to
+
+// flash_params.c is built here so its cycle counter can be replaced by the
+// model
+#define CYCLE_COUNTER_H_
+#define CycleCounterGet()       (SimCycles)
+#include "../../flash_params.c"
+
+// No recording in progress
+bool FlashWriterBusy(void)
+{
+    return false;
+}
+
+uint32_t SysCtlFlashSectorSizeGet(void)
+{
+    return PAGE_SIZE;
+}
+
+// Counts a flash operation down to the power cut; true if power is lost now
+static bool PowerCut(void)
+{
+    if (CutAfter < 0)
+    {
+        return false;
+    }
+    return (CutAfter-- == 0);
+}
+
+int32_t FlashErase(uint32_t Address)
+{
+    uint32_t *Page = (uint32_t *)(uintptr_t)Address;
+    uint32_t lop;
+
+    if (PowerCut())
+    {
+        // Partly erased: some words erased, the rest as they were
+        for (lop = 0; lop < (PAGE_SIZE / 4); lop++)
+        {
+            if (HostRandom() & 1)
+            {
+                Page[lop] = 0xFFFFFFFF;
+            }
+        }
+        longjmp(PowerLost, 1);
+    }
+
+    memset(Page, 0xFF, PAGE_SIZE);
+    SimCycles += (uint32_t)((uint64_t)ERASE_US * CPU_HZ / 1000000);
+    return 0;
+}
+
+int32_t FlashProgram(uint32_t *Data, uint32_t Address, uint32_t Count)
+{
+    uint32_t *Flash = (uint32_t *)(uintptr_t)Address;
+    uint32_t lop;
+
+    for (lop = 0; lop < (Count / 4); lop++)
+    {
+        if (PowerCut())
+        {
+            // Torn word: only some of its bits have been cleared
+            Flash[lop] &= Data[lop] | HostRandom();
+            longjmp(PowerLost, 1);
+        }
+        Flash[lop] &= Data[lop];
+        SimCycles += (uint32_t)((uint64_t)PROGRAM_US * CPU_HZ / 1000000);
+    }
+    return 0;
+}
+
+//*****************************************************************************
+//
+// Test
+//
+//*****************************************************************************
+
+// Compares the parameters, ignoring the bytes maintained by the journal
+static bool ParamsEqual(const FlashParams *A, const FlashParams *B)
+{
+    return (memcmp(&A->Version, &B->Version, offsetof(FlashParams, Crc) - offsetof(FlashParams, Version)) == 0);
+}
+
+// Changes some of the parameters, as the firmware does between saves
+static void ParamsChange(FlashParams *Params)
+{
+    uint32_t lop;
+
+    Params->BootCount++;
+    Params->RecordingSeq = HostRandom();
+    Params->LastSampleSize = HostRandom() & 0xFFFFF;
+    Params->LastSampleCrc = HostRandom();
+    if ((HostRandom() & 7) == 0)
+    {
+        lop = HostRandom() % FLASH_PARAMS_CAL_SLOTS;
+        Params->Cal[lop].ModuleID = HostRandom();
+        memset(&Params->Cal[lop].Poly, (int)(HostRandom() & 0xFF), sizeof(Params->Cal[lop].Poly));
+    }
+}
+
+int main(void)
+{
+    static FlashParams Committed, Attempt;
+    volatile uint32_t Cuts = 0, Recovered = 0, Completed = 0, Torn = 0, Failed = 0;
+    uint32_t Save, Ops;
+    uint64_t CyclesTotal = 0;
+    void *Map;
+
+    // Page-aligned host mapping covering the journal
+    Map = mmap((void *)(uintptr_t)(PARAM_START & ~0xFFF), 0x1000, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (Map != (void *)(uintptr_t)(PARAM_START & ~0xFFF))
+    {
+        printf("cannot map the journal at 0x%X\n", PARAM_START);
+        return 1;
+    }
+    memset((void *)(uintptr_t)PARAM_START, 0xFF, PARAM_END - PARAM_START);
+
+    FlashParamsInit(PARAM_START, PARAM_END);
+    HOST_CHECK(FlashParamsGet()->Version == FLASH_PARAMS_VERSION, "defaults on a blank journal");
+    Committed = *FlashParamsGet();
+
+    for (Save = 0; Save < SAVES; Save++)
+    {
+        ParamsChange(FlashParamsGet());
+        Attempt = *FlashParamsGet();
+
+        // Erase (at most once) plus the words of a block
+        Ops = 1 + (sizeof(FlashParams) / 4);
+        CutAfter = ((HostRandom() % CUT_ONE_IN) == 0) ? (int32_t)(HostRandom() % Ops) : -1;
+
+        if (setjmp(PowerLost) == 0)
+        {
+            bool Ok = FlashParamsSave();
+
+            CutAfter = -1;
+            HOST_CHECK(Ok, "save %u failed without a power cut", Save);
+            Failed += !Ok;
+            Committed = Attempt;
+            CyclesTotal += FlashParamsSaveCycles(false);
+            continue;
+        }
+
+        // Power lost: reboot and see what the journal gives back
+        CutAfter = -1;
+        Cuts++;
+        FlashParamsInit(PARAM_START, PARAM_END);
+        if (ParamsEqual(FlashParamsGet(), &Committed))
+        {
+            Recovered++;
+        }
+        else if (ParamsEqual(FlashParamsGet(), &Attempt))
+        {
+            Completed++;
+            Committed = Attempt;
+        }
+        else
+        {
+            Torn++;
+            Committed = *FlashParamsGet();
+        }
+    }
+
+    // The journal survives a final clean reboot
+    FlashParamsInit(PARAM_START, PARAM_END);
+    HOST_CHECK(ParamsEqual(FlashParamsGet(), &Committed), "parameters lost over a clean reboot");
+
+    printf("%u saves, %u power cuts: %u rolled back, %u kept the new block, %u torn blocks accepted\n",
+           SAVES, Cuts, Recovered, Completed, Torn);
+    HOST_CHECK(Torn == 0, "%u torn blocks accepted as valid", Torn);
+
+    printf("Save latency at %u MHz (assumed %u us/word, %u us/page erase):\n", CPU_HZ / 1000000,
+           PROGRAM_US, ERASE_US);
+    printf("  mean %.2f ms, worst %.2f ms (with a page erase)\n",
+           (CyclesTotal / (double)(SAVES - Cuts - Failed)) * 1000.0 / CPU_HZ,
+           FlashParamsSaveCycles(true) * 1000.0 / CPU_HZ);
+
+    return HostDone("params_test");
+}
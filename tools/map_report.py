@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""
+ map_report.py
+
+ Flash and SRAM usage report from a TI ARM linker map (Debug/*.map).
+
+ • Prints the MEMORY CONFIGURATION totals and the MODULE SUMMARY grouped by
+   origin (application objects, driverlib, utils, run-time library)
+ • Given a second (baseline) map, prints the change per group, e.g. to see what
+   moving driverlib calls to ROM (TARGET_IS_BLIZZARD_RB1) saved
+ • SRAM budget: the output sections placed in SRAM (.vtable, .stack, .bss,
+   .data, .sysmem), the largest variables in them and the SRAM left over for
+   capture buffers. The stack is only the reserved size; the firmware's
+   'stack' command reports how much of it has actually been used
+
+ Usage: python tools/map_report.py Debug/Inkley_MasterTester.map [baseline.map]
+"""
+
+import re
+import sys
+
+SRAM_BASE = 0x20000000                  # SRAM region of tm4c123ge6pm.cmd
+TOP_OBJECTS = 12                        # Largest SRAM variables listed
+
+# Module summary group names, keyed by the directory line of the map
+def GroupName(Directory):
+    Directory = Directory.replace('/', '\\').rstrip('\\').lower()
+    if Directory.endswith('driverlib'):
+        return 'driverlib'
+    if Directory.endswith('utils'):
+        return 'utils'
+    if Directory.endswith('.lib'):
+        return 'rts'
+    if Directory in ('.', ''):
+        return 'application'
+    return Directory
+
+
+def MapRead(Path):
+    """Returns ({region: (length, used)}, {group: [code, ro, rw]},
+    {section: [origin, length, [(size, object), ...]]}) of a map."""
+    Regions = {}
+    Groups = {}
+    Sections = {}
+    Group = None
+    Output = None
+    Section = None
+
+    with open(Path, errors='replace') as File:
+        for Line in File:
+            Text = Line.strip()
+            if Text in ('MEMORY CONFIGURATION', 'MODULE SUMMARY', 'SEGMENT ALLOCATION MAP',
+                        'SECTION ALLOCATION MAP', 'GLOBAL SYMBOLS: SORTED ALPHABETICALLY BY Name'):
+                Section = Text
+                continue
+
+            if Section == 'MEMORY CONFIGURATION':
+                Match = re.match(r'(\w+)\s+([0-9a-f]{8})\s+([0-9a-f]{8})\s+([0-9a-f]{8})\s+([0-9a-f]{8})', Text)
+                if Match:
+                    Regions[Match.group(1)] = (int(Match.group(3), 16), int(Match.group(4), 16))
+
+            elif Section == 'SECTION ALLOCATION MAP':
+                Match = re.match(r'(\.\w+)\s+0\s+([0-9a-f]{8})\s+([0-9a-f]{8})', Line)
+                if Match:
+                    Output = Sections.setdefault(Match.group(1), [int(Match.group(2), 16),
+                                                                  int(Match.group(3), 16), []])
+                    continue
+                Match = re.match(r'\s+([0-9a-f]{8})\s+([0-9a-f]{8})\s+(.+)$', Line)
+                if Match and Output is not None and '--HOLE--' not in Line:
+                    Output[2].append((int(Match.group(2), 16), ObjectName(Match.group(3))))
+
+            elif Section == 'MODULE SUMMARY':
+                if Text.startswith('Grand Total'):
+                    break
+                if not Text or Text.startswith(('Module', '-', '+', 'Total:')):
+                    continue
+                Match = re.match(r'(.+?):?\s+(\d+)\s+(\d+)\s+(\d+)$', Text)
+                if Match is None:
+                    Group = GroupName(Text)         # Directory or library heading
+                    continue
+                Name = Group or 'application'
+                if Text.startswith(('Stack:', 'Linker Generated:')):
+                    Name = Match.group(1).lower()
+                Sizes = Groups.setdefault(Name, [0, 0, 0])
+                for Index in range(3):
+                    Sizes[Index] += int(Match.group(Index + 2))
+
+    return Regions, Groups, Sections
+
+
+# Readable name of a section allocation entry, e.g. "RcvString" or
+# "main.obj CAN_MODULES"
+def ObjectName(Entry):
+    Entry = Entry.split(': ')[-1].strip()           # Drop the library name
+    Match = re.search(r'\(\.common:(\w+)\)', Entry)
+    if Match:
+        return Match.group(1)
+    Match = re.match(r'(\S+)\s+\(\.\w+:?([\w.]*)\)', Entry)
+    if Match:
+        return (Match.group(1) + ' ' + Match.group(2)).strip()
+    return Entry
+
+
+def SramBudget(Regions, Sections):
+    Length, Used = Regions.get('SRAM', (0, 0))
+    Ram = {Name: Value for Name, Value in Sections.items() if Value[0] >= SRAM_BASE and Value[1]}
+
+    print('\nSRAM budget (bytes)')
+    for Name in sorted(Ram, key=lambda Key: Ram[Key][0]):
+        print('  %-16s %8d  at %08x' % (Name, Ram[Name][1], Ram[Name][0]))
+    print('  %-16s %8d' % ('spare', Length - Used))
+
+    Objects = sorted((Entry for Name in ('.bss', '.data') if Name in Ram for Entry in Ram[Name][2]), reverse=True)
+    print('\nLargest SRAM variables (bytes)')
+    for Size, Name in Objects[:TOP_OBJECTS]:
+        print('  %8d  %s' % (Size, Name))
+
+
+def Report(Path, BasePath=None):
+    Regions, Groups, Sections = MapRead(Path)
+    Base = MapRead(BasePath)[1] if BasePath else None
+
+    print('Memory (bytes)         used      size    free')
+    for Name, (Length, Used) in Regions.items():
+        print('  %-16s %8d  %8d  %6d  (%d%% used)' % (Name, Used, Length, Length - Used, (100 * Used) // Length))
+
+    print('\nModules (bytes)        code   ro data  rw data' + ('    flash change' if Base else ''))
+    for Name in sorted(Groups, key=lambda Key: -(Groups[Key][0] + Groups[Key][1])):
+        Code, Ro, Rw = Groups[Name]
+        Line = '  %-16s %8d  %8d  %7d' % (Name, Code, Ro, Rw)
+        if Base is not None:
+            Old = Base.get(Name, [0, 0, 0])
+            Line += '  %+14d' % ((Code + Ro) - (Old[0] + Old[1]))
+        print(Line)
+
+    if Base is not None:
+        Flash = sum(Sizes[0] + Sizes[1] for Sizes in Groups.values())
+        OldFlash = sum(Sizes[0] + Sizes[1] for Sizes in Base.values())
+        print('\nFlash code + ro data: %d -> %d bytes (%+d)' % (OldFlash, Flash, Flash - OldFlash))
+
+    SramBudget(Regions, Sections)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) not in (2, 3):
+        sys.exit(__doc__)
+    Report(sys.argv[1], sys.argv[2] if len(sys.argv) == 3 else None)
@@ -0,0 +1,250 @@
+/*
+ trigger_capture.c
+
+ Triggered capture with pre-trigger history.
+
+ • While armed every sample of the stream (local ADC or CAN sensor values) goes
+   into a circular buffer in SRAM, so the samples leading up to an event are
+   already in memory when it happens
+ • A trigger comes either from the software threshold checked here on each
+   sample, or from outside at a given stream index (the ADC digital comparator)
+ • After the trigger Post more samples are collected and the window is frozen;
+   it is then committed to flash through the normal recording path, so only
+   the interesting part of a long idle period is stored
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "flash_writer.h"
+#include "sample_codec.h"
+#include "trigger_capture.h"
+
+//*****************************************************************************
+//
+// Triggered Capture State
+//
+//*****************************************************************************
+
+static uint32_t TC_Buffer[TRIG_BUFFER_SAMPLES];  // Circular sample history
+static uint32_t TC_Head = 0;                    // Next slot to write
+static uint32_t TC_PreWanted = 0;               // Pre-trigger samples requested
+static uint32_t TC_PostWanted = 0;              // Post-trigger samples requested
+static uint32_t TC_Level = 0;                   // Software threshold
+static uint32_t TC_Edges = 0;                   // TRIG_EDGE_* flags, 0 = threshold off
+static bool TC_FireSet = false;                 // External trigger pending
+static uint32_t TC_FireIndex = 0;               // Stream index of the external trigger
+static uint32_t TC_Prev = 0;                    // Previous sample (edge detection)
+static SampleEncoder TC_Encoder;                // Compressor used by TriggerCaptureCommit
+
+static TriggerCaptureStatus TC_Status;          // Capture status
+
+//*****************************************************************************
+//
+// TriggerCaptureArm: Clears the history and starts waiting for a trigger
+//
+// \param Pre:      Samples to keep from before the trigger
+// \param Post:     Samples to collect after the trigger (including the trigger sample)
+//
+// \return false if the window does not fit the buffer
+//
+//*****************************************************************************
+
+bool TriggerCaptureArm(uint32_t Pre, uint32_t Post)
+{
+    if ((Post == 0) || ((Pre + Post) > TRIG_BUFFER_SAMPLES))
+    {
+        return false;
+    }
+
+    TC_PreWanted = Pre;
+    TC_PostWanted = Post;
+    TC_Head = 0;
+    TC_FireSet = false;
+
+    TC_Status.Pre = 0;
+    TC_Status.Post = 0;
+    TC_Status.TriggerIndex = 0;
+    TC_Status.TriggerValue = 0;
+    TC_Status.Samples = 0;
+    TC_Status.State = TRIG_ARMED;
+    return true;
+}
+
+//*****************************************************************************
+//
+// TriggerCaptureDisarm: Abandons the capture
+//
+//*****************************************************************************
+
+void TriggerCaptureDisarm(void)
+{
+    TC_Status.State = TRIG_IDLE;
+}
+
+//*****************************************************************************
+//
+// TriggerCaptureLevelSet: Configures the software threshold trigger
+//
+// \param Level:    Threshold value
+// \param Edges:    TRIG_EDGE_RISING and/or TRIG_EDGE_FALLING, 0 to disable
+//
+//*****************************************************************************
+
+void TriggerCaptureLevelSet(uint32_t Level, uint32_t Edges)
+{
+    TC_Level = Level;
+    TC_Edges = Edges;
+}
+
+//*****************************************************************************
+//
+// TriggerCaptureFireAt: Triggers at the given stream index (counted from the
+// start of the stream feeding TriggerCapturePut, so hardware triggers can be
+// matched to the sample they belong to)
+//
+//*****************************************************************************
+
+void TriggerCaptureFireAt(uint32_t Index)
+{
+    if (TC_Status.State == TRIG_ARMED)
+    {
+        TC_FireIndex = Index;
+        TC_FireSet = true;
+    }
+}
+
+//*****************************************************************************
+//
+// TriggerCapturePut: Adds the next sample of the stream
+//
+//*****************************************************************************
+
+void TriggerCapturePut(uint32_t Sample)
+{
+    bool Fire = false;
+    uint32_t Index;
+
+    if ((TC_Status.State != TRIG_ARMED) && (TC_Status.State != TRIG_POST))
+    {
+        return;
+    }
+
+    Index = TC_Status.Samples++;
+    TC_Buffer[TC_Head] = Sample;
+    TC_Head = (TC_Head + 1) % TRIG_BUFFER_SAMPLES;
+
+    if (TC_Status.State == TRIG_POST)
+    {
+        if (++TC_Status.Post == TC_PostWanted)
+        {
+            TC_Status.State = TRIG_DONE;
+        }
+        return;
+    }
+
+    // Armed: check the external trigger and the threshold crossing
+    if (TC_FireSet && ((int32_t)(Index - TC_FireIndex) >= 0))
+    {
+        Fire = true;
+    }
+    else if (Index > 0)
+    {
+        if ((TC_Edges & TRIG_EDGE_RISING) && (TC_Prev < TC_Level) && (Sample >= TC_Level))
+        {
+            Fire = true;
+        }
+        if ((TC_Edges & TRIG_EDGE_FALLING) && (TC_Prev >= TC_Level) && (Sample < TC_Level))
+        {
+            Fire = true;
+        }
+    }
+    TC_Prev = Sample;
+
+    if (Fire)
+    {
+        TC_Status.TriggerIndex = Index;
+        TC_Status.TriggerValue = Sample;
+        TC_Status.Pre = (Index < TC_PreWanted) ? Index : TC_PreWanted;
+        TC_Status.Post = 1;
+        TC_Status.State = (TC_PostWanted == 1) ? TRIG_DONE : TRIG_POST;
+    }
+}
+
+//*****************************************************************************
+//
+// TriggerCaptureState: Returns the capture state (TRIG_*)
+//
+//*****************************************************************************
+
+uint32_t TriggerCaptureState(void)
+{
+    return TC_Status.State;
+}
+
+//*****************************************************************************
+//
+// TriggerCaptureCommit: Writes the frozen window to flash in stream order and
+// returns to idle; blocks until the flash writer has finished
+//
+// \param Address:  Page-aligned start of the recording
+// \param Compress: Store the window compressed
+//
+// \return Size of the window in bytes (as raw 32-bit samples), 0 if no window
+// was frozen or the flash writer is busy
+//
+//*****************************************************************************
+
+uint32_t TriggerCaptureCommit(uint32_t Address, bool Compress)
+{
+    uint32_t Count, Slot, lop;
+
+    if (TC_Status.State != TRIG_DONE)
+    {
+        return 0;
+    }
+
+    Count = TC_Status.Pre + TC_Status.Post;
+    if (!FlashWriterStart(Address, Compress ? CODEC_WORST_CASE(Count * 4) : (Count * 4)))
+    {
+        return 0;
+    }
+    SampleEncodeInit(&TC_Encoder, FlashWriterPut);
+
+    // The newest sample is just behind the head; the window ends there
+    Slot = (TC_Head + TRIG_BUFFER_SAMPLES - Count) % TRIG_BUFFER_SAMPLES;
+    for (lop = 0; lop < Count; lop++)
+    {
+        if (Compress)
+        {
+            SampleEncodePut(&TC_Encoder, TC_Buffer[Slot]);
+        }
+        else
+        {
+            FlashWriterPut(TC_Buffer[Slot]);
+        }
+        Slot = (Slot + 1) % TRIG_BUFFER_SAMPLES;
+    }
+
+    if (Compress)
+    {
+        SampleEncodeFlush(&TC_Encoder);
+    }
+    FlashWriterSync();
+
+    TC_Status.State = TRIG_IDLE;
+    return Count * 4;
+}
+
+//*****************************************************************************
+//
+// TriggerCaptureStatusGet: Copies the current capture status
+//
+// \param Status:   Pointer to the structure to fill in
+//
+//*****************************************************************************
+
+void TriggerCaptureStatusGet(TriggerCaptureStatus *Status)
+{
+    *Status = TC_Status;
+}
@@ -0,0 +1,53 @@
+/*
+ trigger_capture.h
+
+ Triggered capture: keeps a circular pre-trigger history of a sample stream
+ and freezes a window of pre- and post-trigger samples around an event.
+ */
+
+#ifndef TRIGGER_CAPTURE_H_
+#define TRIGGER_CAPTURE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Triggered Capture Settings
+//
+//*****************************************************************************
+
+#define TRIG_BUFFER_SAMPLES     2048        // Capture window limit (pre + post samples, 8 KB of SRAM)
+
+// Capture states
+enum {
+    TRIG_IDLE = 0,                  // Not armed
+    TRIG_ARMED,                     // Filling the pre-trigger history, waiting for a trigger
+    TRIG_POST,                      // Triggered, collecting post-trigger samples
+    TRIG_DONE                       // Window frozen, ready to be committed
+};
+
+// Software threshold edges (TriggerCaptureLevelSet)
+#define TRIG_EDGE_RISING        0x01        // Sample rises to or above the level
+#define TRIG_EDGE_FALLING       0x02        // Sample falls below the level
+
+// Capture status
+typedef struct {
+    uint32_t State;                 // TRIG_*
+    uint32_t Pre;                   // Pre-trigger samples in the window
+    uint32_t Post;                  // Post-trigger samples in the window
+    uint32_t TriggerIndex;          // Stream index of the trigger sample
+    uint32_t TriggerValue;          // Value of the trigger sample
+    uint32_t Samples;               // Samples seen since arming
+} TriggerCaptureStatus;
+
+extern bool TriggerCaptureArm(uint32_t Pre, uint32_t Post);
+extern void TriggerCaptureDisarm(void);
+extern void TriggerCaptureLevelSet(uint32_t Level, uint32_t Edges);
+extern void TriggerCaptureFireAt(uint32_t Index);
+extern void TriggerCapturePut(uint32_t Sample);
+extern uint32_t TriggerCaptureState(void);
+extern uint32_t TriggerCaptureCommit(uint32_t Address, bool Compress);
+extern void TriggerCaptureStatusGet(TriggerCaptureStatus *Status);
+
+#endif /* TRIGGER_CAPTURE_H_ */
@@ -0,0 +1,331 @@
+/*
+ uart_stream.c
+
+ UART0 transmit ring drained by uDMA.
+
+ • Once started, everything sent on UART0 (menu text, replies and stream
+   records) goes through a ring buffer in SRAM; uDMA moves it to the UART FIFO
+   in the background, so a message costs only its formatting and a copy into
+   the ring, and the main loop only waits on the serial line when the ring is
+   full
+ • Each transfer covers the contiguous bytes between the read position and
+   the end of the ring; its completion interrupt (on the UART0 vector) moves
+   the read position and starts the next one
+ • Sample records are all-or-nothing: when the ring cannot take a whole record
+   it is dropped and counted, which is the backpressure signal that the link
+   is slower than the sample stream. Text (menu replies, reports) waits for
+   room instead, and those waits are counted as stalls
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_uart.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/uart.h"
+#include "driverlib/udma.h"
+#include "driverlib/rom.h"
+#include "driverlib/rom_map.h"
+
+#include "dma_table.h"
+#include "uart_stream.h"
+
+//*****************************************************************************
+//
+// UART Stream State
+//
+//*****************************************************************************
+
+static uint8_t UST_Buffer[UST_BUFFER_SIZE];     // Transmit ring
+static volatile uint32_t UST_Head = 0;          // Next byte to write (main loop)
+static volatile uint32_t UST_Tail = 0;          // Next byte to send (interrupt)
+static volatile uint32_t UST_InFlight = 0;      // Bytes of the running uDMA transfer
+static volatile bool UST_Active = false;        // Output goes through the ring
+static UartStreamStats UST_Stats;               // Stream statistics
+
+//*****************************************************************************
+//
+// UST_Kick: Starts a transfer of the pending bytes up to the end of the ring
+// if none is running; called with the UART0 interrupt masked or from it
+//
+//*****************************************************************************
+
+static void UST_Kick(void)
+{
+    uint32_t Length;
+
+    if (UST_InFlight || (UST_Head == UST_Tail))
+    {
+        return;
+    }
+
+    Length = (UST_Head - UST_Tail) & (UST_BUFFER_SIZE - 1);
+    if (Length > (UST_BUFFER_SIZE - UST_Tail))
+    {
+        Length = UST_BUFFER_SIZE - UST_Tail;
+    }
+    if (Length > UST_MAX_TRANSFER)
+    {
+        Length = UST_MAX_TRANSFER;
+    }
+
+    UST_InFlight = Length;
+    UST_Stats.Transfers++;
+    MAP_uDMAChannelTransferSet(UDMA_CHANNEL_UART0TX | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+                           &UST_Buffer[UST_Tail], (void *)(UART0_BASE + UART_O_DR), Length);
+    MAP_uDMAChannelEnable(UDMA_CHANNEL_UART0TX);
+}
+
+//*****************************************************************************
+//
+// UST_Copy: Copies bytes into the ring (room checked by the caller) and starts
+// the transfer
+//
+//*****************************************************************************
+
+static void UST_Copy(const uint8_t *Data, uint32_t Length)
+{
+    uint32_t Head = UST_Head, Fill, lop;
+
+    for (lop = 0; lop < Length; lop++)
+    {
+        UST_Buffer[Head] = Data[lop];
+        Head = (Head + 1) & (UST_BUFFER_SIZE - 1);
+    }
+    UST_Stats.Bytes += Length;
+
+    MAP_IntDisable(INT_UART0);
+    UST_Head = Head;
+    Fill = (UST_Head - UST_Tail) & (UST_BUFFER_SIZE - 1);
+    if (Fill > UST_Stats.MaxFill)
+    {
+        UST_Stats.MaxFill = Fill;
+    }
+    UST_Kick();
+    MAP_IntEnable(INT_UART0);
+}
+
+//*****************************************************************************
+//
+// UartStreamInit: Configures the UART0 transmit uDMA channel; UART0 itself is
+// set up by the application
+//
+//*****************************************************************************
+
+void UartStreamInit(void)
+{
+    DMATableInit();
+
+    // Memory-to-peripheral, bytes, four per request (the UART asks at half-empty FIFO)
+    MAP_uDMAChannelAssign(UDMA_CH9_UART0TX);
+    MAP_uDMAChannelAttributeDisable(UDMA_CHANNEL_UART0TX, UDMA_ATTR_ALTSELECT | UDMA_ATTR_HIGH_PRIORITY |
+                                                      UDMA_ATTR_REQMASK | UDMA_ATTR_USEBURST);
+    MAP_uDMAChannelControlSet(UDMA_CHANNEL_UART0TX | UDMA_PRI_SELECT,
+                          UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_4);
+    MAP_UARTFIFOLevelSet(UART0_BASE, UART_FIFO_TX4_8, UART_FIFO_RX4_8);
+}
+
+//*****************************************************************************
+//
+// UartStreamStatsClear: Clears the statistics, e.g. when a stream starts
+//
+//*****************************************************************************
+
+void UartStreamStatsClear(void)
+{
+    UST_Stats.Records = 0;
+    UST_Stats.Drops = 0;
+    UST_Stats.Bytes = 0;
+    UST_Stats.Stalls = 0;
+    UST_Stats.MaxFill = 0;
+    UST_Stats.Transfers = 0;
+}
+
+//*****************************************************************************
+//
+// UartStreamStart: Routes UART0 output through the ring and clears the
+// statistics
+//
+//*****************************************************************************
+
+void UartStreamStart(void)
+{
+    if (UST_Active)
+    {
+        return;
+    }
+
+    UST_Head = 0;
+    UST_Tail = 0;
+    UST_InFlight = 0;
+    UartStreamStatsClear();
+
+    // Let bytes already written directly leave the FIFO before uDMA takes over
+    while (MAP_UARTBusy(UART0_BASE))
+    {
+    }
+    MAP_UARTDMAEnable(UART0_BASE, UART_DMA_TX);
+    MAP_IntEnable(INT_UART0);
+    UST_Active = true;
+}
+
+//*****************************************************************************
+//
+// UartStreamStop: Waits until the ring has been sent, then returns UART0 to
+// direct writes
+//
+//*****************************************************************************
+
+void UartStreamStop(void)
+{
+    if (!UST_Active)
+    {
+        return;
+    }
+
+    UartStreamFlush();
+
+    MAP_IntDisable(INT_UART0);
+    MAP_UARTDMADisable(UART0_BASE, UART_DMA_TX);
+    UST_Active = false;
+}
+
+//*****************************************************************************
+//
+// UartStreamFlush: Waits until the ring and the UART FIFO have been sent, e.g.
+// before the baud rate divider changes
+//
+//*****************************************************************************
+
+void UartStreamFlush(void)
+{
+    while ((UST_Head != UST_Tail) || UST_InFlight)
+    {
+    }
+    while (MAP_UARTBusy(UART0_BASE))
+    {
+    }
+}
+
+//*****************************************************************************
+//
+// UartStreamActive: Checks if UART0 output has to go through the ring
+//
+// \return true while a stream runs
+//
+//*****************************************************************************
+
+bool UartStreamActive(void)
+{
+    return UST_Active;
+}
+
+//*****************************************************************************
+//
+// UartStreamFree: Gets the room left in the ring (one slot stays empty), e.g.
+// to queue only as many records as fit
+//
+// \return Free bytes
+//
+//*****************************************************************************
+
+uint32_t UartStreamFree(void)
+{
+    return (UST_BUFFER_SIZE - 1) - ((UST_Head - UST_Tail) & (UST_BUFFER_SIZE - 1));
+}
+
+//*****************************************************************************
+//
+// UartStreamPut: Queues one sample record without waiting
+//
+// \param Data:     The record
+// \param Length:   Record length in bytes
+//
+// \return false if the record was dropped because the ring was full
+//
+//*****************************************************************************
+
+bool UartStreamPut(const uint8_t *Data, uint32_t Length)
+{
+    if (Length > UartStreamFree())
+    {
+        UST_Stats.Drops++;
+        return false;
+    }
+
+    UST_Stats.Records++;
+    UST_Copy(Data, Length);
+    return true;
+}
+
+//*****************************************************************************
+//
+// UartStreamWrite: Queues text, waiting for room in the ring as needed
+//
+// \param Data:     The bytes
+// \param Length:   Number of bytes
+//
+//*****************************************************************************
+
+void UartStreamWrite(const uint8_t *Data, uint32_t Length)
+{
+    uint32_t Chunk;
+    bool Stalled = false;
+
+    while (Length)
+    {
+        Chunk = UartStreamFree();
+        if (Chunk == 0)
+        {
+            Stalled = true;
+            continue;
+        }
+        if (Chunk > Length)
+        {
+            Chunk = Length;
+        }
+        UST_Copy(Data, Chunk);
+        Data += Chunk;
+        Length -= Chunk;
+    }
+
+    if (Stalled)
+    {
+        UST_Stats.Stalls++;
+    }
+}
+
+//*****************************************************************************
+//
+// UartStreamStatsGet: Copies the stream statistics
+//
+// \param Stats:    Pointer to the structure to fill in
+//
+//*****************************************************************************
+
+void UartStreamStatsGet(UartStreamStats *Stats)
+{
+    *Stats = UST_Stats;
+}
+
+//*****************************************************************************
+//
+// UartStreamIntHandler: UART0 interrupt; signals the end of a uDMA transfer.
+// Receive interrupts only wake the main loop; the characters are left in the
+// FIFO
+//
+//*****************************************************************************
+
+void UartStreamIntHandler(void)
+{
+    MAP_UARTIntClear(UART0_BASE, MAP_UARTIntStatus(UART0_BASE, true));
+
+    if (UST_InFlight && (MAP_uDMAChannelModeGet(UDMA_CHANNEL_UART0TX | UDMA_PRI_SELECT) == UDMA_MODE_STOP))
+    {
+        UST_Tail = (UST_Tail + UST_InFlight) & (UST_BUFFER_SIZE - 1);
+        UST_InFlight = 0;
+        UST_Kick();
+    }
+}
@@ -0,0 +1,46 @@
+/*
+ uart_stream.h
+
+ uDMA-driven UART0 transmit ring carrying all console output and live sample
+ streams; stream records that do not fit are dropped and counted instead of
+ stalling the main loop.
+ */
+
+#ifndef UART_STREAM_H_
+#define UART_STREAM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// UART Stream Settings
+//
+//*****************************************************************************
+
+#define UST_BUFFER_SIZE         4096        // Transmit ring (bytes, power of two)
+#define UST_MAX_TRANSFER        1024        // Bytes per uDMA transfer (uDMA limit)
+
+// Stream statistics, cleared by UartStreamStart and UartStreamStatsClear
+typedef struct {
+    uint32_t Records;               // Records queued by UartStreamPut
+    uint32_t Drops;                 // Records dropped because the ring was full
+    uint32_t Bytes;                 // Bytes queued (records and text)
+    uint32_t Stalls;                // UartStreamWrite calls that had to wait for room
+    uint32_t MaxFill;               // Highest ring fill level in bytes
+    uint32_t Transfers;             // uDMA transfers started
+} UartStreamStats;
+
+extern void UartStreamInit(void);
+extern void UartStreamStart(void);
+extern void UartStreamStop(void);
+extern void UartStreamFlush(void);
+extern bool UartStreamActive(void);
+extern void UartStreamStatsClear(void);
+extern uint32_t UartStreamFree(void);
+extern bool UartStreamPut(const uint8_t *Data, uint32_t Length);
+extern void UartStreamWrite(const uint8_t *Data, uint32_t Length);
+extern void UartStreamStatsGet(UartStreamStats *Stats);
+extern void UartStreamIntHandler(void);
+
+#endif /* UART_STREAM_H_ */